@@ -0,0 +1,140 @@
+// Photo strip timing: N shots as one pipelined burst against N single captures
+// back to back, each waiting for its file to be written as the single-shot
+// flow does.
+//
+//   burstbench [shots] [runs] [exposure-ms] [WxH@fps]
+//
+// Uses MockCamera on the offscreen platform. exposure-ms is the simulated
+// shutter time (150 by default). Without a stream spec every shot is the
+// 800x600 PNG test photo; with one, shots are JPEG frames grabbed from the
+// synthetic stream, which is closer to a real sensor.
+
+#include "mockcamera.h"
+#include "photosaveservice.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace {
+
+const int TIMEOUT_MS = 60000;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+bool waitUntil(const std::function<bool()>& done) {
+    // Keeps WaitForMoreEvents from sleeping past a condition set by a direct call
+    QTimer heartbeat;
+    heartbeat.start(5);
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > TIMEOUT_MS) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QTemporaryDir photosDir;
+    qputenv("PHOTOBOOTH_PHOTOS_DIR", photosDir.path().toLocal8Bit());
+    qInstallMessageHandler(messageHandler);
+    QApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int shots = std::max(1, args.size() > 1 ? args.at(1).toInt() : 4);
+    const int runs = std::max(1, args.size() > 2 ? args.at(2).toInt() : 10);
+    const int exposureMs = std::max(0, args.size() > 3 ? args.at(3).toInt() : 150);
+    const QString streamSpec = args.size() > 4 ? args.at(4) : QString();
+
+    MockCamera camera;
+    camera.setCaptureDelay(exposureMs);
+    if (!streamSpec.isEmpty()) {
+        MockCamera::StreamSettings settings;
+        if (!MockCamera::parseStreamSettings(streamSpec, &settings)) {
+            std::fprintf(stderr, "burstbench: invalid stream spec %s\n", qPrintable(streamSpec));
+            return 1;
+        }
+        camera.setStreamSettings(settings);
+    }
+    if (!camera.initialize()) {
+        std::fprintf(stderr, "burstbench: mock camera failed to initialize\n");
+        return 1;
+    }
+    camera.startPreview();
+    if (!streamSpec.isEmpty() && !waitUntil([&camera]() { return camera.streamStatistics().framesShown > 0; })) {
+        std::fprintf(stderr, "burstbench: no frames from the stream\n");
+        return 1;
+    }
+
+    int savedCount = 0;
+    int errorCount = 0;
+    bool burstDone = false;
+    QObject::connect(&camera, &ICamera::photoSaved, [&savedCount]() { ++savedCount; });
+    QObject::connect(&camera, &ICamera::captureError, [&errorCount]() { ++errorCount; });
+    QObject::connect(&camera, &ICamera::burstFinished, [&burstDone]() { burstDone = true; });
+
+    std::vector<double> sequentialMs;
+    std::vector<double> burstMs;
+    for (int run = 0; run < runs; ++run) {
+        // Alternate so any drift on the machine hits both equally
+        savedCount = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int shot = 0; shot < shots; ++shot) {
+            camera.capturePhoto();
+            if (!waitUntil([&]() { return savedCount > shot || errorCount > 0; }) || errorCount > 0) {
+                std::fprintf(stderr, "burstbench: single capture failed\n");
+                return 1;
+            }
+        }
+        sequentialMs.push_back(timer.nsecsElapsed() / 1e6);
+
+        burstDone = false;
+        timer.restart();
+        camera.startBurst(shots, 0);
+        if (!waitUntil([&]() { return burstDone || errorCount > 0; }) || errorCount > 0) {
+            std::fprintf(stderr, "burstbench: burst failed\n");
+            return 1;
+        }
+        burstMs.push_back(timer.nsecsElapsed() / 1e6);
+    }
+
+    PhotoSaveService *service = PhotoSaveService::instance();
+    std::printf("burstbench: %d shots, %d runs, %d ms exposure, %s, %d save workers\n\n",
+                shots, runs, exposureMs, streamSpec.isEmpty() ? "800x600 png" : qPrintable(streamSpec + " jpg"),
+                service->workerCount());
+    std::printf("  %-12s %12s %12s\n", "mode", "strip ms", "per shot ms");
+    const double sequential = median(sequentialMs);
+    const double burst = median(burstMs);
+    std::printf("  %-12s %12.1f %12.1f\n", "sequential", sequential, sequential / shots);
+    std::printf("  %-12s %12.1f %12.1f\n", "burst", burst, burst / shots);
+    if (burst > 0) {
+        std::printf("\nspeedup: %.2fx\n", sequential / burst);
+    }
+
+    camera.stopPreview();
+    camera.cleanup();
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Green-screen keying on stills: time to key a frame and composite a land
+// behind it at preview and capture size, scalar and SIMD on one thread and
+// SIMD over the keyer's pool, and how well the matte separates a known
+// scene.
+//
+//   chromabench [photo] [backdrop] [passes]
+//
+// photo is a shot against the booth's screen, keyed with the booth's saved
+// settings (see ChromaKeyer); without one a synthetic scene is used, a
+// figure with a soft edge on a lit green screen, keyed with the defaults,
+// and the matte is checked: figure pixels unchanged, screen pixels fully
+// replaced, no green left in between. backdrop defaults to :/land1.jpg, or a
+// gradient without the resources. Each timing is the median of passes (20)
+// runs. The preview has to key at 25 fps; scalar and SIMD must agree bit for
+// bit.
+
+#include "chromakeyer.h"
+#include "simd.h"
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double PREVIEW_BUDGET_MS = 1000.0 / 25.0;
+const double CAPTURE_BUDGET_MS = 100.0;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+// Unevenly lit screen with noise, a warm figure in the middle with a blurred
+// rim where it blends into the screen, and the figure region for checking
+QImage syntheticScene(const QSize& size, QRect *figure) {
+    QImage scene(size, QImage::Format_RGB32);
+    QRandomGenerator random(11);
+    const QPointF centre(size.width() * 0.5, size.height() * 0.55);
+    const double radius = size.height() * 0.3;
+    const double rim = size.height() * 0.02;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *row = reinterpret_cast<QRgb*>(scene.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const int light = 150 + 40 * x / size.width() - 30 * y / size.height() + random.bounded(-6, 7);
+            const QRgb screen = qRgb(40 + random.bounded(8), light, 50 + random.bounded(8));
+            const QRgb skin = qRgb(215 + random.bounded(-8, 8), 170 + random.bounded(-8, 8), 140);
+            const double distance = std::hypot(x - centre.x(), y - centre.y()) - radius;
+            const double inside = std::clamp(0.5 - distance / rim, 0.0, 1.0);
+            row[x] = qRgb(qRound(qRed(skin) * inside + qRed(screen) * (1 - inside)),
+                          qRound(qGreen(skin) * inside + qGreen(screen) * (1 - inside)),
+                          qRound(qBlue(skin) * inside + qBlue(screen) * (1 - inside)));
+        }
+    }
+    const int inner = qRound(radius * 0.7);
+    *figure = QRect(qRound(centre.x()) - inner / 2, qRound(centre.y()) - inner / 2, inner, inner);
+    return scene;
+}
+
+QImage fallbackBackdrop() {
+    QImage backdrop(1600, 1200, QImage::Format_RGB32);
+    QPainter painter(&backdrop);
+    QLinearGradient gradient(0, 0, 0, backdrop.height());
+    gradient.setColorAt(0, QColor(120, 160, 230));
+    gradient.setColorAt(1, QColor(200, 120, 60));
+    painter.fillRect(backdrop.rect(), gradient);
+    return backdrop;
+}
+
+double medianMs(ChromaKeyer *keyer, const QImage& source, const QImage& backdrop, int passes, QImage *keyed) {
+    std::vector<double> samples;
+    for (int pass = 0; pass < passes; ++pass) {
+        QImage image = source.copy();
+        QElapsedTimer timer;
+        timer.start();
+        keyer->composite(&image, backdrop);
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+        *keyed = image;
+    }
+    return percentile(samples, 0.5);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const QString photoPath = args.size() > 1 ? args.at(1) : QString();
+    const QString backdropPath = args.size() > 2 ? args.at(2) : QString(":/land1.jpg");
+    const int passes = std::max(1, args.size() > 3 ? args.at(3).toInt() : 20);
+
+    QImage photo;
+    if (!photoPath.isEmpty()) {
+        photo = QImage(photoPath).convertToFormat(QImage::Format_RGB32);
+        if (photo.isNull()) {
+            std::fprintf(stderr, "chromabench: cannot read %s\n", qPrintable(photoPath));
+            return 1;
+        }
+    }
+    QImage backdrop(backdropPath);
+    if (backdrop.isNull()) {
+        backdrop = fallbackBackdrop();
+    }
+
+    // A synthetic scene is keyed with the defaults, not whatever the booth has saved
+    QTemporaryDir scratch;
+    const QString settingsPath = photo.isNull() ? scratch.filePath("chromakey.ini")
+                                                : ChromaKeyer::defaultSettingsPath();
+    ChromaKeyer single(settingsPath, 1);
+    ChromaKeyer threaded(settingsPath);
+    const ChromaKeyer::Settings settings = threaded.settings();
+
+    const QSize sizes[2] = {QSize(640, 480), QSize(1920, 1080)};
+    std::printf("chromabench: %s, %d threads, %s scene, %s screen, threshold %d, softness %d, spill %d%%, "
+                "median of %d\n\n", Simd::name(), threaded.threadCount(), photo.isNull() ? "synthetic" : "photo",
+                settings.screen == ChromaKeyer::Blue ? "blue" : "green", settings.threshold, settings.softness,
+                settings.spill, passes);
+    std::printf("%-10s %9s %9s %9s\n", "size", "scalar", "simd", "threaded");
+
+    bool identical = true;
+    bool separated = true;
+    double worst[2] = {0.0, 0.0};
+    for (int s = 0; s < 2; ++s) {
+        QRect figure;
+        const QImage scene = photo.isNull() ? syntheticScene(sizes[s], &figure)
+                                            : photo.scaled(sizes[s], Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        QImage keyed[3];
+        double ms[3];
+        single.setSimdEnabled(false);
+        ms[0] = medianMs(&single, scene, backdrop, passes, &keyed[0]);
+        single.setSimdEnabled(true);
+        ms[1] = medianMs(&single, scene, backdrop, passes, &keyed[1]);
+        ms[2] = medianMs(&threaded, scene, backdrop, passes, &keyed[2]);
+        worst[s] = ms[2];
+        identical = identical && keyed[0] == keyed[1] && keyed[1] == keyed[2];
+        std::printf("%4dx%-5d %9.2f %9.2f %9.2f ms\n", sizes[s].width(), sizes[s].height(), ms[0], ms[1], ms[2]);
+
+        if (!photo.isNull()) {
+            continue;
+        }
+        // The figure must come through untouched, the far corners must be
+        // pure backdrop and no pixel may keep a green cast
+        QImage plate(sizes[s], QImage::Format_RGB32);
+        plate.fill(qRgb(0, 255, 0));
+        const QImage expected = threaded.composited(plate, backdrop);
+        const QRect corner(0, 0, sizes[s].width() / 10, sizes[s].height() / 10);
+        int figureChanged = 0;
+        int screenLeft = 0;
+        int greenCast = 0;
+        for (int y = 0; y < sizes[s].height(); ++y) {
+            const QRgb *in = reinterpret_cast<const QRgb*>(scene.constScanLine(y));
+            const QRgb *out = reinterpret_cast<const QRgb*>(keyed[2].constScanLine(y));
+            const QRgb *back = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+            for (int x = 0; x < sizes[s].width(); ++x) {
+                figureChanged += figure.contains(x, y) && out[x] != in[x];
+                screenLeft += corner.contains(x, y) && out[x] != back[x];
+                greenCast += qGreen(out[x]) > std::max(qRed(out[x]), qBlue(out[x])) + settings.threshold &&
+                             qGreen(back[x]) <= std::max(qRed(back[x]), qBlue(back[x])) + settings.threshold;
+            }
+        }
+        std::printf("%10s figure changed %d, screen left %d, green cast %d pixels\n", "", figureChanged, screenLeft,
+                    greenCast);
+        separated = separated && figureChanged == 0 && screenLeft == 0 && greenCast == 0;
+    }
+
+    const bool fast = worst[0] <= PREVIEW_BUDGET_MS && worst[1] < CAPTURE_BUDGET_MS;
+    std::printf("\npreview under %.0f ms (%.2f), capture under %.0f ms (%.2f): %s\n", PREVIEW_BUDGET_MS, worst[0],
+                CAPTURE_BUDGET_MS, worst[1], fast ? "ok" : "FAILED");
+    std::printf("scalar, SIMD and threaded identical: %s\n", identical ? "ok" : "FAILED");
+    if (photo.isNull()) {
+        std::printf("matte separates the synthetic scene: %s\n", separated ? "ok" : "FAILED");
+    }
+    return fast && identical && separated ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// Reading a captured JPEG back for display: full decode then scale, against
+// ImageDecoder's reduced-size decode then scale.
+//
+//   decodebench [iterations] [WxH]
+//
+// Without a size, runs the Pi's 1920x1080 capture and a 4056x3040 HQ camera
+// capture. Targets are the sizes the booth shows a photo at. The MB columns are
+// the image the decoder allocates, which is the peak for the read; the
+// scaled result is small next to it.
+
+#include "imagedecoder.h"
+#include "imagedownscaler.h"
+#include "photocompositor.h"
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QWidget>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+QImage makePhoto(const QSize& size) {
+    QImage image(size, QImage::Format_RGB32);
+    QPainter painter(&image);
+    QLinearGradient gradient(0, 0, size.width(), size.height());
+    gradient.setColorAt(0, QColor(230, 180, 140));
+    gradient.setColorAt(1, QColor(40, 60, 90));
+    painter.fillRect(image.rect(), gradient);
+    // Detail, so the JPEG isn't trivially compressible
+    painter.setPen(QColor(20, 20, 20));
+    for (int x = 0; x < size.width(); x += 7) {
+        painter.drawLine(x, 0, x + size.height() / 3, size.height());
+    }
+    painter.setBrush(QColor(250, 220, 190));
+    painter.drawEllipse(QPoint(size.width() / 2, size.height() / 2), size.height() / 4, size.height() / 3);
+    return image;
+}
+
+struct Sample {
+    double medianMs = 0.0;
+    double decodedMb = 0.0;
+};
+
+// decode returns the decoded image; its size is what the read allocated
+Sample measure(int iterations, const std::function<QImage()>& decode, const QSize& target) {
+    Sample sample;
+    std::vector<double> times;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        QImage decoded = decode();
+        QImage shown = ImageDownscaler::areaAverage(decoded, ImageDownscaler::fitSize(decoded.size(), target));
+        times.push_back(timer.nsecsElapsed() / 1e6);
+        if (shown.isNull()) {
+            return Sample();
+        }
+        sample.decodedMb = decoded.sizeInBytes() / (1024.0 * 1024.0);
+    }
+    std::sort(times.begin(), times.end());
+    sample.medianMs = times[times.size() / 2];
+    return sample;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int iterations = std::max(1, args.size() > 1 ? args.at(1).toInt() : 10);
+    QList<QSize> sources = {QSize(1920, 1080), QSize(4056, 3040)};
+    if (args.size() > 2) {
+        QRegularExpressionMatch match = QRegularExpression("^(\\d+)x(\\d+)$").match(args.at(2));
+        if (!match.hasMatch()) {
+            std::fprintf(stderr, "decodebench: expected WIDTHxHEIGHT, got %s\n", qPrintable(args.at(2)));
+            return 1;
+        }
+        sources = {QSize(match.captured(1).toInt(), match.captured(2).toInt())};
+    }
+
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        std::fprintf(stderr, "decodebench: cannot create a temporary directory\n");
+        return 1;
+    }
+
+    struct Target {
+        const char* name;
+        QSize size;
+    };
+    const Target targets[] = {
+        {"print", QSize(PhotoCompositor::PHOTO_BOX_WIDTH, PhotoCompositor::PHOTO_BOX_HEIGHT)},
+        {"review", QSize(800, 480)},
+        {"strip", QSize(320, QWIDGETSIZE_MAX)},
+        {"gallery", QSize(160, 120)},
+    };
+
+    std::printf("decodebench: %d iterations\n", iterations);
+    for (const QSize& source : sources) {
+        const QString path = directory.filePath(QString("capture_%1x%2.jpg").arg(source.width()).arg(source.height()));
+        if (!makePhoto(source).save(path, "JPEG", 95)) {
+            std::fprintf(stderr, "decodebench: cannot write %s\n", qPrintable(path));
+            return 1;
+        }
+
+        std::printf("\n%dx%d JPEG\n", source.width(), source.height());
+        std::printf("  %-8s %5s %12s %12s %12s %12s %8s\n", "target", "scale",
+                    "full ms", "reduced ms", "full MB", "reduced MB", "speedup");
+        for (const Target& target : targets) {
+            const Sample full = measure(iterations, [&]() { return QImage(path); }, target.size);
+            const Sample reduced = measure(iterations, [&]() { return ImageDecoder::read(path, target.size); },
+                                           target.size);
+            std::printf("  %-8s  1/%-2d %12.2f %12.2f %12.2f %12.2f %7.1fx\n", target.name,
+                        ImageDecoder::scaleDenominator(source, target.size),
+                        full.medianMs, reduced.medianMs, full.decodedMb, reduced.decodedMb,
+                        reduced.medianMs > 0.0 ? full.medianMs / reduced.medianMs : 0.0);
+        }
+    }
+    return 0;
+}
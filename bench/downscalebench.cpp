@@ -0,0 +1,132 @@
+// Review image downscaling: ImageDownscaler against QImage::scaled() at the
+// ratios the review screen sees.
+//
+//   downscalebench [iterations] [WxH]
+//
+// The source is a 1920x1080 capture unless given. Run it on both the
+// desktop build (SSE2) and the Pi (NEON); the kernel in use is printed in
+// the header. The booth shows "nearest" on the GUI thread and replaces it
+// with "area" from a worker.
+
+#include "imagedownscaler.h"
+#include "simd.h"
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+QImage makePhoto(const QSize& size) {
+    QImage image(size, QImage::Format_RGB32);
+    QPainter painter(&image);
+    QLinearGradient gradient(0, 0, size.width(), size.height());
+    gradient.setColorAt(0, QColor(230, 180, 140));
+    gradient.setColorAt(1, QColor(40, 60, 90));
+    painter.fillRect(image.rect(), gradient);
+    // Fine detail, so aliasing in the cheap scalers costs something
+    painter.setPen(QColor(20, 20, 20));
+    for (int x = 0; x < size.width(); x += 7) {
+        painter.drawLine(x, 0, x + size.height() / 3, size.height());
+    }
+    painter.setBrush(QColor(250, 220, 190));
+    painter.drawEllipse(QPoint(size.width() / 2, size.height() / 2), size.height() / 4, size.height() / 3);
+    return image;
+}
+
+double medianMs(int iterations, const std::function<QImage()>& scale) {
+    std::vector<double> samples;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        QImage result = scale();
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+        if (result.isNull()) {
+            return -1.0;
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Mean absolute difference per channel against a reference of the same size
+double meanDifference(const QImage& image, const QImage& reference) {
+    const QImage a = image.convertToFormat(QImage::Format_RGB32);
+    const QImage b = reference.convertToFormat(QImage::Format_RGB32);
+    if (a.size() != b.size()) {
+        return -1.0;
+    }
+    qint64 total = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const QRgb *rowA = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+        const QRgb *rowB = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x) {
+            total += std::abs(qRed(rowA[x]) - qRed(rowB[x]))
+                   + std::abs(qGreen(rowA[x]) - qGreen(rowB[x]))
+                   + std::abs(qBlue(rowA[x]) - qBlue(rowB[x]));
+        }
+    }
+    return static_cast<double>(total) / (3.0 * a.width() * a.height());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int iterations = std::max(1, args.size() > 1 ? args.at(1).toInt() : 30);
+    QSize sourceSize(1920, 1080);
+    if (args.size() > 2) {
+        QRegularExpressionMatch match = QRegularExpression("^(\\d+)x(\\d+)$").match(args.at(2));
+        if (!match.hasMatch()) {
+            std::fprintf(stderr, "downscalebench: expected WIDTHxHEIGHT, got %s\n", qPrintable(args.at(2)));
+            return 1;
+        }
+        sourceSize = QSize(match.captured(1).toInt(), match.captured(2).toInt());
+    }
+
+    const QImage photo = makePhoto(sourceSize);
+    std::printf("downscalebench: %dx%d source, %d iterations, %s\n\n",
+                sourceSize.width(), sourceSize.height(), iterations, Simd::name());
+    std::printf("  %-7s %-10s %10s %10s %10s %10s  %s\n", "ratio", "target",
+                "qt smooth", "qt fast", "nearest", "area", "area vs smooth");
+
+    const double ratios[] = {2.0, 2.4, 3.0, 4.0};
+    for (double ratio : ratios) {
+        const QSize target = ImageDownscaler::fitSize(sourceSize, QSize(qRound(sourceSize.width() / ratio),
+                                                                        qRound(sourceSize.height() / ratio)));
+        const double smooth = medianMs(iterations, [&]() {
+            return photo.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        });
+        const double fast = medianMs(iterations, [&]() {
+            return photo.scaled(target, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        });
+        const double nearest = medianMs(iterations, [&]() { return ImageDownscaler::nearest(photo, target); });
+        const double area = medianMs(iterations, [&]() { return ImageDownscaler::areaAverage(photo, target); });
+
+        const double difference = meanDifference(ImageDownscaler::areaAverage(photo, target),
+                                                 photo.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+        const QString label = QString("%1x%2").arg(target.width()).arg(target.height());
+        std::printf("  %-7.1f %-10s %10.2f %10.2f %10.2f %10.2f  %.2f levels, %.1fx faster\n",
+                    ratio, qPrintable(label), smooth, fast, nearest, area,
+                    difference, area > 0.0 ? smooth / area : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Face and smile detection over a recorded set of preview frames: time per
+// frame, including the grayscale conversion FaceTracker does for RGB
+// frames, and what was found.
+//
+//   facebench [frames-dir] [passes]
+//
+// Reads every .jpg and .png in frames-dir, in name order, as the preview
+// delivered them; record a set on the booth with, for example,
+// rpicam-vid -t 20000 --width 1280 --height 720 --codec mjpeg --segment 1 -o frame%04d.jpg
+// Without a directory, times synthetic 1280x720 scenes, where detections
+// mean nothing. Runs passes (3) over the set on this thread only, so the
+// rate is what one core sustains; the booth needs 15 detections a second.
+// Cascades come from PHOTOBOOTH_FACE_CASCADE and PHOTOBOOTH_SMILE_CASCADE
+// as in the app.
+
+#include "facedetector.h"
+#include <QGuiApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double REQUIRED_RATE = 15.0;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+// Textured background and a few face-sized blobs, so the early stages see
+// something like a room
+QImage syntheticScene(int index) {
+    QImage scene(1280, 720, QImage::Format_RGB32);
+    QRandomGenerator random(index + 1);
+    QPainter painter(&scene);
+    QLinearGradient gradient(0, 0, scene.width(), scene.height());
+    gradient.setColorAt(0, QColor(90, 80, 70));
+    gradient.setColorAt(1, QColor(30, 40, 60));
+    painter.fillRect(scene.rect(), gradient);
+    for (int i = 0; i < 400; ++i) {
+        painter.fillRect(random.bounded(scene.width()), random.bounded(scene.height()), random.bounded(4, 60),
+                         random.bounded(4, 60), QColor::fromHsv(random.bounded(360), 60, random.bounded(40, 200)));
+    }
+    painter.setPen(Qt::NoPen);
+    for (int face = 0; face < 3; ++face) {
+        const QPoint centre(300 + face * 340 + random.bounded(-40, 40), 330 + random.bounded(-40, 40));
+        painter.setBrush(QColor(225, 185, 150));
+        painter.drawEllipse(centre, 90, 120);
+        painter.setBrush(QColor(40, 30, 30));
+        painter.drawEllipse(centre + QPoint(-35, -25), 14, 9);
+        painter.drawEllipse(centre + QPoint(35, -25), 14, 9);
+        painter.drawEllipse(centre + QPoint(0, 55), 35, 10);
+    }
+    return scene;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const QString framesDir = args.size() > 1 ? args.at(1) : QString();
+    const int passes = std::max(1, args.size() > 2 ? args.at(2).toInt() : 3);
+
+    FaceDetector detector;
+    QString errorMessage;
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    if (!detector.load(FaceDetector::defaultFaceCascadePath(), FaceDetector::defaultSmileCascadePath(),
+                       &errorMessage)) {
+        std::fprintf(stderr, "facebench: %s\n", qPrintable(errorMessage));
+        return 1;
+    }
+    const qint64 loadMs = loadTimer.elapsed();
+
+    std::vector<QImage> frames;
+    if (!framesDir.isEmpty()) {
+        const QStringList names = QDir(framesDir).entryList({"*.jpg", "*.jpeg", "*.png"}, QDir::Files, QDir::Name);
+        for (const QString& name : names) {
+            QImage frame(QDir(framesDir).filePath(name));
+            if (!frame.isNull()) {
+                frames.push_back(frame.convertToFormat(QImage::Format_RGB32));
+            }
+        }
+        if (frames.empty()) {
+            std::fprintf(stderr, "facebench: no frames in %s\n", qPrintable(framesDir));
+            return 1;
+        }
+    } else {
+        for (int i = 0; i < 30; ++i) {
+            frames.push_back(syntheticScene(i));
+        }
+    }
+
+    std::printf("facebench: %zu %s frames of %dx%d, %d passes, smiles %s, cascades loaded in %lld ms\n\n",
+                frames.size(), framesDir.isEmpty() ? "synthetic" : "recorded", frames.front().width(),
+                frames.front().height(), passes, detector.detectsSmiles() ? "on" : "off",
+                static_cast<long long>(loadMs));
+
+    std::vector<double> samples;
+    quint64 faces = 0;
+    quint64 smiling = 0;
+    quint64 framesWithFaces = 0;
+    double totalMs = 0.0;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (const QImage& frame : frames) {
+            QElapsedTimer timer;
+            timer.start();
+            const QList<FaceDetector::Face> found = detector.detect(frame.convertToFormat(QImage::Format_Grayscale8));
+            const double ms = timer.nsecsElapsed() / 1e6;
+            samples.push_back(ms);
+            totalMs += ms;
+            if (pass == 0) {
+                faces += found.size();
+                framesWithFaces += found.isEmpty() ? 0 : 1;
+                smiling += std::count_if(found.begin(), found.end(),
+                                         [](const FaceDetector::Face& face) { return face.smiling; });
+            }
+        }
+    }
+
+    const double rate = 1000.0 * samples.size() / totalMs;
+    const double p95 = percentile(samples, 0.95);
+    std::printf("per frame  p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms\n", percentile(samples, 0.50), p95,
+                percentile(samples, 0.99), percentile(samples, 1.0));
+    std::printf("rate       %.1f detections/s on one core\n", rate);
+    std::printf("found      %llu faces in %llu of %zu frames, %llu smiling\n", static_cast<unsigned long long>(faces),
+                static_cast<unsigned long long>(framesWithFaces), frames.size(),
+                static_cast<unsigned long long>(smiling));
+
+    // The tracker runs at the rate only if nearly every frame fits the interval
+    const bool fast = rate >= REQUIRED_RATE && p95 <= 1000.0 / REQUIRED_RATE;
+    std::printf("\n%.0f detections/s with p95 under %.1f ms: %s\n", REQUIRED_RATE, 1000.0 / REQUIRED_RATE,
+                fast ? "ok" : "FAILED");
+    return fast ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+// Gallery: thumbnail store fill and reopen, scroll repaint time over the
+// whole list, and search latency.
+//
+//   gallerybench [photos]
+//
+// Adds photos (20000 by default) to a fresh store, reopens it, then scrolls
+// an 800x480 gallery from top to bottom a screenful at a time, repainting
+// synchronously so each frame's cost is measured rather than coalesced. Set
+// TMPDIR to put the store on the SD card being measured.
+
+#include "gallerymodel.h"
+#include "thumbnailstore.h"
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QListView>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+// A camera-sized frame that differs from shot to shot
+QImage makePhoto(int shot) {
+    QImage photo(1920, 1080, QImage::Format_RGB32);
+    photo.fill(QColor::fromHsv(shot * 37 % 360, 160, 200));
+    QPainter painter(&photo);
+    painter.fillRect(photo.width() / 4, photo.height() / 4, photo.width() / 2, photo.height() / 2,
+                     QColor::fromHsv(shot * 91 % 360, 200, 120));
+    return photo;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int photos = std::max(1, args.size() > 1 ? args.at(1).toInt() : 20000);
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "gallerybench: cannot create a temporary directory\n");
+        return 1;
+    }
+    const QString directory = QDir(workDir.path()).absoluteFilePath("thumbnails");
+    std::printf("gallerybench: %d photos, %s\n\n", photos, qPrintable(directory));
+
+    // A handful of distinct frames is enough; scaling cost doesn't depend on content
+    std::vector<QImage> frames;
+    for (int i = 0; i < 8; ++i) {
+        frames.push_back(makePhoto(i));
+    }
+
+    // Fill
+    const QDateTime start(QDate(2025, 6, 21), QTime(10, 0));
+    std::vector<double> addMs;
+    addMs.reserve(photos);
+    {
+        ThumbnailStore store(directory);
+        if (!store.isOpen()) {
+            std::fprintf(stderr, "gallerybench: cannot open store\n");
+            return 1;
+        }
+        for (int i = 0; i < photos; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            store.add(frames[i % frames.size()],
+                      QString("/home/pi/Pictures/PhotoBooth/photo_%1.jpg").arg(i, 6, 10, QChar('0')),
+                      QString("Guest %1").arg(i), start.addSecs(i * 45));
+            addMs.push_back(timer.nsecsElapsed() / 1e6);
+        }
+    }
+    std::printf("add       median %.2f ms, p99 %.2f ms, max %.2f ms per photo\n",
+                percentile(addMs, 0.5), percentile(addMs, 0.99), percentile(addMs, 1.0));
+
+    // Reopen
+    QElapsedTimer timer;
+    timer.start();
+    ThumbnailStore store(directory);
+    const double openMs = timer.nsecsElapsed() / 1e6;
+    std::printf("reopen    %.1f ms for %d thumbnails\n", openMs, store.count());
+
+    timer.start();
+    GalleryModel model(&store);
+    std::printf("model     %.1f ms to build %d rows\n", timer.nsecsElapsed() / 1e6, model.rowCount());
+
+    QListView view;
+    view.setViewMode(QListView::IconMode);
+    view.setResizeMode(QListView::Adjust);
+    view.setMovement(QListView::Static);
+    view.setUniformItemSizes(true);
+    view.setLayoutMode(QListView::Batched);
+    view.setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    view.setModel(&model);
+    view.setItemDelegate(new GalleryDelegate(&store, &view));
+    view.resize(800, 480);
+    timer.start();
+    view.show();
+    view.doItemsLayout();
+    app.processEvents();
+    std::printf("layout    %.1f ms\n", timer.nsecsElapsed() / 1e6);
+
+    // Scroll top to bottom; the first pass maps the pixel areas, the second is warm
+    QScrollBar *scrollBar = view.verticalScrollBar();
+    const int step = std::max(1, view.viewport()->height() / 4);
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<double> frameMs;
+        for (int position = 0; position <= scrollBar->maximum(); position += step) {
+            scrollBar->setValue(position);
+            timer.start();
+            view.viewport()->repaint();
+            frameMs.push_back(timer.nsecsElapsed() / 1e6);
+        }
+        std::printf("scroll    %s: %zu frames, median %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                    pass == 0 ? "cold" : "warm", frameMs.size(),
+                    percentile(frameMs, 0.5), percentile(frameMs, 0.99), percentile(frameMs, 1.0));
+    }
+
+    // Search
+    const struct {
+        const char* label;
+        QString text;
+    } searches[] = {
+        {"name", "guest 1234"},
+        {"time", start.addSecs(photos / 2 * 45).toString("yyyy-MM-dd hh:")},
+        {"clear", QString()},
+    };
+    bool complete = true;
+    for (const auto& search : searches) {
+        timer.start();
+        model.setFilter(search.text);
+        view.viewport()->repaint();
+        std::printf("search    %-5s %.1f ms, %d rows\n", search.label, timer.nsecsElapsed() / 1e6, model.rowCount());
+        if (search.text.isEmpty()) {
+            complete = model.rowCount() == photos;
+        }
+    }
+
+    std::printf("\nall photos listed: %s\n", complete ? "ok" : "FAILED");
+    return complete ? 0 : 1;
+}
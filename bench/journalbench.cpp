@@ -0,0 +1,158 @@
+// Session journal: append latency on the calling thread, group commit
+// batching, recovery after a torn write, index rebuild and range queries.
+//
+//   journalbench [sessions] [queries]
+//
+// Appends sessions (200000 by default) spread over a year, with the clock
+// occasionally jumping back as it does on a Pi that boots without NTP. Then
+// tears the last record, reopens, checks every committed session survived,
+// and times one-day range queries against a scan of the whole journal. Set
+// TMPDIR to put the journal on the SD card being measured.
+
+#include "sessionjournal.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const qint64 DAY_MS = 24LL * 60 * 60 * 1000;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    qInstallMessageHandler(messageHandler);
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int sessions = std::max(1, args.size() > 1 ? args.at(1).toInt() : 200000);
+    const int queries = std::max(1, args.size() > 2 ? args.at(2).toInt() : 200);
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "journalbench: cannot create a temporary directory\n");
+        return 1;
+    }
+    const QString directory = QDir(workDir.path()).absoluteFilePath("journal");
+    const qint64 yearStartMs = QDateTime(QDate(2025, 1, 1), QTime(0, 0)).toMSecsSinceEpoch();
+    const qint64 spacingMs = 365 * DAY_MS / sessions;
+    QRandomGenerator random(42);
+
+    std::printf("journalbench: %d sessions, %d queries, %s\n\n", sessions, queries, qPrintable(directory));
+
+    // Append
+    std::vector<double> appendUs;
+    appendUs.reserve(sessions);
+    QElapsedTimer total;
+    total.start();
+    SessionJournal::Statistics written;
+    {
+        SessionJournal journal(directory);
+        if (!journal.isOpen()) {
+            std::fprintf(stderr, "journalbench: cannot open journal\n");
+            return 1;
+        }
+        qint64 clockMs = yearStartMs;
+        for (int i = 0; i < sessions; ++i) {
+            clockMs += spacingMs;
+            // One in a thousand sessions starts with the clock a day behind
+            const qint64 startMs = random.bounded(1000) == 0 ? clockMs - DAY_MS : clockMs;
+
+            SessionJournal::Entry entry;
+            entry.startTime = QDateTime::fromMSecsSinceEpoch(startMs);
+            entry.endTime = QDateTime::fromMSecsSinceEpoch(startMs + 90000);
+            entry.userName = QString("Guest %1").arg(i);
+            entry.weaponId = QString("weapon%1").arg(i % 4 + 1);
+            entry.landId = QString("land%1").arg(i % 3 + 1);
+            entry.companionId = QString("companion%1").arg(i % 4 + 1);
+            entry.photoPath = QString("/home/pi/Pictures/PhotoBooth/photo_2025-01-01_00-00-00_%1.jpg").arg(i, 4, 10, QChar('0'));
+            entry.printPath = QString(entry.photoPath).replace(".jpg", "_print.jpg");
+
+            QElapsedTimer timer;
+            timer.start();
+            journal.append(entry);
+            appendUs.push_back(timer.nsecsElapsed() / 1e3);
+        }
+        if (!journal.waitForCommitted(600000)) {
+            std::fprintf(stderr, "journalbench: timed out waiting for commits\n");
+            return 1;
+        }
+        written = journal.statistics();
+    }
+    const double appendSeconds = total.elapsed() / 1000.0;
+    std::printf("append    median %.1f us, p99 %.1f us, max %.1f us on the caller\n",
+                percentile(appendUs, 0.5), percentile(appendUs, 0.99), percentile(appendUs, 1.0));
+    std::printf("commit    %llu syncs for %llu sessions (%.1f per sync), slowest %.1f ms, %.0f sessions/s\n",
+                static_cast<unsigned long long>(written.commits), static_cast<unsigned long long>(written.entries),
+                written.commits ? static_cast<double>(written.entries) / written.commits : 0.0,
+                written.maxCommitNs / 1e6, sessions / appendSeconds);
+    std::printf("size      %.1f MB log, %d index blocks\n", written.logBytes / (1024.0 * 1024.0), written.indexBlocks);
+
+    // Power loss in the middle of the next record
+    QFile log(QDir(directory).filePath("sessions.log"));
+    if (!log.open(QIODevice::Append)) {
+        std::fprintf(stderr, "journalbench: cannot open log\n");
+        return 1;
+    }
+    const QByteArray torn("\x80\x00\x00\x00\x12\x34\x56\x78partial record", 22);
+    log.write(torn);
+    log.close();
+
+    std::unique_ptr<SessionJournal> journal;
+    QElapsedTimer timer;
+    timer.start();
+    journal = std::make_unique<SessionJournal>(directory);
+    const double recoverMs = timer.nsecsElapsed() / 1e6;
+    SessionJournal::Statistics recovered = journal->statistics();
+    std::printf("recover   %.1f ms, %lld torn bytes truncated, %llu sessions\n", recoverMs,
+                static_cast<long long>(recovered.truncatedBytes), static_cast<unsigned long long>(recovered.entries));
+    const bool intact = recovered.entries == written.entries && recovered.truncatedBytes == torn.size();
+
+    // Lost index
+    journal.reset();
+    QFile::remove(QDir(directory).filePath("sessions.idx"));
+    timer.start();
+    journal = std::make_unique<SessionJournal>(directory);
+    std::printf("reindex   %.1f ms for %d blocks\n", timer.nsecsElapsed() / 1e6, journal->statistics().indexBlocks);
+
+    // Range queries
+    std::vector<double> dayMs;
+    qint64 found = 0;
+    for (int i = 0; i < queries; ++i) {
+        const qint64 fromMs = yearStartMs + random.bounded(364) * DAY_MS;
+        timer.start();
+        found += journal->query(QDateTime::fromMSecsSinceEpoch(fromMs), QDateTime::fromMSecsSinceEpoch(fromMs + DAY_MS)).size();
+        dayMs.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    timer.start();
+    const int all = journal->query(QDateTime::fromMSecsSinceEpoch(0), QDateTime::fromMSecsSinceEpoch(yearStartMs + 2 * 365 * DAY_MS)).size();
+    const double allMs = timer.nsecsElapsed() / 1e6;
+    std::printf("query     one day: median %.2f ms, p99 %.2f ms, %.0f sessions each\n",
+                percentile(dayMs, 0.5), percentile(dayMs, 0.99), static_cast<double>(found) / queries);
+    std::printf("          everything: %.1f ms for %d sessions\n", allMs, all);
+
+    const bool complete = all == sessions;
+    std::printf("\nrecovery: %s, full scan: %s\n", intact ? "ok" : "FAILED", complete ? "ok" : "FAILED");
+    return intact && complete ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// What a log line costs the thread that writes it: a message in a disabled
+// category, a message queued into BoothLog's ring, and the same line written
+// and flushed to a file synchronously, as stderr into journald did before.
+//
+//   logbench [messages] [threads]
+//
+// Then threads (4) threads log messages (20000) between them while the
+// writer drains the ring to the file, and every message must either be in
+// the file or counted as overwritten; the ring holds 4096. Last, a dump of
+// the last minute must end with the last message logged.
+
+#include "boothlog.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int RING_SLOTS = 4096;
+const double DISABLED_BUDGET_NS = 50.0;
+
+Q_LOGGING_CATEGORY(lcBenchOff, "bench.off")
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+void printRow(const char* name, const std::vector<double>& samples) {
+    std::printf("%-22s %9.0f %9.0f %9.0f ns\n", name, percentile(samples, 0.5), percentile(samples, 0.99),
+                percentile(samples, 1.0));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    qputenv("PHOTOBOOTH_LOG_STDERR", "0");
+    qputenv("PHOTOBOOTH_LOG_LEVEL", "debug");
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int messages = std::max(1, args.size() > 1 ? args.at(1).toInt() : 20000);
+    const int threads = std::max(1, args.size() > 2 ? args.at(2).toInt() : 4);
+
+    QTemporaryDir scratch;
+    const QString logPath = scratch.filePath("booth.log");
+    QLoggingCategory::setFilterRules("bench.off.debug=false");
+
+    std::printf("logbench: %d messages, %d threads, %d slots\n\n", messages, threads, RING_SLOTS);
+    std::printf("%-22s %9s %9s %9s\n", "per message", "p50", "p99", "max");
+
+    // Disabled category: timed in bulk, a single call is below the clock's resolution
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < messages; ++i) {
+        qCDebug(lcBenchOff) << "Frame" << i << "delivered to" << 3 << "subscribers";
+    }
+    const double disabledNs = static_cast<double>(timer.nsecsElapsed()) / messages;
+    std::printf("%-22s %9.1f ns (mean)\n", "disabled category", disabledNs);
+
+    std::vector<double> queued;
+    std::vector<double> synchronous;
+    {
+        BoothLog log(logPath, RING_SLOTS);
+        for (int i = 0; i < messages; ++i) {
+            timer.start();
+            log.log(QtDebugMsg, "bench.on", QString("Frame %1 delivered to %2 subscribers").arg(i).arg(3));
+            queued.push_back(timer.nsecsElapsed());
+        }
+        log.flush();
+
+        QFile file(scratch.filePath("sync.log"));
+        file.open(QIODevice::WriteOnly);
+        for (int i = 0; i < messages; ++i) {
+            timer.start();
+            file.write(QString("Frame %1 delivered to %2 subscribers\n").arg(i).arg(3).toUtf8());
+            file.flush();
+            synchronous.push_back(timer.nsecsElapsed());
+        }
+    }
+    printRow("queued to the ring", queued);
+    printRow("written synchronously", synchronous);
+
+    // Concurrent writers against the drain; nothing may go missing unaccounted
+    const QString concurrentPath = scratch.filePath("concurrent.log");
+    QString dumpPath;
+    {
+        BoothLog log(concurrentPath, RING_SLOTS);
+        std::vector<QThread*> workers;
+        const int perThread = messages / threads;
+        for (int t = 0; t < threads; ++t) {
+            workers.push_back(QThread::create([&log, t, perThread]() {
+                for (int i = 0; i < perThread; ++i) {
+                    log.log(QtDebugMsg, "bench.on", QString("Thread %1 message %2").arg(t).arg(i));
+                }
+            }));
+            workers.back()->start();
+        }
+        for (QThread *worker : workers) {
+            worker->wait();
+            delete worker;
+        }
+        log.log(QtWarningMsg, "bench.on", "Last message");
+        log.flush();
+        dumpPath = log.dumpRecent(60, "logbench");
+    }
+
+    const int expected = (messages / threads) * threads + 1;
+    int written = 0;
+    int overwritten = 0;
+    QFile concurrent(concurrentPath);
+    concurrent.open(QIODevice::ReadOnly);
+    const QRegularExpression overwrittenLine("(\\d+) messages overwritten");
+    while (!concurrent.atEnd()) {
+        const QString line = QString::fromUtf8(concurrent.readLine());
+        if (line.contains(" bench.on ")) {
+            ++written;
+        } else {
+            const QRegularExpressionMatch match = overwrittenLine.match(line);
+            overwritten += match.hasMatch() ? match.captured(1).toInt() : 0;
+        }
+    }
+    std::printf("\n%d threads: %d written, %d overwritten, of %d\n", threads, written, overwritten, expected);
+
+    QFile dump(dumpPath);
+    QByteArray lastLine;
+    if (dump.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = dump.readAll().trimmed().split('\n');
+        lastLine = lines.isEmpty() ? QByteArray() : lines.last();
+    }
+
+    const bool cheap = disabledNs < DISABLED_BUDGET_NS;
+    const bool accounted = written + overwritten == expected;
+    const bool dumped = lastLine.endsWith("Last message");
+    std::printf("\ndisabled category under %.0f ns: %s\n", DISABLED_BUDGET_NS, cheap ? "ok" : "FAILED");
+    std::printf("every message written or counted: %s\n", accounted ? "ok" : "FAILED");
+    std::printf("dump ends with the last message: %s\n", dumped ? "ok" : "FAILED");
+    return cheap && accounted && dumped ? 0 : 1;
+}
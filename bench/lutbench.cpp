@@ -0,0 +1,184 @@
+// Colour-grading looks at preview and capture size: time per frame for each
+// look, scalar and SIMD on one thread and SIMD over the filter's pool, and
+// how far the fixed-point mapping is from ColorLut::mapReference().
+//
+//   lutbench [photo] [passes]
+//
+// Grades the built-in looks and every .cube file in PHOTOBOOTH_LUT_DIR.
+// photo is scaled to 640x480 (the Pi preview) and 1920x1080; without one a
+// synthetic scene is used. Each timing is the median of passes (20) runs.
+// The preview has to grade inside a 30 fps frame and a capture in 100 ms;
+// scalar and SIMD must agree bit for bit and stay within one level of the
+// reference on every channel.
+
+#include "colorfilter.h"
+#include "colorlut.h"
+#include "simd.h"
+#include <QGuiApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const double PREVIEW_BUDGET_MS = 1000.0 / 30.0;
+const double CAPTURE_BUDGET_MS = 100.0;
+const int MAX_REFERENCE_ERROR = 1;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+// Gradients and saturated blocks, so every region of the cube is visited
+QImage syntheticScene(const QSize& size) {
+    QImage scene(size, QImage::Format_RGB32);
+    QPainter painter(&scene);
+    QLinearGradient gradient(0, 0, scene.width(), scene.height());
+    gradient.setColorAt(0.0, QColor(250, 220, 180));
+    gradient.setColorAt(0.5, QColor(60, 120, 90));
+    gradient.setColorAt(1.0, QColor(10, 20, 60));
+    painter.fillRect(scene.rect(), gradient);
+    QRandomGenerator random(7);
+    for (int i = 0; i < 300; ++i) {
+        painter.fillRect(random.bounded(scene.width()), random.bounded(scene.height()), random.bounded(4, 120),
+                         random.bounded(4, 120), QColor(random.bounded(256), random.bounded(256),
+                                                        random.bounded(256)));
+    }
+    return scene;
+}
+
+double medianMs(ColorFilter *filter, const QImage& source, const ColorLut& lut, int passes, QImage *graded) {
+    std::vector<double> samples;
+    for (int pass = 0; pass < passes; ++pass) {
+        QImage image = source.copy();
+        QElapsedTimer timer;
+        timer.start();
+        filter->apply(&image, lut);
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+        *graded = image;
+    }
+    return percentile(samples, 0.5);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const QString photoPath = args.size() > 1 ? args.at(1) : QString();
+    const int passes = std::max(1, args.size() > 2 ? args.at(2).toInt() : 20);
+
+    QImage photo;
+    if (!photoPath.isEmpty()) {
+        photo = QImage(photoPath).convertToFormat(QImage::Format_RGB32);
+        if (photo.isNull()) {
+            std::fprintf(stderr, "lutbench: cannot read %s\n", qPrintable(photoPath));
+            return 1;
+        }
+    }
+    auto frameAt = [&photo](const QSize& size) {
+        return photo.isNull() ? syntheticScene(size)
+                              : photo.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    };
+    const QImage preview = frameAt(QSize(640, 480));
+    const QImage capture = frameAt(QSize(1920, 1080));
+
+    QStringList looks = ColorFilter::builtInLooks();
+    const QStringList cubes = QDir(ColorFilter::lutDirectory()).entryList({"*.cube"}, QDir::Files, QDir::Name);
+    for (const QString& cube : cubes) {
+        const QString name = QFileInfo(cube).completeBaseName();
+        if (!looks.contains(name)) {
+            looks.append(name);
+        }
+    }
+
+    ColorFilter single(1);
+    ColorFilter threaded;
+    std::printf("lutbench: %d looks, %s, %d threads, %s frames, median of %d\n\n", static_cast<int>(looks.size()),
+                Simd::name(), threaded.threadCount(), photo.isNull() ? "synthetic" : "photo", passes);
+    std::printf("%-10s %5s | %27s | %27s | %9s\n", "", "", "640x480 ms", "1920x1080 ms", "vs ref");
+    std::printf("%-10s %5s | %8s %8s %9s | %8s %8s %9s | %4s %4s\n", "look", "size", "scalar", "simd",
+                "threaded", "scalar", "simd", "threaded", "max", "mean");
+
+    bool ok = true;
+    double worstPreview = 0.0;
+    double worstCapture = 0.0;
+    for (const QString& look : looks) {
+        const std::shared_ptr<const ColorLut> lut = threaded.lut(look);
+        if (!lut) {
+            std::printf("%-10s could not be loaded\n", qPrintable(look));
+            ok = false;
+            continue;
+        }
+
+        double ms[2][3];
+        QImage graded[2][3];
+        const QImage *sources[2] = {&preview, &capture};
+        for (int s = 0; s < 2; ++s) {
+            single.setSimdEnabled(false);
+            ms[s][0] = medianMs(&single, *sources[s], *lut, passes, &graded[s][0]);
+            single.setSimdEnabled(true);
+            ms[s][1] = medianMs(&single, *sources[s], *lut, passes, &graded[s][1]);
+            ms[s][2] = medianMs(&threaded, *sources[s], *lut, passes, &graded[s][2]);
+        }
+        worstPreview = std::max(worstPreview, ms[0][2]);
+        worstCapture = std::max(worstCapture, ms[1][2]);
+
+        // Every variant must produce the same pixels
+        bool identical = true;
+        for (int s = 0; s < 2; ++s) {
+            identical = identical && graded[s][0] == graded[s][1] && graded[s][1] == graded[s][2];
+        }
+
+        int maxError = 0;
+        double totalError = 0.0;
+        for (int y = 0; y < capture.height(); ++y) {
+            const QRgb *in = reinterpret_cast<const QRgb*>(capture.constScanLine(y));
+            const QRgb *out = reinterpret_cast<const QRgb*>(graded[1][0].constScanLine(y));
+            for (int x = 0; x < capture.width(); ++x) {
+                const QRgb reference = lut->mapReference(in[x]);
+                const int error = std::max({std::abs(qRed(out[x]) - qRed(reference)),
+                                            std::abs(qGreen(out[x]) - qGreen(reference)),
+                                            std::abs(qBlue(out[x]) - qBlue(reference))});
+                maxError = std::max(maxError, error);
+                totalError += error;
+            }
+        }
+        const double meanError = totalError / (static_cast<double>(capture.width()) * capture.height());
+
+        std::printf("%-10s %5d | %8.2f %8.2f %9.2f | %8.2f %8.2f %9.2f | %4d %4.2f%s\n", qPrintable(look),
+                    lut->size(), ms[0][0], ms[0][1], ms[0][2], ms[1][0], ms[1][1], ms[1][2], maxError, meanError,
+                    identical ? "" : "  scalar/SIMD differ");
+        ok = ok && identical && maxError <= MAX_REFERENCE_ERROR;
+    }
+
+    const bool fast = worstPreview <= PREVIEW_BUDGET_MS && worstCapture < CAPTURE_BUDGET_MS;
+    std::printf("\npreview under %.1f ms (worst %.2f), capture under %.0f ms (worst %.2f): %s\n", PREVIEW_BUDGET_MS,
+                worstPreview, CAPTURE_BUDGET_MS, worstCapture, fast ? "ok" : "FAILED");
+    std::printf("scalar, SIMD and threaded identical, within %d of the reference: %s\n", MAX_REFERENCE_ERROR,
+                ok ? "ok" : "FAILED");
+    return fast && ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Trigger-to-file latency of PiCaptureHelper against the fake capture helper.
+//
+//   picapturebench [shots] [helper-path]
+//
+// FAKE_HELPER_* variables are passed through to the helper, so e.g.
+// FAKE_HELPER_CAPTURE_MS=0 measures pure pipe + poll + rename overhead.
+
+#include "picapturehelper.h"
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#ifndef FAKE_HELPER_PATH
+#define FAKE_HELPER_PATH "fakepicapturehelper"
+#endif
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int shots = args.size() > 1 ? args.at(1).toInt() : 100;
+    const QString helperPath = args.size() > 2 ? args.at(2) : QString(FAKE_HELPER_PATH);
+    qputenv("PHOTOBOOTH_PI_CAPTURE_HELPER", helperPath.toLocal8Bit());
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "picapturebench: cannot create temporary directory\n");
+        return 1;
+    }
+
+    PiCaptureHelper helper;
+    helper.setResolution(1920, 1080);
+    if (!helper.start(QDir(workDir.path()).absoluteFilePath(".spool"))) {
+        return 1;
+    }
+
+    std::vector<qint64> latencies;
+    latencies.reserve(shots);
+    int failures = 0;
+
+    auto triggerNext = [&]() {
+        if (static_cast<int>(latencies.size()) + failures >= shots) {
+            app.quit();
+            return;
+        }
+        QString path = QDir(workDir.path()).absoluteFilePath(
+            QString("shot_%1.jpg").arg(latencies.size() + failures));
+        helper.trigger(path);
+    };
+
+    QObject::connect(&helper, &PiCaptureHelper::captureFinished, [&](const QString&, qint64 latencyMs) {
+        latencies.push_back(latencyMs);
+        QTimer::singleShot(0, triggerNext);
+    });
+    QObject::connect(&helper, &PiCaptureHelper::captureFailed, [&](const QString& error) {
+        std::fprintf(stderr, "picapturebench: capture failed: %s\n", qPrintable(error));
+        ++failures;
+        QTimer::singleShot(0, triggerNext);
+    });
+
+    QTimer::singleShot(0, triggerNext);
+    app.exec();
+    helper.stop();
+
+    if (latencies.empty()) {
+        std::fprintf(stderr, "picapturebench: no successful captures\n");
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::printf("shots=%zu failures=%d min=%lldms p50=%lldms p95=%lldms max=%lldms\n",
+                latencies.size(), failures,
+                static_cast<long long>(latencies.front()),
+                static_cast<long long>(percentile(0.50)),
+                static_cast<long long>(percentile(0.95)),
+                static_cast<long long>(latencies.back()));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+// Sensor handoff of PiCamera when the preview stream and the still helper
+// can't both hold the camera: each shot stops the stream, triggers the warm
+// helper and restarts the stream.
+//
+//   pihandoffbench [shots] [--real]
+//
+// Reports, per shot, shutter latency (capturePhoto() to photoReady()), the
+// preview gap (capturePhoto() to the next preview frame), a strip of
+// STRIP_SHOTS shots, which holds the helper from first shot to last, and
+// shots taken with the preview stopped, when the helper is already warm. The
+// longest stall of the GUI event loop is reported too; the handoff must never
+// wait on a process from the GUI thread.
+//
+// By default runs fakepicapturehelper and fakepreviewstream with
+// PHOTOBOOTH_PI_EXCLUSIVE_SENSOR=1. --real leaves the environment alone, so
+// on a Pi it measures libcamera-vid and libcamera-still themselves.
+
+#include "picamera.h"
+#include "framesubscriber.h"
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#ifndef FAKE_HELPER_PATH
+#define FAKE_HELPER_PATH "fakepicapturehelper"
+#endif
+
+#ifndef FAKE_STREAM_PATH
+#define FAKE_STREAM_PATH "fakepreviewstream"
+#endif
+
+namespace {
+
+const int TIMEOUT_MS = 30000;
+const int STRIP_SHOTS = 4;
+const int STRIP_INTERVAL_MS = 1500;
+const int WARM_UP_MS = 2000;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+bool waitUntil(const std::function<bool()>& done) {
+    // Keeps WaitForMoreEvents from sleeping past a condition set by a direct call
+    QTimer heartbeat;
+    heartbeat.start(5);
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > TIMEOUT_MS) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+void settle(int ms) {
+    QElapsedTimer timer;
+    timer.start();
+    waitUntil([&timer, ms]() { return timer.elapsed() >= ms; });
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+double maximum(const std::vector<double>& values) {
+    return values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QTemporaryDir workDir;
+    qputenv("PHOTOBOOTH_PHOTOS_DIR", QDir(workDir.path()).absoluteFilePath("photos").toLocal8Bit());
+    qInstallMessageHandler(messageHandler);
+    QApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const bool real = args.contains("--real");
+    const int shots = std::max(1, args.size() > 1 && args.at(1) != "--real" ? args.at(1).toInt() : 10);
+
+    if (!real) {
+        const QString streamFile = QDir(workDir.path()).absoluteFilePath("stream.mjpeg");
+        if (QProcess::execute(FAKE_STREAM_PATH, {"--generate", streamFile, "--count", "120"}) != 0) {
+            std::fprintf(stderr, "pihandoffbench: failed to generate stream\n");
+            return 1;
+        }
+        qputenv("PHOTOBOOTH_PI_PREVIEW_COMMAND",
+                QString("%1 --input %2 --fps 30").arg(FAKE_STREAM_PATH, streamFile).toLocal8Bit());
+        qputenv("PHOTOBOOTH_PI_CAPTURE_HELPER", FAKE_HELPER_PATH);
+        qputenv("PHOTOBOOTH_PI_EXCLUSIVE_SENSOR", "1");
+    }
+
+    PiCamera camera;
+    if (!camera.initialize()) {
+        std::fprintf(stderr, "pihandoffbench: Pi camera failed to initialize\n");
+        return 1;
+    }
+
+    quint64 frames = 0;
+    FrameSubscriber subscriber;
+    QObject::connect(&subscriber, &FrameSubscriber::frameAvailable, [&]() {
+        subscriber.takeFrame();
+        ++frames;
+    });
+    camera.addFrameSubscriber(&subscriber);
+
+    int readyCount = 0;
+    int savedCount = 0;
+    int errorCount = 0;
+    bool burstDone = false;
+    QObject::connect(&camera, &ICamera::photoReady, [&readyCount]() { ++readyCount; });
+    QObject::connect(&camera, &ICamera::photoSaved, [&savedCount]() { ++savedCount; });
+    QObject::connect(&camera, &ICamera::captureError, [&errorCount](const QString& error) {
+        std::fprintf(stderr, "pihandoffbench: capture error: %s\n", qPrintable(error));
+        ++errorCount;
+    });
+    QObject::connect(&camera, &ICamera::burstFinished, [&burstDone]() { burstDone = true; });
+
+    // Longest gap between ticks of a 5 ms timer is the worst GUI stall
+    double worstStallMs = 0.0;
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+    QTimer ticker;
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        worstStallMs = std::max(worstStallMs, tickTimer.nsecsElapsed() / 1e6 - 5.0);
+        tickTimer.restart();
+    });
+    ticker.start(5);
+
+    auto waitForPreview = [&]() {
+        const quint64 before = frames;
+        return waitUntil([&]() { return frames > before || errorCount > 0; }) && errorCount == 0;
+    };
+
+    camera.startPreview();
+    if (!waitForPreview()) {
+        std::fprintf(stderr, "pihandoffbench: no preview frames\n");
+        return 1;
+    }
+
+    std::vector<double> shutterMs;
+    std::vector<double> gapMs;
+    for (int shot = 0; shot < shots; ++shot) {
+        const int ready = readyCount;
+        const int saved = savedCount;
+        QElapsedTimer timer;
+        timer.start();
+        camera.capturePhoto();
+        if (!waitUntil([&]() { return readyCount > ready || errorCount > 0; }) || errorCount > 0) {
+            std::fprintf(stderr, "pihandoffbench: shot %d failed\n", shot + 1);
+            return 1;
+        }
+        shutterMs.push_back(timer.nsecsElapsed() / 1e6);
+        if (!waitForPreview()) {
+            std::fprintf(stderr, "pihandoffbench: preview didn't come back after shot %d\n", shot + 1);
+            return 1;
+        }
+        gapMs.push_back(timer.nsecsElapsed() / 1e6);
+        waitUntil([&]() { return savedCount > saved; });
+    }
+
+    QElapsedTimer stripTimer;
+    stripTimer.start();
+    camera.startBurst(STRIP_SHOTS, STRIP_INTERVAL_MS);
+    if (!waitUntil([&]() { return burstDone || errorCount > 0; }) || errorCount > 0) {
+        std::fprintf(stderr, "pihandoffbench: strip failed\n");
+        return 1;
+    }
+    const double stripMs = stripTimer.nsecsElapsed() / 1e6;
+    if (!waitForPreview()) {
+        std::fprintf(stderr, "pihandoffbench: preview didn't come back after the strip\n");
+        return 1;
+    }
+    const double stripGapMs = stripTimer.nsecsElapsed() / 1e6;
+
+    // With the preview stopped the helper takes the sensor and stays warm
+    camera.stopPreview();
+    settle(WARM_UP_MS);
+    std::vector<double> warmMs;
+    for (int shot = 0; shot < shots; ++shot) {
+        const int ready = readyCount;
+        QElapsedTimer timer;
+        timer.start();
+        camera.capturePhoto();
+        if (!waitUntil([&]() { return readyCount > ready || errorCount > 0; }) || errorCount > 0) {
+            std::fprintf(stderr, "pihandoffbench: warm shot %d failed\n", shot + 1);
+            return 1;
+        }
+        warmMs.push_back(timer.nsecsElapsed() / 1e6);
+        waitUntil([&]() { return savedCount >= readyCount; });
+    }
+
+    std::printf("pihandoffbench: %d shots, %s\n\n", shots, real ? "libcamera" : "fake helper and stream");
+    std::printf("  %-26s %10s %10s\n", "", "median ms", "max ms");
+    std::printf("  %-26s %10.1f %10.1f\n", "shutter, handoff", median(shutterMs), maximum(shutterMs));
+    std::printf("  %-26s %10.1f %10.1f\n", "preview gap", median(gapMs), maximum(gapMs));
+    std::printf("  %-26s %10.1f %10.1f\n", "shutter, helper warm", median(warmMs), maximum(warmMs));
+    std::printf("\nstrip of %d, %d ms apart: %.1f ms, preview back after %.1f ms\n",
+                STRIP_SHOTS, STRIP_INTERVAL_MS, stripMs, stripGapMs);
+    std::printf("worst GUI stall: %.1f ms\n", worstStallMs);
+
+    camera.removeFrameSubscriber(&subscriber);
+    camera.cleanup();
+    return 0;
+}
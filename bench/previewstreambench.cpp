@@ -0,0 +1,87 @@
+// Throughput and drop counters of PreviewStreamReader fed by fakepreviewstream.
+//
+//   previewstreambench [seconds] [consumer-ms] [stream-file]
+//
+// consumer-ms simulates a GUI thread that needs that long per frame, which
+// should show up as dropped frames rather than growing latency. Without a
+// stream file a synthetic 640x480 MJPEG stream is generated first.
+
+#include "previewstreamreader.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QDir>
+#include <cstdio>
+#include <ctime>
+
+#ifndef FAKE_STREAM_PATH
+#define FAKE_STREAM_PATH "fakepreviewstream"
+#endif
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int seconds = args.size() > 1 ? args.at(1).toInt() : 10;
+    const int consumerMs = args.size() > 2 ? args.at(2).toInt() : 0;
+    QString streamFile = args.size() > 3 ? args.at(3) : QString();
+
+    QTemporaryDir workDir;
+    if (streamFile.isEmpty()) {
+        streamFile = QDir(workDir.path()).absoluteFilePath("stream.mjpeg");
+        if (QProcess::execute(FAKE_STREAM_PATH, {"--generate", streamFile, "--count", "120"}) != 0) {
+            std::fprintf(stderr, "previewstreambench: failed to generate stream\n");
+            return 1;
+        }
+    }
+
+    qputenv("PHOTOBOOTH_PI_PREVIEW_COMMAND",
+            QString("%1 --input %2 --fps 30").arg(FAKE_STREAM_PATH, streamFile).toLocal8Bit());
+
+    QThread streamThread;
+    PreviewStreamReader *reader = new PreviewStreamReader();
+    reader->moveToThread(&streamThread);
+    QObject::connect(&streamThread, &QThread::finished, reader, &QObject::deleteLater);
+    streamThread.start();
+
+    quint64 framesConsumed = 0;
+    QObject::connect(reader, &PreviewStreamReader::frameAvailable, &app, [&]() {
+        QImage frame = reader->takeLatestFrame();
+        if (frame.isNull()) {
+            return;
+        }
+        ++framesConsumed;
+        if (consumerMs > 0) {
+            QThread::msleep(consumerMs);
+        }
+    }, Qt::QueuedConnection);
+
+    QElapsedTimer wallClock;
+    wallClock.start();
+    std::clock_t cpuStart = std::clock();
+
+    QMetaObject::invokeMethod(reader, "start", Qt::QueuedConnection);
+    QTimer::singleShot(seconds * 1000, &app, &QCoreApplication::quit);
+    app.exec();
+
+    QMetaObject::invokeMethod(reader, "stop", Qt::BlockingQueuedConnection);
+    PreviewStreamReader::Statistics stats = reader->statistics();
+    double wallSeconds = wallClock.elapsed() / 1000.0;
+    double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    streamThread.quit();
+    streamThread.wait();
+
+    std::printf("received=%llu decoded=%llu dropped=%llu consumed=%llu\n",
+                static_cast<unsigned long long>(stats.framesReceived),
+                static_cast<unsigned long long>(stats.framesDecoded),
+                static_cast<unsigned long long>(stats.framesDropped),
+                static_cast<unsigned long long>(framesConsumed));
+    std::printf("fps=%.1f cpu=%.2f cores MB/s=%.2f\n",
+                framesConsumed / wallSeconds, cpuSeconds / wallSeconds,
+                stats.bytesReceived / wallSeconds / (1024.0 * 1024.0));
+    return 0;
+}
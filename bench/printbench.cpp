@@ -0,0 +1,179 @@
+// Print queue: submit latency on the calling thread, time in queue and
+// printer throughput while guests outpace the printer, the "prints delayed"
+// backpressure, and recovery of queued jobs across a restart.
+//
+//   printbench [prints] [pageMs] [capacity]
+//
+// Submits prints (40 by default) twice as fast as a spool-directory printer
+// taking pageMs (200) per page, to a queue of capacity (10) jobs, so the
+// queue fills and refuses some. Halfway through the queue is destroyed with
+// jobs still waiting and reopened, as after a power cut. Then checks that
+// every accepted print came out exactly once. Set TMPDIR to put the queue on
+// the SD card being measured.
+
+#include "printqueue.h"
+#include "printsink.h"
+#include "photocompositor.h"
+#include <QGuiApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+// Larger than the print so every job is downscaled, like a camera frame
+QImage sourcePage(int index) {
+    QImage page(2400, 1600, QImage::Format_RGB32);
+    QPainter painter(&page);
+    QLinearGradient gradient(0, 0, page.width(), page.height());
+    gradient.setColorAt(0, QColor::fromHsv((index * 37) % 360, 200, 220));
+    gradient.setColorAt(1, QColor::fromHsv((index * 37 + 180) % 360, 200, 60));
+    painter.fillRect(page.rect(), gradient);
+    painter.setPen(Qt::white);
+    painter.setFont(QFont("Sans", 120));
+    painter.drawText(page.rect(), Qt::AlignCenter, QString("Guest %1").arg(index));
+    return page;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(messageHandler);
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int prints = std::max(2, args.size() > 1 ? args.at(1).toInt() : 40);
+    const int pageMs = std::max(1, args.size() > 2 ? args.at(2).toInt() : 200);
+    const int capacity = std::max(1, args.size() > 3 ? args.at(3).toInt() : 10);
+    const int submitIntervalMs = pageMs / 2;
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "printbench: cannot create a temporary directory\n");
+        return 1;
+    }
+    const QString queueDir = QDir(workDir.path()).absoluteFilePath("printqueue");
+    const QString spoolDir = QDir(workDir.path()).absoluteFilePath("printspool");
+    qputenv("PHOTOBOOTH_PHOTOS_DIR", QDir(workDir.path()).absoluteFilePath("photos").toLocal8Bit());
+    const QSize printSize(PhotoCompositor::PRINT_WIDTH, PhotoCompositor::PRINT_HEIGHT);
+    // Delayed once the backlog passes half the queue's worth of pages
+    const int delayedThresholdMs = pageMs * capacity / 2;
+
+    std::printf("printbench: %d prints every %d ms, printer %d ms/page, capacity %d, %s\n\n", prints,
+                submitIntervalMs, pageMs, capacity, qPrintable(workDir.path()));
+
+    std::vector<QImage> pages;
+    for (int i = 0; i < 8; ++i) {
+        pages.push_back(sourcePage(i));
+    }
+
+    std::atomic<int> printed{0};
+    std::atomic<int> failed{0};
+    std::atomic<int> delayedChanges{0};
+    std::atomic<int> maxDepth{0};
+    QMutex resultMutex;
+    std::vector<double> queueMs;
+    auto openQueue = [&]() {
+        auto queue = std::make_unique<PrintQueue>(queueDir, std::make_unique<SpoolDirectoryPrintSink>(spoolDir, pageMs),
+                                                  capacity, printSize, delayedThresholdMs);
+        QObject::connect(queue.get(), &PrintQueue::jobPrinted, queue.get(), [&](quint64, qint64 ms) {
+            ++printed;
+            QMutexLocker locker(&resultMutex);
+            queueMs.push_back(ms);
+        }, Qt::DirectConnection);
+        QObject::connect(queue.get(), &PrintQueue::jobFailed, queue.get(),
+                         [&failed](quint64, const QString&) { ++failed; }, Qt::DirectConnection);
+        QObject::connect(queue.get(), &PrintQueue::delayedChanged, queue.get(),
+                         [&delayedChanges](bool) { ++delayedChanges; }, Qt::DirectConnection);
+        QObject::connect(queue.get(), &PrintQueue::depthChanged, queue.get(), [&maxDepth](int depth) {
+            int seen = maxDepth.load();
+            while (depth > seen && !maxDepth.compare_exchange_weak(seen, depth)) {
+            }
+        }, Qt::DirectConnection);
+        return queue;
+    };
+
+    std::unique_ptr<PrintQueue> queue = openQueue();
+    std::vector<double> submitMs;
+    int accepted = 0;
+    int rejected = 0;
+    int delayedAtSubmit = 0;
+    int leftAtRestart = 0;
+    quint64 recovered = 0;
+    double restartMs = 0.0;
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < prints; ++i) {
+        if (i == prints / 2) {
+            // Power cut: whatever is queued must come back
+            leftAtRestart = queue->depth();
+            QElapsedTimer restart;
+            restart.start();
+            queue.reset();
+            queue = openQueue();
+            restartMs = restart.nsecsElapsed() / 1e6;
+            recovered = queue->statistics().recovered;
+        }
+        delayedAtSubmit += queue->isDelayed() ? 1 : 0;
+        QElapsedTimer timer;
+        timer.start();
+        const quint64 jobId = queue->submit(pages[i % pages.size()], QString("Guest %1").arg(i));
+        submitMs.push_back(timer.nsecsElapsed() / 1e6);
+        if (jobId != 0) {
+            ++accepted;
+        } else {
+            ++rejected;
+        }
+        QThread::msleep(submitIntervalMs);
+    }
+    const bool drained = queue->waitForIdle(pageMs * (capacity + 2) + 30000);
+    const double seconds = total.elapsed() / 1000.0;
+    const PrintQueue::Statistics stats = queue->statistics();
+
+    std::printf("submit    median %.2f ms, p99 %.2f ms, max %.2f ms on the caller\n",
+                percentile(submitMs, 0.5), percentile(submitMs, 0.99), percentile(submitMs, 1.0));
+    std::printf("in queue  median %.0f ms, p99 %.0f ms, max %.0f ms submit to printed\n",
+                percentile(queueMs, 0.5), percentile(queueMs, 0.99), percentile(queueMs, 1.0));
+    std::printf("printer   p50 %.0f ms per page, %.1f pages/min (%.1f ideal)\n",
+                queue->printLatency().percentileNs(50) / 1e6, stats.pagesPerMinute, 60000.0 / pageMs);
+    std::printf("queue     %d accepted, %d refused, max depth %d, %d delayed changes, delayed at %d submits\n",
+                accepted, rejected, maxDepth.load(), delayedChanges.load(), delayedAtSubmit);
+    std::printf("restart   %d jobs in flight, %llu recovered, %.1f ms to close and reopen\n", leftAtRestart,
+                static_cast<unsigned long long>(recovered), restartMs);
+    std::printf("total     %d printed in %.1f s, %d failed\n", printed.load(), seconds, failed.load());
+    queue.reset();
+
+    const int spooled = QDir(spoolDir).entryList(QStringList() << "print_*.jpg", QDir::Files).size();
+    const int leftover = QDir(queueDir).entryList(QDir::Files).size();
+    const bool exactlyOnce = drained && spooled == accepted && printed == accepted && leftover == 0;
+    const bool backpressure = rejected > 0 && delayedChanges > 0;
+    std::printf("\nevery print once: %s (%d spooled, %d left in queue), backpressure: %s\n",
+                exactlyOnce ? "ok" : "FAILED", spooled, leftover, backpressure ? "ok" : "FAILED");
+    return exactlyOnce && backpressure ? 0 : 1;
+}
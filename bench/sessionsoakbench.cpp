@@ -0,0 +1,444 @@
+// Headless session throughput and soak benchmark. Runs the real MainWindow on
+// the offscreen platform with the mock camera and scripts complete guest
+// sessions: start, weapon, land, companion, name, countdown and capture,
+// continue.
+//
+//   sessionsoakbench [sessions] [report-every] [--zero-delay] [--verbose]
+//                    [--fail-on-growth]
+//
+// --zero-delay removes the countdown, flash and shutter delays so thousands of
+// sessions run in minutes. Every report-every sessions (1000 by default) the
+// session rate, RSS and malloc heap are printed, and the final summary gives
+// per-step latency and memory growth per 1000 sessions measured after a short
+// warm-up. Steady growth points at leaked PhotoSessionData, pixmaps or frames.
+//
+// Image memory (see ImageMemory) is sampled at the start of every session,
+// when the last guest's images should be gone, and the summary shows it per
+// subsystem with high-water marks. Its steady state is the smallest sample in
+// a window of GROWTH_WINDOW sessions; --fail-on-growth fails the run if that
+// is more than MAX_IMAGE_GROWTH_MB higher in the last window than in the
+// first, e.g. over the default 1000 mock sessions.
+
+#include "mainwindow.h"
+#include "capturelatencytracker.h"
+#include "latencyhistogram.h"
+#include "imagememory.h"
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMetaObject>
+#include <QPushButton>
+#include <QStackedWidget>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <unistd.h>
+
+namespace {
+
+enum Step {
+    StartStep,
+    WeaponStep,
+    LandStep,
+    CompanionStep,
+    NameStep,
+    CaptureStep,
+    ContinueStep,
+    StepCount
+};
+
+const char* const STEP_NAMES[StepCount] = {
+    "start", "weapon", "land", "companion", "name", "capture", "continue"
+};
+
+const int WARMUP_SESSIONS = 20;
+const int STEP_TIMEOUT_MS = 30000;
+const int GROWTH_WINDOW = 100;
+const double MAX_IMAGE_GROWTH_MB = 1.0;
+
+bool s_verbose = false;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    // The app logs several lines per session; keep the benchmark output readable
+    if (type == QtDebugMsg && !s_verbose) {
+        return;
+    }
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+double rssMb() {
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0.0;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) {
+        return 0.0;
+    }
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+double heapMb() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (info.uordblks + info.hblkhd) / (1024.0 * 1024.0);
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return (static_cast<unsigned>(info.uordblks) + static_cast<unsigned>(info.hblkhd)) / (1024.0 * 1024.0);
+#else
+    return 0.0;
+#endif
+}
+
+double toMs(qint64 nanoseconds) {
+    return nanoseconds / 1e6;
+}
+
+double toMb(qint64 bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+void printHistogram(const char* name, const LatencyHistogram& histogram) {
+    std::printf("  %-18s %8llu %9.2f %9.2f %9.2f %9.2f\n", name,
+                static_cast<unsigned long long>(histogram.count()),
+                toMs(histogram.percentileNs(50)), toMs(histogram.percentileNs(95)),
+                toMs(histogram.percentileNs(99)), toMs(histogram.maxNs()));
+}
+
+// Walks one session at a time through the UI. Every action is a real button
+// click; the driver then yields to the event loop until the UI reaches the
+// state the step expects.
+class SessionDriver {
+public:
+    SessionDriver(MainWindow *window, int sessions, int reportEvery, bool zeroDelay, const QString& photosDir)
+        : m_window(window)
+        , m_sessions(sessions)
+        , m_reportEvery(reportEvery)
+        , m_pollIntervalMs(zeroDelay ? 0 : 5)
+        , m_photosDir(photosDir)
+        , m_completed(0)
+        , m_failed(false)
+    {
+        m_stack = window->findChild<QStackedWidget*>();
+    }
+
+    void start() {
+        beginSession();
+    }
+
+    bool failed() const { return m_failed; }
+
+    // Steady-state image memory growth from the first window of measured
+    // sessions to the last; false if there weren't two windows' worth
+    bool imageGrowthMb(double *growth) const {
+        if (m_imageSamples.size() < 2 * GROWTH_WINDOW) {
+            return false;
+        }
+        const qint64 first = *std::min_element(m_imageSamples.begin(), m_imageSamples.begin() + GROWTH_WINDOW);
+        const qint64 last = *std::min_element(m_imageSamples.end() - GROWTH_WINDOW, m_imageSamples.end());
+        *growth = toMb(last - first);
+        return true;
+    }
+
+    void printSummary() const {
+        const int measured = m_completed - WARMUP_SESSIONS;
+        const double seconds = m_measureClock.isValid() ? m_measureClock.elapsed() / 1000.0 : 0.0;
+
+        std::printf("\nsessions: %d (%d measured after warm-up) in %.1f s, %.1f sessions/s\n",
+                    m_completed, qMax(0, measured), seconds, measured > 0 && seconds > 0 ? measured / seconds : 0.0);
+
+        std::printf("\n  %-18s %8s %9s %9s %9s %9s\n", "step (ms)", "count", "p50", "p95", "p99", "max");
+        for (int i = 0; i < StepCount; ++i) {
+            printHistogram(STEP_NAMES[i], m_stepHistograms[i]);
+        }
+        printHistogram("session", m_sessionHistogram);
+
+        CaptureLatencyTracker *tracker = CaptureLatencyTracker::instance();
+        std::printf("\n  %-18s %8s %9s %9s %9s %9s\n", "capture span (ms)", "count", "p50", "p95", "p99", "max");
+        for (int i = 0; i < CaptureLatencyTracker::spanCount(); ++i) {
+            printHistogram(CaptureLatencyTracker::span(i).name, tracker->histogram(i));
+        }
+
+        if (measured > 0) {
+            double perThousand = 1000.0 / measured;
+            std::printf("\nmemory: RSS %.1f -> %.1f MB (%+.2f MB/1000 sessions), heap %.1f -> %.1f MB (%+.2f MB/1000 sessions)\n",
+                        m_baselineRss, rssMb(), (rssMb() - m_baselineRss) * perThousand,
+                        m_baselineHeap, heapMb(), (heapMb() - m_baselineHeap) * perThousand);
+        }
+
+        const ImageMemory::Snapshot images = ImageMemory::instance()->snapshot();
+        std::printf("\n  %-18s %9s %9s\n", "image memory (MB)", "live", "peak");
+        for (int i = 0; i < ImageMemory::SubsystemCount; ++i) {
+            std::printf("  %-18s %9.2f %9.2f\n", ImageMemory::subsystemName(static_cast<ImageMemory::Subsystem>(i)),
+                        toMb(images.subsystems[i].bytes), toMb(images.subsystems[i].highWater));
+        }
+        std::printf("  %-18s %9.2f %9.2f of %.0f MB budget, reclaimed %llu times\n", "total",
+                    toMb(images.total.bytes), toMb(images.total.highWater), toMb(images.budget),
+                    static_cast<unsigned long long>(images.reclaims));
+    }
+
+private:
+    void beginSession() {
+        if (m_completed == WARMUP_SESSIONS) {
+            // Measure from a warm state: caches, pools and fonts are populated
+            m_baselineRss = rssMb();
+            m_baselineHeap = heapMb();
+            m_intervalRss = m_baselineRss;
+            m_intervalHeap = m_baselineHeap;
+            m_measureClock.start();
+            m_intervalClock.start();
+            for (LatencyHistogram& histogram : m_stepHistograms) {
+                histogram.reset();
+            }
+            m_sessionHistogram.reset();
+            CaptureLatencyTracker::instance()->reset();
+            ImageMemory::instance()->resetHighWater();
+        }
+        if (m_completed >= WARMUP_SESSIONS) {
+            ImageMemory::instance()->check();
+            m_imageSamples.push_back(ImageMemory::instance()->snapshot().total.bytes);
+        }
+        if (m_completed >= m_sessions) {
+            QApplication::quit();
+            return;
+        }
+        m_sessionClock.start();
+        runStep(StartStep);
+    }
+
+    void runStep(Step step) {
+        m_step = step;
+        m_stepClock.start();
+
+        switch (step) {
+        case StartStep:
+            click("startButton");
+            waitFor([this]() { return onScreen("weaponScreen"); });
+            break;
+        case WeaponStep:
+            choose("weapon1", "onWeaponSelected");
+            waitFor([this]() { return onScreen("landScreen"); });
+            break;
+        case LandStep:
+            choose("land1", "onLandSelected");
+            waitFor([this]() { return onScreen("companionScreen"); });
+            break;
+        case CompanionStep:
+            choose("companion1", "onCompanionSelected");
+            waitFor([this]() { return onScreen("nameScreen"); });
+            break;
+        case NameStep:
+            m_window->findChild<QLineEdit*>("nameLineEdit")->setText(QString("Guest %1").arg(m_completed + 1));
+            click("submitNameButton");
+            waitFor([this]() { return onScreen("cameraScreen"); });
+            break;
+        case CaptureStep: {
+            // Take Photo stays disabled while the save queue is saturated
+            QPushButton *takePhoto = m_window->findChild<QPushButton*>("takePhotoButton");
+            waitFor([takePhoto]() { return takePhoto->isEnabled(); }, [this, takePhoto]() {
+                takePhoto->click();
+                waitFor([this]() { return m_window->findChild<QLabel*>("capturedPhotoLabel")->isVisible(); });
+            });
+            break;
+        }
+        case ContinueStep:
+            click("continueButton");
+            waitFor([this]() { return onScreen("startScreen"); });
+            break;
+        default:
+            break;
+        }
+    }
+
+    void stepFinished() {
+        m_stepHistograms[m_step].record(m_stepClock.nsecsElapsed());
+        if (m_step + 1 < StepCount) {
+            runStep(static_cast<Step>(m_step + 1));
+            return;
+        }
+
+        m_sessionHistogram.record(m_sessionClock.nsecsElapsed());
+        ++m_completed;
+        if (m_completed > WARMUP_SESSIONS && (m_completed - WARMUP_SESSIONS) % m_reportEvery == 0) {
+            report();
+        }
+        beginSession();
+    }
+
+    bool onScreen(const char* objectName) const {
+        return m_stack->currentWidget() && m_stack->currentWidget()->objectName() == objectName;
+    }
+
+    void click(const char* objectName) {
+        QPushButton *button = m_window->findChild<QPushButton*>(objectName);
+        if (button) {
+            button->click();
+        } else {
+            fail(QString("button %1 not found").arg(objectName));
+        }
+    }
+
+    // Choice buttons only exist when their artwork loaded; fall back to the slot
+    void choose(const char* choiceId, const char* slot) {
+        QPushButton *button = m_window->findChild<QPushButton*>(choiceId);
+        if (button) {
+            button->click();
+        } else {
+            QMetaObject::invokeMethod(m_window, slot, Qt::DirectConnection, Q_ARG(QString, QString(choiceId)));
+        }
+    }
+
+    void waitFor(std::function<bool()> condition, std::function<void()> then = std::function<void()>()) {
+        QElapsedTimer deadline;
+        deadline.start();
+        poll(std::move(condition), std::move(then), deadline);
+    }
+
+    void poll(std::function<bool()> condition, std::function<void()> then, QElapsedTimer deadline) {
+        if (m_failed) {
+            return;
+        }
+        if (condition()) {
+            if (then) {
+                then();
+            } else {
+                // Let the UI settle (layout, paint) before the next click
+                QTimer::singleShot(0, [this]() { stepFinished(); });
+            }
+            return;
+        }
+        if (deadline.elapsed() > STEP_TIMEOUT_MS) {
+            fail(QString("step %1 timed out").arg(STEP_NAMES[m_step]));
+            return;
+        }
+        QTimer::singleShot(m_pollIntervalMs, [this, condition, then, deadline]() {
+            poll(condition, then, deadline);
+        });
+    }
+
+    void report() {
+        double seconds = m_intervalClock.restart() / 1000.0;
+        double rss = rssMb();
+        double heap = heapMb();
+        std::printf("%7d sessions  %7.1f sessions/s  RSS %7.1f MB (%+.2f)  heap %7.1f MB (%+.2f)\n",
+                    m_completed - WARMUP_SESSIONS, seconds > 0 ? m_reportEvery / seconds : 0.0,
+                    rss, rss - m_intervalRss, heap, heap - m_intervalHeap);
+        std::fflush(stdout);
+        m_intervalRss = rss;
+        m_intervalHeap = heap;
+
+        // Keep the disk from filling up; only finished files are removed
+        QDir photos(m_photosDir);
+        for (const QString& file : photos.entryList({"*.png", "*.jpg"}, QDir::Files)) {
+            photos.remove(file);
+        }
+    }
+
+    void fail(const QString& reason) {
+        std::fprintf(stderr, "sessionsoakbench: session %d failed: %s\n", m_completed + 1, qPrintable(reason));
+        m_failed = true;
+        QApplication::exit(1);
+    }
+
+    MainWindow *m_window;
+    QStackedWidget *m_stack;
+    const int m_sessions;
+    const int m_reportEvery;
+    const int m_pollIntervalMs;
+    const QString m_photosDir;
+
+    int m_completed;
+    bool m_failed;
+    Step m_step = StartStep;
+
+    QElapsedTimer m_measureClock;
+    QElapsedTimer m_intervalClock;
+    QElapsedTimer m_sessionClock;
+    QElapsedTimer m_stepClock;
+    LatencyHistogram m_stepHistograms[StepCount];
+    LatencyHistogram m_sessionHistogram;
+
+    double m_baselineRss = 0.0;
+    double m_baselineHeap = 0.0;
+    double m_intervalRss = 0.0;
+    double m_intervalHeap = 0.0;
+    std::vector<qint64> m_imageSamples;     // Image memory at the start of each measured session
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QStringList options;
+    QStringList positional;
+    for (int i = 1; i < argc; ++i) {
+        QString arg = QString::fromLocal8Bit(argv[i]);
+        (arg.startsWith("--") ? options : positional) << arg;
+    }
+    const int sessions = positional.size() > 0 ? positional.at(0).toInt() : 1000;
+    const int reportEvery = qMax(1, positional.size() > 1 ? positional.at(1).toInt() : 1000);
+    const bool zeroDelay = options.contains("--zero-delay");
+    const bool failOnGrowth = options.contains("--fail-on-growth");
+    s_verbose = options.contains("--verbose");
+
+    QTemporaryDir workDir;
+    const QString photosDir = QDir(workDir.path()).absoluteFilePath("photos");
+    QDir().mkpath(photosDir);
+
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qputenv("PHOTOBOOTH_CAMERA", "mock");
+    qputenv("PHOTOBOOTH_PHOTOS_DIR", photosDir.toLocal8Bit());
+    qputenv("PHOTOBOOTH_LATENCY_FILE", QDir(workDir.path()).absoluteFilePath("capture-latency.json").toLocal8Bit());
+    qputenv("PHOTOBOOTH_JOURNAL_DIR", QDir(workDir.path()).absoluteFilePath("journal").toLocal8Bit());
+    qputenv("PHOTOBOOTH_THUMBNAIL_DIR", QDir(workDir.path()).absoluteFilePath("thumbnails").toLocal8Bit());
+    qputenv("PHOTOBOOTH_PRINT_QUEUE_DIR", QDir(workDir.path()).absoluteFilePath("printqueue").toLocal8Bit());
+    qputenv("PHOTOBOOTH_PRINTER", ("spool:" + QDir(workDir.path()).absoluteFilePath("printspool")).toLocal8Bit());
+    if (zeroDelay) {
+        qputenv("PHOTOBOOTH_COUNTDOWN_TICK_MS", "0");
+        qputenv("PHOTOBOOTH_FLASH_DELAY_MS", "0");
+        qputenv("PHOTOBOOTH_MOCK_CAPTURE_DELAY_MS", "0");
+    }
+    qInstallMessageHandler(messageHandler);
+
+    QApplication app(argc, argv);
+
+    std::printf("sessionsoakbench: %d sessions on %s%s, reporting every %d\n", sessions,
+                qPrintable(QGuiApplication::platformName()), zeroDelay ? " with zero delays" : "", reportEvery);
+
+    int result = 0;
+    {
+        MainWindow window;
+        window.resize(1280, 800);
+        window.show();
+
+        SessionDriver driver(&window, sessions + WARMUP_SESSIONS, reportEvery, zeroDelay, photosDir);
+        QTimer::singleShot(0, [&driver]() { driver.start(); });
+        result = app.exec();
+        driver.printSummary();
+
+        double growth = 0.0;
+        if (driver.imageGrowthMb(&growth)) {
+            const bool steady = growth <= MAX_IMAGE_GROWTH_MB;
+            std::printf("\nsteady-state image memory grew %+.2f MB (at most %.1f): %s\n", growth,
+                        MAX_IMAGE_GROWTH_MB, steady ? "ok" : "FAILED");
+            if (failOnGrowth && !steady && result == 0) {
+                result = 1;
+            }
+        } else if (failOnGrowth) {
+            std::printf("\nsteady-state image memory: too few sessions, need %d\n", 2 * GROWTH_WINDOW);
+            result = result == 0 ? 1 : result;
+        }
+    }
+    return result;
+}
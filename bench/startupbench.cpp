@@ -0,0 +1,132 @@
+// Time to first frame of MainWindow with eager and lazy screen construction.
+//
+//   startupbench [runs]
+//
+// Every run is a fresh child process (this binary with --child) so Qt, fonts,
+// plugins and the camera start cold each time, like after a reboot. The child
+// builds MainWindow on the offscreen platform with the mock camera and reports
+// when the start screen first painted and when the camera, brought up in the
+// background, became ready; with lazy screens it also waits for the background
+// pre-build to finish.
+
+#include "mainwindow.h"
+#include "startuptelemetry.h"
+#include <QApplication>
+#include <QCoreApplication>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int runChild(int argc, char *argv[]) {
+    StartupTelemetry::start();
+    QApplication app(argc, argv);
+    StartupTelemetry::mark("qapplication");
+
+    MainWindow window;
+    window.resize(1280, 800);
+    const bool lazy = qEnvironmentVariable("PHOTOBOOTH_EAGER_SCREENS") != "1";
+
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &app, [&]() {
+        if (StartupTelemetry::phaseMs("first_frame") >= 0 && window.isCameraReady() &&
+            (!lazy || StartupTelemetry::phaseMs("screens_prebuilt") >= 0)) {
+            QCoreApplication::quit();
+        }
+    });
+    poll.start(1);
+    window.show();
+    app.exec();
+
+    // One line per phase for the parent to parse
+    for (const auto& phase : StartupTelemetry::phases()) {
+        std::printf("%s %lld\n", phase.first.constData(), static_cast<long long>(phase.second));
+    }
+    return 0;
+}
+
+struct Samples {
+    std::vector<double> firstFrame;
+    std::vector<double> constructed;
+    std::vector<double> prebuilt;
+    std::vector<double> cameraReady;
+};
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return -1.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+bool runOnce(const QString& program, bool eager, Samples *samples) {
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    if (!environment.contains("QT_QPA_PLATFORM")) {
+        environment.insert("QT_QPA_PLATFORM", "offscreen");
+    }
+    environment.insert("PHOTOBOOTH_CAMERA", "mock");
+    environment.insert("PHOTOBOOTH_EAGER_SCREENS", eager ? "1" : "0");
+    environment.insert("QT_LOGGING_RULES", "*.debug=false");
+
+    QProcess child;
+    child.setProcessEnvironment(environment);
+    child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    child.start(program, {"--child"});
+    if (!child.waitForFinished(60000) || child.exitCode() != 0) {
+        std::fprintf(stderr, "startupbench: child run failed\n");
+        return false;
+    }
+
+    for (const QByteArray& line : child.readAllStandardOutput().split('\n')) {
+        QList<QByteArray> fields = line.split(' ');
+        if (fields.size() != 2) {
+            continue;
+        }
+        double ms = fields.at(1).toDouble();
+        if (fields.at(0) == "first_frame") {
+            samples->firstFrame.push_back(ms);
+        } else if (fields.at(0) == "mainwindow_constructed") {
+            samples->constructed.push_back(ms);
+        } else if (fields.at(0) == "screens_prebuilt") {
+            samples->prebuilt.push_back(ms);
+        } else if (fields.at(0) == "camera_ready") {
+            samples->cameraReady.push_back(ms);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && qstrcmp(argv[1], "--child") == 0) {
+        return runChild(argc, argv);
+    }
+
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int runs = std::max(1, args.size() > 1 ? args.at(1).toInt() : 10);
+
+    Samples eager;
+    Samples lazy;
+    for (int i = 0; i < runs; ++i) {
+        // Interleave so drift on the machine affects both modes equally
+        if (!runOnce(app.applicationFilePath(), true, &eager) ||
+            !runOnce(app.applicationFilePath(), false, &lazy)) {
+            return 1;
+        }
+    }
+
+    std::printf("startupbench: %d cold runs per mode, median ms since main()\n\n", runs);
+    std::printf("  %-8s %14s %14s %14s %14s\n", "screens", "constructed", "first frame", "all built", "camera ready");
+    std::printf("  %-8s %14.0f %14.0f %14.0f %14.0f\n", "eager", median(eager.constructed), median(eager.firstFrame),
+                median(eager.constructed), median(eager.cameraReady));
+    std::printf("  %-8s %14.0f %14.0f %14.0f %14.0f\n", "lazy", median(lazy.constructed), median(lazy.firstFrame),
+                median(lazy.prebuilt), median(lazy.cameraReady));
+    return 0;
+}
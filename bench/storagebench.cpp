@@ -0,0 +1,162 @@
+// Photo storage: sustained write throughput through PhotoStorage, with retake
+// eviction running against a quota the whole time.
+//
+//   storagebench [photos] [kilobytes] [writers]
+//
+// Writes photos (400 by default) of the given size (2500 KB, about a Pi HQ
+// camera JPEG) from writers threads (2, like the save workers). Half are
+// discarded as retakes, some before their write lands, and the quota only
+// fits the kept photos plus a little, so retakes are evicted throughout.
+// Then checks that no kept photo was lost and the quota held, and times the
+// index rebuild on reopen. Set TMPDIR to put the directory on the SD card
+// being measured.
+
+#include "photostorage.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * fraction))];
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    qInstallMessageHandler(messageHandler);
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int photos = std::max(2, args.size() > 1 ? args.at(1).toInt() : 400);
+    const int kilobytes = std::max(1, args.size() > 2 ? args.at(2).toInt() : 2500);
+    const int writers = std::max(1, args.size() > 3 ? args.at(3).toInt() : 2);
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "storagebench: cannot create a temporary directory\n");
+        return 1;
+    }
+    const QString directory = QDir(workDir.path()).absoluteFilePath("photos");
+
+    // Incompressible, like JPEG data; a few variants so pages aren't shared
+    std::vector<QByteArray> payloads;
+    for (int i = 0; i < 4; ++i) {
+        QByteArray data(kilobytes * 1024, Qt::Uninitialized);
+        QRandomGenerator(i + 1).fillRange(reinterpret_cast<quint32*>(data.data()), data.size() / 4);
+        payloads.push_back(data);
+    }
+    const qint64 photoBytes = payloads.front().size();
+
+    // Room for the kept half plus a tenth more; free space isn't what's measured
+    PhotoStorage::Limits limits;
+    limits.quotaBytes = photoBytes * photos / 10 * 6;
+    limits.lowSpaceBytes = 0;
+    limits.reserveBytes = 0;
+    limits.retakeMaxAgeSecs = 0;
+
+    std::printf("storagebench: %d photos of %d KB, %d writers, quota %.0f MB, %s\n\n", photos, kilobytes, writers,
+                limits.quotaBytes / (1024.0 * 1024.0), qPrintable(directory));
+
+    QDir().mkpath(directory);
+    PhotoStorage storage(directory, limits);
+    std::atomic<int> levelChanges{0};
+    QObject::connect(&storage, &PhotoStorage::spaceLevelChanged, &storage,
+                     [&levelChanges](PhotoStorage::SpaceLevel, qint64) { ++levelChanges; }, Qt::DirectConnection);
+
+    std::atomic<int> next{0};
+    QMutex resultMutex;
+    std::vector<double> writeMs;
+    QStringList kept;
+    std::vector<QThread*> threads;
+    QElapsedTimer total;
+    total.start();
+    for (int w = 0; w < writers; ++w) {
+        threads.push_back(QThread::create([&]() {
+            std::vector<double> localMs;
+            QStringList localKept;
+            for (int i = next++; i < photos; i = next++) {
+                const QString path = storage.nextPhotoPath("bench", "jpg");
+                // One in four retaken before the save lands, one in four after
+                if (i % 4 == 1) {
+                    storage.discard(path);
+                }
+                QElapsedTimer timer;
+                timer.start();
+                if (!storage.write(path, payloads[i % payloads.size()])) {
+                    continue;
+                }
+                localMs.push_back(timer.nsecsElapsed() / 1e6);
+                if (i % 4 == 3) {
+                    storage.discard(path);
+                } else if (i % 2 == 0) {
+                    localKept << path;
+                }
+            }
+            QMutexLocker locker(&resultMutex);
+            writeMs.insert(writeMs.end(), localMs.begin(), localMs.end());
+            kept << localKept;
+        }));
+        threads.back()->start();
+    }
+    for (QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+    const double seconds = total.elapsed() / 1000.0;
+    // Concurrent writers can each make room for one photo and land together
+    storage.refresh();
+
+    const PhotoStorage::Statistics stats = storage.statistics();
+    const double megabytes = stats.writes * photoBytes / (1024.0 * 1024.0);
+    std::printf("write     median %.1f ms, p99 %.1f ms, max %.1f ms per photo\n",
+                percentile(writeMs, 0.5), percentile(writeMs, 0.99), percentile(writeMs, 1.0));
+    std::printf("sustained %.1f MB/s, %.1f photos/s over %.1f s, %llu failed\n", megabytes / seconds,
+                stats.writes / seconds, seconds, static_cast<unsigned long long>(stats.failedWrites));
+    std::printf("evicted   %llu retakes, %.0f MB; %d retakes left, %d level changes\n",
+                static_cast<unsigned long long>(stats.evictions), stats.evictedBytes / (1024.0 * 1024.0),
+                stats.retakes, levelChanges.load());
+    const qint64 used = stats.photoBytes + stats.retakeBytes;
+    std::printf("usage     %.0f of %.0f MB quota, %d photos\n", used / (1024.0 * 1024.0),
+                limits.quotaBytes / (1024.0 * 1024.0), stats.photos);
+
+    int missing = 0;
+    for (const QString& path : std::as_const(kept)) {
+        if (!QFile::exists(path)) {
+            ++missing;
+        }
+    }
+
+    // A fresh process: one directory scan builds the index
+    PhotoStorage reopened(directory, limits);
+    reopened.refresh();
+    const PhotoStorage::Statistics rescanned = reopened.statistics();
+    std::printf("reopen    %.1f ms to index %d photos and %d retakes\n",
+                rescanned.scanNs / 1e6, rescanned.photos, rescanned.retakes);
+
+    const bool intact = missing == 0 && stats.failedWrites == 0 && rescanned.photos == stats.photos;
+    const bool withinQuota = used <= limits.quotaBytes;
+    std::printf("\nkept photos: %s (%d missing), quota: %s\n", intact ? "ok" : "FAILED", missing,
+                withinQuota ? "ok" : "FAILED");
+    return intact && withinQuota ? 0 : 1;
+}
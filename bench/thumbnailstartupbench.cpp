@@ -0,0 +1,118 @@
+// Startup cost of the choice-screen thumbnails: decoding the 12 JPEGs from the
+// resources and resampling them to 150x150 (the old startup path) against
+// wrapping the pre-scaled atlas linked in by thumbgen.
+//
+//   thumbnailstartupbench [iterations]
+//
+// The first iteration is reported separately since it includes plugin loading
+// and cold caches, which is what a booth pays after a reboot.
+
+#include "choicethumbnails.h"
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QPixmap>
+#include <QPixmapCache>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int ICON_SIZE = 150;
+
+QStringList choiceKeys() {
+    QStringList keys;
+    for (const char* category : {"weapon", "land", "companion"}) {
+        for (int i = 1; i <= 4; ++i) {
+            keys << QString("%1%2").arg(category).arg(i);
+        }
+    }
+    return keys;
+}
+
+int decodeAndScale(const QStringList& keys) {
+    int loaded = 0;
+    for (const QString& key : keys) {
+        QPixmap pixmap;
+        if (pixmap.load(QString(":/%1.jpg").arg(key))) {
+            QPixmap scaled = pixmap.scaled(ICON_SIZE, ICON_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            loaded += scaled.isNull() ? 0 : 1;
+        }
+    }
+    return loaded;
+}
+
+int wrapAtlas(const QStringList& keys) {
+    int loaded = 0;
+    for (const QString& key : keys) {
+        QImage thumbnail = ChoiceThumbnails::image(key, QSize(ICON_SIZE, ICON_SIZE));
+        if (!thumbnail.isNull()) {
+            QPixmap pixmap = QPixmap::fromImage(thumbnail);
+            loaded += pixmap.isNull() ? 0 : 1;
+        }
+    }
+    return loaded;
+}
+
+struct Result {
+    double firstMs = 0.0;
+    std::vector<double> samplesMs;
+    int loaded = 0;
+};
+
+template <typename Function>
+Result measure(int iterations, const QStringList& keys, Function function) {
+    Result result;
+    for (int i = 0; i < iterations; ++i) {
+        // QPixmap::load() caches by path; every run must decode again
+        QPixmapCache::clear();
+        QElapsedTimer timer;
+        timer.start();
+        result.loaded = function(keys);
+        double ms = timer.nsecsElapsed() / 1e6;
+        if (i == 0) {
+            result.firstMs = ms;
+        } else {
+            result.samplesMs.push_back(ms);
+        }
+    }
+    std::sort(result.samplesMs.begin(), result.samplesMs.end());
+    return result;
+}
+
+void printResult(const char* name, const Result& result) {
+    double median = result.samplesMs.empty() ? 0.0 : result.samplesMs[result.samplesMs.size() / 2];
+    double best = result.samplesMs.empty() ? 0.0 : result.samplesMs.front();
+    std::printf("  %-16s %6d %10.3f %10.3f %10.3f\n", name, result.loaded, result.firstMs, median, best);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int iterations = std::max(2, args.size() > 1 ? args.at(1).toInt() : 20);
+    const QStringList keys = choiceKeys();
+
+    // Atlas first so the decode path doesn't warm anything up for it
+    Result atlas = measure(iterations, keys, wrapAtlas);
+    Result decode = measure(iterations, keys, decodeAndScale);
+
+    std::printf("thumbnailstartupbench: %d thumbnails, %d iterations\n\n", static_cast<int>(keys.size()), iterations);
+    std::printf("  %-16s %6s %10s %10s %10s\n", "path (ms)", "loaded", "first", "median", "best");
+    printResult("decode+scale", decode);
+    printResult("prescaled atlas", atlas);
+
+    if (atlas.loaded == 0) {
+        std::printf("\nNo pre-scaled thumbnails linked in; configure with PHOTOBOOTH_PRESCALED_THUMBNAILS=ON\n");
+    } else if (!atlas.samplesMs.empty() && atlas.samplesMs[atlas.samplesMs.size() / 2] > 0) {
+        std::printf("\nspeedup: %.0fx first, %.0fx median\n", decode.firstMs / atlas.firstMs,
+                    decode.samplesMs[decode.samplesMs.size() / 2] / atlas.samplesMs[atlas.samplesMs.size() / 2]);
+    }
+    return 0;
+}
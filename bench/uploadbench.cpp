@@ -0,0 +1,218 @@
+// Upload queue against fakeuploadserver: throughput under the bandwidth cap,
+// what dropped connections and server errors cost, batching of small files,
+// and resuming across a restart.
+//
+//   uploadbench [sessions] [kbps] [drop-after-kb]
+//
+// Queues sessions (12 by default) of a 2.5 MB photo and a 1 MB print, every
+// third with four 120 KB strip shots that go out batched with the session
+// summaries, capped at kbps (8192). The server drops the connection every
+// drop-after-kb (1500) of upload data and answers every 23rd request with a
+// 503. Halfway through, the queue is destroyed mid-upload and reopened, as
+// after a power cut. Then checks every file arrived intact and the cap held.
+// Set TMPDIR to put the queue and photos on the SD card being measured.
+
+#include "uploadqueue.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+
+#ifndef FAKE_UPLOAD_SERVER_PATH
+#define FAKE_UPLOAD_SERVER_PATH "fakeuploadserver"
+#endif
+
+namespace {
+
+// The failures are the point here; they're counted rather than printed
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type != QtDebugMsg && type != QtWarningMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+QString writeFile(const QString& path, int bytes, quint32 seed) {
+    QByteArray data(bytes, Qt::Uninitialized);
+    QRandomGenerator(seed).fillRange(reinterpret_cast<quint32*>(data.data()), data.size() / 4);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void addStatistics(UploadQueue::Statistics *total, const UploadQueue::Statistics& part) {
+    total->uploadedFiles += part.uploadedFiles;
+    total->uploadedBytes += part.uploadedBytes;
+    total->sentBytes += part.sentBytes;
+    total->uploads += part.uploads;
+    total->batches += part.batches;
+    total->requests += part.requests;
+    total->failedRequests += part.failedRequests;
+    total->resumes += part.resumes;
+    total->skippedFiles += part.skippedFiles;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    qInstallMessageHandler(messageHandler);
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int sessions = std::max(2, args.size() > 1 ? args.at(1).toInt() : 12);
+    const int kbps = std::max(0, args.size() > 2 ? args.at(2).toInt() : 8192);
+    const int dropAfterKb = std::max(0, args.size() > 3 ? args.at(3).toInt() : 1500);
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "uploadbench: cannot create a temporary directory\n");
+        return 1;
+    }
+    const QDir work(workDir.path());
+    const QString photosDir = work.absoluteFilePath("photos");
+    const QString serverDir = work.absoluteFilePath("server");
+    const QString queueDir = work.absoluteFilePath("uploadqueue");
+    QDir().mkpath(photosDir);
+    qputenv("PHOTOBOOTH_PHOTOS_DIR", photosDir.toLocal8Bit());
+
+    QProcess server;
+    server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    server.start(FAKE_UPLOAD_SERVER_PATH, {"--dir", serverDir, "--drop-after-kb", QString::number(dropAfterKb),
+                                           "--fail-every", "23"});
+    if (!server.waitForReadyRead(5000)) {
+        std::fprintf(stderr, "uploadbench: %s did not start\n", FAKE_UPLOAD_SERVER_PATH);
+        return 1;
+    }
+    const QRegularExpressionMatch listening =
+        QRegularExpression("listening on (\\d+)").match(QString::fromLatin1(server.readLine()));
+    if (!listening.hasMatch()) {
+        std::fprintf(stderr, "uploadbench: unexpected output from %s\n", FAKE_UPLOAD_SERVER_PATH);
+        return 1;
+    }
+
+    // The sessions, as MainWindow would hand them over
+    QList<SessionJournal::Entry> entries;
+    QStringList expected;
+    qint64 totalBytes = 0;
+    for (int i = 0; i < sessions; ++i) {
+        SessionJournal::Entry entry;
+        entry.sequence = i + 1;
+        entry.startTime = QDateTime::currentDateTime();
+        entry.endTime = entry.startTime.addSecs(90);
+        entry.userName = QString("Guest %1").arg(i);
+        const QString base = QDir(photosDir).filePath(QString("photo_%1").arg(i, 4, 10, QChar('0')));
+        entry.photoPath = writeFile(base + ".jpg", 2500 * 1024, i * 8 + 1);
+        entry.printPath = writeFile(base + "_print.jpg", 1000 * 1024, i * 8 + 2);
+        totalBytes += (2500 + 1000) * 1024;
+        if (i % 3 == 0) {
+            for (int shot = 0; shot < 4; ++shot) {
+                entry.stripPhotoPaths << writeFile(QString("%1_strip%2.jpg").arg(base).arg(shot), 120 * 1024,
+                                                   i * 8 + 3 + shot);
+                totalBytes += 120 * 1024;
+            }
+        }
+        const QString folder = QString("session-%1/").arg(entry.sequence, 6, 10, QChar('0'));
+        for (const QString& path : QStringList() << entry.photoPath << entry.stripPhotoPaths << entry.printPath) {
+            if (path.isEmpty()) {
+                std::fprintf(stderr, "uploadbench: cannot write test photos\n");
+                return 1;
+            }
+            expected << path << folder + QFileInfo(path).fileName();
+        }
+        entries << entry;
+    }
+
+    UploadQueue::Options options;
+    options.endpoint = QUrl(QString("http://127.0.0.1:%1/files").arg(listening.captured(1)));
+    options.bytesPerSecond = static_cast<qint64>(kbps) * 1024;
+    options.chunkBytes = 512 * 1024;
+    options.batchDelayMs = 300;
+    options.timeoutMs = 5000;
+
+    std::printf("uploadbench: %d sessions, %.1f MB, cap %d KB/s, drop every %d KB, %s\n\n", sessions,
+                totalBytes / (1024.0 * 1024.0), kbps, dropAfterKb, qPrintable(options.endpoint.toString()));
+
+    std::atomic<int> failures{0};
+    auto openQueue = [&]() {
+        auto queue = std::make_unique<UploadQueue>(queueDir, options);
+        QObject::connect(queue.get(), &UploadQueue::uploadFailed, queue.get(),
+                         [&failures](const QString&, int) { ++failures; }, Qt::DirectConnection);
+        return queue;
+    };
+
+    UploadQueue::Statistics total;
+    QElapsedTimer clock;
+    clock.start();
+    std::unique_ptr<UploadQueue> queue = openQueue();
+    for (int i = 0; i < sessions / 2; ++i) {
+        queue->submitSession(entries[i]);
+    }
+
+    // Power cut a couple of files in, most likely in the middle of one
+    while (queue->statistics().uploadedFiles < 2 && clock.elapsed() < 120000) {
+        QThread::msleep(20);
+    }
+    QThread::msleep(150);
+    const int pendingAtRestart = queue->statistics().pendingFiles;
+    addStatistics(&total, queue->statistics());
+    queue.reset();
+    queue = openQueue();
+    for (int i = sessions / 2; i < sessions; ++i) {
+        queue->submitSession(entries[i]);
+    }
+
+    const int timeoutMs = kbps > 0 ? static_cast<int>(totalBytes * 3000 / (kbps * 1024LL)) + 60000 : 120000;
+    const bool drained = queue->waitForIdle(timeoutMs);
+    const double seconds = clock.elapsed() / 1000.0;
+    addStatistics(&total, queue->statistics());
+    queue.reset();
+
+    const double megabytes = total.uploadedBytes / (1024.0 * 1024.0);
+    const double wireRate = total.sentBytes / 1024.0 / seconds;
+    std::printf("throughput %.2f MB/s of files, %.0f KB/s on the wire (cap %d KB/s), %.1f s\n", megabytes / seconds,
+                wireRate, kbps, seconds);
+    std::printf("overhead   %.1f%% resent after %d failures; %llu requests, %llu failed, %llu resumed\n",
+                total.uploadedBytes > 0 ? 100.0 * (total.sentBytes - total.uploadedBytes) / total.uploadedBytes : 0.0,
+                failures.load(), static_cast<unsigned long long>(total.requests),
+                static_cast<unsigned long long>(total.failedRequests),
+                static_cast<unsigned long long>(total.resumes));
+    std::printf("uploads    %llu files in %llu uploads, %llu of them batches; %llu skipped\n",
+                static_cast<unsigned long long>(total.uploadedFiles), static_cast<unsigned long long>(total.uploads),
+                static_cast<unsigned long long>(total.batches), static_cast<unsigned long long>(total.skippedFiles));
+    std::printf("restart    %d files waiting when the queue was closed\n", pendingAtRestart);
+
+    int missing = 0;
+    for (int i = 0; i + 1 < expected.size(); i += 2) {
+        QFile local(expected[i]);
+        QFile remote(QDir(serverDir).filePath(expected[i + 1]));
+        if (!local.open(QIODevice::ReadOnly) || !remote.open(QIODevice::ReadOnly) ||
+            local.readAll() != remote.readAll()) {
+            ++missing;
+        }
+    }
+    for (const SessionJournal::Entry& entry : std::as_const(entries)) {
+        if (!QFile::exists(QDir(serverDir).filePath(QString("session-%1/session.json")
+                                                        .arg(entry.sequence, 6, 10, QChar('0'))))) {
+            ++missing;
+        }
+    }
+    server.kill();
+    server.waitForFinished();
+
+    const bool intact = drained && missing == 0;
+    const bool capped = kbps == 0 || wireRate <= kbps * 1.1;
+    std::printf("\nevery file intact: %s (%d missing or different), cap: %s\n", intact ? "ok" : "FAILED", missing,
+                capped ? "ok" : "FAILED");
+    return intact && capped ? 0 : 1;
+}
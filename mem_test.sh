@@ -1,18 +1,37 @@
-#!/binbash
+#!/bin/bash
+# Builds the headless session soak benchmark and runs it under a leak checker.
+#
+#   ./mem_test.sh [sessions] [valgrind|asan]
+#
+# valgrind (default) uses a RelWithDebInfo build, asan a Debug build with
+# AddressSanitizer/LeakSanitizer. Set QT_PATH to a Qt install prefix and
+# BUILD_DIR to override the build directory.
 set -e # Exit on error
-PROJECT_DIR=~/src/cpp_version
-BUILD_DIR=${PROJECT_DIR}/build
-QT_PATH=~/Qt/6.7.3/gcc_arm64
+PROJECT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+SESSIONS=${1:-200}
+MODE=${2:-valgrind}
 
-echo "--- Cleaning and Rebuilding ---"
-cd "${BUILD_DIR}"
-rm -rf CMakeCache.txt CMakeFiles/ Makefile cmake_install.cmake QtPhotoBoothApp_autogen/
-cmake -DCMAKE_PREFIX_PATH=${QT_PATH} -DCMAKE_BUILD_TYPE=Debug "${PROJECT_DIR}"
-make -j$(nproc)
+if [ "${MODE}" = "asan" ]; then
+    BUILD_TYPE=Debug
+else
+    BUILD_TYPE=RelWithDebInfo
+fi
+BUILD_DIR=${BUILD_DIR:-${PROJECT_DIR}/build-memtest-${MODE}}
 
-echo "--- Running Memory Test (e.g., Valgrind) ---"
-valgrind --leak-check=full ./QtPhotoBoothApp 
-# Or just run with ASan/LSan if compiled with it:
-# ./QtPhotoBoothApp 
-# (If your app auto-runs test cycles or you trigger them manually quickly)
+CMAKE_ARGS=(-DCMAKE_BUILD_TYPE=${BUILD_TYPE} -DPHOTOBOOTH_BUILD_BENCHMARKS=ON)
+if [ -n "${QT_PATH}" ]; then
+    CMAKE_ARGS+=(-DCMAKE_PREFIX_PATH="${QT_PATH}")
+fi
+
+echo "--- Building (${BUILD_TYPE}) in ${BUILD_DIR} ---"
+cmake -S "${PROJECT_DIR}" -B "${BUILD_DIR}" "${CMAKE_ARGS[@]}"
+cmake --build "${BUILD_DIR}" --target sessionsoakbench -j"$(nproc)"
+
+echo "--- Running ${SESSIONS} sessions (${MODE}) ---"
+if [ "${MODE}" = "asan" ]; then
+    "${BUILD_DIR}/sessionsoakbench" "${SESSIONS}" 100 --zero-delay
+else
+    valgrind --leak-check=full \
+        "${BUILD_DIR}/sessionsoakbench" "${SESSIONS}" 100 --zero-delay
+fi
 echo "--- Test Finished ---"
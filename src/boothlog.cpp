@@ -0,0 +1,383 @@
+#include "boothlog.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcSession, "photobooth.session")
+Q_LOGGING_CATEGORY(lcUi, "photobooth.ui")
+Q_LOGGING_CATEGORY(lcCamera, "photobooth.camera")
+Q_LOGGING_CATEGORY(lcStorage, "photobooth.storage")
+Q_LOGGING_CATEGORY(lcPrint, "photobooth.print")
+Q_LOGGING_CATEGORY(lcUpload, "photobooth.upload")
+Q_LOGGING_CATEGORY(lcJournal, "photobooth.journal")
+Q_LOGGING_CATEGORY(lcStartup, "photobooth.startup")
+
+namespace {
+
+const int CATEGORY_BYTES = 40;
+const int TEXT_BYTES = BoothLog::SLOT_BYTES - CATEGORY_BYTES - 32;
+const char LEVEL_LETTERS[] = "DIWCF";
+
+std::atomic<BoothLog*> s_installed{nullptr};
+
+int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value >= 0 ? value : defaultValue;
+}
+
+BoothLog::Level envLevel() {
+    const QString level = qEnvironmentVariable("PHOTOBOOTH_LOG_LEVEL").toLower();
+    if (level == "debug") {
+        return BoothLog::Debug;
+    } else if (level == "warning") {
+        return BoothLog::Warning;
+    } else if (level == "critical") {
+        return BoothLog::Critical;
+    }
+    return BoothLog::Info;
+}
+
+BoothLog::Level levelOf(QtMsgType type) {
+    switch (type) {
+    case QtDebugMsg:
+        return BoothLog::Debug;
+    case QtInfoMsg:
+        return BoothLog::Info;
+    case QtWarningMsg:
+        return BoothLog::Warning;
+    case QtCriticalMsg:
+        return BoothLog::Critical;
+    default:
+        return BoothLog::Fatal;
+    }
+}
+
+QString defaultFilePath() {
+    const QString path = qEnvironmentVariable("PHOTOBOOTH_LOG_FILE");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/logs/photobooth.log";
+}
+
+// Copies as much of text as fits without splitting a UTF-8 sequence
+int copyTruncated(char *destination, int capacity, const char* text, int length) {
+    int copied = std::min(length, capacity);
+    while (copied > 0 && copied < length && (static_cast<uchar>(text[copied]) & 0xC0) == 0x80) {
+        --copied;
+    }
+    std::memcpy(destination, text, copied);
+    return copied;
+}
+
+} // namespace
+
+// Published when sequence is 2 * position + 2; odd while being written
+struct BoothLog::Slot {
+    std::atomic<quint64> sequence{0};
+    qint64 timeMs = 0;
+    quint64 thread = 0;
+    quint8 level = 0;
+    quint8 categoryLength = 0;
+    quint16 textLength = 0;
+    char category[CATEGORY_BYTES];
+    char text[TEXT_BYTES];
+};
+
+struct BoothLog::Record {
+    qint64 timeMs;
+    quint64 thread;
+    Level level;
+    int categoryLength;
+    int textLength;
+    char category[CATEGORY_BYTES];
+    char text[TEXT_BYTES];
+};
+
+Q_GLOBAL_STATIC_WITH_ARGS(BoothLog, s_boothLog, (defaultFilePath(), envInt("PHOTOBOOTH_LOG_RING", 2048)))
+
+namespace {
+
+void messageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    BoothLog *log = s_installed.load(std::memory_order_acquire);
+    if (!log) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+        return;
+    }
+    log->log(type, context.category, message);
+    if (type == QtFatalMsg) {
+        // Qt aborts as soon as this returns
+        log->flush();
+    }
+}
+
+quint64 ringSize(int slotCount) {
+    quint64 size = 64;
+    while (size < static_cast<quint64>(slotCount)) {
+        size *= 2;
+    }
+    return size;
+}
+
+} // namespace
+
+BoothLog::BoothLog(const QString& filePath, int slotCount)
+    : m_filePath(filePath)
+    , m_mask(ringSize(slotCount) - 1)
+    , m_slots(new Slot[m_mask + 1])
+    , m_head(0)
+    , m_level(envLevel())
+    , m_maxFileBytes(static_cast<qint64>(std::max(64, envInt("PHOTOBOOTH_LOG_MAX_KB", 2048))) * 1024)
+    , m_keepFiles(envInt("PHOTOBOOTH_LOG_FILES", 3))
+    , m_dumpSeconds(envInt("PHOTOBOOTH_LOG_DUMP_SECONDS", 30))
+    , m_stderr(qEnvironmentVariable("PHOTOBOOTH_LOG_STDERR") != "0")
+    , m_drained(0)
+    , m_overwritten(0)
+    , m_fileFailed(false)
+    , m_stopping(false)
+{
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->setObjectName("BoothLog");
+    m_writer->start(QThread::LowPriority);
+}
+
+BoothLog::~BoothLog() {
+    BoothLog *self = this;
+    if (s_installed.compare_exchange_strong(self, nullptr)) {
+        qInstallMessageHandler(nullptr);
+    }
+    m_stopping.store(true, std::memory_order_release);
+    m_wake.release();
+    m_writer->wait();
+    delete m_writer;
+}
+
+void BoothLog::install() {
+    const QString rules = qEnvironmentVariable("PHOTOBOOTH_LOG_RULES");
+    if (!rules.isEmpty()) {
+        QLoggingCategory::setFilterRules(QString(rules).replace(';', '\n'));
+    }
+    BoothLog *log = s_boothLog();
+    s_installed.store(log, std::memory_order_release);
+    qInstallMessageHandler(messageHandler);
+    qInfo() << "BoothLog: Logging to" << log->filePath() << "at level" << LEVEL_LETTERS[log->level()]
+            << "with" << (log->m_mask + 1) << "slots";
+}
+
+BoothLog* BoothLog::instance() {
+    return s_installed.load(std::memory_order_acquire);
+}
+
+void BoothLog::log(QtMsgType type, const char* category, const QString& message) {
+    const Level level = levelOf(type);
+    const QByteArray text = message.toUtf8();
+    if (!category) {
+        category = "default";
+    }
+    const int categoryLength = static_cast<int>(std::strlen(category));
+
+    const quint64 position = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[position & m_mask];
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeMs = QDateTime::currentMSecsSinceEpoch();
+    slot.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    slot.level = level;
+    slot.categoryLength = copyTruncated(slot.category, CATEGORY_BYTES, category, categoryLength);
+    slot.textLength = copyTruncated(slot.text, TEXT_BYTES, text.constData(), text.size());
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+
+    if (level >= Warning) {
+        m_wake.release();
+    }
+}
+
+BoothLog::ReadResult BoothLog::readSlot(quint64 position, Record *record) const {
+    const Slot& slot = m_slots[position & m_mask];
+    const quint64 published = 2 * position + 2;
+    const quint64 before = slot.sequence.load(std::memory_order_acquire);
+    if (before < published) {
+        return NotWritten;
+    } else if (before > published) {
+        return Overwritten;
+    }
+
+    record->timeMs = slot.timeMs;
+    record->thread = slot.thread;
+    record->level = static_cast<Level>(std::min<int>(slot.level, Fatal));
+    record->categoryLength = std::min<int>(slot.categoryLength, CATEGORY_BYTES);
+    record->textLength = std::min<int>(slot.textLength, TEXT_BYTES);
+    std::memcpy(record->category, slot.category, record->categoryLength);
+    std::memcpy(record->text, slot.text, record->textLength);
+
+    // A writer that lapped us while we copied makes the copy garbage
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == before ? Read : Overwritten;
+}
+
+QByteArray BoothLog::formatRecord(const Record& record) {
+    QByteArray line = QDateTime::fromMSecsSinceEpoch(record.timeMs).toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+    line += ' ';
+    line += LEVEL_LETTERS[record.level];
+    line += ' ';
+    line += QByteArray(record.category, record.categoryLength);
+    line += " [";
+    line += QByteArray::number(record.thread, 16);
+    line += "] ";
+    line += QByteArray(record.text, record.textLength);
+    line += '\n';
+    return line;
+}
+
+void BoothLog::writerLoop() {
+    forever {
+        m_wake.tryAcquire(1, FLUSH_INTERVAL_MS);
+        m_wake.tryAcquire(m_wake.available());
+        const bool stopping = m_stopping.load(std::memory_order_acquire);
+
+        drain();
+        QString reason;
+        {
+            QMutexLocker locker(&m_dumpMutex);
+            reason.swap(m_dumpReason);
+        }
+        if (!reason.isEmpty()) {
+            dumpRecent(m_dumpSeconds, reason);
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void BoothLog::flush() {
+    drain();
+}
+
+void BoothLog::drain() {
+    QMutexLocker locker(&m_writeMutex);
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 capacity = m_mask + 1;
+    if (head - m_drained > capacity) {
+        m_overwritten += head - capacity - m_drained;
+        m_drained = head - capacity;
+    }
+
+    const Level level = this->level();
+    QByteArray lines;
+    Record record;
+    while (m_drained < head) {
+        const ReadResult result = readSlot(m_drained, &record);
+        if (result == NotWritten) {
+            break;  // Still being written; picked up next time
+        }
+        ++m_drained;
+        if (result == Overwritten) {
+            ++m_overwritten;
+        } else if (record.level >= level) {
+            lines += formatRecord(record);
+        }
+    }
+    if (m_overwritten > 0) {
+        lines.prepend(QString("%1 W photobooth.log %2 messages overwritten before they were written out\n")
+                          .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz"))
+                          .arg(m_overwritten)
+                          .toLatin1());
+        m_overwritten = 0;
+    }
+    if (!lines.isEmpty()) {
+        writeOut(lines);
+    }
+}
+
+void BoothLog::writeOut(const QByteArray& lines) {
+    if (m_stderr) {
+        std::fwrite(lines.constData(), 1, lines.size(), stderr);
+    }
+    if (m_fileFailed) {
+        return;
+    }
+    if (m_file.isOpen() && m_file.size() + lines.size() > m_maxFileBytes) {
+        rotate();
+    }
+    if (!m_file.isOpen()) {
+        QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+        m_file.setFileName(m_filePath);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            // Not through qWarning(): that would come straight back here
+            std::fprintf(stderr, "BoothLog: Cannot open %s: %s\n", qPrintable(m_filePath),
+                         qPrintable(m_file.errorString()));
+            m_fileFailed = true;
+            return;
+        }
+    }
+    m_file.write(lines);
+    m_file.flush();
+}
+
+void BoothLog::rotate() {
+    m_file.close();
+    QFile::remove(QString("%1.%2").arg(m_filePath).arg(m_keepFiles));
+    for (int i = m_keepFiles - 1; i >= 1; --i) {
+        QFile::rename(QString("%1.%2").arg(m_filePath).arg(i), QString("%1.%2").arg(m_filePath).arg(i + 1));
+    }
+    if (m_keepFiles > 0) {
+        QFile::rename(m_filePath, m_filePath + ".1");
+    } else {
+        QFile::remove(m_filePath);
+    }
+}
+
+void BoothLog::requestDump(const QString& reason) {
+    {
+        QMutexLocker locker(&m_dumpMutex);
+        m_dumpReason = reason.isEmpty() ? QString("Dump requested") : reason;
+    }
+    m_wake.release();
+}
+
+QString BoothLog::dumpRecent(int seconds, const QString& reason) {
+    const qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - static_cast<qint64>(seconds) * 1000;
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 oldest = head > m_mask + 1 ? head - (m_mask + 1) : 0;
+
+    // Newest first, until the cutoff or the oldest message still in the ring
+    std::vector<QByteArray> lines;
+    Record record;
+    for (quint64 position = head; position > oldest; --position) {
+        const ReadResult result = readSlot(position - 1, &record);
+        if (result == Overwritten) {
+            break;
+        } else if (result == Read) {
+            if (record.timeMs < cutoff) {
+                break;
+            }
+            lines.push_back(formatRecord(record));
+        }
+    }
+
+    const QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+    const QString path = QFileInfo(m_filePath).absoluteDir().filePath(QString("photobooth-dump-%1.log").arg(stamp));
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "BoothLog: Cannot write log dump" << path << ":" << file.errorString();
+        return QString();
+    }
+    file.write(QString("# %1; the last %2 s, %3 messages\n").arg(reason).arg(seconds).arg(lines.size()).toUtf8());
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+        file.write(*it);
+    }
+    file.close();
+    qWarning() << "BoothLog:" << reason << "- saved the last" << seconds << "s of log to" << path;
+    return path;
+}
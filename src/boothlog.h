@@ -0,0 +1,126 @@
+#ifndef BOOTHLOG_H
+#define BOOTHLOG_H
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+class QThread;
+
+Q_DECLARE_LOGGING_CATEGORY(lcSession)   // photobooth.session: guest flow and session data
+Q_DECLARE_LOGGING_CATEGORY(lcUi)        // photobooth.ui: screens and artwork
+Q_DECLARE_LOGGING_CATEGORY(lcCamera)    // photobooth.camera: backends, preview, capture and bursts
+Q_DECLARE_LOGGING_CATEGORY(lcStorage)   // photobooth.storage: save queue, photo directory, thumbnails, image memory
+Q_DECLARE_LOGGING_CATEGORY(lcPrint)     // photobooth.print: layout, print queue and printers
+Q_DECLARE_LOGGING_CATEGORY(lcUpload)    // photobooth.upload: upload queue
+Q_DECLARE_LOGGING_CATEGORY(lcJournal)   // photobooth.journal: session journal
+Q_DECLARE_LOGGING_CATEGORY(lcStartup)   // photobooth.startup: startup phases
+
+// Asynchronous log for the booth, installed as the Qt message handler so
+// every qDebug()/qCDebug() line goes through it.
+//
+// Logging categories (above, or any QLoggingCategory) switch messages on and
+// off at runtime with PHOTOBOOTH_LOG_RULES or QT_LOGGING_RULES, in
+// QLoggingCategory rule syntax (e.g. "photobooth.camera.debug=false"). A
+// disabled qCDebug() returns before its arguments are evaluated.
+//
+// An enabled message is copied into a fixed-size slot of a ring without
+// taking a lock: the writer claims a slot with an atomic increment and
+// publishes it with a sequence number, which readers check before and after
+// copying it out (a seqlock). A writer thread drains the ring every
+// FLUSH_INTERVAL_MS, or at once for warnings, to a rotating file and stderr.
+// Only messages at PHOTOBOOTH_LOG_LEVEL (info by default) or above are
+// written out; the ring keeps debug messages too, so dumpRecent() can save
+// the whole story before a capture error to a file of its own. If the
+// writer falls a ring behind, the oldest messages are overwritten and their
+// count is logged.
+//
+// Files: PHOTOBOOTH_LOG_FILE (logs/photobooth.log in the app data directory)
+// is rotated to .1, .2, ... at PHOTOBOOTH_LOG_MAX_KB, keeping
+// PHOTOBOOTH_LOG_FILES old files. Dumps go next to it.
+class BoothLog {
+public:
+    // Same order as the severity, unlike QtMsgType
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Critical,
+        Fatal
+    };
+
+    static const int SLOT_BYTES = 512;
+    static const int FLUSH_INTERVAL_MS = 100;
+
+    // slotCount is rounded up to a power of two
+    BoothLog(const QString& filePath, int slotCount);
+    ~BoothLog();
+
+    // Applies the rules and installs the message handler; call once the
+    // QApplication exists. Messages before that go to stderr as before.
+    static void install();
+    static BoothLog* instance();     // Null until install()
+
+    Level level() const { return static_cast<Level>(m_level.load(std::memory_order_relaxed)); }
+    void setLevel(Level level) { m_level.store(level, std::memory_order_relaxed); }
+    QString filePath() const { return m_filePath; }
+
+    // Appends a message to the ring; safe from any thread
+    void log(QtMsgType type, const char* category, const QString& message);
+
+    // Writes everything in the ring from the last seconds, debug included, to
+    // a new file next to the log and returns its path. requestDump() does the
+    // same on the writer thread, for callers that mustn't block on the card.
+    QString dumpRecent(int seconds, const QString& reason);
+    void requestDump(const QString& reason);     // Last PHOTOBOOTH_LOG_DUMP_SECONDS (30)
+
+    // Writes out whatever is in the ring now
+    void flush();
+
+private:
+    struct Slot;
+    struct Record;
+
+    enum ReadResult {
+        Read,
+        NotWritten,     // Claimed but not yet published
+        Overwritten     // The ring has wrapped past it
+    };
+
+    ReadResult readSlot(quint64 position, Record *record) const;
+    void writerLoop();
+    void drain();
+    void writeOut(const QByteArray& lines);
+    void rotate();
+    static QByteArray formatRecord(const Record& record);
+
+    const QString m_filePath;
+    const quint64 m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<quint64> m_head;        // Next position to claim
+    std::atomic<int> m_level;
+    qint64 m_maxFileBytes;
+    int m_keepFiles;
+    int m_dumpSeconds;
+    bool m_stderr;
+
+    // Writer side; m_writeMutex lets flush() and a fatal message drain from
+    // other threads
+    QMutex m_writeMutex;
+    quint64 m_drained;                  // Next position to write out
+    quint64 m_overwritten;
+    QFile m_file;
+    bool m_fileFailed;
+
+    QSemaphore m_wake;
+    QMutex m_dumpMutex;                 // Guards m_dumpReason
+    QString m_dumpReason;
+    std::atomic<bool> m_stopping;
+    QThread *m_writer;
+};
+
+#endif // BOOTHLOG_H
@@ -1,12 +1,15 @@
 #include "camerafactory.h"
+#include "boothlog.h"
 #include "mockcamera.h"
 
 // Include platform-specific cameras based on compile definitions
 #ifdef HAS_QT_MULTIMEDIA
 #include "qtcamera.h"
+#include <QMediaDevices>
+#include <QCameraDevice>
 #endif
 
-#ifdef IS_RASPBERRY_PI
+#ifdef HAS_PI_CAMERA
 #include "picamera.h"
 #endif
 
@@ -15,39 +18,99 @@
 #include <QFile>
 
 std::unique_ptr<ICamera> CameraFactory::createCamera(CameraType type, QObject* parent) {
-    QString platform = QSysInfo::prettyProductName();
-    qDebug() << "Using Qt Camera for platform:" << platform;
-
-#ifdef IS_MAC
-    // Always use mock camera on macOS for testing
-    qDebug() << "Creating camera of type: \"Mock Camera (macOS testing)\"";
-    return std::make_unique<MockCamera>(parent);
-#else
-    switch (type) {
-        case AUTO_DETECT:
-            if (platform.contains("Raspberry", Qt::CaseInsensitive)) {
-                qDebug() << "Creating camera of type: \"Pi Camera\"";
-                return std::make_unique<PiCamera>(parent);
-            } else {
-                qDebug() << "Creating camera of type: \"Qt Camera\"";
-                return std::make_unique<QtCamera>(parent);
-            }
+    switch (resolveCameraType(type)) {
+#ifdef HAS_QT_MULTIMEDIA
         case QT_CAMERA:
-            qDebug() << "Creating camera of type: \"Qt Camera\"";
+            qCDebug(lcCamera) << "Creating camera of type: \"Qt Camera\"";
             return std::make_unique<QtCamera>(parent);
+#endif
+#ifdef HAS_PI_CAMERA
         case PI_CAMERA:
-            qDebug() << "Creating camera of type: \"Pi Camera\"";
+            qCDebug(lcCamera) << "Creating camera of type: \"Pi Camera\"";
             return std::make_unique<PiCamera>(parent);
+#endif
         case MOCK_CAMERA:
-            qDebug() << "Creating camera of type: \"Mock Camera\"";
+            qCDebug(lcCamera) << "Creating camera of type: \"Mock Camera\"";
             return std::make_unique<MockCamera>(parent);
         default:
-            qWarning() << "Unknown camera type, falling back to mock";
+            qCWarning(lcCamera) << "Unknown camera type, falling back to mock";
             return std::make_unique<MockCamera>(parent);
     }
+}
+
+CameraFactory::CameraType CameraFactory::resolveCameraType(CameraType type) {
+    if (type != AUTO_DETECT) {
+        return type;
+    }
+
+#ifdef IS_MAC
+    // Always use mock camera on macOS for testing
+    qCDebug(lcCamera) << "Using mock camera on macOS for testing";
+    return MOCK_CAMERA;
+#else
+    // PHOTOBOOTH_CAMERA=pi|qt|mock overrides auto detection, e.g. to drive the
+    // Pi camera path with a fake capture helper on a desktop machine
+    QString requested = qEnvironmentVariable("PHOTOBOOTH_CAMERA").toLower();
+    if (requested == "pi") {
+        return PI_CAMERA;
+    } else if (requested == "qt") {
+        return QT_CAMERA;
+    } else if (requested == "mock") {
+        return MOCK_CAMERA;
+    }
+
+    QString platform = QSysInfo::prettyProductName();
+#ifdef HAS_PI_CAMERA
+    if (platform.contains("Raspberry", Qt::CaseInsensitive)) {
+        return PI_CAMERA;
+    }
+#endif
+#ifdef HAS_QT_MULTIMEDIA
+    qCDebug(lcCamera) << "Using Qt Camera for platform:" << platform;
+    return QT_CAMERA;
+#else
+    return MOCK_CAMERA;
+#endif
 #endif
 }
 
+bool CameraFactory::probeCamera(CameraType type, QString* description) {
+    QString found;
+    bool available = false;
+
+    switch (type) {
+#ifdef HAS_QT_MULTIMEDIA
+        case QT_CAMERA: {
+            // Enumerating devices loads the multimedia backend, which is most
+            // of QtCamera's start-up cost; the GUI thread then finds it loaded
+            const QList<QCameraDevice> cameras = QMediaDevices::videoInputs();
+            available = !cameras.isEmpty();
+            if (available) {
+                found = QMediaDevices::defaultVideoInput().description();
+            }
+            break;
+        }
+#endif
+#ifdef HAS_PI_CAMERA
+        case PI_CAMERA:
+            available = PiCamera::checkCameraAvailable();
+            found = "Raspberry Pi camera helper";
+            break;
+#endif
+        case MOCK_CAMERA:
+            available = true;
+            found = "Mock camera";
+            break;
+        default:
+            break;
+    }
+
+    if (description) {
+        *description = available ? found : QString();
+    }
+    return available;
+}
+
 CameraFactory::CameraType CameraFactory::detectBestCamera() {
 #ifdef IS_RASPBERRY_PI
     // Check if we're on Raspberry Pi by looking for Pi-specific files
@@ -56,7 +119,7 @@ CameraFactory::CameraType CameraFactory::detectBestCamera() {
         if (modelFile.open(QIODevice::ReadOnly)) {
             QString model = QString::fromUtf8(modelFile.readAll());
             if (model.contains("Raspberry Pi", Qt::CaseInsensitive)) {
-                qDebug() << "Detected Raspberry Pi via device tree:" << model.trimmed();
+                qCDebug(lcCamera) << "Detected Raspberry Pi via device tree:" << model.trimmed();
                 return PI_CAMERA;
             }
         }
@@ -65,19 +128,19 @@ CameraFactory::CameraType CameraFactory::detectBestCamera() {
     // Check hostname as backup
     if (QSysInfo::machineHostName().contains("raspberry", Qt::CaseInsensitive) ||
         QSysInfo::productType().contains("raspberry", Qt::CaseInsensitive)) {
-        qDebug() << "Detected Raspberry Pi via hostname/product type";
+        qCDebug(lcCamera) << "Detected Raspberry Pi via hostname/product type";
         return PI_CAMERA;
     }
 #endif
 
 #ifdef HAS_QT_MULTIMEDIA
     // For Mac/Windows/Linux with Qt Multimedia, try Qt Camera
-    qDebug() << "Using Qt Camera for platform:" << QSysInfo::prettyProductName();
+    qCDebug(lcCamera) << "Using Qt Camera for platform:" << QSysInfo::prettyProductName();
     return QT_CAMERA;
 #endif
 
     // Fallback to mock camera
-    qDebug() << "No platform-specific camera available, using mock camera";
+    qCDebug(lcCamera) << "No platform-specific camera available, using mock camera";
     return MOCK_CAMERA;
 }
 
@@ -15,6 +15,14 @@ public:
     };
 
     static std::unique_ptr<ICamera> createCamera(CameraType type = AUTO_DETECT, QObject* parent = nullptr);
+
+    // Applies the platform rules and PHOTOBOOTH_CAMERA to AUTO_DETECT; any
+    // other type is returned unchanged
+    static CameraType resolveCameraType(CameraType type);
+
+    // Checks whether hardware for a resolved type is present without creating
+    // a camera or any widgets. Runs on the camera bring-up worker thread.
+    static bool probeCamera(CameraType type, QString* description = nullptr);
     static CameraType detectBestCamera();
     static QString cameraTypeToString(CameraType type);
 };
@@ -0,0 +1,232 @@
+#include "cameraframe.h"
+#include "framepool.h"
+#include <algorithm>
+
+namespace {
+
+void cleanupImageFrame(void* info) {
+    delete static_cast<CameraFrame*>(info);
+}
+
+inline QRgb yuvToRgb(int y, int u, int v) {
+    // BT.601 limited range
+    int c = (y - 16) * 298;
+    int d = u - 128;
+    int e = v - 128;
+    int r = (c + 409 * e + 128) >> 8;
+    int g = (c - 100 * d - 208 * e + 128) >> 8;
+    int b = (c + 516 * d + 128) >> 8;
+    return qRgb(std::clamp(r, 0, 255), std::clamp(g, 0, 255), std::clamp(b, 0, 255));
+}
+
+} // namespace
+
+CameraFrame::CameraFrame()
+    : m_buffer(nullptr)
+{
+}
+
+CameraFrame::CameraFrame(const std::shared_ptr<FramePoolState>& state, FrameBuffer* buffer)
+    : m_state(state)
+    , m_buffer(buffer)
+{
+    // The pool hands the buffer over with a reference count of one
+}
+
+CameraFrame::CameraFrame(const CameraFrame& other)
+    : m_state(other.m_state)
+    , m_buffer(other.m_buffer)
+{
+    if (m_buffer) {
+        m_buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+CameraFrame::CameraFrame(CameraFrame&& other) noexcept
+    : m_state(std::move(other.m_state))
+    , m_buffer(other.m_buffer)
+{
+    other.m_buffer = nullptr;
+}
+
+CameraFrame& CameraFrame::operator=(const CameraFrame& other) {
+    if (this != &other) {
+        if (other.m_buffer) {
+            other.m_buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        release();
+        m_state = other.m_state;
+        m_buffer = other.m_buffer;
+    }
+    return *this;
+}
+
+CameraFrame& CameraFrame::operator=(CameraFrame&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_state = std::move(other.m_state);
+        m_buffer = other.m_buffer;
+        other.m_buffer = nullptr;
+    }
+    return *this;
+}
+
+CameraFrame::~CameraFrame() {
+    release();
+}
+
+void CameraFrame::release() {
+    if (m_buffer && m_buffer->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_state->release(m_buffer);
+    }
+    m_buffer = nullptr;
+    m_state.reset();
+}
+
+int CameraFrame::width() const {
+    return m_buffer ? m_buffer->width : 0;
+}
+
+int CameraFrame::height() const {
+    return m_buffer ? m_buffer->height : 0;
+}
+
+CameraFrame::PixelFormat CameraFrame::pixelFormat() const {
+    return m_buffer ? m_buffer->format : Format_Invalid;
+}
+
+qint64 CameraFrame::timestampNs() const {
+    return m_buffer ? m_buffer->timestampNs : 0;
+}
+
+quint64 CameraFrame::sequence() const {
+    return m_buffer ? m_buffer->sequence : 0;
+}
+
+int CameraFrame::useCount() const {
+    return m_buffer ? m_buffer->refCount.load(std::memory_order_relaxed) : 0;
+}
+
+int CameraFrame::planeCount() const {
+    return m_buffer ? m_buffer->planeCount : 0;
+}
+
+int CameraFrame::bytesPerLine(int plane) const {
+    return m_buffer && plane < m_buffer->planeCount ? m_buffer->bytesPerLine[plane] : 0;
+}
+
+int CameraFrame::planeHeight(int plane) const {
+    return m_buffer && plane < m_buffer->planeCount ? m_buffer->planeHeight[plane] : 0;
+}
+
+const uchar* CameraFrame::constBits(int plane) const {
+    if (!m_buffer || plane >= m_buffer->planeCount) {
+        return nullptr;
+    }
+    return m_buffer->storage.get() + m_buffer->planeOffset[plane];
+}
+
+uchar* CameraFrame::bits(int plane) {
+    return const_cast<uchar*>(constBits(plane));
+}
+
+void CameraFrame::setTimestamp(qint64 timestampNs) {
+    if (m_buffer) {
+        m_buffer->timestampNs = timestampNs;
+    }
+}
+
+void CameraFrame::setSequence(quint64 sequence) {
+    if (m_buffer) {
+        m_buffer->sequence = sequence;
+    }
+}
+
+QImage CameraFrame::toImage() const {
+    if (!m_buffer) {
+        return QImage();
+    }
+
+    const int w = width();
+    const int h = height();
+
+    switch (pixelFormat()) {
+        case Format_RGB32:
+        case Format_ARGB32_Premultiplied:
+        case Format_Grayscale8:
+            // Zero-copy: the image owns a reference until it is destroyed
+            return QImage(constBits(0), w, h, bytesPerLine(0), toImageFormat(pixelFormat()),
+                          cleanupImageFrame, new CameraFrame(*this));
+        case Format_YUV420P: {
+            QImage image(w, h, QImage::Format_RGB32);
+            for (int y = 0; y < h; ++y) {
+                QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+                const uchar* yRow = constBits(0) + y * bytesPerLine(0);
+                const uchar* uRow = constBits(1) + (y / 2) * bytesPerLine(1);
+                const uchar* vRow = constBits(2) + (y / 2) * bytesPerLine(2);
+                for (int x = 0; x < w; ++x) {
+                    line[x] = yuvToRgb(yRow[x], uRow[x / 2], vRow[x / 2]);
+                }
+            }
+            return image;
+        }
+        case Format_NV12: {
+            QImage image(w, h, QImage::Format_RGB32);
+            for (int y = 0; y < h; ++y) {
+                QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+                const uchar* yRow = constBits(0) + y * bytesPerLine(0);
+                const uchar* uvRow = constBits(1) + (y / 2) * bytesPerLine(1);
+                for (int x = 0; x < w; ++x) {
+                    line[x] = yuvToRgb(yRow[x], uvRow[(x / 2) * 2], uvRow[(x / 2) * 2 + 1]);
+                }
+            }
+            return image;
+        }
+        case Format_Invalid:
+        default:
+            return QImage();
+    }
+}
+
+QImage CameraFrame::toGrayscaleImage() const {
+    switch (pixelFormat()) {
+        case Format_Grayscale8:
+        case Format_YUV420P:
+        case Format_NV12:
+            return QImage(constBits(0), width(), height(), bytesPerLine(0), QImage::Format_Grayscale8,
+                          cleanupImageFrame, new CameraFrame(*this));
+        case Format_RGB32:
+        case Format_ARGB32_Premultiplied:
+            return toImage().convertToFormat(QImage::Format_Grayscale8);
+        case Format_Invalid:
+        default:
+            return QImage();
+    }
+}
+
+int CameraFrame::planeCountFor(PixelFormat format) {
+    switch (format) {
+        case Format_YUV420P: return 3;
+        case Format_NV12: return 2;
+        case Format_Invalid: return 0;
+        default: return 1;
+    }
+}
+
+CameraFrame::PixelFormat CameraFrame::fromImageFormat(QImage::Format format) {
+    switch (format) {
+        case QImage::Format_RGB32: return Format_RGB32;
+        case QImage::Format_ARGB32_Premultiplied: return Format_ARGB32_Premultiplied;
+        case QImage::Format_Grayscale8: return Format_Grayscale8;
+        default: return Format_Invalid;
+    }
+}
+
+QImage::Format CameraFrame::toImageFormat(PixelFormat format) {
+    switch (format) {
+        case Format_RGB32: return QImage::Format_RGB32;
+        case Format_ARGB32_Premultiplied: return QImage::Format_ARGB32_Premultiplied;
+        case Format_Grayscale8: return QImage::Format_Grayscale8;
+        default: return QImage::Format_Invalid;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CAMERAFRAME_H
+#define CAMERAFRAME_H
+
+#include <QImage>
+#include <QtGlobal>
+#include <memory>
+
+struct FrameBuffer;
+struct FramePoolState;
+
+// Reference-counted handle to a frame buffer owned by a FramePool. Copying a
+// CameraFrame only bumps the reference count, so preview, effects and recorder
+// can hold the same pixels at once; the buffer goes back to its pool when the
+// last handle is released. Handles may be copied and released on any thread.
+class CameraFrame {
+public:
+    enum PixelFormat {
+        Format_Invalid,
+        Format_RGB32,
+        Format_ARGB32_Premultiplied,
+        Format_Grayscale8,
+        Format_YUV420P,     // Planar Y, U, V
+        Format_NV12         // Planar Y, interleaved UV
+    };
+
+    static const int MAX_PLANES = 3;
+
+    CameraFrame();
+    CameraFrame(const CameraFrame& other);
+    CameraFrame(CameraFrame&& other) noexcept;
+    CameraFrame& operator=(const CameraFrame& other);
+    CameraFrame& operator=(CameraFrame&& other) noexcept;
+    ~CameraFrame();
+
+    bool isValid() const { return m_buffer != nullptr; }
+    int width() const;
+    int height() const;
+    QSize size() const { return QSize(width(), height()); }
+    PixelFormat pixelFormat() const;
+    qint64 timestampNs() const;   // std::chrono::steady_clock
+    quint64 sequence() const;
+    int useCount() const;
+
+    int planeCount() const;
+    int bytesPerLine(int plane = 0) const;
+    int planeHeight(int plane = 0) const;
+    const uchar* constBits(int plane = 0) const;
+
+    // Only for the producer, before the frame is published
+    uchar* bits(int plane = 0);
+    void setTimestamp(qint64 timestampNs);
+    void setSequence(quint64 sequence);
+
+    // RGB and grayscale frames are wrapped without copying (the image keeps the
+    // buffer alive); YUV frames are converted to RGB32.
+    QImage toImage() const;
+
+    // Luma only: YUV frames wrap their Y plane and grayscale frames wrap
+    // themselves, without copying; RGB frames are converted.
+    QImage toGrayscaleImage() const;
+
+    static int planeCountFor(PixelFormat format);
+    static PixelFormat fromImageFormat(QImage::Format format);
+    static QImage::Format toImageFormat(PixelFormat format);
+
+private:
+    friend class FramePool;
+    CameraFrame(const std::shared_ptr<FramePoolState>& state, FrameBuffer* buffer);
+    void release();
+
+    std::shared_ptr<FramePoolState> m_state;
+    FrameBuffer* m_buffer;
+};
+
+#endif // CAMERAFRAME_H
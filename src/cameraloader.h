@@ -0,0 +1,55 @@
+#ifndef CAMERALOADER_H
+#define CAMERALOADER_H
+
+#include "camerafactory.h"
+#include <QObject>
+#include <QString>
+#include <memory>
+
+class ICamera;
+
+// Brings the camera up without holding up the window. Detection and the
+// hardware probe run on a pool thread, including the decision to fall back
+// to MockCamera; only creating the camera and its preview widget happens on
+// the GUI thread, in a later event loop pass. Each phase is recorded with
+// StartupTelemetry.
+class CameraLoader : public QObject {
+    Q_OBJECT
+
+public:
+    enum State {
+        Idle,
+        Probing,
+        Initializing,
+        Ready,
+        Failed
+    };
+    Q_ENUM(State)
+
+    explicit CameraLoader(QObject *parent = nullptr);
+    ~CameraLoader() override;
+
+    void start(CameraFactory::CameraType type = CameraFactory::AUTO_DETECT);
+
+    State state() const { return m_state; }
+    bool isReady() const { return m_state == Ready; }
+
+    // Ownership passes to the caller; valid once ready() has been emitted
+    std::unique_ptr<ICamera> takeCamera();
+
+signals:
+    void stateChanged(CameraLoader::State state);
+    void ready();
+    void failed(const QString& errorMessage);
+
+private:
+    void onProbeFinished(CameraFactory::CameraType type, bool available,
+                         const QString& description, qint64 probeMs);
+    bool createAndInitialize(CameraFactory::CameraType type);
+    void setState(State state);
+
+    State m_state;
+    std::unique_ptr<ICamera> m_camera;
+};
+
+#endif // CAMERALOADER_H
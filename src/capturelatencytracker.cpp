@@ -0,0 +1,220 @@
+#include "capturelatencytracker.h"
+#include "boothlog.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QDebug>
+#include <chrono>
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const CaptureLatencyTracker::Span SPANS[] = {
+    {"countdown",         CaptureLatencyTracker::TakePhotoPressed,  CaptureLatencyTracker::CountdownFinished},
+    {"flash_delay",       CaptureLatencyTracker::CountdownFinished, CaptureLatencyTracker::CaptureRequested},
+    {"camera_capture",    CaptureLatencyTracker::CaptureRequested,  CaptureLatencyTracker::PhotoReady},
+    {"review_scale",      CaptureLatencyTracker::PhotoReady,        CaptureLatencyTracker::ReviewScaled},
+    {"review_paint",      CaptureLatencyTracker::ReviewScaled,      CaptureLatencyTracker::ReviewPainted},
+    {"file_write",        CaptureLatencyTracker::PhotoReady,        CaptureLatencyTracker::PhotoSaved},
+    {"capture_to_review", CaptureLatencyTracker::CaptureRequested,  CaptureLatencyTracker::ReviewPainted},
+    {"button_to_review",  CaptureLatencyTracker::TakePhotoPressed,  CaptureLatencyTracker::ReviewPainted},
+};
+
+const char* const STAGE_NAMES[] = {
+    "take_photo_pressed", "countdown_finished", "capture_requested", "photo_ready",
+    "review_scaled", "review_painted", "photo_saved"
+};
+
+#ifdef Q_OS_UNIX
+int s_signalPipe[2] = {-1, -1};
+
+void exportSignalHandler(int) {
+    char byte = 1;
+    ssize_t written = ::write(s_signalPipe[1], &byte, 1);
+    Q_UNUSED(written)
+}
+#endif
+
+double toMs(qint64 nanoseconds) {
+    return nanoseconds / 1e6;
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC(CaptureLatencyTracker, s_captureLatencyTracker)
+
+CaptureLatencyTracker* CaptureLatencyTracker::instance() {
+    return s_captureLatencyTracker();
+}
+
+CaptureLatencyTracker::CaptureLatencyTracker(QObject *parent)
+    : QObject(parent)
+    , m_signalNotifier(nullptr)
+{
+    static_assert(sizeof(SPANS) / sizeof(SPANS[0]) == SPAN_COUNT, "span table out of sync");
+    static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == StageCount, "stage names out of sync");
+    for (std::atomic<qint64>& mark : m_marks) {
+        mark.store(0, std::memory_order_relaxed);
+    }
+}
+
+CaptureLatencyTracker::~CaptureLatencyTracker() {
+    delete m_signalNotifier;
+}
+
+qint64 CaptureLatencyTracker::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CaptureLatencyTracker::mark(Stage stage) {
+    const qint64 now = nowNs();
+
+    if (stage == TakePhotoPressed) {
+        for (int i = 1; i < StageCount; ++i) {
+            m_marks[i].store(0, std::memory_order_relaxed);
+        }
+        m_marks[TakePhotoPressed].store(now, std::memory_order_relaxed);
+        return;
+    }
+
+    if (m_marks[TakePhotoPressed].load(std::memory_order_relaxed) == 0) {
+        return; // Not inside a capture cycle
+    }
+
+    qint64 unset = 0;
+    if (!m_marks[stage].compare_exchange_strong(unset, now, std::memory_order_relaxed)) {
+        return; // First mark per cycle wins
+    }
+
+    for (int i = 0; i < SPAN_COUNT; ++i) {
+        if (SPANS[i].to != stage) {
+            continue;
+        }
+        qint64 from = m_marks[SPANS[i].from].load(std::memory_order_relaxed);
+        if (from != 0) {
+            m_histograms[i].record(now - from);
+        }
+    }
+}
+
+int CaptureLatencyTracker::spanCount() {
+    return SPAN_COUNT;
+}
+
+const CaptureLatencyTracker::Span& CaptureLatencyTracker::span(int index) {
+    return SPANS[index];
+}
+
+void CaptureLatencyTracker::reset() {
+    for (LatencyHistogram& histogram : m_histograms) {
+        histogram.reset();
+    }
+    for (std::atomic<qint64>& mark : m_marks) {
+        mark.store(0, std::memory_order_relaxed);
+    }
+}
+
+QJsonObject CaptureLatencyTracker::toJson() const {
+    QJsonObject spans;
+    for (int i = 0; i < SPAN_COUNT; ++i) {
+        const LatencyHistogram& histogram = m_histograms[i];
+        QJsonObject entry;
+        entry["from"] = STAGE_NAMES[SPANS[i].from];
+        entry["to"] = STAGE_NAMES[SPANS[i].to];
+        entry["count"] = static_cast<qint64>(histogram.count());
+        entry["mean_ms"] = toMs(static_cast<qint64>(histogram.meanNs()));
+        entry["p50_ms"] = toMs(histogram.percentileNs(50));
+        entry["p95_ms"] = toMs(histogram.percentileNs(95));
+        entry["p99_ms"] = toMs(histogram.percentileNs(99));
+        entry["max_ms"] = toMs(histogram.maxNs());
+        spans[SPANS[i].name] = entry;
+    }
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["generated"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+    root["spans"] = spans;
+    return root;
+}
+
+QString CaptureLatencyTracker::exportPath() const {
+    QString path = qEnvironmentVariable("PHOTOBOOTH_LATENCY_FILE");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+        .absoluteFilePath("capture-latency.json");
+}
+
+bool CaptureLatencyTracker::exportToFile(const QString& filePath) const {
+    QString path = filePath.isEmpty() ? exportPath() : filePath;
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcSession) << "CaptureLatencyTracker: Cannot write" << path << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(toJson()).toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        qCWarning(lcSession) << "CaptureLatencyTracker: Failed to save" << path << ":" << file.errorString();
+        return false;
+    }
+
+    const LatencyHistogram& total = m_histograms[SPAN_COUNT - 1];
+    qCDebug(lcSession) << "CaptureLatencyTracker: Exported to" << path << "-" << total.count() << "captures,"
+             << "button to review p50" << toMs(total.percentileNs(50)) << "ms, p99"
+             << toMs(total.percentileNs(99)) << "ms";
+    return true;
+}
+
+void CaptureLatencyTracker::exportNow() {
+    exportToFile();
+}
+
+void CaptureLatencyTracker::installExportSignalHandler() {
+#ifdef Q_OS_UNIX
+    if (m_signalNotifier) {
+        return;
+    }
+    if (::pipe(s_signalPipe) != 0) {
+        qCWarning(lcSession) << "CaptureLatencyTracker: Cannot create signal pipe";
+        return;
+    }
+    ::fcntl(s_signalPipe[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(s_signalPipe[1], F_SETFL, O_NONBLOCK);
+
+    // The handler only writes to the pipe; the export runs on the event loop
+    m_signalNotifier = new QSocketNotifier(s_signalPipe[0], QSocketNotifier::Read);
+    connect(m_signalNotifier, &QSocketNotifier::activated, this, &CaptureLatencyTracker::onExportSignal);
+
+    struct sigaction action = {};
+    action.sa_handler = exportSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+    qCDebug(lcSession) << "CaptureLatencyTracker: Send SIGUSR1 to export capture latencies";
+#endif
+}
+
+void CaptureLatencyTracker::onExportSignal() {
+#ifdef Q_OS_UNIX
+    char buffer[16];
+    while (::read(s_signalPipe[0], buffer, sizeof(buffer)) > 0) {
+    }
+#endif
+    exportNow();
+}
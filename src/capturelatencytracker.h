@@ -0,0 +1,80 @@
+#ifndef CAPTURELATENCYTRACKER_H
+#define CAPTURELATENCYTRACKER_H
+
+#include "latencyhistogram.h"
+#include <QObject>
+#include <QString>
+#include <QJsonObject>
+#include <atomic>
+
+class QSocketNotifier;
+
+// Records monotonic timestamps at each stage of a capture, from the Take Photo
+// press to the review image being painted and the file reaching storage, and
+// keeps a latency histogram per span between stages. mark() costs one clock
+// read and a few relaxed atomics, well under a microsecond.
+//
+// A capture cycle starts at TakePhotoPressed; other stages are ignored outside
+// a cycle and only their first mark per cycle counts, so a retake starts a
+// fresh cycle and repeated paints don't skew the review span.
+//
+// The summary is written as JSON to PHOTOBOOTH_LATENCY_FILE (or
+// capture-latency.json in the app data directory) on exit, on exportNow(), and
+// on SIGUSR1 once installExportSignalHandler() has been called.
+class CaptureLatencyTracker : public QObject {
+    Q_OBJECT
+
+public:
+    enum Stage {
+        TakePhotoPressed,
+        CountdownFinished,
+        CaptureRequested,
+        PhotoReady,
+        ReviewScaled,
+        ReviewPainted,
+        PhotoSaved,
+        StageCount
+    };
+
+    struct Span {
+        const char* name;
+        Stage from;
+        Stage to;
+    };
+
+    explicit CaptureLatencyTracker(QObject *parent = nullptr);
+    ~CaptureLatencyTracker() override;
+
+    static CaptureLatencyTracker* instance();
+
+    void mark(Stage stage);
+
+    static int spanCount();
+    static const Span& span(int index);
+    const LatencyHistogram& histogram(int spanIndex) const { return m_histograms[spanIndex]; }
+    void reset();
+
+    QJsonObject toJson() const;
+    QString exportPath() const;
+    bool exportToFile(const QString& filePath = QString()) const;
+
+    // Unix only: export whenever the process receives SIGUSR1
+    void installExportSignalHandler();
+
+public slots:
+    void exportNow();
+
+private slots:
+    void onExportSignal();
+
+private:
+    static qint64 nowNs();
+
+    static const int SPAN_COUNT = 8;
+
+    std::atomic<qint64> m_marks[StageCount];
+    LatencyHistogram m_histograms[SPAN_COUNT];
+    QSocketNotifier *m_signalNotifier;
+};
+
+#endif // CAPTURELATENCYTRACKER_H
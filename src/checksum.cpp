@@ -0,0 +1,29 @@
+#include "checksum.h"
+
+namespace {
+
+struct Crc32cTable {
+    quint32 values[256];
+
+    Crc32cTable() {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+} // namespace
+
+quint32 Checksum::crc32c(const void* data, qint64 size) {
+    static const Crc32cTable table;
+    const quint8* bytes = static_cast<const quint8*>(data);
+    quint32 crc = 0xffffffff;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table.values[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
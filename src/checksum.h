@@ -0,0 +1,14 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QtGlobal>
+
+namespace Checksum {
+
+// CRC-32C (Castagnoli), as used by ext4 and iSCSI. Framing for the on-disk
+// stores, which detect torn writes with it.
+quint32 crc32c(const void* data, qint64 size);
+
+} // namespace Checksum
+
+#endif // CHECKSUM_H
@@ -0,0 +1,28 @@
+#include "choicethumbnails.h"
+#include <cstring>
+
+QImage ChoiceThumbnails::image(const QString& key, const QSize& bound) {
+#ifdef HAS_PRESCALED_THUMBNAILS
+    using namespace ChoiceThumbnailData;
+
+    if (bound != QSize(BOUND, BOUND)) {
+        return QImage();
+    }
+
+    const QByteArray latinKey = key.toLatin1();
+    for (int i = 0; i < COUNT; ++i) {
+        const Entry& entry = ENTRIES[i];
+        if (std::strcmp(entry.key, latinKey.constData()) != 0) {
+            continue;
+        }
+        // Read-only wrapper into the atlas; painting never writes to it
+        const int bytesPerLine = ATLAS_WIDTH * 4;
+        const uchar* first = reinterpret_cast<const uchar*>(ATLAS) + entry.y * bytesPerLine + entry.x * 4;
+        return QImage(first, entry.width, entry.height, bytesPerLine, QImage::Format_ARGB32_Premultiplied);
+    }
+#else
+    Q_UNUSED(key)
+    Q_UNUSED(bound)
+#endif
+    return QImage();
+}
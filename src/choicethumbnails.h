@@ -0,0 +1,40 @@
+#ifndef CHOICETHUMBNAILS_H
+#define CHOICETHUMBNAILS_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QtGlobal>
+
+// Choice-screen thumbnails pre-scaled at build time by tools/thumbgen and
+// linked into the binary as one premultiplied ARGB atlas. image() wraps the
+// atlas memory directly: no decode, no resample and no copy. Returns a null
+// image when the build was configured without PHOTOBOOTH_PRESCALED_THUMBNAILS,
+// the key is unknown, or the atlas was generated for a different bound.
+namespace ChoiceThumbnails {
+
+QImage image(const QString& key, const QSize& bound);
+
+} // namespace ChoiceThumbnails
+
+// Tables defined by the generated choicethumbnails_data.cpp
+namespace ChoiceThumbnailData {
+
+struct Entry {
+    const char* key;
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+extern const int BOUND;
+extern const int ATLAS_WIDTH;
+extern const int ATLAS_HEIGHT;
+extern const int COUNT;
+extern const Entry ENTRIES[];
+extern const quint32 ATLAS[];
+
+} // namespace ChoiceThumbnailData
+
+#endif // CHOICETHUMBNAILS_H
@@ -0,0 +1,375 @@
+#include "chromakeyer.h"
+#include "boothlog.h"
+#include "simd.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+
+Q_GLOBAL_STATIC(ChromaKeyer, s_chromaKeyer)
+
+namespace {
+
+const int BAND_HEIGHT = 32;
+const int MIN_SOFTNESS = 8;
+const int MAX_CACHED_BACKDROPS = 4;
+
+int envThreads() {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue("PHOTOBOOTH_KEY_THREADS", &ok);
+    return ok && value > 0 ? value : QThread::idealThreadCount();
+}
+
+// Settings turned into the kernels' fixed-point constants
+struct KeyParams {
+    int threshold;
+    int softness;
+    int gain;       // keyed = (lead - threshold) * gain >> 8, reaching 255 at softness
+    int spill;      // 0..256
+};
+
+KeyParams keyParams(const ChromaKeyer::Settings& settings) {
+    KeyParams params;
+    params.threshold = settings.threshold;
+    params.softness = settings.softness;
+    // Rounded up so a full lead keys to 255; at most 255 * 256 + 254, which
+    // still fits the kernels' 16-bit lanes
+    params.gain = (255 * 256 + params.softness - 1) / params.softness;
+    params.spill = settings.spill * 256 / 100;
+    return params;
+}
+
+// One pixel; the SIMD versions compute exactly this. The composite rounds
+// like PixelMath::byteMul() so an opaque guest pixel comes out unchanged.
+template <int Screen>
+void keyRowScalar(quint32 *dst, const quint32 *fg, const quint32 *bg, int count, const KeyParams& params) {
+    constexpr int other1 = Screen == 0 ? 1 : 0;
+    constexpr int other2 = Screen == 2 ? 1 : 2;
+    for (int i = 0; i < count; ++i) {
+        int c[3] = {static_cast<int>(fg[i] & 0xff), static_cast<int>((fg[i] >> 8) & 0xff),
+                    static_cast<int>((fg[i] >> 16) & 0xff)};
+        const int b[3] = {static_cast<int>(bg[i] & 0xff), static_cast<int>((bg[i] >> 8) & 0xff),
+                          static_cast<int>((bg[i] >> 16) & 0xff)};
+        const int lead = c[Screen] - std::max(c[other1], c[other2]);
+        const int keyed = (std::clamp(lead - params.threshold, 0, params.softness) * params.gain) >> 8;
+        const int alpha = 255 - keyed;
+        c[Screen] -= (std::max(lead, 0) * params.spill) >> 8;
+
+        quint32 out = 0xff000000;
+        for (int channel = 0; channel < 3; ++channel) {
+            const int x = c[channel] * alpha + b[channel] * keyed + 128;
+            out |= static_cast<quint32>((x + (x >> 8)) >> 8) << (8 * channel);
+        }
+        dst[i] = out;
+    }
+}
+
+#if defined(PHOTOBOOTH_SSE2)
+template <int Screen>
+inline __m128i keyHalf(__m128i f, __m128i b, const KeyParams& params) {
+    constexpr int other1 = Screen == 0 ? 1 : 0;
+    constexpr int other2 = Screen == 2 ? 1 : 2;
+    const __m128i zero = _mm_setzero_si128();
+    // Each pixel's channel copied across its four lanes
+    const __m128i screen = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, Screen * 0x55), Screen * 0x55);
+    const __m128i o1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, other1 * 0x55), other1 * 0x55);
+    const __m128i o2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, other2 * 0x55), other2 * 0x55);
+    const __m128i lead = _mm_sub_epi16(screen, _mm_max_epi16(o1, o2));
+
+    const __m128i ramp = _mm_min_epi16(_mm_max_epi16(_mm_sub_epi16(lead, _mm_set1_epi16(params.threshold)), zero),
+                                       _mm_set1_epi16(params.softness));
+    const __m128i keyed = _mm_srli_epi16(_mm_mullo_epi16(ramp, _mm_set1_epi16(static_cast<short>(params.gain))), 8);
+    const __m128i alpha = _mm_sub_epi16(_mm_set1_epi16(255), keyed);
+
+    const __m128i screenLanes = _mm_set_epi16(0, Screen == 2 ? -1 : 0, Screen == 1 ? -1 : 0, Screen == 0 ? -1 : 0,
+                                              0, Screen == 2 ? -1 : 0, Screen == 1 ? -1 : 0, Screen == 0 ? -1 : 0);
+    const __m128i spill = _mm_srli_epi16(_mm_mullo_epi16(_mm_max_epi16(lead, zero),
+                                                         _mm_set1_epi16(static_cast<short>(params.spill))), 8);
+    f = _mm_sub_epi16(f, _mm_and_si128(spill, screenLanes));
+
+    const __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(f, alpha), _mm_mullo_epi16(b, keyed)),
+                                    _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+template <int Screen>
+void keyRowSimd(quint32 *dst, const quint32 *fg, const quint32 *bg, int count, const KeyParams& params) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fg + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + i));
+        const __m128i lo = keyHalf<Screen>(_mm_unpacklo_epi8(f, zero), _mm_unpacklo_epi8(b, zero), params);
+        const __m128i hi = keyHalf<Screen>(_mm_unpackhi_epi8(f, zero), _mm_unpackhi_epi8(b, zero), params);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+    keyRowScalar<Screen>(dst + i, fg + i, bg + i, count - i, params);
+}
+#elif defined(PHOTOBOOTH_NEON)
+template <int Screen>
+void keyRowSimd(quint32 *dst, const quint32 *fg, const quint32 *bg, int count, const KeyParams& params) {
+    constexpr int other1 = Screen == 0 ? 1 : 0;
+    constexpr int other2 = Screen == 2 ? 1 : 2;
+    const int16x8_t zero = vdupq_n_s16(0);
+    const int16x8_t threshold = vdupq_n_s16(static_cast<int16_t>(params.threshold));
+    const int16x8_t softness = vdupq_n_s16(static_cast<int16_t>(params.softness));
+    const uint16x8_t gain = vdupq_n_u16(static_cast<uint16_t>(params.gain));
+    const uint16x8_t spillFactor = vdupq_n_u16(static_cast<uint16_t>(params.spill));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Deinterleaved: val[0] blue ... val[3] alpha, eight pixels each
+        uint8x8x4_t f = vld4_u8(reinterpret_cast<const uint8_t*>(fg + i));
+        const uint8x8x4_t b = vld4_u8(reinterpret_cast<const uint8_t*>(bg + i));
+        const uint16x8_t screen = vmovl_u8(f.val[Screen]);
+        const int16x8_t lead = vsubq_s16(vreinterpretq_s16_u16(screen),
+                                         vreinterpretq_s16_u16(vmovl_u8(vmax_u8(f.val[other1], f.val[other2]))));
+        const int16x8_t ramp = vminq_s16(vmaxq_s16(vsubq_s16(lead, threshold), zero), softness);
+        const uint8x8_t keyed = vmovn_u16(vshrq_n_u16(vmulq_u16(vreinterpretq_u16_s16(ramp), gain), 8));
+        const uint8x8_t alpha = vmvn_u8(keyed);
+        const uint16x8_t spill = vshrq_n_u16(vmulq_u16(vreinterpretq_u16_s16(vmaxq_s16(lead, zero)), spillFactor), 8);
+        f.val[Screen] = vmovn_u16(vsubq_u16(screen, spill));
+
+        uint8x8x4_t out;
+        for (int channel = 0; channel < 3; ++channel) {
+            const uint16x8_t x = vaddq_u16(vmlal_u8(vmull_u8(f.val[channel], alpha), b.val[channel], keyed),
+                                           vdupq_n_u16(128));
+            out.val[channel] = vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+        }
+        out.val[3] = vdup_n_u8(255);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + i), out);
+    }
+    keyRowScalar<Screen>(dst + i, fg + i, bg + i, count - i, params);
+}
+#else
+template <int Screen>
+void keyRowSimd(quint32 *dst, const quint32 *fg, const quint32 *bg, int count, const KeyParams& params) {
+    keyRowScalar<Screen>(dst, fg, bg, count, params);
+}
+#endif
+
+using KeyRow = void (*)(quint32*, const quint32*, const quint32*, int, const KeyParams&);
+
+KeyRow keyRow(ChromaKeyer::Screen screen, bool simd) {
+    if (screen == ChromaKeyer::Blue) {
+        return simd ? keyRowSimd<ChromaKeyer::Blue> : keyRowScalar<ChromaKeyer::Blue>;
+    }
+    return simd ? keyRowSimd<ChromaKeyer::Green> : keyRowScalar<ChromaKeyer::Green>;
+}
+
+} // namespace
+
+ChromaKeyer::Settings ChromaKeyer::Settings::load(const QString& path) {
+    Settings settings;
+    QSettings file(path, QSettings::IniFormat);
+    file.beginGroup("ChromaKey");
+    settings.enabled = file.value("enabled", settings.enabled).toBool();
+    settings.screen = file.value("screen", "green").toString() == "blue" ? Blue : Green;
+    settings.threshold = std::clamp(file.value("threshold", settings.threshold).toInt(), 0, 255);
+    settings.softness = std::clamp(file.value("softness", settings.softness).toInt(), MIN_SOFTNESS, 255);
+    settings.spill = std::clamp(file.value("spill", settings.spill).toInt(), 0, 100);
+    file.endGroup();
+    return settings;
+}
+
+bool ChromaKeyer::Settings::save(const QString& path) const {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSettings file(path, QSettings::IniFormat);
+    file.beginGroup("ChromaKey");
+    file.setValue("enabled", enabled);
+    file.setValue("screen", screen == Blue ? "blue" : "green");
+    file.setValue("threshold", threshold);
+    file.setValue("softness", softness);
+    file.setValue("spill", spill);
+    file.endGroup();
+    file.sync();
+    if (file.status() != QSettings::NoError) {
+        qCWarning(lcCamera) << "ChromaKeyer: Failed to save settings to" << path;
+        return false;
+    }
+    return true;
+}
+
+ChromaKeyer::ChromaKeyer(const QString& settingsPath, int threadCount)
+    : m_settingsPath(settingsPath.isEmpty() ? defaultSettingsPath() : settingsPath)
+    , m_threadCount(threadCount > 0 ? threadCount : envThreads())
+    , m_simdEnabled(true)
+{
+    // The calling thread keys bands too
+    m_pool.setMaxThreadCount(std::max(1, m_threadCount - 1));
+    m_pool.setObjectName("ChromaKeyer");
+
+    // Written out on first run so there's a file to tune
+    if (!QFileInfo::exists(m_settingsPath)) {
+        m_settings.save(m_settingsPath);
+    }
+    m_settings = Settings::load(m_settingsPath);
+    qCDebug(lcCamera) << "ChromaKeyer: Settings from" << m_settingsPath << "- enabled" << isEnabled()
+             << "threshold" << m_settings.threshold << "softness" << m_settings.softness
+             << "spill" << m_settings.spill;
+}
+
+ChromaKeyer::~ChromaKeyer() {
+    m_pool.waitForDone();
+}
+
+ChromaKeyer* ChromaKeyer::instance() {
+    return s_chromaKeyer();
+}
+
+QString ChromaKeyer::defaultSettingsPath() {
+    const QString path = qEnvironmentVariable("PHOTOBOOTH_CHROMA_KEY_SETTINGS");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/chromakey.ini";
+}
+
+ChromaKeyer::Settings ChromaKeyer::settings() const {
+    QMutexLocker locker(&m_mutex);
+    return m_settings;
+}
+
+void ChromaKeyer::setSettings(const Settings& settings) {
+    QMutexLocker locker(&m_mutex);
+    m_settings = settings;
+    m_settings.threshold = std::clamp(m_settings.threshold, 0, 255);
+    m_settings.softness = std::clamp(m_settings.softness, MIN_SOFTNESS, 255);
+    m_settings.spill = std::clamp(m_settings.spill, 0, 100);
+    m_settings.save(m_settingsPath);
+}
+
+bool ChromaKeyer::isEnabled() const {
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue("PHOTOBOOTH_CHROMA_KEY", &ok);
+    if (ok) {
+        return value != 0;
+    }
+    QMutexLocker locker(&m_mutex);
+    return m_settings.enabled;
+}
+
+QImage ChromaKeyer::landBackdrop(const QString& landId) {
+    {
+        QMutexLocker locker(&m_mutex);
+        if (landId == m_landId) {
+            return m_land;
+        }
+    }
+    const QImage land(QString(":/%1.jpg").arg(landId));
+    if (land.isNull()) {
+        qCWarning(lcCamera) << "ChromaKeyer: No backdrop for" << landId;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_landId = landId;
+    m_land = land;
+    return land;
+}
+
+void ChromaKeyer::prepareBackdrop(const QImage& backdrop, const QSize& size) {
+    if (!backdrop.isNull() && !size.isEmpty()) {
+        fittedBackdrop(backdrop, size);
+    }
+}
+
+qint64 ChromaKeyer::cacheBytes() const {
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = m_land.sizeInBytes();
+    for (const QImage& fitted : std::as_const(m_backdrops)) {
+        bytes += fitted.sizeInBytes();
+    }
+    return bytes;
+}
+
+qint64 ChromaKeyer::trimCache() {
+    QMutexLocker locker(&m_mutex);
+    qint64 freed = 0;
+    for (const QImage& fitted : std::as_const(m_backdrops)) {
+        freed += fitted.sizeInBytes();
+    }
+    m_backdrops.clear();
+    return freed;
+}
+
+QImage ChromaKeyer::fittedBackdrop(const QImage& backdrop, const QSize& size) {
+    const QString key = QString("%1:%2x%3").arg(backdrop.cacheKey()).arg(size.width()).arg(size.height());
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_backdrops.constFind(key);
+        if (it != m_backdrops.constEnd()) {
+            return it.value();
+        }
+    }
+
+    // Cover the frame and crop the overflow evenly, like a backdrop behind the guests
+    QImage scaled = backdrop.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    QRect crop(QPoint(0, 0), size);
+    crop.moveCenter(scaled.rect().center());
+    const QImage fitted = scaled.copy(crop).convertToFormat(QImage::Format_RGB32);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_backdrops.size() >= MAX_CACHED_BACKDROPS) {
+        m_backdrops.clear();
+    }
+    m_backdrops.insert(key, fitted);
+    return fitted;
+}
+
+void ChromaKeyer::composite(QImage *frame, const QImage& backdrop) {
+    if (frame->isNull() || backdrop.isNull()) {
+        return;
+    }
+    if (frame->format() != QImage::Format_RGB32 && frame->format() != QImage::Format_ARGB32 &&
+        frame->format() != QImage::Format_ARGB32_Premultiplied) {
+        *frame = frame->convertToFormat(QImage::Format_RGB32);
+    } else if (frame->format() != QImage::Format_RGB32) {
+        // The composite is opaque; the pixels are the same
+        frame->reinterpretAsFormat(QImage::Format_RGB32);
+    }
+    const QImage background = fittedBackdrop(backdrop, frame->size());
+    const Settings current = settings();
+    const KeyParams params = keyParams(current);
+    const KeyRow key = keyRow(current.screen, m_simdEnabled);
+
+    // bits() may detach, so take it before the bands run
+    uchar *bits = frame->bits();
+    const qsizetype stride = frame->bytesPerLine();
+    const uchar *backgroundBits = background.constBits();
+    const qsizetype backgroundStride = background.bytesPerLine();
+    const int width = frame->width();
+    const int height = frame->height();
+
+    const int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::atomic<int> nextBand{0};
+    auto keyBands = [&]() {
+        for (int band = nextBand++; band < bandCount; band = nextBand++) {
+            const int y1 = std::min(height, (band + 1) * BAND_HEIGHT);
+            for (int y = band * BAND_HEIGHT; y < y1; ++y) {
+                quint32 *row = reinterpret_cast<quint32*>(bits + y * stride);
+                key(row, row, reinterpret_cast<const quint32*>(backgroundBits + y * backgroundStride), width, params);
+            }
+        }
+    };
+    const int helpers = std::min(m_threadCount, bandCount) - 1;
+    QSemaphore finished;
+    for (int i = 0; i < helpers; ++i) {
+        m_pool.start([&keyBands, &finished]() {
+            keyBands();
+            finished.release();
+        });
+    }
+    keyBands();
+    finished.acquire(helpers);
+}
+
+QImage ChromaKeyer::composited(const QImage& frame, const QImage& backdrop) {
+    QImage keyed = frame;
+    composite(&keyed, backdrop);
+    return keyed;
+}
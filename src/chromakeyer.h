@@ -0,0 +1,97 @@
+#ifndef CHROMAKEYER_H
+#define CHROMAKEYER_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+// Green-screen keying: replaces the screen behind the guests with the land
+// they chose, on the preview and on the photo.
+//
+// The matte comes from how far the screen channel (green, or blue for a blue
+// screen) leads the larger of the other two. Up to threshold the pixel is
+// the guest; the backdrop fades in over the next softness levels, which
+// gives hair and motion blur a soft edge instead of a hard cut-out. Spill
+// suppression then takes spill percent of the remaining lead off the screen
+// channel, so green light bounced onto skin and clothes doesn't show. The
+// matte, spill and composite run in one pass in 16-bit fixed point
+// (SSE2/NEON, see simd.h, with a bit-identical scalar path), in row bands
+// over a private thread pool like ColorFilter.
+//
+// Settings are kept per booth in an INI file (PHOTOBOOTH_CHROMA_KEY_SETTINGS,
+// or chromakey.ini in the app data directory), written with the defaults on
+// first run so the operator can tune them for the booth's screen and light.
+// PHOTOBOOTH_CHROMA_KEY=1 or 0 overrides whether keying is on.
+//
+// composite() may be called from any thread.
+class ChromaKeyer {
+public:
+    // Index of the screen channel in a 0xAARRGGBB pixel's bytes
+    enum Screen {
+        Blue = 0,
+        Green = 1
+    };
+
+    struct Settings {
+        bool enabled = false;
+        Screen screen = Green;
+        int threshold = 24;     // Screen lead, 0..255, where the backdrop starts showing
+        int softness = 48;      // Levels over threshold until it fully replaces the pixel, 8..255
+        int spill = 80;         // Percent of the remaining lead removed from the screen channel
+
+        static Settings load(const QString& path);
+        bool save(const QString& path) const;
+    };
+
+    // threadCount 0 uses PHOTOBOOTH_KEY_THREADS or one per core
+    explicit ChromaKeyer(const QString& settingsPath = QString(), int threadCount = 0);
+    ~ChromaKeyer();
+
+    static ChromaKeyer* instance();
+    static QString defaultSettingsPath();
+
+    Settings settings() const;
+    void setSettings(const Settings& settings);   // Also saves them
+    bool isEnabled() const;
+
+    // Keys frame in place and puts backdrop behind it, scaled to cover the
+    // frame. The result is RGB32. Does nothing with a null backdrop.
+    void composite(QImage *frame, const QImage& backdrop);
+    QImage composited(const QImage& frame, const QImage& backdrop);
+
+    // The art for landId from :/<landId>.jpg, decoded once and kept while
+    // that land is in use; call ahead from a worker to take the decode off
+    // the camera screen
+    QImage landBackdrop(const QString& landId);
+
+    // Scales backdrop to cover frames of size now, so the first keyed frame
+    // at that size doesn't pay for the smooth rescale of the full land
+    void prepareBackdrop(const QImage& backdrop, const QSize& size);
+
+    // Backdrops held for keying; trimCache() drops the scaled ones, which are
+    // rebuilt on the next frame, and returns the bytes it freed
+    qint64 cacheBytes() const;
+    qint64 trimCache();
+
+    // Scalar keying, for comparing against the SIMD path
+    void setSimdEnabled(bool enabled) { m_simdEnabled = enabled; }
+    int threadCount() const { return m_threadCount; }
+
+private:
+    QImage fittedBackdrop(const QImage& backdrop, const QSize& size);
+
+    QString m_settingsPath;
+    int m_threadCount;
+    bool m_simdEnabled;
+    QThreadPool m_pool;
+    mutable QMutex m_mutex;                 // Guards the settings and backdrop cache
+    Settings m_settings;
+    QHash<QString, QImage> m_backdrops;     // "<cacheKey>:<size>" -> scaled and cropped
+    QString m_landId;
+    QImage m_land;
+};
+
+#endif // CHROMAKEYER_H
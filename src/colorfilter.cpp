@@ -0,0 +1,274 @@
+#include "colorfilter.h"
+#include "boothlog.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+Q_GLOBAL_STATIC(ColorFilter, s_colorFilter)
+
+namespace {
+
+const int BAND_HEIGHT = 32;
+const int BUILT_IN_SIZE = 33;
+
+int envThreads() {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue("PHOTOBOOTH_FILTER_THREADS", &ok);
+    return ok && value > 0 ? value : QThread::idealThreadCount();
+}
+
+float luma(const float *rgb) {
+    return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+}
+
+// Contrast around mid grey that stays inside 0..1
+float sCurve(float v, float strength) {
+    const float curved = v * v * (3.0f - 2.0f * v);
+    return v + (curved - v) * strength;
+}
+
+void saturate(float *rgb, float amount) {
+    const float y = luma(rgb);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = y + (rgb[c] - y) * amount;
+    }
+}
+
+// Tints shadows and highlights separately, weighted by luma
+void splitTone(float *rgb, const float *shadows, const float *highlights) {
+    const float y = luma(rgb);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] += shadows[c] * (1.0f - y) + highlights[c] * y;
+    }
+}
+
+void clampRgb(float *rgb) {
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = std::clamp(rgb[c], 0.0f, 1.0f);
+    }
+}
+
+void sepia(float *rgb) {
+    const float r = rgb[0], g = rgb[1], b = rgb[2];
+    rgb[0] = 0.393f * r + 0.769f * g + 0.189f * b;
+    rgb[1] = 0.349f * r + 0.686f * g + 0.168f * b;
+    rgb[2] = 0.272f * r + 0.534f * g + 0.131f * b;
+    clampRgb(rgb);
+}
+
+void noir(float *rgb) {
+    const float y = sCurve(sCurve(luma(rgb), 1.0f), 0.5f);
+    rgb[0] = rgb[1] = rgb[2] = y;
+}
+
+// Warm sunlit land: amber highlights, a little more colour
+void golden(float *rgb) {
+    const float shadows[3] = {0.02f, 0.0f, -0.04f};
+    const float highlights[3] = {0.08f, 0.04f, -0.06f};
+    saturate(rgb, 1.15f);
+    splitTone(rgb, shadows, highlights);
+    clampRgb(rgb);
+}
+
+// Forest land: teal shadows, green mid-tones
+void emerald(float *rgb) {
+    const float shadows[3] = {-0.04f, 0.03f, 0.03f};
+    const float highlights[3] = {-0.02f, 0.05f, 0.0f};
+    splitTone(rgb, shadows, highlights);
+    saturate(rgb, 1.1f);
+    clampRgb(rgb);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = sCurve(rgb[c], 0.25f);
+    }
+}
+
+// Ice land: cool and muted, lifted blacks
+void frost(float *rgb) {
+    const float shadows[3] = {-0.02f, 0.01f, 0.06f};
+    const float highlights[3] = {-0.03f, 0.01f, 0.04f};
+    saturate(rgb, 0.7f);
+    splitTone(rgb, shadows, highlights);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = 0.06f + rgb[c] * 0.94f;
+    }
+    clampRgb(rgb);
+}
+
+// Volcanic land: red-orange, deep shadows
+void ember(float *rgb) {
+    const float shadows[3] = {0.03f, -0.02f, -0.04f};
+    const float highlights[3] = {0.10f, 0.02f, -0.08f};
+    splitTone(rgb, shadows, highlights);
+    saturate(rgb, 1.2f);
+    clampRgb(rgb);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = sCurve(rgb[c], 0.5f);
+    }
+}
+
+} // namespace
+
+ColorFilter::ColorFilter(int threadCount)
+    : m_threadCount(threadCount > 0 ? threadCount : envThreads())
+    , m_simdEnabled(true)
+{
+    // The calling thread maps bands too
+    m_pool.setMaxThreadCount(std::max(1, m_threadCount - 1));
+    m_pool.setObjectName("ColorFilter");
+}
+
+ColorFilter::~ColorFilter() {
+    m_pool.waitForDone();
+}
+
+ColorFilter* ColorFilter::instance() {
+    return s_colorFilter();
+}
+
+qint64 ColorFilter::cacheBytes() {
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = 0;
+    for (const std::shared_ptr<const ColorLut>& table : std::as_const(m_luts)) {
+        bytes += table ? table->byteSize() : 0;
+    }
+    return bytes;
+}
+
+qint64 ColorFilter::clearCache() {
+    QMutexLocker locker(&m_mutex);
+    qint64 freed = 0;
+    for (auto it = m_luts.begin(); it != m_luts.end();) {
+        // A look a camera or the preview still holds would stay alive anyway
+        if (it.value() && it.value().use_count() == 1) {
+            freed += it.value()->byteSize();
+            it = m_luts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return freed;
+}
+
+void ColorFilter::apply(QImage *image, const ColorLut& lut) {
+    if (image->isNull() || lut.isNull()) {
+        return;
+    }
+    // Premultiplied camera frames are opaque, so their colours map as they are
+    if (image->format() != QImage::Format_RGB32 && image->format() != QImage::Format_ARGB32 &&
+        image->format() != QImage::Format_ARGB32_Premultiplied) {
+        *image = image->convertToFormat(image->hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+
+    // bits() may detach, so take it before the bands run
+    uchar *bits = image->bits();
+    const qsizetype stride = image->bytesPerLine();
+    const int width = image->width();
+    const int height = image->height();
+    const bool simd = m_simdEnabled;
+
+    const int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::atomic<int> nextBand{0};
+    auto mapBands = [&]() {
+        for (int band = nextBand++; band < bandCount; band = nextBand++) {
+            const int y1 = std::min(height, (band + 1) * BAND_HEIGHT);
+            for (int y = band * BAND_HEIGHT; y < y1; ++y) {
+                lut.mapRow(reinterpret_cast<quint32*>(bits + y * stride), width, simd);
+            }
+        }
+    };
+    const int helpers = std::min(m_threadCount, bandCount) - 1;
+    QSemaphore finished;
+    for (int i = 0; i < helpers; ++i) {
+        m_pool.start([&mapBands, &finished]() {
+            mapBands();
+            finished.release();
+        });
+    }
+    mapBands();
+    finished.acquire(helpers);
+}
+
+QImage ColorFilter::applied(const QImage& image, const ColorLut& lut) {
+    QImage graded = image;
+    apply(&graded, lut);
+    return graded;
+}
+
+std::shared_ptr<const ColorLut> ColorFilter::lut(const QString& name) {
+    if (name.isEmpty() || name == "none") {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    auto cached = m_luts.constFind(name);
+    if (cached != m_luts.constEnd()) {
+        return cached.value();
+    }
+
+    ColorLut table;
+    const QString cubePath = QDir(lutDirectory()).filePath(name + ".cube");
+    if (QFileInfo::exists(cubePath)) {
+        QString errorMessage;
+        if (table.loadCube(cubePath, &errorMessage)) {
+            qCDebug(lcCamera) << "ColorFilter: Loaded" << name << "from" << cubePath << "size" << table.size();
+        } else {
+            qCWarning(lcCamera) << "ColorFilter:" << errorMessage;
+            table = ColorLut();
+        }
+    }
+    if (table.isNull()) {
+        table = builtIn(name);
+    }
+    if (table.isNull()) {
+        qCWarning(lcCamera) << "ColorFilter: Unknown look" << name;
+    }
+
+    // Unknown names are cached as null too, so they're only looked up once
+    std::shared_ptr<const ColorLut> shared = table.isNull() ? nullptr : std::make_shared<const ColorLut>(table);
+    m_luts.insert(name, shared);
+    return shared;
+}
+
+QString ColorFilter::lookForLand(const QString& landId) {
+    const QString look = qEnvironmentVariable("PHOTOBOOTH_LOOK", "land");
+    if (look != "land") {
+        return look;
+    }
+    static const QHash<QString, QString> landLooks = {
+        {"land1", "golden"},
+        {"land2", "emerald"},
+        {"land3", "frost"},
+        {"land4", "ember"},
+    };
+    return landLooks.value(landId, "none");
+}
+
+QStringList ColorFilter::builtInLooks() {
+    return {"sepia", "noir", "golden", "emerald", "frost", "ember"};
+}
+
+QString ColorFilter::lutDirectory() {
+    return qEnvironmentVariable("PHOTOBOOTH_LUT_DIR", "/usr/share/photobooth/luts");
+}
+
+ColorLut ColorFilter::builtIn(const QString& name) {
+    static const QHash<QString, void (*)(float*)> looks = {
+        {"sepia", sepia},
+        {"noir", noir},
+        {"golden", golden},
+        {"emerald", emerald},
+        {"frost", frost},
+        {"ember", ember},
+    };
+    auto look = looks.constFind(name);
+    if (look == looks.constEnd()) {
+        return ColorLut();
+    }
+    return ColorLut::fromFunction(BUILT_IN_SIZE, look.value(), name);
+}
@@ -0,0 +1,64 @@
+#ifndef COLORFILTER_H
+#define COLORFILTER_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <memory>
+#include "colorlut.h"
+
+// Applies the booth's colour-grading looks. A frame is graded in row bands
+// spread over a private thread pool, the calling thread taking bands too, so
+// one preview frame or capture uses every core for a few milliseconds.
+//
+// Looks are named. lut() reads <name>.cube from PHOTOBOOTH_LUT_DIR
+// (/usr/share/photobooth/luts by default) when there is one, so a grade made
+// in Resolve can replace a built-in, and otherwise builds the built-in of
+// that name. Tables are cached. PHOTOBOOTH_LOOK picks what the booth uses:
+// "land" (the default) grades each photo for the guest's land, a look name
+// grades every photo the same, "none" turns grading off.
+//
+// apply() may be called from any thread; concurrent calls share the pool.
+class ColorFilter {
+public:
+    // threadCount 0 uses PHOTOBOOTH_FILTER_THREADS or one per core
+    explicit ColorFilter(int threadCount = 0);
+    ~ColorFilter();
+
+    static ColorFilter* instance();
+
+    // Grades a 32-bit image in place, converting other formats first
+    void apply(QImage *image, const ColorLut& lut);
+    QImage applied(const QImage& image, const ColorLut& lut);
+
+    // Null for "none", an empty name or a look that can't be found
+    std::shared_ptr<const ColorLut> lut(const QString& name);
+
+    // The look to use for a guest who chose landId, following PHOTOBOOTH_LOOK
+    static QString lookForLand(const QString& landId);
+    static QStringList builtInLooks();
+    static QString lutDirectory();
+
+    // Tables held by the cache, and dropping the ones nothing else is using;
+    // clearCache() returns the bytes it freed
+    qint64 cacheBytes();
+    qint64 clearCache();
+
+    // Scalar mapping, for comparing against the SIMD path
+    void setSimdEnabled(bool enabled) { m_simdEnabled = enabled; }
+    int threadCount() const { return m_threadCount; }
+
+private:
+    static ColorLut builtIn(const QString& name);
+
+    int m_threadCount;
+    bool m_simdEnabled;
+    QThreadPool m_pool;
+    QMutex m_mutex;     // Guards the cache
+    QHash<QString, std::shared_ptr<const ColorLut>> m_luts;
+};
+
+#endif // COLORFILTER_H
@@ -0,0 +1,279 @@
+#include "colorlut.h"
+#include "simd.h"
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Lattice values are 8.4 fixed point, so four corners weighted to 256 sum
+// below 2^20 and the SIMD blend fits 16-bit multiplies
+const int LATTICE_ONE = 255 * 16;
+const int WEIGHT_SHIFT = 8;
+const int RESULT_SHIFT = 12;
+
+// The tetrahedron of the cell containing fractions (fr, fg, fb), each 0..256
+// (fixed point) or 0..1: offsets of its two inner corners from the cell's
+// origin, and the weights of the origin, those two and the far corner. The
+// path runs from the origin through the axes in order of decreasing fraction.
+template <typename T>
+inline void tetrahedron(T fr, T fg, T fb, T one, int dR, int dG, int dB, int *inner1, int *inner2, T *w) {
+    if (fr > fg) {
+        if (fg > fb) {              // r > g > b
+            *inner1 = dR;           *inner2 = dR + dG;
+            w[0] = one - fr; w[1] = fr - fg; w[2] = fg - fb; w[3] = fb;
+        } else if (fr > fb) {       // r > b >= g
+            *inner1 = dR;           *inner2 = dR + dB;
+            w[0] = one - fr; w[1] = fr - fb; w[2] = fb - fg; w[3] = fg;
+        } else {                    // b >= r > g
+            *inner1 = dB;           *inner2 = dR + dB;
+            w[0] = one - fb; w[1] = fb - fr; w[2] = fr - fg; w[3] = fg;
+        }
+    } else {
+        if (fb > fg) {              // b > g >= r
+            *inner1 = dB;           *inner2 = dG + dB;
+            w[0] = one - fb; w[1] = fb - fg; w[2] = fg - fr; w[3] = fr;
+        } else if (fb > fr) {       // g >= b > r
+            *inner1 = dG;           *inner2 = dG + dB;
+            w[0] = one - fg; w[1] = fg - fb; w[2] = fb - fr; w[3] = fr;
+        } else {                    // g >= r >= b
+            *inner1 = dG;           *inner2 = dR + dG;
+            w[0] = one - fg; w[1] = fg - fr; w[2] = fr - fb; w[3] = fb;
+        }
+    }
+}
+
+inline quint32 blendScalar(const qint16 *c0, const qint16 *c1, const qint16 *c2, const qint16 *c3, const int *w) {
+    quint32 out = 0;
+    for (int channel = 0; channel < 3; ++channel) {
+        const int value = c0[channel] * w[0] + c1[channel] * w[1] + c2[channel] * w[2] + c3[channel] * w[3];
+        out |= static_cast<quint32>((value + (1 << (RESULT_SHIFT - 1))) >> RESULT_SHIFT) << (8 * channel);
+    }
+    return out;
+}
+
+#if defined(PHOTOBOOTH_SSE2)
+inline quint32 blendSimd(const qint16 *c0, const qint16 *c1, const qint16 *c2, const qint16 *c3, const int *w) {
+    // Corners interleaved in pairs so one madd weights two of them per channel
+    const __m128i pair01 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(c0)),
+                                              _mm_loadl_epi64(reinterpret_cast<const __m128i*>(c1)));
+    const __m128i pair23 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(c2)),
+                                              _mm_loadl_epi64(reinterpret_cast<const __m128i*>(c3)));
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(pair01, _mm_set1_epi32(w[0] | (w[1] << 16))),
+                                _mm_madd_epi16(pair23, _mm_set1_epi32(w[2] | (w[3] << 16))));
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (RESULT_SHIFT - 1))), RESULT_SHIFT);
+    const __m128i words = _mm_packs_epi32(sum, sum);
+    return static_cast<quint32>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+#elif defined(PHOTOBOOTH_NEON)
+inline quint32 blendSimd(const qint16 *c0, const qint16 *c1, const qint16 *c2, const qint16 *c3, const int *w) {
+    int32x4_t sum = vmull_n_s16(vld1_s16(c0), static_cast<int16_t>(w[0]));
+    sum = vmlal_n_s16(sum, vld1_s16(c1), static_cast<int16_t>(w[1]));
+    sum = vmlal_n_s16(sum, vld1_s16(c2), static_cast<int16_t>(w[2]));
+    sum = vmlal_n_s16(sum, vld1_s16(c3), static_cast<int16_t>(w[3]));
+    const uint16x4_t words = vqrshrun_n_s32(sum, RESULT_SHIFT);
+    return vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(words, words))), 0);
+}
+#else
+inline quint32 blendSimd(const qint16 *c0, const qint16 *c1, const qint16 *c2, const qint16 *c3, const int *w) {
+    return blendScalar(c0, c1, c2, c3, w);
+}
+#endif
+
+template <bool Simd>
+void mapRowKernel(quint32 *pixels, int count, const qint16 *lattice, int size,
+                  const quint16 *cell, const quint16 *fraction) {
+    const int dR = 4;
+    const int dG = 4 * size;
+    const int dB = 4 * size * size;
+    for (int i = 0; i < count; ++i) {
+        const quint32 pixel = pixels[i];
+        const int r = (pixel >> 16) & 0xff;
+        const int g = (pixel >> 8) & 0xff;
+        const int b = pixel & 0xff;
+        const qint16 *origin = lattice + cell[r] * dR + cell[g] * dG + cell[b] * dB;
+        int inner1, inner2;
+        int w[4];
+        tetrahedron<int>(fraction[r], fraction[g], fraction[b], 1 << WEIGHT_SHIFT, dR, dG, dB, &inner1, &inner2, w);
+        const qint16 *far = origin + dR + dG + dB;
+        const quint32 mapped = Simd ? blendSimd(origin, origin + inner1, origin + inner2, far, w)
+                                    : blendScalar(origin, origin + inner1, origin + inner2, far, w);
+        pixels[i] = (pixel & 0xff000000) | mapped;
+    }
+}
+
+} // namespace
+
+ColorLut::ColorLut()
+    : m_size(0)
+{
+    std::fill(std::begin(m_cell), std::end(m_cell), 0);
+    std::fill(std::begin(m_fraction), std::end(m_fraction), 0);
+}
+
+ColorLut ColorLut::fromFunction(int size, const std::function<void(float *rgb)>& map, const QString& title) {
+    ColorLut lut;
+    if (size < MIN_SIZE || size > MAX_SIZE) {
+        return lut;
+    }
+    std::vector<float> table(static_cast<size_t>(size) * size * size * 3);
+    float *out = table.data();
+    for (int b = 0; b < size; ++b) {
+        for (int g = 0; g < size; ++g) {
+            for (int r = 0; r < size; ++r, out += 3) {
+                out[0] = static_cast<float>(r) / (size - 1);
+                out[1] = static_cast<float>(g) / (size - 1);
+                out[2] = static_cast<float>(b) / (size - 1);
+                map(out);
+            }
+        }
+    }
+    lut.setTable(size, std::move(table), title);
+    return lut;
+}
+
+ColorLut ColorLut::identity(int size) {
+    return fromFunction(size, [](float *) {}, "Identity");
+}
+
+bool ColorLut::loadCube(const QString& path, QString *errorMessage) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    QString title;
+    int size = 0;
+    std::vector<float> table;
+    QTextStream stream(&file);
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        const QStringList fields = line.split(QChar(' '), Qt::SkipEmptyParts);
+        const QString keyword = fields.first();
+        if (keyword == "TITLE") {
+            title = line.mid(5).trimmed().remove('"');
+        } else if (keyword == "LUT_3D_SIZE") {
+            size = fields.value(1).toInt();
+            if (size < MIN_SIZE || size > MAX_SIZE) {
+                *errorMessage = QString("%1: unsupported LUT_3D_SIZE %2").arg(path, fields.value(1));
+                return false;
+            }
+            table.reserve(static_cast<size_t>(size) * size * size * 3);
+        } else if (keyword == "LUT_1D_SIZE") {
+            *errorMessage = QString("%1: 1D LUTs aren't supported").arg(path);
+            return false;
+        } else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX" || keyword == "LUT_3D_INPUT_RANGE") {
+            // Only the unit cube the 8-bit pixels cover
+            const float expected = keyword == "DOMAIN_MAX" ? 1.0f : 0.0f;
+            for (int i = 1; i < fields.size(); ++i) {
+                const float value = fields[i].toFloat();
+                const bool ok = keyword == "LUT_3D_INPUT_RANGE" ? value == (i == 1 ? 0.0f : 1.0f) : value == expected;
+                if (!ok) {
+                    *errorMessage = QString("%1: only a 0..1 domain is supported").arg(path);
+                    return false;
+                }
+            }
+        } else if (keyword.at(0).isLetter()) {
+            continue; // Other keywords don't change the table
+        } else {
+            bool ok[3] = {false, false, false};
+            if (fields.size() != 3 || size == 0) {
+                *errorMessage = QString("%1:%2: expected an RGB triple after LUT_3D_SIZE").arg(path).arg(lineNumber);
+                return false;
+            }
+            for (int i = 0; i < 3; ++i) {
+                table.push_back(fields[i].toFloat(&ok[i]));
+            }
+            if (!ok[0] || !ok[1] || !ok[2]) {
+                *errorMessage = QString("%1:%2: malformed number").arg(path).arg(lineNumber);
+                return false;
+            }
+        }
+    }
+
+    if (size == 0 || table.size() != static_cast<size_t>(size) * size * size * 3) {
+        *errorMessage = QString("%1: expected %2 entries, found %3").arg(path).arg(size * size * size)
+                            .arg(table.size() / 3);
+        return false;
+    }
+    return setTable(size, std::move(table), title);
+}
+
+bool ColorLut::setTable(int size, std::vector<float> table, const QString& title) {
+    m_size = size;
+    m_title = title;
+    m_table = std::move(table);
+
+    m_lattice.resize(static_cast<size_t>(size) * size * size * 4);
+    for (size_t e = 0; e < m_table.size() / 3; ++e) {
+        for (int channel = 0; channel < 3; ++channel) {
+            const float value = std::clamp(m_table[e * 3 + channel], 0.0f, 1.0f);
+            m_lattice[e * 4 + 2 - channel] = static_cast<qint16>(std::lround(value * LATTICE_ONE));
+        }
+        m_lattice[e * 4 + 3] = 0;
+    }
+
+    // The top value lands in the last cell at fraction 256, so the far
+    // corner of every cell exists
+    for (int value = 0; value < 256; ++value) {
+        const int position = (value * (size - 1) * 256 + 127) / 255;
+        const int cell = std::min(position >> WEIGHT_SHIFT, size - 2);
+        m_cell[value] = static_cast<quint16>(cell);
+        m_fraction[value] = static_cast<quint16>(position - (cell << WEIGHT_SHIFT));
+    }
+    return true;
+}
+
+qint64 ColorLut::byteSize() const {
+    return static_cast<qint64>(m_table.size() * sizeof(float) + m_lattice.size() * sizeof(qint16));
+}
+
+void ColorLut::mapRow(quint32 *pixels, int count, bool simd) const {
+    if (isNull()) {
+        return;
+    }
+    if (simd) {
+        mapRowKernel<true>(pixels, count, m_lattice.data(), m_size, m_cell, m_fraction);
+    } else {
+        mapRowKernel<false>(pixels, count, m_lattice.data(), m_size, m_cell, m_fraction);
+    }
+}
+
+QRgb ColorLut::mapReference(QRgb pixel) const {
+    if (isNull()) {
+        return pixel;
+    }
+    const float input[3] = {qRed(pixel) / 255.0f, qGreen(pixel) / 255.0f, qBlue(pixel) / 255.0f};
+    int cell[3];
+    float fraction[3];
+    for (int channel = 0; channel < 3; ++channel) {
+        const float position = input[channel] * (m_size - 1);
+        cell[channel] = std::min(static_cast<int>(position), m_size - 2);
+        fraction[channel] = position - cell[channel];
+    }
+    const int dR = 3;
+    const int dG = 3 * m_size;
+    const int dB = 3 * m_size * m_size;
+    const float *origin = m_table.data() + 3 * entry(cell[0], cell[1], cell[2]);
+    int inner1, inner2;
+    float w[4];
+    tetrahedron<float>(fraction[0], fraction[1], fraction[2], 1.0f, dR, dG, dB, &inner1, &inner2, w);
+    const float *corners[4] = {origin, origin + inner1, origin + inner2, origin + dR + dG + dB};
+
+    int out[3];
+    for (int channel = 0; channel < 3; ++channel) {
+        float value = 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            value += w[k] * std::clamp(corners[k][channel], 0.0f, 1.0f);
+        }
+        out[channel] = std::clamp(static_cast<int>(std::lround(value * 255.0f)), 0, 255);
+    }
+    return qRgba(out[0], out[1], out[2], qAlpha(pixel));
+}
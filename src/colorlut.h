@@ -0,0 +1,58 @@
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <QRgb>
+#include <QString>
+#include <functional>
+#include <vector>
+
+// A 3D colour lookup table, as graded looks are shipped: an N x N x N
+// lattice of output colours over the RGB cube, read from Adobe/Resolve
+// .cube files or built from a function.
+//
+// Pixels are mapped with tetrahedral interpolation: the lattice cell is
+// split into six tetrahedra along its grey diagonal and the pixel blends
+// the four corners of the one it falls in, which keeps neutrals neutral
+// and costs four lookups instead of trilinear's eight. mapRow() runs in
+// fixed point, 8.4 bits per lattice value and 1/256 of a cell per
+// position, with the corner blend in SSE2/NEON (see simd.h); the scalar
+// path gives bit-identical results. mapReference() interpolates the file's
+// floats directly and is what the fixed-point path is checked against.
+//
+// const and reentrant once built.
+class ColorLut {
+public:
+    static const int MIN_SIZE = 2;
+    static const int MAX_SIZE = 129;
+
+    ColorLut();
+
+    // map takes and returns RGB in 0..1
+    static ColorLut fromFunction(int size, const std::function<void(float *rgb)>& map, const QString& title = QString());
+    static ColorLut identity(int size);
+
+    bool loadCube(const QString& path, QString *errorMessage);
+
+    bool isNull() const { return m_size == 0; }
+    int size() const { return m_size; }
+    QString title() const { return m_title; }
+    qint64 byteSize() const;
+
+    // Maps 0xAARRGGBB pixels in place, keeping alpha
+    void mapRow(quint32 *pixels, int count, bool simd = true) const;
+
+    QRgb mapReference(QRgb pixel) const;
+
+private:
+    bool setTable(int size, std::vector<float> table, const QString& title);
+    int entry(int r, int g, int b) const { return r + m_size * (g + m_size * b); }
+
+    int m_size;
+    QString m_title;
+    std::vector<float> m_table;         // RGB per entry, red fastest as in .cube files
+    std::vector<qint16> m_lattice;      // B, G, R, 0 per entry in 8.4 fixed point, the QRgb byte order
+    quint16 m_cell[256];                // Lattice index below each channel value
+    quint16 m_fraction[256];            // Position within that cell, 0..256
+};
+
+#endif // COLORLUT_H
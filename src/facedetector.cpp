@@ -0,0 +1,76 @@
+#include "facedetector.h"
+#include <QFile>
+#include <algorithm>
+
+namespace {
+
+const char* const SYSTEM_CASCADE_DIR = "/usr/share/opencv4/haarcascades/";
+
+} // namespace
+
+QString FaceDetector::defaultFaceCascadePath() {
+    const QString path = qEnvironmentVariable("PHOTOBOOTH_FACE_CASCADE");
+    return !path.isEmpty() ? path : QString(SYSTEM_CASCADE_DIR) + "haarcascade_frontalface_default.xml";
+}
+
+QString FaceDetector::defaultSmileCascadePath() {
+    if (qEnvironmentVariableIsSet("PHOTOBOOTH_SMILE_CASCADE")) {
+        return qEnvironmentVariable("PHOTOBOOTH_SMILE_CASCADE");
+    }
+    return QString(SYSTEM_CASCADE_DIR) + "haarcascade_smile.xml";
+}
+
+FaceDetector::FaceDetector() {
+}
+
+bool FaceDetector::load(const QString& faceCascadePath, const QString& smileCascadePath, QString *errorMessage) {
+    HaarCascade faces;
+    HaarCascade smiles;
+    if (!faces.load(faceCascadePath, errorMessage)) {
+        return false;
+    }
+    if (!smileCascadePath.isEmpty() && !smiles.load(smileCascadePath, errorMessage)) {
+        return false;
+    }
+    m_faceCascade = std::move(faces);
+    m_smileCascade = std::move(smiles);
+    return true;
+}
+
+QList<FaceDetector::Face> FaceDetector::detect(const QImage& grayscale) const {
+    QList<Face> faces;
+    if (!isLoaded() || grayscale.isNull()) {
+        return faces;
+    }
+    const QImage image = grayscale.format() == QImage::Format_Grayscale8
+        ? grayscale : grayscale.convertToFormat(QImage::Format_Grayscale8);
+
+    HaarCascade::DetectOptions faceOptions;
+    faceOptions.scaleFactor = m_options.scaleFactor;
+    faceOptions.minNeighbors = m_options.faceNeighbors;
+    const int minWidth = qRound(image.width() * m_options.minFaceWidth);
+    faceOptions.minSize = QSize(minWidth, minWidth);
+    const QList<QRect> found = m_faceCascade.detect(image, faceOptions);
+
+    for (const QRect& rect : found) {
+        Face face;
+        face.box = QRectF(static_cast<double>(rect.x()) / image.width(), static_cast<double>(rect.y()) / image.height(),
+                          static_cast<double>(rect.width()) / image.width(),
+                          static_cast<double>(rect.height()) / image.height());
+        face.smiling = false;
+        if (detectsSmiles()) {
+            // The mouth sits in the lower half; a third of the face wide at least
+            const QRect mouth = QRect(rect.x(), rect.y() + rect.height() / 2, rect.width(), rect.height() / 2)
+                                    .intersected(image.rect());
+            HaarCascade::DetectOptions smileOptions;
+            smileOptions.scaleFactor = 1.1;
+            smileOptions.minNeighbors = m_options.smileNeighbors;
+            smileOptions.minSize = QSize(mouth.width() / 3, mouth.width() / 6);
+            face.smiling = !mouth.isEmpty() && !m_smileCascade.detect(image.copy(mouth), smileOptions).isEmpty();
+        }
+        faces.append(face);
+    }
+    // Left to right, so the overlay doesn't reshuffle as guests hold still
+    std::sort(faces.begin(), faces.end(), [](const Face& a, const Face& b) { return a.box.x() < b.box.x(); });
+    return faces;
+}
@@ -0,0 +1,55 @@
+#ifndef FACEDETECTOR_H
+#define FACEDETECTOR_H
+
+#include "haarcascade.h"
+#include <QImage>
+#include <QList>
+#include <QRectF>
+#include <QString>
+
+// Faces in a grayscale frame, and whether each one is smiling. Faces come
+// from a frontal face cascade searched down to minFaceWidth of the frame;
+// smiles from a smile cascade searched in the lower half of each face, at
+// the frame's full resolution so a face across the room still has a mouth
+// worth looking at. Without a smile cascade no face counts as smiling.
+//
+// const and reentrant once loaded; FaceTracker runs it on preview frames,
+// facebench on a recorded frame set.
+class FaceDetector {
+public:
+    struct Face {
+        QRectF box;             // Fraction of the frame, 0..1 on both axes
+        bool smiling = false;
+    };
+
+    struct Options {
+        double minFaceWidth = 0.12;     // Of the frame width; a guest at the booth is bigger
+        double scaleFactor = 1.2;
+        int faceNeighbors = 3;
+        int smileNeighbors = 10;        // The smile cascade fires a lot on lips; demand more
+    };
+
+    // PHOTOBOOTH_FACE_CASCADE and PHOTOBOOTH_SMILE_CASCADE, or the cascades
+    // Raspberry Pi OS installs with opencv-data. An empty smile path turns
+    // smile detection off.
+    static QString defaultFaceCascadePath();
+    static QString defaultSmileCascadePath();
+
+    FaceDetector();
+
+    bool load(const QString& faceCascadePath, const QString& smileCascadePath, QString *errorMessage);
+    bool isLoaded() const { return !m_faceCascade.isEmpty(); }
+    bool detectsSmiles() const { return !m_smileCascade.isEmpty(); }
+
+    void setOptions(const Options& options) { m_options = options; }
+    Options options() const { return m_options; }
+
+    QList<Face> detect(const QImage& grayscale) const;
+
+private:
+    Options m_options;
+    HaarCascade m_faceCascade;
+    HaarCascade m_smileCascade;
+};
+
+#endif // FACEDETECTOR_H
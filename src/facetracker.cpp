@@ -0,0 +1,182 @@
+#include "facetracker.h"
+#include "boothlog.h"
+#include "framesubscriber.h"
+#include "icamera.h"
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+// What one Pi 4 core keeps up with at the default minimum face size
+const int DEFAULT_RATE = 15;
+
+} // namespace
+
+bool FaceTracker::Result::everyoneInside(const QRectF& region) const {
+    return !faces.isEmpty() && std::all_of(faces.begin(), faces.end(), [&region](const FaceDetector::Face& face) {
+        return region.contains(face.box);
+    });
+}
+
+bool FaceTracker::Result::everyoneSmiling() const {
+    return !faces.isEmpty() && std::all_of(faces.begin(), faces.end(), [](const FaceDetector::Face& face) {
+        return face.smiling;
+    });
+}
+
+FaceTracker::FaceTracker(ICamera *camera, const QString& faceCascadePath, const QString& smileCascadePath,
+                         int maxRate, QObject *parent)
+    : QObject(parent)
+    , m_camera(camera)
+    , m_subscriber(new FrameSubscriber(this))
+    , m_faceCascadePath(faceCascadePath)
+    , m_smileCascadePath(smileCascadePath)
+    , m_intervalMs(1000 / std::max(1, maxRate))
+    , m_frameWaiting(false)
+    , m_active(false)
+    , m_ready(false)
+    , m_detectsSmiles(false)
+    , m_shuttingDown(false)
+    , m_thread(nullptr)
+{
+    // Runs on the camera's thread; the detection thread takes the frame
+    connect(m_subscriber, &FrameSubscriber::frameAvailable, this, [this]() {
+        QMutexLocker locker(&m_mutex);
+        m_frameWaiting = true;
+        m_wake.wakeOne();
+    }, Qt::DirectConnection);
+
+    m_thread = QThread::create([this]() { detectionLoop(); });
+    m_thread->setObjectName("FaceTracker");
+    m_thread->start(QThread::LowPriority);
+}
+
+FaceTracker::~FaceTracker() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shuttingDown = true;
+        m_wake.wakeAll();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
+
+FaceTracker* FaceTracker::create(ICamera *camera, QObject *parent) {
+    if (qEnvironmentVariable("PHOTOBOOTH_FACE_DETECTION") == "0") {
+        return nullptr;
+    }
+    bool ok = false;
+    const int rate = qEnvironmentVariableIntValue("PHOTOBOOTH_FACE_RATE", &ok);
+    return new FaceTracker(camera, FaceDetector::defaultFaceCascadePath(), FaceDetector::defaultSmileCascadePath(),
+                           ok && rate > 0 ? rate : DEFAULT_RATE, parent);
+}
+
+bool FaceTracker::isReady() const {
+    QMutexLocker locker(&m_mutex);
+    return m_ready;
+}
+
+bool FaceTracker::detectsSmiles() const {
+    QMutexLocker locker(&m_mutex);
+    return m_detectsSmiles;
+}
+
+void FaceTracker::setActive(bool active) {
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_active == active) {
+            return;
+        }
+        m_active = active;
+        m_frameWaiting = false;
+        m_result = Result();
+    }
+    if (active) {
+        m_camera->addFrameSubscriber(m_subscriber);
+    } else {
+        m_camera->removeFrameSubscriber(m_subscriber);
+        m_subscriber->takeFrame(); // Don't start on a stale frame next time
+    }
+    emit resultChanged();
+}
+
+FaceTracker::Result FaceTracker::result() const {
+    QMutexLocker locker(&m_mutex);
+    return m_result;
+}
+
+FaceTracker::Statistics FaceTracker::statistics() const {
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.framesSkipped = m_subscriber->framesDropped();
+    return statistics;
+}
+
+void FaceTracker::detectionLoop() {
+    // Parsing the cascades takes a while on the Pi; keep it off the GUI thread
+    FaceDetector detector;
+    QString errorMessage;
+    const bool loaded = detector.load(m_faceCascadePath, m_smileCascadePath, &errorMessage);
+    if (loaded) {
+        qCDebug(lcCamera) << "FaceTracker: Detecting faces" << (detector.detectsSmiles() ? "and smiles" : "only")
+                 << "at up to" << 1000 / m_intervalMs << "per second";
+    } else {
+        qCWarning(lcCamera) << "FaceTracker: Face detection off:" << errorMessage;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_ready = loaded;
+        m_detectsSmiles = loaded && detector.detectsSmiles();
+    }
+    if (!loaded) {
+        return;
+    }
+
+    QElapsedTimer sinceLast;
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_shuttingDown && !(m_active && m_frameWaiting)) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_shuttingDown) {
+                return;
+            }
+            // Hold the rate; frames that arrive meanwhile replace this one
+            if (sinceLast.isValid() && sinceLast.elapsed() < m_intervalMs) {
+                m_wake.wait(&m_mutex, QDeadlineTimer(m_intervalMs - sinceLast.elapsed()));
+                continue;
+            }
+            m_frameWaiting = false;
+        }
+
+        const CameraFrame frame = m_subscriber->takeFrame();
+        if (!frame.isValid()) {
+            continue;
+        }
+        sinceLast.start();
+        QElapsedTimer timer;
+        timer.start();
+        const QList<FaceDetector::Face> faces = detector.detect(frame.toGrayscaleImage());
+        const qint64 detectNs = timer.nsecsElapsed();
+
+        {
+            QMutexLocker locker(&m_mutex);
+            ++m_statistics.detections;
+            m_statistics.detectNs += detectNs;
+            m_statistics.maxDetectUs = std::max(m_statistics.maxDetectUs, detectNs / 1000);
+            if (!m_active) {
+                continue; // Deactivated while detecting; the result is stale
+            }
+            m_result.faces = faces;
+            m_result.frameSize = frame.size();
+            m_result.frameSequence = frame.sequence();
+            m_result.smilesDetected = m_detectsSmiles;
+        }
+        emit resultChanged();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef FACETRACKER_H
+#define FACETRACKER_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QWaitCondition>
+#include "facedetector.h"
+
+class ICamera;
+class FrameSubscriber;
+class QThread;
+
+// Runs a FaceDetector over the camera's preview frames on a thread of its
+// own, at most maxRate times a second, always on the newest frame. It only
+// subscribes to frames while active, so the camera doesn't produce them for
+// nobody. The cascades are loaded on that thread too; result() stays empty
+// if they can't be.
+//
+// resultChanged() is emitted from the detection thread.
+class FaceTracker : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        QList<FaceDetector::Face> faces;
+        QSize frameSize;
+        quint64 frameSequence = 0;
+        bool smilesDetected = false;    // Otherwise no face is ever smiling
+
+        // At least one face, and all of them inside region (frame fractions)
+        bool everyoneInside(const QRectF& region) const;
+        bool everyoneSmiling() const;
+    };
+
+    struct Statistics {
+        quint64 detections = 0;
+        quint64 framesSkipped = 0;      // Newer frames arrived while detecting
+        qint64 detectNs = 0;            // Total, including the grayscale conversion
+        qint64 maxDetectUs = 0;
+    };
+
+    FaceTracker(ICamera *camera, const QString& faceCascadePath, const QString& smileCascadePath,
+                int maxRate, QObject *parent = nullptr);
+    ~FaceTracker() override;
+
+    // Uses FaceDetector's default cascades and PHOTOBOOTH_FACE_RATE (15).
+    // Returns nullptr when PHOTOBOOTH_FACE_DETECTION is 0.
+    static FaceTracker* create(ICamera *camera, QObject *parent);
+
+    // False until the cascades are loaded, and for good if they can't be
+    bool isReady() const;
+    bool detectsSmiles() const;
+
+    void setActive(bool active);
+    Result result() const;
+    Statistics statistics() const;
+
+signals:
+    void resultChanged();
+
+private:
+    void detectionLoop();
+
+    ICamera *m_camera;
+    FrameSubscriber *m_subscriber;
+    const QString m_faceCascadePath;
+    const QString m_smileCascadePath;
+    const int m_intervalMs;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_frameWaiting;
+    bool m_active;
+    bool m_ready;
+    bool m_detectsSmiles;
+    bool m_shuttingDown;
+    Result m_result;
+    Statistics m_statistics;
+    QThread *m_thread;
+};
+
+#endif // FACETRACKER_H
@@ -0,0 +1,129 @@
+#include "framepool.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+
+void FramePoolState::release(FrameBuffer* buffer) {
+    QMutexLocker locker(&mutex);
+    freeList.push_back(buffer); // Reserved up front, never reallocates
+}
+
+FramePool::FramePool(int maxBuffers)
+    : m_state(std::make_shared<FramePoolState>())
+    , m_lastAllocations(0)
+{
+    m_state->maxBuffers = std::max(1, maxBuffers);
+    m_state->buffers.reserve(m_state->maxBuffers);
+    m_state->freeList.reserve(m_state->maxBuffers);
+    m_rateTimer.start();
+}
+
+CameraFrame FramePool::acquire(int width, int height, CameraFrame::PixelFormat format) {
+    if (width <= 0 || height <= 0 || format == CameraFrame::Format_Invalid) {
+        return CameraFrame();
+    }
+
+    FrameBuffer* buffer = nullptr;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->freeList.empty()) {
+            buffer = m_state->freeList.back();
+            m_state->freeList.pop_back();
+        } else if (static_cast<int>(m_state->buffers.size()) < m_state->maxBuffers) {
+            m_state->buffers.push_back(std::make_unique<FrameBuffer>());
+            buffer = m_state->buffers.back().get();
+        }
+    }
+
+    if (!buffer) {
+        // Every buffer is still held by a consumer; the producer drops this frame
+        ++m_state->acquireFailures;
+        return CameraFrame();
+    }
+
+    layoutPlanes(buffer, width, height, format);
+    size_t required = buffer->planeOffset[buffer->planeCount - 1] +
+                      static_cast<size_t>(buffer->bytesPerLine[buffer->planeCount - 1]) *
+                      buffer->planeHeight[buffer->planeCount - 1];
+    if (buffer->capacity < required) {
+        buffer->storage.reset(new uchar[required]);
+        buffer->capacity = required;
+        ++m_state->bufferAllocations;
+        m_state->bytesAllocated += required;
+    }
+
+    buffer->refCount.store(1, std::memory_order_relaxed);
+    buffer->timestampNs = 0;
+    buffer->sequence = 0;
+    ++m_state->framesAcquired;
+    return CameraFrame(m_state, buffer);
+}
+
+FramePool::Statistics FramePool::statistics() const {
+    Statistics stats;
+    stats.bufferAllocations = m_state->bufferAllocations.load();
+    stats.bytesAllocated = m_state->bytesAllocated.load();
+    stats.framesAcquired = m_state->framesAcquired.load();
+    stats.acquireFailures = m_state->acquireFailures.load();
+
+    QMutexLocker locker(&m_state->mutex);
+    stats.bufferCount = static_cast<int>(m_state->buffers.size());
+    stats.buffersInUse = stats.bufferCount - static_cast<int>(m_state->freeList.size());
+    for (const std::unique_ptr<FrameBuffer>& buffer : m_state->buffers) {
+        stats.bytesHeld += buffer->capacity;
+    }
+    return stats;
+}
+
+double FramePool::allocationRate() {
+    quint64 allocations = m_state->bufferAllocations.load();
+    qint64 elapsedMs = m_rateTimer.restart();
+    double rate = elapsedMs > 0 ? (allocations - m_lastAllocations) * 1000.0 / elapsedMs : 0.0;
+    m_lastAllocations = allocations;
+    return rate;
+}
+
+void FramePool::layoutPlanes(FrameBuffer* buffer, int width, int height, CameraFrame::PixelFormat format) {
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+
+    buffer->width = width;
+    buffer->height = height;
+    buffer->format = format;
+    buffer->planeCount = CameraFrame::planeCountFor(format);
+
+    switch (format) {
+        case CameraFrame::Format_RGB32:
+        case CameraFrame::Format_ARGB32_Premultiplied:
+            buffer->bytesPerLine[0] = width * 4;
+            buffer->planeHeight[0] = height;
+            break;
+        case CameraFrame::Format_Grayscale8:
+            buffer->bytesPerLine[0] = (width + 3) & ~3; // QImage wants 32-bit aligned lines
+            buffer->planeHeight[0] = height;
+            break;
+        case CameraFrame::Format_YUV420P:
+            buffer->bytesPerLine[0] = width;
+            buffer->planeHeight[0] = height;
+            buffer->bytesPerLine[1] = chromaWidth;
+            buffer->planeHeight[1] = chromaHeight;
+            buffer->bytesPerLine[2] = chromaWidth;
+            buffer->planeHeight[2] = chromaHeight;
+            break;
+        case CameraFrame::Format_NV12:
+            buffer->bytesPerLine[0] = width;
+            buffer->planeHeight[0] = height;
+            buffer->bytesPerLine[1] = chromaWidth * 2;
+            buffer->planeHeight[1] = chromaHeight;
+            break;
+        case CameraFrame::Format_Invalid:
+        default:
+            break;
+    }
+
+    size_t offset = 0;
+    for (int plane = 0; plane < buffer->planeCount; ++plane) {
+        buffer->planeOffset[plane] = offset;
+        offset += static_cast<size_t>(buffer->bytesPerLine[plane]) * buffer->planeHeight[plane];
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include "cameraframe.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct FrameBuffer {
+    std::unique_ptr<uchar[]> storage;
+    size_t capacity = 0;
+    std::atomic<int> refCount{0};
+
+    int width = 0;
+    int height = 0;
+    CameraFrame::PixelFormat format = CameraFrame::Format_Invalid;
+    int planeCount = 0;
+    int bytesPerLine[CameraFrame::MAX_PLANES] = {};
+    int planeHeight[CameraFrame::MAX_PLANES] = {};
+    size_t planeOffset[CameraFrame::MAX_PLANES] = {};
+    qint64 timestampNs = 0;
+    quint64 sequence = 0;
+};
+
+struct FramePoolState {
+    QMutex mutex;
+    std::vector<std::unique_ptr<FrameBuffer>> buffers;
+    std::vector<FrameBuffer*> freeList;
+    int maxBuffers = 0;
+
+    std::atomic<quint64> bufferAllocations{0};
+    std::atomic<quint64> bytesAllocated{0};
+    std::atomic<quint64> framesAcquired{0};
+    std::atomic<quint64> acquireFailures{0};
+
+    void release(FrameBuffer* buffer);
+};
+
+// Fixed-size pool of frame buffers. Buffers are allocated on first use (or when
+// the frame size grows) and recycled afterwards, so a camera running at a steady
+// resolution performs no allocations per frame. When every buffer is still held
+// by consumers, acquire() returns an invalid frame and the producer drops that
+// frame instead of waiting.
+class FramePool {
+public:
+    struct Statistics {
+        quint64 bufferAllocations = 0;
+        quint64 bytesAllocated = 0;
+        quint64 framesAcquired = 0;
+        quint64 acquireFailures = 0;
+        int buffersInUse = 0;
+        int bufferCount = 0;
+        quint64 bytesHeld = 0;      // Capacity of the buffers allocated now
+    };
+
+    explicit FramePool(int maxBuffers = 6);
+
+    CameraFrame acquire(int width, int height, CameraFrame::PixelFormat format);
+
+    Statistics statistics() const;
+
+    // Buffer allocations per second since the previous call
+    double allocationRate();
+
+private:
+    static void layoutPlanes(FrameBuffer* buffer, int width, int height, CameraFrame::PixelFormat format);
+
+    std::shared_ptr<FramePoolState> m_state;
+    QElapsedTimer m_rateTimer;
+    quint64 m_lastAllocations;
+};
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,45 @@
+#include "framesubscriber.h"
+#include "icamera.h"
+#include <QMutexLocker>
+
+FrameSubscriber::FrameSubscriber(QObject *parent)
+    : QObject(parent)
+    , m_source(nullptr)
+    , m_notifyPending(false)
+    , m_framesDelivered(0)
+    , m_framesDropped(0)
+{
+}
+
+FrameSubscriber::~FrameSubscriber() {
+    if (m_source) {
+        m_source->removeFrameSubscriber(this);
+    }
+}
+
+CameraFrame FrameSubscriber::takeFrame() {
+    QMutexLocker locker(&m_mutex);
+    CameraFrame frame = std::move(m_pending);
+    m_notifyPending = false;
+    if (frame.isValid()) {
+        ++m_framesDelivered;
+    }
+    return frame;
+}
+
+void FrameSubscriber::offer(const CameraFrame& frame) {
+    CameraFrame replaced;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_pending.isValid()) {
+            ++m_framesDropped;
+        }
+        replaced = std::move(m_pending);
+        m_pending = frame;
+    }
+    // `replaced` returns its buffer to the pool outside the lock
+
+    if (!m_notifyPending.exchange(true)) {
+        emit frameAvailable();
+    }
+}
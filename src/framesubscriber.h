@@ -0,0 +1,45 @@
+#ifndef FRAMESUBSCRIBER_H
+#define FRAMESUBSCRIBER_H
+
+#include "cameraframe.h"
+#include <QObject>
+#include <QMutex>
+#include <atomic>
+
+class ICamera;
+
+// One consumer's mailbox for camera frames. The producer overwrites the single
+// pending slot, so a consumer that falls behind only ever sees the newest frame
+// and the skipped ones are counted as dropped. frameAvailable() is emitted at
+// most once until takeFrame() is called and is delivered on the subscriber's
+// thread.
+class FrameSubscriber : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FrameSubscriber(QObject *parent = nullptr);
+    ~FrameSubscriber() override;
+
+    CameraFrame takeFrame();
+
+    quint64 framesDelivered() const { return m_framesDelivered.load(); }
+    quint64 framesDropped() const { return m_framesDropped.load(); }
+
+signals:
+    void frameAvailable();
+
+private:
+    friend class ICamera;
+
+    // Called by the producing camera, possibly from a capture thread
+    void offer(const CameraFrame& frame);
+
+    QMutex m_mutex;
+    CameraFrame m_pending;
+    ICamera* m_source;
+    std::atomic<bool> m_notifyPending;
+    std::atomic<quint64> m_framesDelivered;
+    std::atomic<quint64> m_framesDropped;
+};
+
+#endif // FRAMESUBSCRIBER_H
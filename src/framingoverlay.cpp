@@ -0,0 +1,77 @@
+#include "framingoverlay.h"
+#include <QPainter>
+#include <QPaintEvent>
+
+FramingOverlay::FramingOverlay(QWidget *parent)
+    : QWidget(parent)
+    , m_showHints(false)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAttribute(Qt::WA_NoSystemBackground);
+}
+
+void FramingOverlay::setResult(const FaceTracker::Result& result) {
+    m_result = result;
+    update();
+}
+
+void FramingOverlay::setShowHints(bool show) {
+    m_showHints = show;
+    update();
+}
+
+QString FramingOverlay::hint() const {
+    if (m_result.faces.isEmpty()) {
+        return "Step into the frame";
+    }
+    if (!m_result.everyoneInside(guideRegion())) {
+        return "Everyone inside the box";
+    }
+    if (!m_result.everyoneSmiling()) {
+        return "Big smiles!";
+    }
+    return "Hold it!";
+}
+
+void FramingOverlay::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QRectF frame = rect();
+    if (m_result.frameSize.isValid()) {
+        const QSizeF fitted = QSizeF(m_result.frameSize).scaled(size(), Qt::KeepAspectRatio);
+        frame = QRectF(QPointF(0, 0), fitted);
+        frame.moveCenter(QRectF(rect()).center());
+    }
+    auto toWidget = [&frame](const QRectF& box) {
+        return QRectF(frame.x() + box.x() * frame.width(), frame.y() + box.y() * frame.height(),
+                      box.width() * frame.width(), box.height() * frame.height());
+    };
+
+    const QColor ready(76, 175, 80);
+    const QColor waiting(255, 152, 0);
+    const QRectF guide = guideRegion();
+    const bool framed = m_result.everyoneInside(guide);
+    painter.setPen(QPen(framed ? ready : QColor(255, 255, 255, 180), 3, framed ? Qt::SolidLine : Qt::DashLine));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRoundedRect(toWidget(guide), 12, 12);
+
+    for (const FaceDetector::Face& face : std::as_const(m_result.faces)) {
+        // Framed is all that can be asked without smile detection
+        const bool good = (face.smiling || !m_result.smilesDetected) && guide.contains(face.box);
+        painter.setPen(QPen(good ? ready : waiting, 3));
+        painter.drawRoundedRect(toWidget(face.box), 8, 8);
+    }
+
+    if (m_showHints) {
+        const QRectF band(frame.left(), frame.bottom() - 60, frame.width(), 60);
+        painter.fillRect(band, QColor(0, 0, 0, 128));
+        QFont font = painter.font();
+        font.setPointSize(22);
+        font.setBold(true);
+        painter.setFont(font);
+        painter.setPen(Qt::white);
+        painter.drawText(band, Qt::AlignCenter, hint());
+    }
+}
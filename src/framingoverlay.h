@@ -0,0 +1,34 @@
+#ifndef FRAMINGOVERLAY_H
+#define FRAMINGOVERLAY_H
+
+#include <QWidget>
+#include <QRectF>
+#include "facetracker.h"
+
+// Drawn over the camera preview: the region guests should be in, a box
+// round each face FaceTracker sees, green once it's inside and smiling, and
+// while waiting for smiles a line telling guests what's missing. Faces are
+// mapped the way the preview scales frames, to fit with the aspect kept.
+class FramingOverlay : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit FramingOverlay(QWidget *parent = nullptr);
+
+    // Where every face has to be, as fractions of the frame
+    static QRectF guideRegion() { return QRectF(0.15, 0.08, 0.70, 0.84); }
+
+    void setResult(const FaceTracker::Result& result);
+    void setShowHints(bool show);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QString hint() const;
+
+    FaceTracker::Result m_result;
+    bool m_showHints;
+};
+
+#endif // FRAMINGOVERLAY_H
@@ -0,0 +1,142 @@
+#include "gallerymodel.h"
+#include "thumbnailstore.h"
+#include <QDateTime>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPalette>
+
+namespace {
+
+const int ITEM_MARGIN = 6;
+const char* const TIME_FORMAT = "yyyy-MM-dd hh:mm";
+
+} // namespace
+
+GalleryModel::GalleryModel(ThumbnailStore *store, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_store(store)
+{
+    loadKeys();
+    for (int slot = static_cast<int>(m_keys.size()) - 1; slot >= 0; --slot) {
+        m_rows.push_back(slot);
+    }
+    // Thumbnails are added on worker threads; rows are inserted on ours
+    connect(m_store, &ThumbnailStore::thumbnailAdded, this, &GalleryModel::onThumbnailAdded, Qt::QueuedConnection);
+}
+
+void GalleryModel::loadKeys() {
+    const int count = m_store->count();
+    m_keys.reserve(count);
+    for (int slot = static_cast<int>(m_keys.size()); slot < count; ++slot) {
+        const ThumbnailStore::Entry entry = m_store->entry(slot);
+        m_keys.push_back({entry.guestName.toCaseFolded(), entry.captureTime.toString(TIME_FORMAT)});
+    }
+}
+
+bool GalleryModel::matches(int slot) const {
+    if (m_filter.isEmpty()) {
+        return true;
+    }
+    const SearchKey& key = m_keys[slot];
+    return key.name.contains(m_filter) || key.time.contains(m_filter);
+}
+
+int GalleryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
+
+QVariant GalleryModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(m_rows.size())) {
+        return QVariant();
+    }
+    const int slot = m_rows[index.row()];
+    switch (role) {
+    case SlotRole:
+        return slot;
+    case Qt::DisplayRole: {
+        const QString name = m_store->entry(slot).guestName;
+        return name.isEmpty() ? QString("(no name)") : name;
+    }
+    case Qt::ToolTipRole:
+    case PhotoPathRole:
+        return m_store->entry(slot).photoPath;
+    case CaptureTimeRole:
+        return m_store->entry(slot).captureTime;
+    default:
+        return QVariant();
+    }
+}
+
+void GalleryModel::setFilter(const QString& text) {
+    const QString filter = text.trimmed().toCaseFolded();
+    if (filter == m_filter) {
+        return;
+    }
+    beginResetModel();
+    m_filter = filter;
+    m_rows.clear();
+    for (int slot = static_cast<int>(m_keys.size()) - 1; slot >= 0; --slot) {
+        if (matches(slot)) {
+            m_rows.push_back(slot);
+        }
+    }
+    endResetModel();
+}
+
+void GalleryModel::onThumbnailAdded() {
+    const int first = static_cast<int>(m_keys.size());
+    loadKeys();
+    std::vector<int> added;
+    for (int slot = static_cast<int>(m_keys.size()) - 1; slot >= first; --slot) {
+        if (matches(slot)) {
+            added.push_back(slot);
+        }
+    }
+    if (added.empty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), 0, static_cast<int>(added.size()) - 1);
+    m_rows.insert(m_rows.begin(), added.begin(), added.end());
+    endInsertRows();
+}
+
+GalleryDelegate::GalleryDelegate(ThumbnailStore *store, QObject *parent)
+    : QStyledItemDelegate(parent)
+    , m_store(store)
+{
+}
+
+void GalleryDelegate::paint(QPainter *painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    painter->save();
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(option.rect, option.palette.highlight());
+    }
+
+    // Drawn straight from the mapped store: no decode, no pixmap cache
+    const QRect imageArea(option.rect.x() + ITEM_MARGIN, option.rect.y() + ITEM_MARGIN,
+                          ThumbnailStore::THUMBNAIL_WIDTH, ThumbnailStore::THUMBNAIL_HEIGHT);
+    const QImage thumbnail = m_store->thumbnail(index.data(GalleryModel::SlotRole).toInt());
+    if (!thumbnail.isNull()) {
+        QRect target(QPoint(0, 0), thumbnail.size());
+        target.moveCenter(imageArea.center());
+        painter->drawImage(target, thumbnail);
+    }
+
+    const QFontMetrics metrics(option.font);
+    QRect textRect(option.rect.x() + ITEM_MARGIN, imageArea.bottom() + ITEM_MARGIN,
+                   ThumbnailStore::THUMBNAIL_WIDTH, metrics.height());
+    painter->setPen(option.palette.color(option.state & QStyle::State_Selected ? QPalette::HighlightedText
+                                                                               : QPalette::Text));
+    painter->drawText(textRect, Qt::AlignCenter,
+                      metrics.elidedText(index.data(Qt::DisplayRole).toString(), Qt::ElideRight, textRect.width()));
+    textRect.translate(0, metrics.height());
+    painter->drawText(textRect, Qt::AlignCenter,
+                      index.data(GalleryModel::CaptureTimeRole).toDateTime().toString("ddd hh:mm"));
+    painter->restore();
+}
+
+QSize GalleryDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex&) const {
+    const QFontMetrics metrics(option.font);
+    return QSize(ThumbnailStore::THUMBNAIL_WIDTH + 2 * ITEM_MARGIN,
+                 ThumbnailStore::THUMBNAIL_HEIGHT + 3 * ITEM_MARGIN + 2 * metrics.height());
+}
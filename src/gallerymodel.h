@@ -0,0 +1,68 @@
+#ifndef GALLERYMODEL_H
+#define GALLERYMODEL_H
+
+#include <QAbstractListModel>
+#include <QStyledItemDelegate>
+#include <QString>
+#include <vector>
+
+class ThumbnailStore;
+
+// Gallery rows over ThumbnailStore, newest first. Rows carry no images:
+// GalleryDelegate paints straight from the store, and with uniform item
+// sizes QListView only ever touches the rows on screen.
+class GalleryModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Role {
+        SlotRole = Qt::UserRole + 1,
+        PhotoPathRole,
+        CaptureTimeRole
+    };
+
+    explicit GalleryModel(ThumbnailStore *store, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    // Keeps photos whose guest name contains text, ignoring case, or whose
+    // capture time as "yyyy-MM-dd hh:mm" does ("14:3", "2025-06-21")
+    void setFilter(const QString& text);
+    QString filter() const { return m_filter; }
+
+    ThumbnailStore* store() const { return m_store; }
+
+private slots:
+    void onThumbnailAdded();
+
+private:
+    struct SearchKey {
+        QString name;   // Case-folded
+        QString time;
+    };
+
+    void loadKeys();
+    bool matches(int slot) const;
+
+    ThumbnailStore *m_store;
+    std::vector<SearchKey> m_keys;      // By slot
+    std::vector<int> m_rows;            // Matching slots, newest first
+    QString m_filter;
+};
+
+// Thumbnail with the guest's name and capture time underneath
+class GalleryDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    explicit GalleryDelegate(ThumbnailStore *store, QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+private:
+    ThumbnailStore *m_store;
+};
+
+#endif // GALLERYMODEL_H
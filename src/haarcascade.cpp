@@ -0,0 +1,497 @@
+#include "haarcascade.h"
+#include "pixelmath.h"
+#include <QFile>
+#include <QXmlStreamReader>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// What OpenCV allows below a stage threshold for float rounding
+const float STAGE_THRESHOLD_EPSILON = 1e-5f;
+
+std::vector<double> parseNumbers(const QString& text, bool *ok) {
+    std::vector<double> numbers;
+    *ok = true;
+    const QStringList parts = text.simplified().split(' ', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        bool valid = false;
+        numbers.push_back(part.toDouble(&valid));
+        *ok = *ok && valid;
+    }
+    return numbers;
+}
+
+// Halves both dimensions, averaging 2x2 blocks
+QImage halve(const QImage& image) {
+    QImage half(image.width() / 2, image.height() / 2, QImage::Format_Grayscale8);
+    for (int y = 0; y < half.height(); ++y) {
+        const uchar *top = image.constScanLine(2 * y);
+        const uchar *bottom = image.constScanLine(2 * y + 1);
+        uchar *out = half.scanLine(y);
+        for (int x = 0; x < half.width(); ++x) {
+            out[x] = static_cast<uchar>((top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2);
+        }
+    }
+    return half;
+}
+
+// Bilinear resize for ratios below two, where it still sees every pixel
+QImage resizeBilinear(const QImage& image, const QSize& size) {
+    if (image.size() == size) {
+        return image;
+    }
+    std::vector<int> xOffsets, yOffsets;
+    std::vector<quint32> xWeights, yWeights;
+    PixelMath::buildSamplePositions(image.width(), size.width(), &xOffsets, &xWeights);
+    PixelMath::buildSamplePositions(image.height(), size.height(), &yOffsets, &yWeights);
+
+    QImage resized(size, QImage::Format_Grayscale8);
+    std::vector<quint32> rowA(size.width()), rowB(size.width());
+    auto sampleRow = [&](const uchar *source, std::vector<quint32>& row) {
+        for (int x = 0; x < size.width(); ++x) {
+            const int offset = xOffsets[x];
+            const quint32 weight = xWeights[x];
+            row[x] = weight != 0 ? source[offset] * (256 - weight) + source[offset + 1] * weight
+                                 : source[offset] << 8;
+        }
+    };
+    for (int y = 0; y < size.height(); ++y) {
+        const quint32 weight = yWeights[y];
+        sampleRow(image.constScanLine(yOffsets[y]), rowA);
+        uchar *out = resized.scanLine(y);
+        if (weight == 0) {
+            for (int x = 0; x < size.width(); ++x) {
+                out[x] = static_cast<uchar>((rowA[x] + 0x80) >> 8);
+            }
+            continue;
+        }
+        sampleRow(image.constScanLine(yOffsets[y] + 1), rowB);
+        for (int x = 0; x < size.width(); ++x) {
+            out[x] = static_cast<uchar>((rowA[x] * (256 - weight) + rowB[x] * weight + 0x8000) >> 16);
+        }
+    }
+    return resized;
+}
+
+} // namespace
+
+// One scale of the image as integral images, (width + 1) x (height + 1).
+// Sums wrap at 32 bits; differences over a window are still exact.
+struct HaarCascade::Level {
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    std::vector<quint32> sum;
+    std::vector<quint32> squareSum;
+    std::vector<quint32> tiltedSum;     // Only when the cascade has tilted features
+
+    Level(const QImage& image, bool tilted) : width(image.width()), height(image.height()), stride(width + 1) {
+        sum.assign(static_cast<size_t>(stride) * (height + 1), 0);
+        squareSum.assign(sum.size(), 0);
+        for (int y = 0; y < height; ++y) {
+            const uchar *row = image.constScanLine(y);
+            const quint32 *sumAbove = sum.data() + y * stride;
+            const quint32 *squareAbove = squareSum.data() + y * stride;
+            quint32 *sumRow = sum.data() + (y + 1) * stride;
+            quint32 *squareRow = squareSum.data() + (y + 1) * stride;
+            quint32 rowSum = 0;
+            quint32 rowSquareSum = 0;
+            for (int x = 0; x < width; ++x) {
+                rowSum += row[x];
+                rowSquareSum += static_cast<quint32>(row[x]) * row[x];
+                sumRow[x + 1] = sumAbove[x + 1] + rowSum;
+                squareRow[x + 1] = squareAbove[x + 1] + rowSquareSum;
+            }
+        }
+        if (tilted) {
+            computeTilted(image);
+        }
+    }
+
+    // tilted(X, Y) sums the pixels (x, y) with y < Y and |x - X + 1| <= Y - y - 1,
+    // a triangle opening upwards, as cv::integral() defines it. The recurrence
+    // reaches up to Y columns to either side, so it runs over a padded row.
+    void computeTilted(const QImage& image) {
+        const int pad = height + 1;
+        const int paddedWidth = stride + 2 * pad;
+        std::vector<quint32> previous(paddedWidth, 0), twoBack(paddedWidth, 0), current(paddedWidth, 0);
+        tiltedSum.assign(sum.size(), 0);
+        auto pixel = [&](int x, int y) -> quint32 {
+            return y >= 0 && x >= 0 && x < width ? image.constScanLine(y)[x] : 0;
+        };
+        for (int y = 1; y <= height; ++y) {
+            for (int i = 1; i + 1 < paddedWidth; ++i) {
+                const int x = i - pad;
+                current[i] = previous[i - 1] + previous[i + 1] - twoBack[i] + pixel(x - 1, y - 1) + pixel(x - 1, y - 2);
+            }
+            // The padding edges are wrong, but only reach y columns inwards
+            current[0] = current[paddedWidth - 1] = 0;
+            std::copy(current.begin() + pad, current.begin() + pad + stride, tiltedSum.begin() + y * stride);
+            std::swap(twoBack, previous);
+            std::swap(previous, current);
+        }
+    }
+
+    quint32 rectSum(const std::vector<quint32>& table, int x, int y, int w, int h) const {
+        const quint32 *p = table.data();
+        return p[y * stride + x] - p[y * stride + x + w] - p[(y + h) * stride + x] + p[(y + h) * stride + x + w];
+    }
+};
+
+HaarCascade::HaarCascade()
+    : m_hasTiltedFeatures(false)
+{
+}
+
+bool HaarCascade::load(const QString& path, QString *errorMessage) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    HaarCascade loaded;
+    QString featureType, stageType;
+    int maxCategories = 0;
+    bool inCascade = false;
+    bool numbersOk = true;
+    QStringList openElements;   // Except those read whole
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd() && numbersOk) {
+        xml.readNext();
+        if (xml.isEndElement()) {
+            openElements.removeLast();
+            continue;
+        }
+        if (!xml.isStartElement()) {
+            continue;
+        }
+        const QString name = xml.name().toString();
+        const QString parent = openElements.value(openElements.size() - 1);
+        if (name == "cascade") {
+            inCascade = true;
+        } else if (name == "_" && parent == "stages") {
+            Stage stage;
+            stage.firstTree = static_cast<int>(loaded.m_trees.size());
+            stage.treeCount = 0;
+            stage.threshold = 0.0f;
+            loaded.m_stages.push_back(stage);
+        } else if (name == "_" && parent == "weakClassifiers" && !loaded.m_stages.empty()) {
+            Tree tree;
+            tree.firstNode = static_cast<int>(loaded.m_nodes.size());
+            tree.firstLeaf = static_cast<int>(loaded.m_leaves.size());
+            loaded.m_trees.push_back(tree);
+            ++loaded.m_stages.back().treeCount;
+        } else if (name == "_" && parent == "features") {
+            loaded.m_features.push_back(Feature());
+        } else if (name == "_" && parent == "rects" && !loaded.m_features.empty()) {
+            const std::vector<double> values = parseNumbers(xml.readElementText(), &numbersOk);
+            Feature& feature = loaded.m_features.back();
+            if (values.size() != 5 || feature.rectCount == 3) {
+                *errorMessage = QString("%1: malformed feature rect").arg(path);
+                return false;
+            }
+            feature.rects[feature.rectCount++] = Rect{static_cast<int>(values[0]), static_cast<int>(values[1]),
+                                                      static_cast<int>(values[2]), static_cast<int>(values[3]),
+                                                      static_cast<float>(values[4])};
+            continue;
+        } else if (name == "tilted" && !loaded.m_features.empty()) {
+            loaded.m_features.back().tilted = xml.readElementText().trimmed() != "0";
+            loaded.m_hasTiltedFeatures = loaded.m_hasTiltedFeatures || loaded.m_features.back().tilted;
+            continue;
+        } else if ((name == "width" || name == "height") && parent == "cascade") {
+            const int size = xml.readElementText().toInt();
+            name == "width" ? loaded.m_windowSize.setWidth(size) : loaded.m_windowSize.setHeight(size);
+            continue;
+        } else if (name == "featureType" && parent == "cascade") {
+            featureType = xml.readElementText().trimmed();
+            continue;
+        } else if (name == "stageType" && parent == "cascade") {
+            stageType = xml.readElementText().trimmed();
+            continue;
+        } else if (name == "maxCatCount") {
+            maxCategories = xml.readElementText().toInt();
+            continue;
+        } else if (name == "stageThreshold" && !loaded.m_stages.empty()) {
+            loaded.m_stages.back().threshold = static_cast<float>(xml.readElementText().toDouble(&numbersOk));
+            continue;
+        } else if (name == "internalNodes" && !loaded.m_trees.empty()) {
+            const std::vector<double> values = parseNumbers(xml.readElementText(), &numbersOk);
+            if (values.empty() || values.size() % 4 != 0 || maxCategories > 0) {
+                *errorMessage = QString("%1: unsupported tree nodes").arg(path);
+                return false;
+            }
+            for (size_t i = 0; i < values.size(); i += 4) {
+                loaded.m_nodes.push_back(Node{static_cast<int>(values[i + 2]), static_cast<float>(values[i + 3]),
+                                              static_cast<int>(values[i]), static_cast<int>(values[i + 1])});
+            }
+            continue;
+        } else if (name == "leafValues" && !loaded.m_trees.empty()) {
+            const std::vector<double> values = parseNumbers(xml.readElementText(), &numbersOk);
+            const Tree& tree = loaded.m_trees.back();
+            if (values.size() != loaded.m_nodes.size() - tree.firstNode + 1) {
+                *errorMessage = QString("%1: leaf count doesn't match the tree").arg(path);
+                return false;
+            }
+            for (double value : values) {
+                loaded.m_leaves.push_back(static_cast<float>(value));
+            }
+            continue;
+        }
+        openElements << name;
+    }
+
+    if (xml.hasError() || !numbersOk) {
+        *errorMessage = QString("%1: %2").arg(path, xml.hasError() ? xml.errorString() : "malformed number");
+        return false;
+    }
+    if (!inCascade) {
+        *errorMessage = QString("%1: not an opencv_traincascade cascade").arg(path);
+        return false;
+    }
+    if (featureType != "HAAR" || stageType != "BOOST" || maxCategories > 0) {
+        *errorMessage = QString("%1: %2 %3 cascades aren't supported").arg(path, stageType, featureType);
+        return false;
+    }
+    if (loaded.m_stages.empty() || loaded.m_windowSize.width() < 3 || loaded.m_windowSize.height() < 3) {
+        *errorMessage = QString("%1: empty cascade").arg(path);
+        return false;
+    }
+
+    // Everything the scan indexes without checking
+    const int windowWidth = loaded.m_windowSize.width();
+    const int windowHeight = loaded.m_windowSize.height();
+    for (const Feature& feature : loaded.m_features) {
+        for (int i = 0; i < feature.rectCount; ++i) {
+            const Rect& r = feature.rects[i];
+            const bool inside = feature.tilted
+                ? r.x - r.height >= 0 && r.x + r.width <= windowWidth && r.y >= 0 && r.y + r.width + r.height <= windowHeight
+                : r.x >= 0 && r.y >= 0 && r.x + r.width <= windowWidth && r.y + r.height <= windowHeight;
+            if (!inside || r.width < 0 || r.height < 0) {
+                *errorMessage = QString("%1: feature rect outside the window").arg(path);
+                return false;
+            }
+        }
+    }
+    for (size_t t = 0; t < loaded.m_trees.size(); ++t) {
+        const Tree& tree = loaded.m_trees[t];
+        const int nodeEnd = t + 1 < loaded.m_trees.size() ? loaded.m_trees[t + 1].firstNode
+                                                          : static_cast<int>(loaded.m_nodes.size());
+        const int nodeCount = nodeEnd - tree.firstNode;
+        for (int n = tree.firstNode; n < nodeEnd; ++n) {
+            const Node& node = loaded.m_nodes[n];
+            const bool valid = node.feature >= 0 && node.feature < static_cast<int>(loaded.m_features.size())
+                && node.left < nodeCount && node.right < nodeCount
+                && -node.left <= nodeCount && -node.right <= nodeCount;
+            if (!valid) {
+                *errorMessage = QString("%1: tree refers past its nodes or features").arg(path);
+                return false;
+            }
+        }
+    }
+
+    *this = std::move(loaded);
+    return true;
+}
+
+void HaarCascade::scaleFeatures(int stride, std::vector<ScaledFeature> *scaled) const {
+    scaled->resize(m_features.size());
+    for (size_t i = 0; i < m_features.size(); ++i) {
+        const Feature& feature = m_features[i];
+        ScaledFeature& out = (*scaled)[i];
+        out.rectCount = feature.rectCount;
+        out.tilted = feature.tilted;
+        for (int r = 0; r < feature.rectCount; ++r) {
+            const Rect& rect = feature.rects[r];
+            int *o = out.offsets[r];
+            if (feature.tilted) {
+                o[0] = rect.x + stride * rect.y;
+                o[1] = rect.x - rect.height + stride * (rect.y + rect.height);
+                o[2] = rect.x + rect.width + stride * (rect.y + rect.width);
+                o[3] = rect.x + rect.width - rect.height + stride * (rect.y + rect.width + rect.height);
+            } else {
+                o[0] = rect.x + stride * rect.y;
+                o[1] = rect.x + rect.width + stride * rect.y;
+                o[2] = rect.x + stride * (rect.y + rect.height);
+                o[3] = rect.x + rect.width + stride * (rect.y + rect.height);
+            }
+            out.weights[r] = rect.weight;
+        }
+    }
+}
+
+bool HaarCascade::evaluate(const Level& level, const std::vector<ScaledFeature>& features, int x, int y) const {
+    // Features are compared against thresholds scaled by the window's
+    // contrast, so lighting doesn't matter
+    const int normalizedWidth = m_windowSize.width() - 2;
+    const int normalizedHeight = m_windowSize.height() - 2;
+    const double area = static_cast<double>(normalizedWidth) * normalizedHeight;
+    const double windowSum = level.rectSum(level.sum, x + 1, y + 1, normalizedWidth, normalizedHeight);
+    const double windowSquareSum = level.rectSum(level.squareSum, x + 1, y + 1, normalizedWidth, normalizedHeight);
+    double contrast = area * windowSquareSum - windowSum * windowSum;
+    contrast = contrast > 0.0 ? std::sqrt(contrast) : 1.0;
+    const float normalization = static_cast<float>(contrast);
+
+    const int base = y * level.stride + x;
+    const quint32 *sum = level.sum.data() + base;
+    const quint32 *tilted = m_hasTiltedFeatures ? level.tiltedSum.data() + base : nullptr;
+    for (const Stage& stage : m_stages) {
+        float stageSum = 0.0f;
+        for (int t = stage.firstTree; t < stage.firstTree + stage.treeCount; ++t) {
+            const Tree& tree = m_trees[t];
+            int index = 0;
+            do {
+                const Node& node = m_nodes[tree.firstNode + index];
+                const ScaledFeature& feature = features[node.feature];
+                const quint32 *table = feature.tilted ? tilted : sum;
+                float value = 0.0f;
+                for (int r = 0; r < feature.rectCount; ++r) {
+                    const int *o = feature.offsets[r];
+                    const qint32 rectSum = static_cast<qint32>(table[o[0]] - table[o[1]] - table[o[2]] + table[o[3]]);
+                    value += feature.weights[r] * rectSum;
+                }
+                index = value < node.threshold * normalization ? node.left : node.right;
+            } while (index > 0);
+            stageSum += m_leaves[tree.firstLeaf - index];
+        }
+        if (stageSum < stage.threshold - STAGE_THRESHOLD_EPSILON) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void HaarCascade::scanLevel(const Level& level, const std::vector<ScaledFeature>& features, double scale,
+                            int step, QList<QRect> *hits) const {
+    const QSize window(qRound(m_windowSize.width() * scale), qRound(m_windowSize.height() * scale));
+    for (int y = 0; y + m_windowSize.height() <= level.height; y += step) {
+        for (int x = 0; x + m_windowSize.width() <= level.width; x += step) {
+            if (evaluate(level, features, x, y)) {
+                hits->append(QRect(QPoint(qRound(x * scale), qRound(y * scale)), window));
+            }
+        }
+    }
+}
+
+QList<QRect> HaarCascade::detect(const QImage& image, const DetectOptions& options) const {
+    if (isEmpty() || image.isNull()) {
+        return QList<QRect>();
+    }
+    QImage base = image.format() == QImage::Format_Grayscale8 ? image
+                                                              : image.convertToFormat(QImage::Format_Grayscale8);
+    const double startScale = std::max({1.0, options.minSize.width() / static_cast<double>(m_windowSize.width()),
+                                        options.minSize.height() / static_cast<double>(m_windowSize.height())});
+    const double scaleFactor = std::max(1.01, options.scaleFactor);
+    int baseFactor = 1;
+
+    QList<QRect> hits;
+    std::vector<ScaledFeature> features;
+    int featureStride = -1;
+    for (double scale = startScale; ; scale *= scaleFactor) {
+        const QSize levelSize(qRound(image.width() / scale), qRound(image.height() / scale));
+        if (levelSize.width() < m_windowSize.width() || levelSize.height() < m_windowSize.height()) {
+            break;
+        }
+        if (options.maxSize.isValid() && (m_windowSize.width() * scale > options.maxSize.width() ||
+                                          m_windowSize.height() * scale > options.maxSize.height())) {
+            break;
+        }
+        // Box-halve first, so no level is interpolated over more than 2x
+        while (scale / baseFactor >= 2.0 && base.width() >= 2 * levelSize.width()) {
+            base = halve(base);
+            baseFactor *= 2;
+        }
+        const Level level(resizeBilinear(base, levelSize), m_hasTiltedFeatures);
+        if (level.stride != featureStride) {
+            scaleFeatures(level.stride, &features);
+            featureStride = level.stride;
+        }
+        // Two-pixel steps until the search has shrunk the image past twice
+        // its starting scale, as detectMultiScale() does from full size
+        scanLevel(level, features, scale, scale / startScale > 2.0 ? 1 : 2, &hits);
+    }
+    return options.minNeighbors > 0 ? groupRectangles(hits, options.minNeighbors) : hits;
+}
+
+QList<QRect> HaarCascade::groupRectangles(const QList<QRect>& rects, int minNeighbors, double eps) {
+    const int count = static_cast<int>(rects.size());
+    auto similar = [eps](const QRect& a, const QRect& b) {
+        const double delta = eps * (std::min(a.width(), b.width()) + std::min(a.height(), b.height())) * 0.5;
+        return std::abs(a.x() - b.x()) <= delta && std::abs(a.y() - b.y()) <= delta &&
+               std::abs(a.x() + a.width() - b.x() - b.width()) <= delta &&
+               std::abs(a.y() + a.height() - b.y() - b.height()) <= delta;
+    };
+
+    // Union-find over the similarity relation
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&parent](int i) {
+        while (parent[i] != i) {
+            i = parent[i] = parent[parent[i]];
+        }
+        return i;
+    };
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (similar(rects[i], rects[j])) {
+                parent[root(i)] = root(j);
+            }
+        }
+    }
+
+    struct Cluster {
+        qint64 x = 0, y = 0, width = 0, height = 0;
+        int members = 0;
+        QRect average;
+    };
+    std::vector<int> clusterOf(count, -1);
+    std::vector<Cluster> clusters;
+    for (int i = 0; i < count; ++i) {
+        const int r = root(i);
+        if (clusterOf[r] < 0) {
+            clusterOf[r] = static_cast<int>(clusters.size());
+            clusters.emplace_back();
+        }
+        Cluster& cluster = clusters[clusterOf[r]];
+        cluster.x += rects[i].x();
+        cluster.y += rects[i].y();
+        cluster.width += rects[i].width();
+        cluster.height += rects[i].height();
+        ++cluster.members;
+    }
+    for (Cluster& cluster : clusters) {
+        const double n = cluster.members;
+        cluster.average = QRect(qRound(cluster.x / n), qRound(cluster.y / n),
+                                qRound(cluster.width / n), qRound(cluster.height / n));
+    }
+
+    QList<QRect> grouped;
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        const Cluster& cluster = clusters[i];
+        if (cluster.members <= minNeighbors) {
+            continue;
+        }
+        const QRect& r1 = cluster.average;
+        bool nested = false;
+        for (size_t j = 0; j < clusters.size() && !nested; ++j) {
+            const Cluster& other = clusters[j];
+            if (j == i || other.members <= minNeighbors) {
+                continue;
+            }
+            const QRect& r2 = other.average;
+            const int dx = qRound(r2.width() * eps);
+            const int dy = qRound(r2.height() * eps);
+            nested = r1.x() >= r2.x() - dx && r1.y() >= r2.y() - dy &&
+                     r1.x() + r1.width() <= r2.x() + r2.width() + dx &&
+                     r1.y() + r1.height() <= r2.y() + r2.height() + dy &&
+                     (other.members > std::max(3, cluster.members) || cluster.members < 3);
+        }
+        if (!nested) {
+            grouped.append(r1);
+        }
+    }
+    return grouped;
+}
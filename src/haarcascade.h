@@ -0,0 +1,101 @@
+#ifndef HAARCASCADE_H
+#define HAARCASCADE_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <vector>
+
+// Viola-Jones detector for the boosted Haar cascades OpenCV ships, such as
+// haarcascade_frontalface_default.xml and haarcascade_smile.xml from the
+// opencv-data package. Only the XML format written by opencv_traincascade
+// (a <cascade> root, which is what OpenCV 3 and later install) is read;
+// LBP cascades and the pre-2.0 format are refused.
+//
+// detect() scans the image at a series of scales the way
+// CascadeClassifier::detectMultiScale() does: the image is shrunk rather
+// than the features grown, windows step two pixels below 2x reduction and
+// one above, and overlapping hits are merged by groupRectangles(). Scanning
+// starts at the scale where the window is minSize, so the full resolution
+// of a large frame is never searched. const and reentrant once loaded.
+class HaarCascade {
+public:
+    struct DetectOptions {
+        double scaleFactor = 1.2;
+        int minNeighbors = 3;       // Hits a detection needs; 0 returns them all unmerged
+        QSize minSize;              // Smallest object, in image pixels; empty for the window size
+        QSize maxSize;              // Largest object; empty for no limit
+    };
+
+    HaarCascade();
+
+    bool load(const QString& path, QString *errorMessage);
+    bool isEmpty() const { return m_stages.empty(); }
+    QSize windowSize() const { return m_windowSize; }
+    int stageCount() const { return static_cast<int>(m_stages.size()); }
+
+    // image is Format_Grayscale8; anything else is converted first
+    QList<QRect> detect(const QImage& image, const DetectOptions& options) const;
+
+    // OpenCV's groupRectangles(): clusters rects whose edges are all within
+    // eps of their size of each other, keeps clusters of more than
+    // minNeighbors, and drops small clusters inside larger ones
+    static QList<QRect> groupRectangles(const QList<QRect>& rects, int minNeighbors, double eps = 0.2);
+
+private:
+    struct Rect {
+        int x, y, width, height;
+        float weight;
+    };
+
+    struct Feature {
+        Rect rects[3];
+        int rectCount = 0;
+        bool tilted = false;
+    };
+
+    struct Node {
+        int feature;
+        float threshold;
+        int left;                   // > 0 another node of the tree, <= 0 minus a leaf index
+        int right;
+    };
+
+    struct Tree {
+        int firstNode;
+        int firstLeaf;
+    };
+
+    struct Stage {
+        int firstTree;
+        int treeCount;
+        float threshold;
+    };
+
+    // Feature rect corners as offsets into an integral image of one stride
+    struct ScaledFeature {
+        int offsets[3][4];
+        float weights[3];
+        int rectCount;
+        bool tilted;
+    };
+
+    struct Level;
+
+    void scaleFeatures(int stride, std::vector<ScaledFeature> *scaled) const;
+    void scanLevel(const Level& level, const std::vector<ScaledFeature>& features, double scale, int step,
+                   QList<QRect> *hits) const;
+    bool evaluate(const Level& level, const std::vector<ScaledFeature>& features, int x, int y) const;
+
+    QSize m_windowSize;
+    bool m_hasTiltedFeatures;
+    std::vector<Feature> m_features;
+    std::vector<Node> m_nodes;
+    std::vector<float> m_leaves;
+    std::vector<Tree> m_trees;
+    std::vector<Stage> m_stages;
+};
+
+#endif // HAARCASCADE_H
@@ -0,0 +1,342 @@
+#include "icamera.h"
+#include "photosaveservice.h"
+#include "boothlog.h"
+#include "framesubscriber.h"
+#include "colorfilter.h"
+#include "chromakeyer.h"
+#include "imagedownscaler.h"
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <QDebug>
+
+namespace {
+
+// The camera whose publishFrame() is running on this thread, if any
+thread_local ICamera *s_publishingCamera = nullptr;
+
+} // namespace
+
+ICamera::ICamera(QObject *parent)
+    : QObject(parent)
+    , m_burstTimer(new QTimer(this))
+{
+    m_burstTimer->setSingleShot(true);
+    connect(m_burstTimer, &QTimer::timeout, this, &ICamera::triggerBurstShot);
+
+    // Connected before anyone else so the burst state is current when
+    // other receivers see the same signal
+    connect(this, &ICamera::photoReady, this, &ICamera::onBurstPhotoReady);
+    connect(this, &ICamera::photoSaved, this, &ICamera::onBurstPhotoSaved);
+    connect(this, &ICamera::captureError, this, &ICamera::onBurstCaptureError);
+}
+
+ICamera::~ICamera() {
+    QMutexLocker locker(&m_subscriberMutex);
+    for (FrameSubscriber* subscriber : std::as_const(m_frameSubscribers)) {
+        subscriber->m_source = nullptr;
+    }
+    m_frameSubscribers.clear();
+}
+
+void ICamera::addFrameSubscriber(FrameSubscriber* subscriber) {
+    QMutexLocker locker(&m_subscriberMutex);
+    if (subscriber->m_source == this) {
+        return;
+    }
+    if (subscriber->m_source) {
+        // A subscriber follows one camera at a time
+        subscriber->m_source->removeFrameSubscriber(subscriber);
+    }
+    subscriber->m_source = this;
+    m_frameSubscribers.append(subscriber);
+}
+
+void ICamera::removeFrameSubscriber(FrameSubscriber* subscriber) {
+    QMutexLocker locker(&m_subscriberMutex);
+    if (m_frameSubscribers.removeOne(subscriber)) {
+        subscriber->m_source = nullptr;
+    }
+    // The subscriber may be about to be destroyed; let a publisher on another
+    // thread finish with it first. A publisher on this thread is the caller,
+    // and checks the list again before each offer.
+    if (s_publishingCamera != this) {
+        while (m_publishing > 0) {
+            m_publishDone.wait(&m_subscriberMutex);
+        }
+    }
+}
+
+bool ICamera::hasFrameSubscribers() const {
+    QMutexLocker locker(&m_subscriberMutex);
+    return !m_frameSubscribers.isEmpty();
+}
+
+CameraFrame ICamera::acquireFrame(int width, int height, CameraFrame::PixelFormat format) {
+    CameraFrame frame = m_framePool.acquire(width, height, format);
+    if (frame.isValid()) {
+        frame.setSequence(++m_frameSequence);
+        frame.setTimestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    return frame;
+}
+
+bool ICamera::publishImage(const QImage& image) {
+    QImage source = image;
+    CameraFrame::PixelFormat format = CameraFrame::fromImageFormat(source.format());
+    if (format == CameraFrame::Format_Invalid) {
+        source = source.convertToFormat(QImage::Format_RGB32);
+        format = CameraFrame::Format_RGB32;
+    }
+
+    CameraFrame frame = acquireFrame(source.width(), source.height(), format);
+    if (!frame.isValid()) {
+        return false;
+    }
+
+    const int rowBytes = std::min<qsizetype>(source.bytesPerLine(), frame.bytesPerLine(0));
+    for (int y = 0; y < source.height(); ++y) {
+        memcpy(frame.bits(0) + y * frame.bytesPerLine(0), source.constScanLine(y), rowBytes);
+    }
+    publishFrame(frame);
+    return true;
+}
+
+void ICamera::publishFrame(const CameraFrame& frame) {
+    if (!frame.isValid()) {
+        return;
+    }
+    QList<FrameSubscriber*> subscribers;
+    {
+        QMutexLocker locker(&m_subscriberMutex);
+        subscribers = m_frameSubscribers;
+        ++m_publishing;
+    }
+
+    ICamera *outer = s_publishingCamera;
+    s_publishingCamera = this;
+    for (FrameSubscriber* subscriber : std::as_const(subscribers)) {
+        {
+            // A slot run by an earlier offer may have unsubscribed it
+            QMutexLocker locker(&m_subscriberMutex);
+            if (!m_frameSubscribers.contains(subscriber)) {
+                continue;
+            }
+        }
+        subscriber->offer(frame);
+    }
+    s_publishingCamera = outer;
+
+    QMutexLocker locker(&m_subscriberMutex);
+    if (--m_publishing == 0) {
+        m_publishDone.wakeAll();
+    }
+}
+
+void ICamera::setColorLut(std::shared_ptr<const ColorLut> lut) {
+    QMutexLocker locker(&m_lookMutex);
+    m_colorLut = std::move(lut);
+}
+
+std::shared_ptr<const ColorLut> ICamera::colorLut() const {
+    QMutexLocker locker(&m_lookMutex);
+    return m_colorLut;
+}
+
+void ICamera::setBackdrop(const QImage& backdrop) {
+    QMutexLocker locker(&m_lookMutex);
+    m_backdrop = backdrop;
+}
+
+QImage ICamera::backdrop() const {
+    QMutexLocker locker(&m_lookMutex);
+    return m_backdrop;
+}
+
+bool ICamera::hasLook() const {
+    QMutexLocker locker(&m_lookMutex);
+    return m_colorLut || !m_backdrop.isNull();
+}
+
+QImage ICamera::lookedPreview(const QImage& frame) const {
+    const std::shared_ptr<const ColorLut> lut = colorLut();
+    const QImage backdrop = this->backdrop();
+    if (!lut && backdrop.isNull()) {
+        return QImage();
+    }
+    return finishPhoto(frame, backdrop, lut.get());
+}
+
+QImage ICamera::finishPhoto(const QImage& photo, const QImage& backdrop, const ColorLut *lut) {
+    QImage finished = photo;
+    if (!backdrop.isNull()) {
+        ChromaKeyer::instance()->composite(&finished, backdrop);
+    }
+    if (lut) {
+        ColorFilter::instance()->apply(&finished, *lut);
+    }
+    return finished;
+}
+
+bool ICamera::savePhotoAsync(const QImage& photo, const QString& filePath, int quality) {
+    PhotoSaveService* service = PhotoSaveService::instance();
+    connect(service, &PhotoSaveService::jobFinished, this, &ICamera::onSaveJobFinished, Qt::UniqueConnection);
+    connect(service, &PhotoSaveService::jobFailed, this, &ICamera::onSaveJobFailed, Qt::UniqueConnection);
+
+    quint64 jobId = service->submit(photo, filePath, QByteArray(), quality);
+    if (jobId == 0) {
+        emitCaptureError("Storage is busy, photo could not be saved");
+        return false;
+    }
+    m_pendingSaveJobs.insert(jobId);
+    return true;
+}
+
+void ICamera::deliverPhoto(const QImage& photo, const QString& filePath) {
+    QPointer<ICamera> guard(this);
+    const QSize decodeSize = photoDecodeSize();
+    // The look as it was when the shutter fired
+    const std::shared_ptr<const ColorLut> lut = colorLut();
+    const QImage backdrop = this->backdrop();
+    QThreadPool::globalInstance()->start([guard, photo, filePath, decodeSize, lut, backdrop]() {
+        const QImage finished = finishPhoto(photo, backdrop, lut.get());
+        QImage reduced = finished;
+        const QSize fitted = ImageDownscaler::fitSize(finished.size(), decodeSize);
+        if (fitted.isValid() && fitted.width() < finished.width()) {
+            reduced = ImageDownscaler::areaAverage(finished, fitted);
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, finished, reduced, filePath]() {
+            if (!guard) {
+                return;
+            }
+            guard->emitPhotoReady(reduced, filePath);
+            guard->savePhotoAsync(finished, filePath);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ICamera::onSaveJobFinished(quint64 jobId, const QString& filePath,
+                                qint64 queueUs, qint64 encodeUs, qint64 writeUs) {
+    if (!m_pendingSaveJobs.remove(jobId)) {
+        return; // Another camera's job
+    }
+    qCDebug(lcCamera) << "ICamera: Saved" << filePath << "queued" << queueUs / 1000 << "ms, encode"
+             << encodeUs / 1000 << "ms, write" << writeUs / 1000 << "ms";
+    emitPhotoSaved(filePath);
+}
+
+void ICamera::onSaveJobFailed(quint64 jobId, const QString& filePath, const QString& errorMessage) {
+    if (!m_pendingSaveJobs.remove(jobId)) {
+        return;
+    }
+    qCWarning(lcCamera) << "ICamera: Failed to save" << filePath << ":" << errorMessage;
+    emitCaptureError(errorMessage);
+}
+
+bool ICamera::startBurst(int shots, int intervalMs) {
+    if (isBurstActive() || shots < 1) {
+        return false;
+    }
+
+    qCDebug(lcCamera) << "ICamera: Starting burst of" << shots << "shots," << intervalMs << "ms apart";
+    m_burst = BurstState();
+    m_burst.shots = shots;
+    m_burst.intervalMs = qMax(0, intervalMs);
+    connect(PhotoSaveService::instance(), &PhotoSaveService::backpressureChanged,
+            this, &ICamera::onBurstBackpressureChanged, Qt::UniqueConnection);
+    triggerBurstShot();
+    return true;
+}
+
+void ICamera::cancelBurst() {
+    if (!isBurstActive()) {
+        return;
+    }
+    qCDebug(lcCamera) << "ICamera: Burst cancelled after" << m_burst.captured.size() << "of" << m_burst.shots << "shots";
+    m_burstTimer->stop();
+    m_burst = BurstState();
+}
+
+void ICamera::triggerBurstShot() {
+    if (!isBurstActive() || m_burst.triggered >= m_burst.shots) {
+        return;
+    }
+    if (PhotoSaveService::instance()->isSaturated()) {
+        // A shot now would only be refused by the save queue
+        m_burst.waitingForStorage = true;
+        return;
+    }
+    m_burst.waitingForStorage = false;
+    ++m_burst.triggered;
+    m_burst.sinceTrigger.start();
+    capturePhoto();
+}
+
+void ICamera::onBurstBackpressureChanged(bool saturated) {
+    if (!saturated && isBurstActive() && m_burst.waitingForStorage) {
+        triggerBurstShot();
+    }
+}
+
+void ICamera::onBurstPhotoReady(const QImage& photo, const QString& filePath) {
+    Q_UNUSED(photo)
+    onBurstShotCaptured(filePath);
+}
+
+void ICamera::onBurstPhotoSaved(const QString& filePath) {
+    if (!isBurstActive()) {
+        return;
+    }
+    // Every backend reports photoReady() first, so the shot is already counted
+    m_burst.saved.insert(filePath);
+    finishBurstIfSaved();
+}
+
+void ICamera::onBurstCaptureError(const QString& errorMessage) {
+    if (!isBurstActive()) {
+        return;
+    }
+    qCWarning(lcCamera) << "ICamera: Burst aborted after" << m_burst.captured.size() << "of" << m_burst.shots
+               << "shots:" << errorMessage;
+    m_burstTimer->stop();
+    m_burst = BurstState();
+    emit burstAborted(errorMessage);
+}
+
+void ICamera::onBurstShotCaptured(const QString& filePath) {
+    if (!isBurstActive() || m_burst.captured.contains(filePath)) {
+        return;
+    }
+
+    m_burst.captured.append(filePath);
+    const int shot = m_burst.captured.size();
+    emit burstShotTaken(shot, m_burst.shots, filePath);
+
+    if (m_burst.triggered < m_burst.shots) {
+        // The interval runs from trigger to trigger, so a slow shot eats into
+        // the wait rather than adding to it
+        m_burstTimer->start(qMax<qint64>(0, m_burst.intervalMs - m_burst.sinceTrigger.elapsed()));
+    }
+}
+
+void ICamera::finishBurstIfSaved() {
+    if (m_burst.captured.size() < m_burst.shots) {
+        return;
+    }
+    for (const QString& filePath : std::as_const(m_burst.captured)) {
+        if (!m_burst.saved.contains(filePath)) {
+            return;
+        }
+    }
+
+    const QStringList filePaths = m_burst.captured;
+    m_burst = BurstState();
+    qCDebug(lcCamera) << "ICamera: Burst finished," << filePaths.size() << "photos saved";
+    emit burstFinished(filePaths);
+}
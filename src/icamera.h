@@ -3,15 +3,30 @@
 
 #include <QObject>
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
+#include <QSize>
 #include <QString>
+#include <QSet>
+#include <QList>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include "cameraframe.h"
+#include "framepool.h"
+#include "colorlut.h"
+
+class FrameSubscriber;
+class QTimer;
 
 class ICamera : public QObject {
     Q_OBJECT
 
 public:
-    explicit ICamera(QObject *parent = nullptr) : QObject(parent) {}
-    virtual ~ICamera() = default;
+    explicit ICamera(QObject *parent = nullptr);
+    virtual ~ICamera();
 
     // Camera lifecycle
     virtual bool initialize() = 0;
@@ -27,17 +42,72 @@ public:
     virtual void capturePhoto() = 0;
     virtual void cancelCapture() = 0;
 
+    // Burst capture for photo strips: shots photos, triggered intervalMs apart.
+    // Each exposure is triggered as soon as the previous shot is in memory (or
+    // on disk, for backends that write the file themselves), so encoding and
+    // writing shot k overlaps exposure of shot k+1. A shot waits while the save
+    // queue is full. burstFinished() follows once every shot has been saved; a
+    // capture error aborts the burst.
+    bool startBurst(int shots, int intervalMs);
+    void cancelBurst();
+    bool isBurstActive() const { return m_burst.shots > 0; }
+
+    // Largest size anything will show the next photoReady() image at. Every
+    // backend hands photoReady() an image reduced to fit this (the Pi camera
+    // by decoding its file reduced, the others by scaling on a worker); the
+    // saved file keeps full resolution. An empty size keeps full size.
+    void setPhotoDecodeSize(const QSize& size) { m_photoDecodeSize = size; }
+    QSize photoDecodeSize() const { return m_photoDecodeSize; }
+
+    // Colour grade applied to the preview and baked into every photo from the
+    // next capture on; null turns grading off. Backends with their own preview
+    // widget grade each frame on the thread that produces it (lookedPreview()),
+    // so the widget only paints.
+    virtual void setColorLut(std::shared_ptr<const ColorLut> lut);
+    std::shared_ptr<const ColorLut> colorLut() const;
+
+    // Land put behind the guests in place of the green screen, likewise on
+    // the preview and every photo from the next capture on, keyed before the
+    // grade. A null image turns keying off.
+    virtual void setBackdrop(const QImage& backdrop);
+    QImage backdrop() const;
+
+    // Size of the frames the preview keys, so the backdrop can be scaled for
+    // it ahead of time; empty while that isn't known yet
+    virtual QSize previewFrameSize() const { return QSize(); }
+
+    // Frame delivery. Every subscriber gets a reference to the same pooled
+    // buffer; a subscriber that falls behind drops frames instead of stalling
+    // the camera. Subscribers detach themselves when destroyed. Frames are
+    // offered outside the subscriber lock, so a slot connected directly to
+    // frameAvailable() may subscribe and unsubscribe; removing a subscriber
+    // from another thread waits until no frame is being offered.
+    void addFrameSubscriber(FrameSubscriber* subscriber);
+    void removeFrameSubscriber(FrameSubscriber* subscriber);
+    bool hasFrameSubscribers() const;
+    FramePool::Statistics frameStatistics() const { return m_framePool.statistics(); }
+    double frameAllocationRate() { return m_framePool.allocationRate(); }
+
 signals:
-    void photoReady(const QPixmap& photo, const QString& filePath);
+    // Emitted with the decoded capture as soon as it exists in memory. The file at
+    // filePath may not have been written yet; photoSaved() follows once it has.
+    void photoReady(const QImage& photo, const QString& filePath);
+    void photoSaved(const QString& filePath);
     void captureError(const QString& errorMessage);
     void previewStarted();
     void previewStopped();
+    void burstShotTaken(int shot, int shots, const QString& filePath);
+    void burstFinished(const QStringList& filePaths);
+    void burstAborted(const QString& errorMessage);
 
 protected:
     // Helper for implementations to emit signals
-    void emitPhotoReady(const QPixmap& photo, const QString& filePath) {
+    void emitPhotoReady(const QImage& photo, const QString& filePath) {
         emit photoReady(photo, filePath);
     }
+    void emitPhotoSaved(const QString& filePath) {
+        emit photoSaved(filePath);
+    }
     void emitCaptureError(const QString& error) {
         emit captureError(error);
     }
@@ -47,6 +117,77 @@ protected:
     void emitPreviewStopped() {
         emit previewStopped();
     }
+
+    // Queues the encode and write on the shared PhotoSaveService. photoSaved()
+    // or captureError() is emitted when the job completes. Returns false if the
+    // save queue is full.
+    bool savePhotoAsync(const QImage& photo, const QString& filePath, int quality = 95);
+
+    // For backends that capture into memory: keys and grades photo with the
+    // current look and reduces it to fit photoDecodeSize() on a worker, then
+    // emits photoReady() with that and queues the full-size finished photo
+    // with savePhotoAsync(), so photoSaved() always comes after photoReady().
+    void deliverPhoto(const QImage& photo, const QString& filePath);
+
+    // The capture keyed onto backdrop and graded, or photo unchanged when
+    // neither is set. Workers that outlive the camera take the backdrop and
+    // LUT up front.
+    static QImage finishPhoto(const QImage& photo, const QImage& backdrop, const ColorLut *lut);
+
+    // A preview frame keyed and graded with the current look, or a null image
+    // when there is no look and the frame can be shown as it is. Call it on
+    // the thread producing the frames; frame itself is left untouched.
+    QImage lookedPreview(const QImage& frame) const;
+    bool hasLook() const;               // A backdrop or grade is set
+
+    // Producers fill a buffer from acquireFrame() and hand it to publishFrame();
+    // both may be called from any thread. acquireFrame() stamps the sequence
+    // number and capture time, and returns an invalid frame when consumers still
+    // hold every buffer, in which case the producer should skip that frame.
+    CameraFrame acquireFrame(int width, int height, CameraFrame::PixelFormat format);
+    void publishFrame(const CameraFrame& frame);
+
+    // Copies an already decoded image into a pooled frame and publishes it
+    bool publishImage(const QImage& image);
+
+private slots:
+    void onSaveJobFinished(quint64 jobId, const QString& filePath,
+                           qint64 queueUs, qint64 encodeUs, qint64 writeUs);
+    void onSaveJobFailed(quint64 jobId, const QString& filePath, const QString& errorMessage);
+    void onBurstPhotoReady(const QImage& photo, const QString& filePath);
+    void onBurstPhotoSaved(const QString& filePath);
+    void onBurstCaptureError(const QString& errorMessage);
+    void triggerBurstShot();
+    void onBurstBackpressureChanged(bool saturated);
+
+private:
+    struct BurstState {
+        int shots = 0;
+        int intervalMs = 0;
+        int triggered = 0;
+        bool waitingForStorage = false;
+        QStringList captured;
+        QSet<QString> saved;
+        QElapsedTimer sinceTrigger;
+    };
+
+    void onBurstShotCaptured(const QString& filePath);
+    void finishBurstIfSaved();
+
+    QSet<quint64> m_pendingSaveJobs;
+    QSize m_photoDecodeSize;
+    mutable QMutex m_lookMutex;         // Guards the grade and backdrop
+    std::shared_ptr<const ColorLut> m_colorLut;
+    QImage m_backdrop;
+    BurstState m_burst;
+    QTimer* m_burstTimer;
+
+    FramePool m_framePool;
+    std::atomic<quint64> m_frameSequence{0};
+    mutable QMutex m_subscriberMutex;
+    QWaitCondition m_publishDone;
+    QList<FrameSubscriber*> m_frameSubscribers;
+    int m_publishing = 0;               // publishFrame() calls offering frames now
 };
 
 #endif // ICAMERA_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "imagedecoder.h"
+#include "boothlog.h"
+#include <QDebug>
+#include <QImageIOHandler>
+#include <QImageReader>
+
+namespace {
+
+// libjpeg rounds scaled dimensions up
+int scaledDimension(int size, int denominator) {
+    return (size + denominator - 1) / denominator;
+}
+
+} // namespace
+
+int ImageDecoder::scaleDenominator(const QSize& source, const QSize& target) {
+    if (source.isEmpty() || target.isEmpty()) {
+        return 1;
+    }
+    const QSize fitted = source.scaled(target, Qt::KeepAspectRatio);
+    for (int denominator = 8; denominator > 1; denominator /= 2) {
+        if (scaledDimension(source.width(), denominator) >= fitted.width() &&
+            scaledDimension(source.height(), denominator) >= fitted.height()) {
+            return denominator;
+        }
+    }
+    return 1;
+}
+
+QImage ImageDecoder::read(const QString& filePath, const QSize& target) {
+    QImageReader reader(filePath);
+    const QSize source = reader.size();
+    const int denominator = scaleDenominator(source, target);
+    if (denominator > 1 && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        // Exactly libjpeg's 1/denominator output, so Qt doesn't rescale it
+        reader.setScaledSize(QSize(scaledDimension(source.width(), denominator),
+                                   scaledDimension(source.height(), denominator)));
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qCWarning(lcStorage) << "ImageDecoder: Failed to read" << filePath << ":" << reader.errorString();
+    }
+    return image;
+}
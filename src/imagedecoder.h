@@ -0,0 +1,27 @@
+#ifndef IMAGEDECODER_H
+#define IMAGEDECODER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+// Reads photos back from disk no larger than they will be shown. JPEG
+// decoders can scale by 1/2, 1/4 or 1/8 while decoding (libjpeg's
+// scale_denom, reached through QImageReader::setScaledSize), which skips
+// most of the IDCT work and never allocates the full-size image.
+//
+// The result still covers the target, so callers finish with
+// ImageDownscaler. Formats without decode-time scaling are read at full size.
+namespace ImageDecoder {
+
+// Largest of 1, 2, 4 or 8 that shrinks source while still covering the
+// KeepAspectRatio fit of source into target. An empty target means 1.
+int scaleDenominator(const QSize& source, const QSize& target);
+
+// An empty target reads the image at full size. Returns a null image and
+// logs a warning if the file can't be read.
+QImage read(const QString& filePath, const QSize& target = QSize());
+
+} // namespace ImageDecoder
+
+#endif // IMAGEDECODER_H
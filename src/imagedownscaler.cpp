@@ -0,0 +1,207 @@
+#include "imagedownscaler.h"
+#include "pixelmath.h"
+#include "simd.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Sums of up to 8x8 pixels stay within 16-bit accumulators
+const int MAX_BOX_FACTOR = 8;
+
+QImage packed32(const QImage& image) {
+    switch (image.format()) {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            return image;
+        case QImage::Format_ARGB32:
+            // Averaging straight alpha would bleed colour out of transparent pixels
+            return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        default:
+            return image.convertToFormat(QImage::Format_RGB32);
+    }
+}
+
+// Adds count pixels of a source row into 16-bit per-channel accumulators
+void accumulateRow(quint16 *acc, const quint32 *row, int count) {
+    int i = 0;
+#if defined(PHOTOBOOTH_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i *sums = reinterpret_cast<__m128i*>(acc + i * 4);
+        _mm_storeu_si128(sums, _mm_add_epi16(_mm_loadu_si128(sums), _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(sums + 1, _mm_add_epi16(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi8(pixels, zero)));
+    }
+#elif defined(PHOTOBOOTH_NEON)
+    for (; i + 4 <= count; i += 4) {
+        const uint8x16_t pixels = vreinterpretq_u8_u32(vld1q_u32(row + i));
+        quint16 *sums = acc + i * 4;
+        vst1q_u16(sums, vaddw_u8(vld1q_u16(sums), vget_low_u8(pixels)));
+        vst1q_u16(sums + 8, vaddw_u8(vld1q_u16(sums + 8), vget_high_u8(pixels)));
+    }
+#endif
+    for (; i < count; ++i) {
+        const quint32 pixel = row[i];
+        quint16 *sums = acc + i * 4;
+        sums[0] += pixel & 0xff;
+        sums[1] += (pixel >> 8) & 0xff;
+        sums[2] += (pixel >> 16) & 0xff;
+        sums[3] += pixel >> 24;
+    }
+}
+
+// Sums factor accumulated pixels per output pixel and divides by factor^2,
+// as (sum + factor^2 / 2) * multiplier >> 16 on every path. That is within
+// one level of the rounded average and exact for factors 2, 4 and 8.
+void collapseRow(const quint16 *acc, quint32 *out, int count, int factor) {
+    const int area = factor * factor;
+    const quint32 half = area / 2;
+    const quint32 multiplier = (65536 + area - 1) / area;
+
+    int i = 0;
+#if defined(PHOTOBOOTH_SSE2)
+    const __m128i halfv = _mm_set1_epi16(static_cast<short>(half));
+    const __m128i multiplierv = _mm_set1_epi16(static_cast<short>(multiplier));
+    for (; i < count; ++i) {
+        const quint16 *sums = acc + i * factor * 4;
+        __m128i sum = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sums));
+        for (int j = 1; j < factor; ++j) {
+            sum = _mm_add_epi16(sum, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sums + j * 4)));
+        }
+        sum = _mm_mulhi_epu16(_mm_add_epi16(sum, halfv), multiplierv);
+        out[i] = static_cast<quint32>(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+    }
+#elif defined(PHOTOBOOTH_NEON)
+    const uint16x4_t halfv = vdup_n_u16(static_cast<quint16>(half));
+    for (; i < count; ++i) {
+        const quint16 *sums = acc + i * factor * 4;
+        uint16x4_t sum = vld1_u16(sums);
+        for (int j = 1; j < factor; ++j) {
+            sum = vadd_u16(sum, vld1_u16(sums + j * 4));
+        }
+        const uint16x4_t scaled = vshrn_n_u32(vmull_n_u16(vadd_u16(sum, halfv), static_cast<quint16>(multiplier)), 16);
+        out[i] = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(scaled, scaled))), 0);
+    }
+#endif
+    for (; i < count; ++i) {
+        const quint16 *sums = acc + i * factor * 4;
+        quint32 pixel = 0;
+        for (int channel = 0; channel < 4; ++channel) {
+            quint32 sum = 0;
+            for (int j = 0; j < factor; ++j) {
+                sum += sums[j * 4 + channel];
+            }
+            pixel |= (((sum + half) * multiplier) >> 16) << (channel * 8);
+        }
+        out[i] = pixel;
+    }
+}
+
+// Averages factor x factor blocks. Leftover edge pixels are split evenly
+// between both sides so the image stays centred.
+QImage boxReduce(const QImage& source, int factor) {
+    const int width = source.width() / factor;
+    const int height = source.height() / factor;
+    const int x0 = (source.width() - width * factor) / 2;
+    const int y0 = (source.height() - height * factor) / 2;
+
+    QImage result(width, height, source.format());
+    if (result.isNull()) {
+        return QImage();
+    }
+
+    std::vector<quint16> acc(static_cast<size_t>(width) * factor * 4);
+    for (int y = 0; y < height; ++y) {
+        std::fill(acc.begin(), acc.end(), 0);
+        for (int row = 0; row < factor; ++row) {
+            const quint32 *line = reinterpret_cast<const quint32*>(source.constScanLine(y0 + y * factor + row));
+            accumulateRow(acc.data(), line + x0, width * factor);
+        }
+        collapseRow(acc.data(), reinterpret_cast<quint32*>(result.scanLine(y)), width, factor);
+    }
+    return result;
+}
+
+QImage bilinear(const QImage& source, const QSize& size) {
+    QImage result(size, source.format());
+    if (result.isNull()) {
+        return QImage();
+    }
+
+    std::vector<int> sourceX;
+    std::vector<quint32> weightX;
+    std::vector<int> sourceY;
+    std::vector<quint32> weightY;
+    PixelMath::buildSamplePositions(source.width(), size.width(), &sourceX, &weightX);
+    PixelMath::buildSamplePositions(source.height(), size.height(), &sourceY, &weightY);
+
+    for (int y = 0; y < size.height(); ++y) {
+        const quint32 wy = weightY[y];
+        const quint32 *top = reinterpret_cast<const quint32*>(source.constScanLine(sourceY[y]));
+        const quint32 *bottom = wy ? reinterpret_cast<const quint32*>(source.constScanLine(sourceY[y] + 1)) : top;
+        quint32 *out = reinterpret_cast<quint32*>(result.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const int sx = sourceX[x];
+            const quint32 wx = weightX[x];
+            const int sx1 = wx ? sx + 1 : sx;
+            out[x] = PixelMath::lerpPixel(PixelMath::lerpPixel(top[sx], top[sx1], wx),
+                                          PixelMath::lerpPixel(bottom[sx], bottom[sx1], wx), wy);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+QSize ImageDownscaler::fitSize(const QSize& source, const QSize& bound) {
+    if (source.isEmpty() || bound.isEmpty()) {
+        return QSize();
+    }
+    return source.scaled(bound, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+}
+
+QImage ImageDownscaler::nearest(const QImage& image, const QSize& size) {
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    const QImage source = packed32(image);
+    QImage result(size, source.format());
+    if (result.isNull()) {
+        return QImage();
+    }
+
+    std::vector<int> sourceX(size.width());
+    for (int x = 0; x < size.width(); ++x) {
+        sourceX[x] = static_cast<int>((2 * static_cast<qint64>(x) + 1) * source.width() / (2 * size.width()));
+    }
+    for (int y = 0; y < size.height(); ++y) {
+        const int sy = static_cast<int>((2 * static_cast<qint64>(y) + 1) * source.height() / (2 * size.height()));
+        const quint32 *in = reinterpret_cast<const quint32*>(source.constScanLine(sy));
+        quint32 *out = reinterpret_cast<quint32*>(result.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            out[x] = in[sourceX[x]];
+        }
+    }
+    return result;
+}
+
+QImage ImageDownscaler::areaAverage(const QImage& image, const QSize& size) {
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+
+    QImage current = packed32(image);
+    for (;;) {
+        const int factor = std::min({current.width() / size.width(), current.height() / size.height(),
+                                     MAX_BOX_FACTOR});
+        if (factor < 2) {
+            break;
+        }
+        current = boxReduce(current, factor);
+        if (current.isNull()) {
+            return QImage();
+        }
+    }
+    return current.size() == size ? current : bilinear(current, size);
+}
@@ -0,0 +1,28 @@
+#ifndef IMAGEDOWNSCALER_H
+#define IMAGEDOWNSCALER_H
+
+#include <QImage>
+#include <QSize>
+
+// Downscaling for the review screen, cheaper than QImage::scaled() with
+// Qt::SmoothTransformation for the photo sizes the booth sees.
+//
+// areaAverage() box-filters by whole factors (SSE2/NEON, see simd.h) until
+// the image is less than twice the target size, then finishes with a
+// bilinear pass, which averages every remaining source pixel at ratios below
+// two. Exact 2x, 3x and 4x reductions skip the bilinear pass entirely.
+// nearest() is a single lookup per output pixel, fast enough to show on the
+// GUI thread while areaAverage() runs on a worker.
+//
+// Both keep 32-bit images in their format and convert anything else to RGB32.
+namespace ImageDownscaler {
+
+// Largest size with the aspect ratio of source that fits in bound
+QSize fitSize(const QSize& source, const QSize& bound);
+
+QImage nearest(const QImage& image, const QSize& size);
+QImage areaAverage(const QImage& image, const QSize& size);
+
+} // namespace ImageDownscaler
+
+#endif // IMAGEDOWNSCALER_H
@@ -0,0 +1,193 @@
+#include "imagememory.h"
+#include "boothlog.h"
+#include <QMutexLocker>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Reclaimed from first to last: what's cheapest to rebuild goes first
+const ImageMemory::Subsystem RECLAIM_ORDER[] = {
+    ImageMemory::Effects,
+    ImageMemory::Print,
+    ImageMemory::Thumbnails,
+    ImageMemory::Review,
+    ImageMemory::Camera,
+};
+
+qint64 envBudget() {
+    bool ok = false;
+    const int megabytes = qEnvironmentVariableIntValue("PHOTOBOOTH_IMAGE_BUDGET_MB", &ok);
+    return static_cast<qint64>(ok && megabytes > 0 ? megabytes : 256) * 1024 * 1024;
+}
+
+double toMb(qint64 bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(ImageMemory, s_imageMemory, (envBudget()))
+
+ImageMemory::ImageMemory(qint64 budgetBytes, QObject *parent)
+    : QObject(parent)
+    , m_nextId(1)
+{
+    m_snapshot.budget = budgetBytes;
+    connect(&m_timer, &QTimer::timeout, this, &ImageMemory::check);
+}
+
+ImageMemory* ImageMemory::instance() {
+    return s_imageMemory();
+}
+
+const char* ImageMemory::subsystemName(Subsystem subsystem) {
+    switch (subsystem) {
+    case Camera:
+        return "camera";
+    case Review:
+        return "review";
+    case Thumbnails:
+        return "thumbnails";
+    case Effects:
+        return "effects";
+    case Print:
+        return "print";
+    default:
+        return "unknown";
+    }
+}
+
+qint64 ImageMemory::pixmapBytes(const QPixmap& pixmap) {
+    return static_cast<qint64>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
+
+int ImageMemory::addSource(Subsystem subsystem, const QString& name, Probe probe, Reclaimer reclaimer) {
+    QMutexLocker locker(&m_mutex);
+    const int id = m_nextId++;
+    m_sources.push_back({id, subsystem, name, std::move(probe), std::move(reclaimer)});
+    return id;
+}
+
+void ImageMemory::removeSource(int id) {
+    QMutexLocker locker(&m_mutex);
+    m_sources.erase(std::remove_if(m_sources.begin(), m_sources.end(),
+                                   [id](const Source& source) { return source.id == id; }),
+                    m_sources.end());
+}
+
+void ImageMemory::startMonitoring(int intervalMs) {
+    m_timer.start(intervalMs);
+}
+
+qint64 ImageMemory::budget() const {
+    QMutexLocker locker(&m_mutex);
+    return m_snapshot.budget;
+}
+
+bool ImageMemory::constrained() const {
+    QMutexLocker locker(&m_mutex);
+    return m_snapshot.constrained;
+}
+
+ImageMemory::Snapshot ImageMemory::snapshot() const {
+    QMutexLocker locker(&m_mutex);
+    return m_snapshot;
+}
+
+QString ImageMemory::summary() const {
+    const Snapshot current = snapshot();
+    QStringList parts;
+    for (int i = 0; i < SubsystemCount; ++i) {
+        parts << QString("%1 %2 MB (peak %3)")
+                     .arg(subsystemName(static_cast<Subsystem>(i)))
+                     .arg(toMb(current.subsystems[i].bytes), 0, 'f', 1)
+                     .arg(toMb(current.subsystems[i].highWater), 0, 'f', 1);
+    }
+    return QString("%1 of %2 MB (peak %3): %4")
+        .arg(toMb(current.total.bytes), 0, 'f', 1)
+        .arg(toMb(current.budget), 0, 'f', 0)
+        .arg(toMb(current.total.highWater), 0, 'f', 1)
+        .arg(parts.join(", "));
+}
+
+void ImageMemory::resetHighWater() {
+    QMutexLocker locker(&m_mutex);
+    for (Usage& usage : m_snapshot.subsystems) {
+        usage.highWater = usage.bytes;
+    }
+    m_snapshot.total.highWater = m_snapshot.total.bytes;
+}
+
+qint64 ImageMemory::sample(const std::vector<Source>& sources) {
+    // Probes take their owners' locks, so they run without ours
+    qint64 bytes[SubsystemCount] = {};
+    for (const Source& source : sources) {
+        bytes[source.subsystem] += std::max<qint64>(0, source.probe());
+    }
+
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (int i = 0; i < SubsystemCount; ++i) {
+        Usage& usage = m_snapshot.subsystems[i];
+        usage.bytes = bytes[i];
+        usage.highWater = std::max(usage.highWater, bytes[i]);
+        total += bytes[i];
+    }
+    m_snapshot.total.bytes = total;
+    m_snapshot.total.highWater = std::max(m_snapshot.total.highWater, total);
+    return total;
+}
+
+void ImageMemory::check() {
+    std::vector<Source> sources;
+    qint64 budget;
+    {
+        QMutexLocker locker(&m_mutex);
+        sources = m_sources;
+        budget = m_snapshot.budget;
+    }
+
+    qint64 total = sample(sources);
+    const qint64 target = static_cast<qint64>(budget * RECLAIM_TARGET);
+    if (total > budget) {
+        qint64 freed = 0;
+        for (Subsystem subsystem : RECLAIM_ORDER) {
+            for (const Source& source : sources) {
+                if (total - freed <= target) {
+                    break;
+                }
+                if (source.subsystem == subsystem && source.reclaimer) {
+                    const qint64 released = source.reclaimer(total - freed - target);
+                    if (released > 0) {
+                        qCDebug(lcStorage) << "ImageMemory: Reclaimed" << toMb(released) << "MB from" << source.name;
+                        freed += released;
+                    }
+                }
+            }
+        }
+        total = sample(sources);
+        QMutexLocker locker(&m_mutex);
+        ++m_snapshot.reclaims;
+        m_snapshot.reclaimedBytes += freed;
+    }
+
+    bool changed = false;
+    bool constrained = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        // Hysteresis: on at the budget, off once back under the target
+        constrained = m_snapshot.constrained ? total > target : total > budget;
+        changed = constrained != m_snapshot.constrained;
+        m_snapshot.constrained = constrained;
+    }
+    if (changed) {
+        if (constrained) {
+            qCWarning(lcStorage) << "ImageMemory: Over budget after reclaiming," << summary();
+        } else {
+            qCDebug(lcStorage) << "ImageMemory: Back under budget," << summary();
+        }
+        emit constrainedChanged(constrained);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef IMAGEMEMORY_H
+#define IMAGEMEMORY_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QPixmap>
+#include <QString>
+#include <QTimer>
+#include <functional>
+#include <vector>
+
+// Accounts for the pixel buffers the booth keeps alive, so a booth running
+// all day shows where image memory sits and stops growing before the OOM
+// killer steps in.
+//
+// Holders register a source: a probe that returns the bytes they hold now
+// and, for caches, a reclaimer that frees some of them. check() samples every
+// source, per subsystem and in total, and raises the high-water marks. Over
+// the budget (PHOTOBOOTH_IMAGE_BUDGET_MB, 256 by default) it calls the
+// reclaimers, effects caches first and the camera last, until usage is back
+// under RECLAIM_TARGET of the budget. If that isn't enough, constrained()
+// goes true until usage falls below the target again, and the UI keeps its
+// review images smaller meanwhile.
+//
+// The thumbnail store isn't a source: it is a file mapping the kernel can
+// drop at will. Probes and reclaimers are called on the thread running
+// check(), normally the GUI thread, and must be safe to call from there.
+class ImageMemory : public QObject {
+    Q_OBJECT
+
+public:
+    enum Subsystem {
+        Camera,         // Frame pools and photos waiting to be saved
+        Review,         // Review screen, strip shots and the print waiting for Continue
+        Thumbnails,     // Choice screen artwork
+        Effects,        // Keying backdrops and colour LUTs
+        Print,          // Compositor layers
+        SubsystemCount
+    };
+
+    using Probe = std::function<qint64()>;
+    using Reclaimer = std::function<qint64(qint64 bytes)>;   // Frees up to bytes, returns what it freed
+
+    struct Usage {
+        qint64 bytes = 0;
+        qint64 highWater = 0;
+    };
+
+    struct Snapshot {
+        Usage subsystems[SubsystemCount];
+        Usage total;
+        qint64 budget = 0;
+        bool constrained = false;
+        quint64 reclaims = 0;           // Times the budget had to be enforced
+        qint64 reclaimedBytes = 0;
+    };
+
+    // Fraction of the budget reclaiming aims for, and below which a
+    // constrained booth goes back to normal
+    static constexpr double RECLAIM_TARGET = 0.75;
+
+    explicit ImageMemory(qint64 budgetBytes, QObject *parent = nullptr);
+
+    static ImageMemory* instance();
+    static const char* subsystemName(Subsystem subsystem);
+    static qint64 imageBytes(const QImage& image) { return image.sizeInBytes(); }
+    static qint64 pixmapBytes(const QPixmap& pixmap);
+
+    // Returns an id for removeSource()
+    int addSource(Subsystem subsystem, const QString& name, Probe probe, Reclaimer reclaimer = Reclaimer());
+    void removeSource(int id);
+
+    // Runs check() every intervalMs on the calling thread
+    void startMonitoring(int intervalMs);
+
+    qint64 budget() const;
+    bool constrained() const;
+    Snapshot snapshot() const;          // As of the last check()
+    QString summary() const;
+    void resetHighWater();
+
+public slots:
+    void check();
+
+signals:
+    void constrainedChanged(bool constrained);
+
+private:
+    struct Source {
+        int id;
+        Subsystem subsystem;
+        QString name;
+        Probe probe;
+        Reclaimer reclaimer;
+    };
+
+    // Samples every source into m_snapshot; returns the total
+    qint64 sample(const std::vector<Source>& sources);
+
+    mutable QMutex m_mutex;
+    std::vector<Source> m_sources;
+    int m_nextId;
+    Snapshot m_snapshot;
+    QTimer m_timer;
+};
+
+#endif // IMAGEMEMORY_H
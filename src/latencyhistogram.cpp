@@ -0,0 +1,77 @@
+#include "latencyhistogram.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    : m_count(0)
+    , m_sumNs(0)
+    , m_maxNs(0)
+{
+    for (std::atomic<quint64>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(qint64 nanoseconds) {
+    quint64 value = static_cast<quint64>(std::max<qint64>(0, nanoseconds));
+    m_buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumNs.fetch_add(static_cast<qint64>(value), std::memory_order_relaxed);
+
+    qint64 previous = m_maxNs.load(std::memory_order_relaxed);
+    while (static_cast<qint64>(value) > previous &&
+           !m_maxNs.compare_exchange_weak(previous, static_cast<qint64>(value), std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<quint64>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sumNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::meanNs() const {
+    quint64 samples = count();
+    return samples ? static_cast<double>(m_sumNs.load(std::memory_order_relaxed)) / samples : 0.0;
+}
+
+qint64 LatencyHistogram::percentileNs(double percentile) const {
+    quint64 samples = count();
+    if (samples == 0) {
+        return 0;
+    }
+
+    quint64 target = static_cast<quint64>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * samples));
+    target = std::max<quint64>(1, target);
+
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min<qint64>(static_cast<qint64>(bucketMidpoint(i)), maxNs());
+        }
+    }
+    return maxNs();
+}
+
+int LatencyHistogram::bucketFor(quint64 value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<int>(value);
+    }
+    int msb = 63 - qCountLeadingZeroBits(value);
+    int shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+quint64 LatencyHistogram::bucketMidpoint(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<quint64>(index);
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    quint64 lower = static_cast<quint64>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((quint64(1) << shift) >> 1);
+}
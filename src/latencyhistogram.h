@@ -0,0 +1,39 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+
+// Fixed-size log-linear histogram of nanosecond latencies. Each power of two
+// is split into 16 linear sub-buckets, so percentiles are within ~6% of the
+// true value while record() is a handful of relaxed atomic increments and
+// never allocates. Safe to record from any thread.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(qint64 nanoseconds);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    qint64 maxNs() const { return m_maxNs.load(std::memory_order_relaxed); }
+    double meanNs() const;
+    // percentile in [0, 100]
+    qint64 percentileNs(double percentile) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = 64 * SUB_BUCKETS;
+
+    static int bucketFor(quint64 value);
+    static quint64 bucketMidpoint(int index);
+
+    std::array<std::atomic<quint64>, BUCKET_COUNT> m_buckets;
+    std::atomic<quint64> m_count;
+    std::atomic<qint64> m_sumNs;
+    std::atomic<qint64> m_maxNs;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -1,4 +1,7 @@
 #include "mainwindow.h"
+#include "capturelatencytracker.h"
+#include "startuptelemetry.h"
+#include "boothlog.h"
 #include <QApplication>
 #include <QtGlobal>   // For qputenv
 #include <QByteArray> // For QByteArray
@@ -6,6 +9,8 @@
 #include <QGuiApplication> // For platformName()
 
 int main(int argc, char *argv[]) {
+    StartupTelemetry::start();
+
     // For high DPI displays, if needed (Qt 6 usually handles this well)
     // QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     // QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
@@ -15,10 +20,17 @@ int main(int argc, char *argv[]) {
     qputenv("QT_IM_MODULE", QByteArray("qtvirtualkeyboard"));
 
     QApplication app(argc, argv);
+    StartupTelemetry::mark("qapplication");
+
+    // From here on logging is written out on a background thread
+    BoothLog::install();
 
     qDebug() << "Application is using QPA platform:" << QGuiApplication::platformName();
     qDebug() << "IM Module should be:" << qgetenv("QT_IM_MODULE").constData();
 
+    // kill -USR1 <pid> writes the capture latency summary without restarting
+    CaptureLatencyTracker::instance()->installExportSignalHandler();
+
     MainWindow w;
     w.showFullScreen(); // Show main window in full screen
 
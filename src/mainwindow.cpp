@@ -20,49 +20,305 @@
 #include <QWidget>
 #include "camerafactory.h"
 #include "icamera.h"
+#include "photosaveservice.h"
+#include "capturelatencytracker.h"
+#include "choicethumbnails.h"
+#include "startuptelemetry.h"
+#include "cameraloader.h"
+#include "photocompositor.h"
+#include "imagedownscaler.h"
+#include "sessionjournal.h"
+#include "photostorage.h"
+#include "thumbnailstore.h"
+#include "gallerymodel.h"
+#include "imagedecoder.h"
+#include "printqueue.h"
+#include "uploadqueue.h"
+#include "facetracker.h"
+#include "framingoverlay.h"
+#include "colorfilter.h"
+#include "chromakeyer.h"
+#include "imagememory.h"
+#include "boothlog.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <iterator>
 #include <QTimer>
+#include <QEvent>
+#include <QPainter>
+#include <QPointer>
+#include <QThreadPool>
+#include <QFileInfo>
+#include <QDir>
+#include <QListView>
+#include <QScroller>
+
+namespace {
+
+// Lets the soak benchmark run sessions without the on-screen delays
+int envDelay(const char* name, int defaultMs) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value >= 0 ? value : defaultMs;
+}
+
+// Shots stacked top to bottom on white, like a photo booth strip
+QImage buildPhotoStrip(const QList<QImage>& shots) {
+    const int margin = 12;
+    int width = 0;
+    int height = margin;
+    for (const QImage& shot : shots) {
+        width = std::max(width, shot.width());
+        height += shot.height() + margin;
+    }
+
+    QImage strip(width + 2 * margin, height, QImage::Format_RGB32);
+    strip.fill(Qt::white);
+    QPainter painter(&strip);
+    int y = margin;
+    for (const QImage& shot : shots) {
+        painter.drawImage(margin + (width - shot.width()) / 2, y, shot);
+        y += shot.height() + margin;
+    }
+    return strip;
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
+    m_stackedWidget(nullptr),
+    m_startButton(nullptr),
+    m_exitButton(nullptr),
+    m_nameLineEdit(nullptr),
+    m_submitNameButton(nullptr),
+    m_cameraPreviewWidget(nullptr),
+    m_countdownLabel(nullptr),
+    m_takePhotoButton(nullptr),
+    m_photoStripButton(nullptr),
+    m_retakeButton(nullptr),
+    m_capturedPhotoLabel(nullptr),
+    m_printStatusLabel(nullptr),
+    m_framingOverlay(nullptr),
+    m_firstFramePainted(false),
+    m_prebuildScreens(qEnvironmentVariable("PHOTOBOOTH_PREBUILD_SCREENS") != "0"),
+    m_cameraLoader(new CameraLoader(this)),
     m_countdownTimer(new QTimer(this)),
-    m_countdownValue(0) {
-        loadPersistentChoiceImages();
-        setupCamera();
+    m_countdownValue(0),
+    m_countdownIntervalMs(envDelay("PHOTOBOOTH_COUNTDOWN_TICK_MS", 1000)),
+    m_flashDelayMs(envDelay("PHOTOBOOTH_FLASH_DELAY_MS", 500)),
+    m_faceTracker(nullptr),
+    m_smileTrigger(qEnvironmentVariable("PHOTOBOOTH_SMILE_TRIGGER") == "1"),
+    m_waitingForSmiles(false),
+    m_smileStreak(0),
+    m_smileTimer(new QTimer(this)),
+    m_stripMode(false),
+    m_stripIntervalMs(envDelay("PHOTOBOOTH_STRIP_INTERVAL_MS", 1500)),
+    m_compositeGeneration(0),
+    m_compositeJobId(0),
+    m_compositePending(false),
+    m_printOnComposeGeneration(0),
+    m_reviewGeneration(0),
+    m_pendingRecordTimer(new QTimer(this)),
+    m_galleryModel(nullptr),
+    m_gallerySearch(nullptr),
+    m_galleryPages(nullptr),
+    m_galleryPreviewLabel(nullptr),
+    m_galleryPreviewCaption(nullptr),
+    m_galleryPreviewGeneration(0),
+    m_memoryConstrained(false) {
+        std::fill(std::begin(m_screens), std::end(m_screens), nullptr);
+
+        // Probe the camera while the first screen is built
+        connect(m_cameraLoader, &CameraLoader::ready, this, &MainWindow::onCameraLoaded);
+        connect(m_cameraLoader, &CameraLoader::failed, this, &MainWindow::onCameraLoadFailed);
+        m_cameraLoader->start();
+
+        connect(m_countdownTimer, &QTimer::timeout, this, &MainWindow::onCountdownTick);
+        m_smileTimer->setSingleShot(true);
+        m_smileTimer->setInterval(envDelay("PHOTOBOOTH_SMILE_WAIT_MS", 10000));
+        connect(m_smileTimer, &QTimer::timeout, this, &MainWindow::onSmileWaitTimeout);
+
+        // Hold off new captures while the SD card catches up
+        connect(PhotoSaveService::instance(), &PhotoSaveService::backpressureChanged,
+                this, &MainWindow::onSaveBackpressureChanged);
+        // A finished session waits for its print to be saved
+        connect(PhotoSaveService::instance(), &PhotoSaveService::jobFinished,
+                this, [this]() { recordPendingSessions(); });
+        m_pendingRecordTimer->setInterval(1000);
+        connect(m_pendingRecordTimer, &QTimer::timeout, this, [this]() { recordPendingSessions(); });
+
+        // Warn before the card fills, and stop offering what would fill it
+        connect(PhotoStorage::instance(), &PhotoStorage::spaceLevelChanged,
+                this, &MainWindow::onStorageSpaceChanged);
+        // Writes only see what the booth did itself; this picks up space
+        // freed (or used) by anything else, so a full card can recover
+        QTimer *storageTimer = new QTimer(this);
+        connect(storageTimer, &QTimer::timeout, this, []() {
+            QThreadPool::globalInstance()->start([]() { PhotoStorage::instance()->refresh(); });
+        });
+        const int storageCheckMs = envDelay("PHOTOBOOTH_STORAGE_CHECK_MS", 30000);
+        if (storageCheckMs > 0) {
+            storageTimer->start(storageCheckMs);
+        }
+
+        // Opening the journal recovers its tail, and the photo index scans the
+        // photos directory; keep both off the GUI thread
+        QThreadPool::globalInstance()->start([]() { SessionJournal::instance(); });
+        QThreadPool::globalInstance()->start([]() { PhotoStorage::instance()->refresh(); });
+        QThreadPool::globalInstance()->start([]() { ThumbnailStore::instance(); });
+
+        // The print queue reloads jobs left from the last run before it's used
+        QPointer<MainWindow> guard(this);
+        QThreadPool::globalInstance()->start([guard]() {
+            PrintQueue::instance();
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [guard]() {
+                if (guard) {
+                    guard->attachPrintQueue();
+                }
+            }, Qt::QueuedConnection);
+        });
+
         setupUi();
+        setupMemoryAccounting();
         setWindowTitle("Qt Photo Booth");
-
+        StartupTelemetry::mark("mainwindow_constructed");
     }
 
 
 MainWindow::~MainWindow() {
     // m_currentSessionData unique_ptr will automatically delete the object if it holds one.
     // Qt's parent-child system will delete UI widgets.
+    for (int source : m_memorySources) {
+        ImageMemory::instance()->removeSource(source);
+    }
     if (m_camera) {
         m_camera->stopPreview();
         m_camera->cleanup();
     }
+
+    // Don't lose photos that are still being written
+    if (!PhotoSaveService::instance()->waitForIdle(10000)) {
+        qCWarning(lcSession) << "Timed out waiting for photos to be saved";
+    }
+    recordPendingSessions(true);
+    if (!SessionJournal::instance()->waitForCommitted(5000)) {
+        qCWarning(lcSession) << "Timed out waiting for the session journal";
+    }
+    CaptureLatencyTracker::instance()->exportToFile();
 }
 
 void MainWindow::setupCamera() {
-    m_camera = CameraFactory::createCamera(CameraFactory::AUTO_DETECT, this);
-    
-    if (!m_camera->initialize()) {
-        qWarning() << "Failed to initialize camera, falling back to mock camera";
-        m_camera = CameraFactory::createCamera(CameraFactory::MOCK_CAMERA, this);
-        if (!m_camera->initialize()) {
-            qCritical() << "Failed to initialize even mock camera!";
-        }
-    }
-    
     // Connect camera signals
     connect(m_camera.get(), &ICamera::photoReady, this, &MainWindow::onCameraPhotoReady);
+    connect(m_camera.get(), &ICamera::photoSaved, this, &MainWindow::onCameraPhotoSaved);
     connect(m_camera.get(), &ICamera::captureError, this, &MainWindow::onCameraError);
-    
-    // Setup countdown timer
-    connect(m_countdownTimer, &QTimer::timeout, this, &MainWindow::onCountdownTick);
+    // The log file leaves out debug messages; keep the ones that led up to a failed capture
+    connect(m_camera.get(), &ICamera::captureError, this, [](const QString& errorMessage) {
+        if (BoothLog *log = BoothLog::instance()) {
+            log->requestDump("Capture error: " + errorMessage);
+        }
+    });
+    connect(m_camera.get(), &ICamera::burstShotTaken, this, &MainWindow::onBurstShotTaken);
+    connect(m_camera.get(), &ICamera::burstFinished, this, &MainWindow::onBurstFinished);
+    connect(m_camera.get(), &ICamera::burstAborted, this, &MainWindow::onBurstAborted);
+}
+
+void MainWindow::setupMemoryAccounting() {
+    ImageMemory *memory = ImageMemory::instance();
+    m_memorySources.push_back(memory->addSource(ImageMemory::Camera, "frame pool", [this]() {
+        return m_camera ? static_cast<qint64>(m_camera->frameStatistics().bytesHeld) : 0;
+    }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Camera, "save queue", []() {
+        return PhotoSaveService::instance()->queuedBytes();
+    }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Review, "review", [this]() {
+        qint64 bytes = ImageMemory::imageBytes(m_printImage);
+        for (const QImage& shot : std::as_const(m_stripShots)) {
+            bytes += ImageMemory::imageBytes(shot);
+        }
+        for (QLabel *label : {m_capturedPhotoLabel, m_galleryPreviewLabel}) {
+            if (label) {
+                bytes += ImageMemory::pixmapBytes(label->pixmap());
+            }
+        }
+        return bytes;
+    }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Thumbnails, "choice artwork", [this]() {
+        qint64 bytes = 0;
+        for (const auto& entry : m_selectableImages) {
+            bytes += ImageMemory::pixmapBytes(entry.second);
+        }
+        return bytes;
+    }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Effects, "backdrops",
+        []() { return ChromaKeyer::instance()->cacheBytes(); },
+        [](qint64) { return ChromaKeyer::instance()->trimCache(); }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Effects, "looks",
+        []() { return ColorFilter::instance()->cacheBytes(); },
+        [](qint64) { return ColorFilter::instance()->clearCache(); }));
+    m_memorySources.push_back(memory->addSource(ImageMemory::Print, "compositor layers",
+        []() { return PhotoCompositor::instance()->cacheBytes(); },
+        [](qint64) {
+            // Layers are rebuilt for the next guest's choices
+            const qint64 before = PhotoCompositor::instance()->cacheBytes();
+            PhotoCompositor::instance()->clearCache();
+            return before - PhotoCompositor::instance()->cacheBytes();
+        }));
+
+    connect(memory, &ImageMemory::constrainedChanged, this, [this](bool constrained) {
+        m_memoryConstrained = constrained;
+    });
+    memory->startMonitoring(envDelay("PHOTOBOOTH_IMAGE_CHECK_MS", 2000));
+}
+
+void MainWindow::onCameraLoaded() {
+    m_camera = m_cameraLoader->takeCamera();
+    setupCamera();
+
+    // Loads its cascades on its own thread; idle until the camera screen
+    m_faceTracker = FaceTracker::create(m_camera.get(), this);
+    if (m_faceTracker) {
+        connect(m_faceTracker, &FaceTracker::resultChanged, this, &MainWindow::onFacesChanged);
+    }
+
+    if (m_screens[CameraScreen]) {
+        attachCameraPreview();
+        // Someone got to the camera screen before the camera did
+        if (m_stackedWidget->currentWidget() == m_screens[CameraScreen] && m_capturedPhotoLabel->isHidden()) {
+            startCameraPreview();
+        }
+    }
+    emit cameraReady();
+}
+
+void MainWindow::onCameraLoadFailed(const QString& errorMessage) {
+    qCWarning(lcSession) << "Camera error:" << errorMessage;
+    if (QLabel *placeholder = qobject_cast<QLabel*>(m_cameraPreviewWidget)) {
+        placeholder->setText("Camera unavailable");
+    }
+}
+
+void MainWindow::attachCameraPreview() {
+    QWidget *preview = m_camera->getPreviewWidget();
+    preview->setMinimumSize(640, 480);
+    preview->setStyleSheet("border: 2px solid #333; background-color: black;");
+
+    if (m_cameraPreviewWidget) {
+        // Replace the placeholder shown while the camera was coming up
+        m_screens[CameraScreen]->layout()->replaceWidget(m_cameraPreviewWidget, preview);
+        preview->setVisible(!m_cameraPreviewWidget->isHidden());
+        m_cameraPreviewWidget->deleteLater();
+    }
+    m_cameraPreviewWidget = preview;
+    m_cameraPreviewWidget->installEventFilter(this); // Keeps the framing overlay on it
 }
 
 void MainWindow::loadPersistentChoiceImages() {
+    if (!m_selectableImages.empty()) {
+        return;
+    }
+
     const std::vector<std::pair<QString, int>> imageCategories = {
         {"weapon", 4},
         {"land", 4},
@@ -78,13 +334,20 @@ void MainWindow::loadPersistentChoiceImages() {
             QString imageKey = QString("%1%2").arg(categoryName).arg(i); 
             QString resourcePath = QString(":/%1.jpg").arg(imageKey);
 
+            // Pre-scaled at build time when available: no decode or resample
+            QImage thumbnail = ChoiceThumbnails::image(imageKey, QSize(iconWidth, iconHeight));
+            if (!thumbnail.isNull()) {
+                m_selectableImages[imageKey] = QPixmap::fromImage(thumbnail);
+                continue;
+            }
+
             QPixmap pixmap;
 
              if (pixmap.load(resourcePath)) {
                 m_selectableImages[imageKey] = pixmap.scaled(iconWidth, iconHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                qDebug() << "Loaded persistent image:" << resourcePath << "as key:" << imageKey;
+                qCDebug(lcUi) << "Loaded persistent image:" << resourcePath << "as key:" << imageKey;
             } else {
-                qWarning() << "Failed to load persistent image:" << resourcePath << "for key:" << imageKey;
+                qCWarning(lcUi) << "Failed to load persistent image:" << resourcePath << "for key:" << imageKey;
             }
         }
     }
@@ -92,23 +355,86 @@ void MainWindow::loadPersistentChoiceImages() {
 
 void MainWindow::setupUi() {
     m_stackedWidget = new QStackedWidget(this);
+    setCentralWidget(m_stackedWidget);
+
+    // Only the start screen is needed for the first frame. The rest, including
+    // camera bring-up, is built on first use or in the background once the
+    // start screen has painted. PHOTOBOOTH_EAGER_SCREENS=1 restores building
+    // everything up front, for start-up comparisons.
+    if (qEnvironmentVariable("PHOTOBOOTH_EAGER_SCREENS") == "1") {
+        for (int screen = StartScreen; screen < GalleryScreen; ++screen) {
+            ensureScreen(static_cast<Screen>(screen));
+        }
+    }
+    navigateTo(StartScreen);
+    m_screens[StartScreen]->installEventFilter(this);
+}
 
-    m_startScreenWidget = createStartScreen();
-    m_weaponChoiceScreenWidget = createChoiceScreen("Choose Your Weapon", "weapon", 4, SLOT(onWeaponSelected(QString)));
-    m_landChoiceScreenWidget = createChoiceScreen("Choose Your Land", "land", 4, SLOT(onLandSelected(QString)));
-    m_companionChoiceScreenWidget = createChoiceScreen("Choose Your Companion", "companion", 4, SLOT(onCompanionSelected(QString)));
-    m_nameEntryScreenWidget = createNameEntryScreen();
-    m_cameraScreenWidget = createCameraScreen(); 
+QWidget* MainWindow::ensureScreen(Screen screen) {
+    if (m_screens[screen]) {
+        return m_screens[screen];
+    }
 
-    m_stackedWidget->addWidget(m_startScreenWidget);
-    m_stackedWidget->addWidget(m_weaponChoiceScreenWidget);
-    m_stackedWidget->addWidget(m_landChoiceScreenWidget);
-    m_stackedWidget->addWidget(m_companionChoiceScreenWidget);
-    m_stackedWidget->addWidget(m_nameEntryScreenWidget);
-    m_stackedWidget->addWidget(m_cameraScreenWidget);
+    QElapsedTimer buildTimer;
+    buildTimer.start();
 
-    setCentralWidget(m_stackedWidget);
-    m_stackedWidget->setCurrentWidget(m_startScreenWidget); 
+    QWidget *widget = nullptr;
+    switch (screen) {
+    case StartScreen:
+        widget = createStartScreen();
+        widget->setObjectName("startScreen");
+        break;
+    case WeaponScreen:
+        loadPersistentChoiceImages();
+        widget = createChoiceScreen("Choose Your Weapon", "weapon", 4, SLOT(onWeaponSelected(QString)));
+        widget->setObjectName("weaponScreen");
+        break;
+    case LandScreen:
+        loadPersistentChoiceImages();
+        widget = createChoiceScreen("Choose Your Land", "land", 4, SLOT(onLandSelected(QString)));
+        widget->setObjectName("landScreen");
+        break;
+    case CompanionScreen:
+        loadPersistentChoiceImages();
+        widget = createChoiceScreen("Choose Your Companion", "companion", 4, SLOT(onCompanionSelected(QString)));
+        widget->setObjectName("companionScreen");
+        break;
+    case NameScreen:
+        widget = createNameEntryScreen();
+        widget->setObjectName("nameScreen");
+        break;
+    case CameraScreen:
+        widget = createCameraScreen();
+        widget->setObjectName("cameraScreen");
+        break;
+    case GalleryScreen:
+        widget = createGalleryScreen();
+        widget->setObjectName("galleryScreen");
+        break;
+    default:
+        return nullptr;
+    }
+
+    m_screens[screen] = widget;
+    m_stackedWidget->addWidget(widget);
+    qCDebug(lcUi) << "Built screen" << widget->objectName() << "in" << buildTimer.elapsed() << "ms";
+    return widget;
+}
+
+void MainWindow::navigateTo(Screen screen) {
+    m_stackedWidget->setCurrentWidget(ensureScreen(screen));
+}
+
+void MainWindow::prebuildNextScreen() {
+    // One screen per event loop pass so touches on the start screen stay responsive
+    for (int screen = StartScreen; screen < GalleryScreen; ++screen) {
+        if (!m_screens[screen]) {
+            ensureScreen(static_cast<Screen>(screen));
+            QTimer::singleShot(0, this, &MainWindow::prebuildNextScreen);
+            return;
+        }
+    }
+    StartupTelemetry::mark("screens_prebuilt");
 }
 
 QWidget* MainWindow::createStartScreen() {
@@ -117,6 +443,7 @@ QWidget* MainWindow::createStartScreen() {
     layout->setContentsMargins(50, 50, 50, 50); // Add some padding
 
     m_startButton = new QPushButton("START PHOTO BOOTH", widget);
+    m_startButton->setObjectName("startButton");
     m_startButton->setMinimumSize(300, 100); // Make button larger
 
     QFont startFont = m_startButton->font();
@@ -125,14 +452,25 @@ QWidget* MainWindow::createStartScreen() {
     connect(m_startButton, &QPushButton::clicked, this, &MainWindow::onStartButtonClicked);
 
     m_exitButton = new QPushButton("EXIT", widget);
+    m_exitButton->setObjectName("exitButton");
     m_exitButton->setMinimumSize(100, 100);
     QFont exitFont = m_exitButton->font();
     exitFont.setPointSize(16);
     connect(m_exitButton, &QPushButton::clicked, this, &MainWindow::onExitButtonClicked);
 
+    QPushButton *galleryButton = new QPushButton("GALLERY", widget);
+    galleryButton->setObjectName("galleryButton");
+    galleryButton->setMinimumSize(100, 100);
+    connect(galleryButton, &QPushButton::clicked, this, &MainWindow::onGalleryButtonClicked);
+
+    QHBoxLayout *operatorLayout = new QHBoxLayout();
+    operatorLayout->addStretch();
+    operatorLayout->addWidget(galleryButton);
+    operatorLayout->addWidget(m_exitButton);
+
     layout->addStretch(); 
     layout->addWidget(m_startButton, 0, Qt::AlignCenter);
-    layout->addWidget(m_exitButton, 0, Qt::AlignTop | Qt::AlignRight);
+    layout->addLayout(operatorLayout);
     layout->addStretch();
 
     widget->setLayout(layout);
@@ -163,6 +501,7 @@ QWidget* MainWindow::createChoiceScreen(
         QString imageKey = QString("%1%2").arg(categoryPrefix).arg(i);
         if (m_selectableImages.count(imageKey)) {
             QPushButton *button = new QPushButton(widget);
+            button->setObjectName(imageKey);
             const QPixmap& pixmap = m_selectableImages.at(imageKey);
             button->setIcon(QIcon(pixmap));
             button->setIconSize(pixmap.size()); 
@@ -185,7 +524,7 @@ QWidget* MainWindow::createChoiceScreen(
             }
             imageButtonsLayout->addWidget(button, 0, Qt::AlignCenter); // Center button in its cell
         } else {
-            qWarning() << "Image key not found in m_selectableImages:" << imageKey;
+            qCWarning(lcUi) << "Image key not found in m_selectableImages:" << imageKey;
         }
     }
 
@@ -211,12 +550,14 @@ QWidget* MainWindow::createNameEntryScreen() {
     namePromptLabel->setAlignment(Qt::AlignCenter);
 
     m_nameLineEdit = new QLineEdit(widget);
+    m_nameLineEdit->setObjectName("nameLineEdit");
     m_nameLineEdit->setMinimumHeight(60);
     m_nameLineEdit->setFont(promptFont);
     m_nameLineEdit->setAlignment(Qt::AlignCenter);
     m_nameLineEdit->setPlaceholderText("Your Name");
 
     m_submitNameButton = new QPushButton("Next", widget);
+    m_submitNameButton->setObjectName("submitNameButton");
     m_submitNameButton->setMinimumSize(200, 80);
     m_submitNameButton->setFont(promptFont);
     connect(m_submitNameButton, &QPushButton::clicked, this, &MainWindow::onNameSubmitButtonClicked);
@@ -237,10 +578,18 @@ QWidget* MainWindow::createCameraScreen() {
     mainLayout->setContentsMargins(20, 20, 20, 20);
     mainLayout->setSpacing(20);
 
-    // Get camera preview widget
-    m_cameraPreviewWidget = m_camera->getPreviewWidget();
-    m_cameraPreviewWidget->setMinimumSize(640, 480);
-    m_cameraPreviewWidget->setStyleSheet("border: 2px solid #333; background-color: black;");
+    // Camera preview, or a placeholder until the camera has come up
+    if (m_camera) {
+        attachCameraPreview();
+    } else {
+        QLabel *placeholder = new QLabel(widget);
+        placeholder->setObjectName("cameraPlaceholder");
+        placeholder->setAlignment(Qt::AlignCenter);
+        placeholder->setText(m_cameraLoader->state() == CameraLoader::Failed ? "Camera unavailable" : "Starting camera...");
+        placeholder->setMinimumSize(640, 480);
+        placeholder->setStyleSheet("border: 2px solid #333; background-color: black; color: white; font-size: 24px;");
+        m_cameraPreviewWidget = placeholder;
+    }
 
     // Countdown label (overlay on preview)
     m_countdownLabel = new QLabel(widget);
@@ -260,15 +609,29 @@ QWidget* MainWindow::createCameraScreen() {
 
     // Captured photo display (hidden initially)
     m_capturedPhotoLabel = new QLabel(widget);
+    m_capturedPhotoLabel->setObjectName("capturedPhotoLabel");
     m_capturedPhotoLabel->setAlignment(Qt::AlignCenter);
     m_capturedPhotoLabel->setMinimumSize(640, 480);
     m_capturedPhotoLabel->setStyleSheet("border: 2px solid #333;");
     m_capturedPhotoLabel->hide();
+    m_capturedPhotoLabel->installEventFilter(this);
+
+    // Shown only while prints are running behind
+    m_printStatusLabel = new QLabel(widget);
+    m_printStatusLabel->setObjectName("printStatusLabel");
+    m_printStatusLabel->setAlignment(Qt::AlignCenter);
+    m_printStatusLabel->setStyleSheet("color: #FF9800; font-size: 18px;");
+    m_printStatusLabel->hide();
+
+    // Framing guide and face boxes (overlay on preview)
+    m_framingOverlay = new FramingOverlay(widget);
+    m_framingOverlay->hide();
 
     // Buttons
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     
     m_takePhotoButton = new QPushButton("Take Photo", widget);
+    m_takePhotoButton->setObjectName("takePhotoButton");
     m_takePhotoButton->setMinimumSize(200, 80);
     m_takePhotoButton->setStyleSheet(
         "QPushButton { "
@@ -283,7 +646,24 @@ QWidget* MainWindow::createCameraScreen() {
     );
     connect(m_takePhotoButton, &QPushButton::clicked, this, &MainWindow::onTakePhotoButtonClicked);
 
+    m_photoStripButton = new QPushButton("Photo Strip", widget);
+    m_photoStripButton->setObjectName("photoStripButton");
+    m_photoStripButton->setMinimumSize(200, 80);
+    m_photoStripButton->setStyleSheet(
+        "QPushButton { "
+        "background-color: #9C27B0; "
+        "color: white; "
+        "border: none; "
+        "border-radius: 10px; "
+        "font-size: 18px; "
+        "font-weight: bold; "
+        "} "
+        "QPushButton:pressed { background-color: #7B1FA2; }"
+    );
+    connect(m_photoStripButton, &QPushButton::clicked, this, &MainWindow::onPhotoStripButtonClicked);
+
     m_retakeButton = new QPushButton("Retake", widget);
+    m_retakeButton->setObjectName("retakeButton");
     m_retakeButton->setMinimumSize(150, 80);
     m_retakeButton->setStyleSheet(
         "QPushButton { "
@@ -299,6 +679,7 @@ QWidget* MainWindow::createCameraScreen() {
     connect(m_retakeButton, &QPushButton::clicked, this, &MainWindow::onRetakeButtonClicked);
 
     QPushButton *continueButton = new QPushButton("Continue", widget);
+    continueButton->setObjectName("continueButton");
     continueButton->setMinimumSize(150, 80);
     continueButton->setStyleSheet(
         "QPushButton { "
@@ -311,10 +692,11 @@ QWidget* MainWindow::createCameraScreen() {
         "QPushButton:pressed { background-color: #1976D2; }"
     );
     continueButton->hide(); // Hidden until photo is taken
-    connect(continueButton, &QPushButton::clicked, this, &MainWindow::returnToStartScreen);
+    connect(continueButton, &QPushButton::clicked, this, &MainWindow::onContinueButtonClicked);
 
     buttonLayout->addStretch();
     buttonLayout->addWidget(m_takePhotoButton);
+    buttonLayout->addWidget(m_photoStripButton);
     buttonLayout->addWidget(m_retakeButton);
     buttonLayout->addWidget(continueButton);
     buttonLayout->addStretch();
@@ -322,22 +704,118 @@ QWidget* MainWindow::createCameraScreen() {
     // Layout assembly
     mainLayout->addWidget(m_cameraPreviewWidget);
     mainLayout->addWidget(m_capturedPhotoLabel);
+    mainLayout->addWidget(m_printStatusLabel);
     mainLayout->addLayout(buttonLayout);
 
-    // Position countdown label as overlay
+    // Position countdown label as overlay, above the framing guide
+    m_framingOverlay->raise();
     m_countdownLabel->setParent(widget);
     m_countdownLabel->raise();
 
     return widget;
 }
 
+QWidget* MainWindow::createGalleryScreen() {
+    QWidget *widget = new QWidget();
+    QVBoxLayout *mainLayout = new QVBoxLayout(widget);
+    mainLayout->setContentsMargins(20, 20, 20, 20);
+    mainLayout->setSpacing(10);
+
+    ThumbnailStore *store = ThumbnailStore::instance();
+
+    QHBoxLayout *searchLayout = new QHBoxLayout();
+    m_gallerySearch = new QLineEdit(widget);
+    m_gallerySearch->setObjectName("gallerySearch");
+    m_gallerySearch->setPlaceholderText("Search by name or time (e.g. 14:3)");
+    m_gallerySearch->setMinimumHeight(50);
+    m_gallerySearch->setClearButtonEnabled(true);
+    QFont searchFont = m_gallerySearch->font();
+    searchFont.setPointSize(16);
+    m_gallerySearch->setFont(searchFont);
+
+    QPushButton *backButton = new QPushButton("Back", widget);
+    backButton->setObjectName("galleryBackButton");
+    backButton->setMinimumSize(120, 50);
+    connect(backButton, &QPushButton::clicked, this, [this]() {
+        if (QApplication::inputMethod()->isVisible()) {
+            QApplication::inputMethod()->hide();
+        }
+        navigateTo(StartScreen);
+    });
+
+    searchLayout->addWidget(m_gallerySearch, 1);
+    searchLayout->addWidget(backButton);
+
+    // Grid of every photo taken. The view only lays out and paints the rows
+    // on screen, so it stays smooth however large the store gets.
+    m_galleryModel = new GalleryModel(store, widget);
+    QListView *view = new QListView(widget);
+    view->setObjectName("galleryView");
+    view->setViewMode(QListView::IconMode);
+    view->setResizeMode(QListView::Adjust);
+    view->setMovement(QListView::Static);
+    view->setUniformItemSizes(true);
+    view->setLayoutMode(QListView::Batched);
+    view->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    view->setSelectionMode(QAbstractItemView::SingleSelection);
+    view->setModel(m_galleryModel);
+    view->setItemDelegate(new GalleryDelegate(store, view));
+    QScroller::grabGesture(view->viewport(), QScroller::LeftMouseButtonGesture);
+    connect(view, &QListView::clicked, this, &MainWindow::onGalleryItemClicked);
+    connect(m_gallerySearch, &QLineEdit::textChanged, m_galleryModel, &GalleryModel::setFilter);
+
+    // Full-size preview of the selected photo
+    QWidget *previewPage = new QWidget(widget);
+    QVBoxLayout *previewLayout = new QVBoxLayout(previewPage);
+    m_galleryPreviewLabel = new QLabel(previewPage);
+    m_galleryPreviewLabel->setObjectName("galleryPreviewLabel");
+    m_galleryPreviewLabel->setAlignment(Qt::AlignCenter);
+    m_galleryPreviewLabel->setMinimumSize(640, 480);
+    m_galleryPreviewCaption = new QLabel(previewPage);
+    m_galleryPreviewCaption->setAlignment(Qt::AlignCenter);
+    m_galleryPreviewCaption->setStyleSheet("font-size: 18px;");
+    QPushButton *gridButton = new QPushButton("Back to gallery", previewPage);
+    gridButton->setObjectName("galleryGridButton");
+    gridButton->setMinimumSize(200, 60);
+    connect(gridButton, &QPushButton::clicked, this, [this]() {
+        ++m_galleryPreviewGeneration;
+        m_galleryPages->setCurrentIndex(0);
+    });
+    previewLayout->addWidget(m_galleryPreviewLabel, 1);
+    previewLayout->addWidget(m_galleryPreviewCaption);
+    previewLayout->addWidget(gridButton, 0, Qt::AlignCenter);
+
+    m_galleryPages = new QStackedWidget(widget);
+    m_galleryPages->addWidget(view);
+    m_galleryPages->addWidget(previewPage);
+
+    mainLayout->addLayout(searchLayout);
+    mainLayout->addWidget(m_galleryPages, 1);
+    return widget;
+}
+
 void MainWindow::startCameraPreview() {
+    m_cameraPreviewWidget->show();
+    m_capturedPhotoLabel->hide();
+    m_takePhotoButton->show();
+    m_photoStripButton->show();
+    m_retakeButton->hide();
+
+    // Without a camera the placeholder stays up; onCameraLoaded() comes back here
+    setCaptureButtonsEnabled(m_camera && !PhotoSaveService::instance()->isSaturated());
     if (m_camera) {
+        // The guest's land behind them and its look, live on the preview and
+        // baked into the photos
+        const QString landId = m_currentSessionData ? m_currentSessionData->chosenLandId : QString();
+        const bool keyed = !landId.isEmpty() && ChromaKeyer::instance()->isEnabled();
+        m_camera->setBackdrop(keyed ? ChromaKeyer::instance()->landBackdrop(landId) : QImage());
+        m_camera->setColorLut(ColorFilter::instance()->lut(ColorFilter::lookForLand(landId)));
         m_camera->startPreview();
-        m_cameraPreviewWidget->show();
-        m_capturedPhotoLabel->hide();
-        m_takePhotoButton->show();
-        m_retakeButton->hide();
+    }
+    if (m_faceTracker) {
+        m_faceTracker->setActive(true);
+        placeFramingOverlay();
+        m_framingOverlay->show();
     }
 }
 
@@ -346,9 +824,51 @@ void MainWindow::stopCameraPreview() {
         m_camera->stopPreview();
     }
     stopCountdown();
+    stopSmileWait();
+    if (m_faceTracker) {
+        m_faceTracker->setActive(false);
+        m_framingOverlay->hide();
+    }
+}
+
+void MainWindow::placeFramingOverlay() {
+    if (m_framingOverlay && m_cameraPreviewWidget) {
+        m_framingOverlay->setGeometry(m_cameraPreviewWidget->geometry());
+    }
+}
+
+void MainWindow::startCaptureTrigger() {
+    // Without a smile cascade nothing would ever smile; count down instead
+    if (m_smileTrigger && m_faceTracker && m_faceTracker->isReady() && m_faceTracker->detectsSmiles()) {
+        startSmileWait();
+    } else {
+        startCountdown();
+    }
+}
+
+void MainWindow::startSmileWait() {
+    // The link and the SD card belong to the camera until the shot is saved
+    UploadQueue::instance()->setPaused(true);
+    m_waitingForSmiles = true;
+    m_smileStreak = 0;
+    m_framingOverlay->setShowHints(true);
+    m_smileTimer->start();
+    setCaptureButtonsEnabled(false);
+}
+
+void MainWindow::stopSmileWait() {
+    if (!m_waitingForSmiles) {
+        return;
+    }
+    m_waitingForSmiles = false;
+    m_smileTimer->stop();
+    m_framingOverlay->setShowHints(false);
+    setCaptureButtonsEnabled(m_camera && !PhotoSaveService::instance()->isSaturated());
 }
 
 void MainWindow::startCountdown() {
+    // The link and the SD card belong to the camera until the shot is saved
+    UploadQueue::instance()->setPaused(true);
     m_countdownValue = COUNTDOWN_SECONDS;
     m_countdownLabel->setText(QString::number(m_countdownValue));
     m_countdownLabel->show();
@@ -362,82 +882,220 @@ void MainWindow::startCountdown() {
         labelSize, labelSize
     );
     
-    m_countdownTimer->start(1000); // 1 second intervals
-    m_takePhotoButton->setEnabled(false);
+    m_countdownTimer->start(m_countdownIntervalMs); // 1 second intervals by default
+    setCaptureButtonsEnabled(false);
 }
 
 void MainWindow::stopCountdown() {
     m_countdownTimer->stop();
     m_countdownLabel->hide();
-    m_takePhotoButton->setEnabled(true);
+    setCaptureButtonsEnabled(m_camera && !PhotoSaveService::instance()->isSaturated());
 }
 
 void MainWindow::capturePhoto() {
-    if (m_camera) {
+    if (!m_camera) {
+        return;
+    }
+    if (PhotoStorage::instance()->spaceLevel() == PhotoStorage::SpaceCritical) {
+        // Look again before turning the guest away; room may have been made
+        // since the last check
+        PhotoStorage::instance()->refresh();
+    }
+    if (PhotoStorage::instance()->spaceLevel() == PhotoStorage::SpaceCritical) {
+        m_stripMode = false;
+        onCameraError("Storage is full");
+        return;
+    }
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::CaptureRequested);
+    m_reviewPaths.clear();
+    if (m_stripMode) {
+        // Strip shots are only ever shown STRIP_SHOT_WIDTH wide
+        m_camera->setPhotoDecodeSize(QSize(STRIP_SHOT_WIDTH, QWIDGETSIZE_MAX));
+        m_stripShots.clear();
+        if (!m_camera->startBurst(STRIP_SHOTS, m_stripIntervalMs)) {
+            m_stripMode = false;
+            onCameraError("Photo strip already in progress");
+        }
+    } else if (m_memoryConstrained) {
+        // Short of image memory the print makes do with the review size;
+        // the full-size photo is still saved
+        qCDebug(lcSession) << "Image memory over budget, decoding the photo at review size";
+        m_camera->setPhotoDecodeSize(m_capturedPhotoLabel->size());
+        m_camera->capturePhoto();
+    } else {
+        // Both the review screen and the print show a single shot
+        m_camera->setPhotoDecodeSize(m_capturedPhotoLabel->size().expandedTo(
+            QSize(PhotoCompositor::PHOTO_BOX_WIDTH, PhotoCompositor::PHOTO_BOX_HEIGHT)));
         m_camera->capturePhoto();
     }
 }
 
+void MainWindow::setCaptureButtonsEnabled(bool enabled) {
+    // Short of space, single shots only; nearly full, nothing
+    const PhotoStorage::SpaceLevel space = PhotoStorage::instance()->spaceLevel();
+    m_takePhotoButton->setEnabled(enabled && space != PhotoStorage::SpaceCritical);
+    m_photoStripButton->setEnabled(enabled && space == PhotoStorage::SpaceOk);
+}
+
+QString MainWindow::takePhotoButtonText(bool saving) const {
+    if (PhotoStorage::instance()->spaceLevel() == PhotoStorage::SpaceCritical) {
+        return "Storage Full";
+    }
+    return saving ? "Saving..." : "Take Photo";
+}
+
 // --- SLOTS ---
 void MainWindow::onStartButtonClicked() {
-    qDebug() << "Start button clicked.";
+    qCDebug(lcSession) << "Start button clicked.";
     startNewSession();
-    if (m_stackedWidget->widget(1)) { // Go to weapon choice screen
-        m_stackedWidget->setCurrentIndex(1);
-    }
+    navigateTo(WeaponScreen);
 }
 void MainWindow::onExitButtonClicked() {
-    qDebug() << "Exit button clicked.";
+    qCDebug(lcSession) << "Exit button clicked.";
     QApplication::closeAllWindows();
     QApplication::quit();
 }
+void MainWindow::onGalleryButtonClicked() {
+    qCDebug(lcSession) << "Gallery button clicked.";
+    navigateTo(GalleryScreen);
+    m_galleryPages->setCurrentIndex(0);
+}
+void MainWindow::onGalleryItemClicked(const QModelIndex& index) {
+    const int slot = index.data(GalleryModel::SlotRole).toInt();
+    const QString filePath = index.data(GalleryModel::PhotoPathRole).toString();
+    const QDateTime captureTime = index.data(GalleryModel::CaptureTimeRole).toDateTime();
+
+    m_galleryPages->setCurrentIndex(1);
+    m_galleryPreviewCaption->setText(index.data(Qt::DisplayRole).toString() + " - " +
+                                     captureTime.toString("yyyy-MM-dd hh:mm"));
+
+    // The thumbnail stands in, blown up, while the photo itself is decoded
+    const QSize target = m_galleryPreviewLabel->size();
+    const QImage thumbnail = ThumbnailStore::instance()->thumbnail(slot);
+    if (!thumbnail.isNull()) {
+        m_galleryPreviewLabel->setPixmap(QPixmap::fromImage(
+            thumbnail.scaled(target, Qt::KeepAspectRatio, Qt::FastTransformation)));
+    } else {
+        m_galleryPreviewLabel->clear();
+    }
+
+    const quint64 generation = ++m_galleryPreviewGeneration;
+    QPointer<MainWindow> guard(this);
+    QThreadPool::globalInstance()->start([guard, filePath, target, generation]() {
+        QImage image = ImageDecoder::read(filePath, target);
+        if (!image.isNull()) {
+            image = ImageDownscaler::areaAverage(image, ImageDownscaler::fitSize(image.size(), target));
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, image, generation]() {
+            if (guard) {
+                guard->onGalleryPreviewLoaded(image, generation);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onGalleryPreviewLoaded(const QImage& image, quint64 generation) {
+    // Dropped if the guest has moved on to another photo or back to the grid
+    if (generation != m_galleryPreviewGeneration) {
+        return;
+    }
+    if (image.isNull()) {
+        m_galleryPreviewCaption->setText(m_galleryPreviewCaption->text() + " (photo missing)");
+        return;
+    }
+    m_galleryPreviewLabel->setPixmap(QPixmap::fromImage(image));
+}
 void MainWindow::onWeaponSelected(const QString& weaponId) {
-    qDebug() << "Weapon Selected: " << weaponId;
+    qCDebug(lcSession) << "Weapon Selected: " << weaponId;
      if (m_currentSessionData){ 
             m_currentSessionData->chosenWeaponId = weaponId;
         }
-    m_stackedWidget->setCurrentIndex(2);
+    navigateTo(LandScreen);
 }
 
 void MainWindow::onLandSelected(const QString& landId) {
-    qDebug() << "Land Selected: " << landId;
+    qCDebug(lcSession) << "Land Selected: " << landId;
      if (m_currentSessionData){ 
             m_currentSessionData->chosenLandId = landId;
         }
-    m_stackedWidget->setCurrentIndex(3);
+    if (ChromaKeyer::instance()->isEnabled()) {
+        // Decoded, and scaled for the preview frames, while the guest picks a
+        // companion and types their name
+        const QSize previewSize = m_camera ? m_camera->previewFrameSize() : QSize();
+        QThreadPool::globalInstance()->start([landId, previewSize]() {
+            ChromaKeyer *keyer = ChromaKeyer::instance();
+            keyer->prepareBackdrop(keyer->landBackdrop(landId), previewSize);
+        });
+    }
+    navigateTo(CompanionScreen);
 }
 
 void MainWindow::onCompanionSelected(const QString& companionId) {
-    qDebug() << "Companion Selected: " << companionId;
+    qCDebug(lcSession) << "Companion Selected: " << companionId;
      if (m_currentSessionData){ 
             m_currentSessionData->chosenCompanionId = companionId;
         }
-    m_stackedWidget->setCurrentIndex(4); // Go to Name Entry Screen 
+    navigateTo(NameScreen); // Go to Name Entry Screen 
     if (m_nameLineEdit) m_nameLineEdit->setFocus(); // Focus keyboard 
 }
 
 void MainWindow::onNameSubmitButtonClicked() {
-    qDebug() << "Submit name button clicked.";
+    qCDebug(lcSession) << "Submit name button clicked.";
     processNameEntry();
     // For now, just log and go back to start. Later, this will go to camera preview.
     if (m_currentSessionData) {
-        qDebug() << "Session Data Collected: User -" << m_currentSessionData->userName
+        qCDebug(lcSession) << "Session Data Collected: User -" << m_currentSessionData->userName
                  << ", Weapon -" << m_currentSessionData->chosenWeaponId
                  << ", Land -" << m_currentSessionData->chosenLandId
                  << ", Companion -" << m_currentSessionData->chosenCompanionId
                  << ", Started at -" << m_currentSessionData->startTime.toString();
     }
-    m_stackedWidget->setCurrentIndex(5);
+    navigateTo(CameraScreen);
     startCameraPreview();
+
+    // Scale the chosen art for the print while the guest lines up the shot
+    if (m_currentSessionData) {
+        const QString landId = m_currentSessionData->chosenLandId;
+        const QString weaponId = m_currentSessionData->chosenWeaponId;
+        const QString companionId = m_currentSessionData->chosenCompanionId;
+        QThreadPool::globalInstance()->start([landId, weaponId, companionId]() {
+            PhotoCompositor::instance()->prepare(landId, weaponId, companionId);
+        });
+    }
 }
 
 void MainWindow::onTakePhotoButtonClicked() {
-    qDebug() << "Take photo button clicked";
-    startCountdown();
+    qCDebug(lcSession) << "Take photo button clicked";
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::TakePhotoPressed);
+    m_stripMode = false;
+    startCaptureTrigger();
+}
+
+void MainWindow::onPhotoStripButtonClicked() {
+    qCDebug(lcSession) << "Photo strip button clicked";
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::TakePhotoPressed);
+    m_stripMode = true;
+    startCaptureTrigger();
 }
 
 void MainWindow::onRetakeButtonClicked() {
-    qDebug() << "Retake button clicked";
+    qCDebug(lcSession) << "Retake button clicked";
+    ++m_compositeGeneration; // The guest rejected that photo; don't print it
+    m_compositeJobId = 0;
+    m_compositePending = false;
+    m_printImage = QImage();
+
+    // Unclaimed, so free to be evicted when space runs short
+    for (const QString& filePath : std::as_const(m_reviewPaths)) {
+        PhotoStorage::instance()->discard(filePath);
+    }
+    m_retakenPaths.append(m_reviewPaths);
+    m_reviewPaths.clear();
+    if (m_currentSessionData) {
+        m_currentSessionData->capturedPhotoPath.clear();
+        m_currentSessionData->stripPhotoPaths.clear();
+        m_currentSessionData->compositePhotoPath.clear();
+    }
     startCameraPreview();
 }
 
@@ -448,41 +1106,207 @@ void MainWindow::onCountdownTick() {
         m_countdownLabel->setText(QString::number(m_countdownValue));
     } else {
         // Countdown finished, take photo
+        CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::CountdownFinished);
         stopCountdown();
-        m_countdownLabel->setText("📸");
-        m_countdownLabel->show();
-        
-        // Brief delay to show camera icon, then capture
-        QTimer::singleShot(500, this, [this]() {
-            m_countdownLabel->hide();
-            capturePhoto();
-        });
+        flashAndCapture();
     }
 }
 
-void MainWindow::onCameraPhotoReady(const QPixmap& photo, const QString& filePath) {
-    qDebug() << "Photo captured successfully:" << filePath;
-    
-    // Store photo in session data
+void MainWindow::flashAndCapture() {
+    m_countdownLabel->setText("📸");
+    m_countdownLabel->show();
+
+    // Brief delay to show camera icon, then capture
+    QTimer::singleShot(m_flashDelayMs, this, [this]() {
+        m_countdownLabel->hide();
+        capturePhoto();
+    });
+}
+
+void MainWindow::onFacesChanged() {
+    if (!m_faceTracker || !m_framingOverlay) {
+        return;
+    }
+    const FaceTracker::Result result = m_faceTracker->result();
+    m_framingOverlay->setResult(result);
+    if (!m_waitingForSmiles) {
+        return;
+    }
+
+    // A few detections in a row, so one lucky frame mid-blink doesn't count
+    const bool ready = result.everyoneInside(FramingOverlay::guideRegion()) && result.everyoneSmiling();
+    m_smileStreak = ready ? m_smileStreak + 1 : 0;
+    if (m_smileStreak >= SMILE_STREAK) {
+        qCDebug(lcSession) << "Everyone framed and smiling," << result.faces.size() << "faces";
+        CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::CountdownFinished);
+        stopSmileWait();
+        setCaptureButtonsEnabled(false);
+        flashAndCapture();
+    }
+}
+
+void MainWindow::onSmileWaitTimeout() {
+    qCDebug(lcSession) << "No smiles in time, counting down instead";
+    stopSmileWait();
+    startCountdown();
+}
+
+void MainWindow::onCameraPhotoReady(const QImage& photo, const QString& filePath) {
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::PhotoReady);
+    qCDebug(lcSession) << "Photo captured successfully:" << filePath;
+    // Usage peaks around a capture; don't wait for the next check to see it
+    ImageMemory::instance()->check();
+    m_reviewPaths.append(filePath);
+    // Recorded now, while the file may still be saving; recordSession()
+    // waits for it to land if the guest leaves first
     if (m_currentSessionData) {
-        m_currentSessionData->capturedPhotoPath = filePath;
+        if (m_stripMode) {
+            m_currentSessionData->stripPhotoPaths.append(filePath);
+        } else {
+            m_currentSessionData->capturedPhotoPath = filePath;
+        }
     }
-    
+
+    // The gallery thumbnail is made now, from the photo already in memory,
+    // so the gallery never has to decode a full-size JPEG
+    const QString guestName = m_currentSessionData ? m_currentSessionData->userName : QString();
+    const QDateTime captureTime = QDateTime::currentDateTime();
+    QThreadPool::globalInstance()->start([photo, filePath, guestName, captureTime]() {
+        ThumbnailStore::instance()->add(photo, filePath, guestName, captureTime);
+    });
+
+    if (m_stripMode) {
+        // Keep the preview up between shots; only a strip-sized copy is kept
+        m_stripShots.append(ImageDownscaler::areaAverage(
+            photo, ImageDownscaler::fitSize(photo.size(), QSize(STRIP_SHOT_WIDTH, photo.height()))));
+        if (m_stripShots.size() < STRIP_SHOTS) {
+            return;
+        }
+        m_stripMode = false;
+        showReview(buildPhotoStrip(m_stripShots));
+        m_stripShots.clear();
+        return;
+    }
+    showReview(photo);
+    composeSessionPhoto(photo, filePath);
+}
+
+void MainWindow::composeSessionPhoto(const QImage& photo, const QString& filePath) {
+    if (!m_currentSessionData) {
+        return;
+    }
+
+    PhotoCompositor::Request request;
+    request.photo = photo;
+    request.landId = m_currentSessionData->chosenLandId;
+    request.weaponId = m_currentSessionData->chosenWeaponId;
+    request.companionId = m_currentSessionData->chosenCompanionId;
+    request.caption = m_currentSessionData->userName;
+
+    const QFileInfo info(filePath);
+    const QString printPath = info.absoluteDir().absoluteFilePath(info.completeBaseName() + "_print.jpg");
+    const quint64 generation = ++m_compositeGeneration;
+    m_compositePending = true;
+    m_printImage = QImage();
+    m_reviewPaths.append(printPath);
+    m_currentSessionData->compositePhotoPath = printPath;
+
+    QPointer<MainWindow> guard(this);
+    QThreadPool::globalInstance()->start([guard, request, printPath, generation]() {
+        QImage composite = PhotoCompositor::instance()->compose(request);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, composite, printPath, generation]() {
+            if (guard) {
+                guard->onCompositeReady(composite, printPath, generation);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onCompositeReady(const QImage& composite, const QString& filePath, quint64 generation) {
+    // The guest pressed Continue before it was ready
+    if (generation == m_printOnComposeGeneration) {
+        m_printOnComposeGeneration = 0;
+        queuePrint(composite, m_printGuestName);
+        m_printGuestName.clear();
+    }
+    if (generation != m_compositeGeneration || composite.isNull()) {
+        // The guest has gone, but their print still belongs in their session
+        for (PendingRecord& record : m_pendingRecords) {
+            if (record.compositeGeneration != generation) {
+                continue;
+            }
+            record.compositeGeneration = 0;
+            if (composite.isNull() || PhotoSaveService::instance()->submit(composite, filePath) == 0) {
+                record.entry.printPath.clear();
+                recordPendingSessions();
+            }
+            break;
+        }
+        return;
+    }
+    m_compositePending = false;
+    if (m_currentSessionData) {
+        m_printImage = composite;
+    }
+
+    if (m_capturedPhotoLabel->isVisible()) {
+        setReviewImage(composite);
+    }
+    m_compositeJobId = PhotoSaveService::instance()->submit(composite, filePath);
+    if (m_compositeJobId == 0) {
+        qCWarning(lcSession) << "Save queue full, print not saved:" << filePath;
+    }
+}
+
+void MainWindow::setReviewImage(const QImage& image) {
+    const QSize size = ImageDownscaler::fitSize(image.size(), m_capturedPhotoLabel->size());
+    if (size.isEmpty()) {
+        return;
+    }
+
+    // A nearest-neighbour copy goes up straight away; the area-averaged one
+    // replaces it once a worker has finished it
+    m_capturedPhotoLabel->setPixmap(QPixmap::fromImage(ImageDownscaler::nearest(image, size)));
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::ReviewScaled);
+
+    const quint64 generation = ++m_reviewGeneration;
+    QPointer<MainWindow> guard(this);
+    QThreadPool::globalInstance()->start([guard, image, size, generation]() {
+        QImage scaled = ImageDownscaler::areaAverage(image, size);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, scaled, generation]() {
+            if (guard) {
+                guard->onReviewImageScaled(scaled, generation);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onReviewImageScaled(const QImage& image, quint64 generation) {
+    // Dropped if a newer image, such as the print composite, replaced it
+    if (generation != m_reviewGeneration || image.isNull() || !m_capturedPhotoLabel->isVisible()) {
+        return;
+    }
+    m_capturedPhotoLabel->setPixmap(QPixmap::fromImage(image));
+}
+
+void MainWindow::showReview(const QImage& photo) {
     // Hide preview, show captured photo
+    m_countdownLabel->hide();
     m_cameraPreviewWidget->hide();
-    m_capturedPhotoLabel->setPixmap(photo.scaled(
-        m_capturedPhotoLabel->size(), 
-        Qt::KeepAspectRatio, 
-        Qt::SmoothTransformation
-    ));
+    if (m_faceTracker) {
+        m_faceTracker->setActive(false);
+        m_framingOverlay->hide();
+    }
+    setReviewImage(photo);
     m_capturedPhotoLabel->show();
     
     // Update button visibility
     m_takePhotoButton->hide();
+    m_photoStripButton->hide();
     m_retakeButton->show();
     
     // Show continue button
-    QWidget* cameraScreen = m_cameraScreenWidget;
+    QWidget* cameraScreen = m_screens[CameraScreen];
     QList<QPushButton*> buttons = cameraScreen->findChildren<QPushButton*>();
     for (QPushButton* button : buttons) {
         if (button->text() == "Continue") {
@@ -492,8 +1316,138 @@ void MainWindow::onCameraPhotoReady(const QPixmap& photo, const QString& filePat
     }
 }
 
+void MainWindow::onCameraPhotoSaved(const QString& filePath) {
+    CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::PhotoSaved);
+    qCDebug(lcSession) << "Photo saved:" << filePath;
+
+    // The session it belongs to may have ended while it was saving
+    recordPendingSessions();
+    // A strip's remaining shots still need the link and the card;
+    // onBurstFinished() resumes uploads after the last one
+    if (!m_camera || !m_camera->isBurstActive()) {
+        UploadQueue::instance()->setPaused(false);
+    }
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == m_screens[StartScreen] && event->type() == QEvent::Paint && !m_firstFramePainted) {
+        m_firstFramePainted = true;
+        StartupTelemetry::mark("first_frame");
+        emit firstFramePainted();
+        if (m_prebuildScreens) {
+            // Paint has not been flushed yet; start after it reaches the screen
+            QTimer::singleShot(0, this, &MainWindow::prebuildNextScreen);
+        }
+    }
+    // First paint of the review image closes the capture-to-review span
+    if (watched == m_capturedPhotoLabel && event->type() == QEvent::Paint) {
+        CaptureLatencyTracker::instance()->mark(CaptureLatencyTracker::ReviewPainted);
+    }
+    if (watched == m_cameraPreviewWidget && (event->type() == QEvent::Resize || event->type() == QEvent::Move)) {
+        placeFramingOverlay();
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::onSaveBackpressureChanged(bool saturated) {
+    qCDebug(lcSession) << "Photo save queue" << (saturated ? "saturated" : "drained");
+    if (!m_takePhotoButton) {
+        return;
+    }
+    if (!m_countdownTimer->isActive() && !m_waitingForSmiles) {
+        setCaptureButtonsEnabled(m_camera && !saturated);
+    }
+    m_takePhotoButton->setText(takePhotoButtonText(saturated));
+}
+
+void MainWindow::onStorageSpaceChanged(PhotoStorage::SpaceLevel level, qint64 bytesAvailable) {
+    qCDebug(lcSession) << "Photo storage" << level << "," << bytesAvailable / (1024 * 1024) << "MB free";
+    if (!m_takePhotoButton) {
+        return;
+    }
+    const bool saturated = PhotoSaveService::instance()->isSaturated();
+    if (!m_countdownTimer->isActive() && !m_waitingForSmiles) {
+        setCaptureButtonsEnabled(m_camera && !saturated);
+    }
+    m_takePhotoButton->setText(takePhotoButtonText(saturated));
+}
+
+void MainWindow::attachPrintQueue() {
+    PrintQueue *queue = PrintQueue::instance();
+    connect(queue, &PrintQueue::depthChanged, this, &MainWindow::onPrintQueueChanged);
+    connect(queue, &PrintQueue::delayedChanged, this, &MainWindow::onPrintQueueChanged);
+    qCDebug(lcSession) << "Printing to" << queue->sinkName() << "," << queue->depth() << "prints queued";
+    onPrintQueueChanged();
+}
+
+void MainWindow::onPrintQueueChanged() {
+    if (!m_printStatusLabel) {
+        return;
+    }
+    // Guests are told rather than kept waiting; the session carries on
+    PrintQueue *queue = PrintQueue::instance();
+    if (!queue->isDelayed()) {
+        m_printStatusLabel->hide();
+        return;
+    }
+    const PrintQueue::Statistics stats = queue->statistics();
+    if (stats.depth >= queue->capacity()) {
+        m_printStatusLabel->setText("Print queue full - new prints paused");
+    } else {
+        const qint64 minutes = std::max<qint64>(1, (stats.estimatedWaitMs + 30000) / 60000);
+        m_printStatusLabel->setText(QString("Prints delayed (about %1 min)").arg(minutes));
+    }
+    m_printStatusLabel->show();
+}
+
+void MainWindow::queuePrint(const QImage& page, const QString& guestName) {
+    if (page.isNull() || !PrintQueue::instance()->isEnabled()) {
+        return;
+    }
+    if (PrintQueue::instance()->submit(page, guestName) == 0) {
+        qCWarning(lcSession) << "Print queue full, not printing for" << guestName;
+    }
+}
+
+void MainWindow::onContinueButtonClicked() {
+    // Strips have no print composite, so only single shots are printed
+    if (m_currentSessionData) {
+        if (!m_printImage.isNull()) {
+            queuePrint(m_printImage, m_currentSessionData->userName);
+        } else if (m_compositePending) {
+            m_printOnComposeGeneration = m_compositeGeneration;
+            m_printGuestName = m_currentSessionData->userName;
+        }
+    }
+    returnToStartScreen();
+}
+
+void MainWindow::onBurstShotTaken(int shot, int shots, const QString& filePath) {
+    qCDebug(lcSession) << "Photo strip shot" << shot << "of" << shots << ":" << filePath;
+    if (shot < shots) {
+        m_countdownLabel->setText(QString("%1/%2").arg(shot + 1).arg(shots));
+        m_countdownLabel->show();
+    }
+}
+
+void MainWindow::onBurstFinished(const QStringList& filePaths) {
+    qCDebug(lcSession) << "Photo strip saved:" << filePaths;
+    if (m_currentSessionData && !filePaths.isEmpty() && !m_retakenPaths.contains(filePaths.first())) {
+        m_currentSessionData->stripPhotoPaths = filePaths;
+    }
+    UploadQueue::instance()->setPaused(false);
+}
+
+void MainWindow::onBurstAborted(const QString& errorMessage) {
+    qCWarning(lcSession) << "Photo strip aborted:" << errorMessage;
+    m_stripMode = false;
+    m_stripShots.clear();
+    UploadQueue::instance()->setPaused(false);
+}
+
 void MainWindow::onCameraError(const QString& errorMessage) {
-    qWarning() << "Camera error:" << errorMessage;
+    qCWarning(lcSession) << "Camera error:" << errorMessage;
+    UploadQueue::instance()->setPaused(false);
     
     // Show error to user (you might want to create a proper error dialog)
     m_countdownLabel->setText("Error!");
@@ -508,6 +1462,7 @@ void MainWindow::onCameraError(const QString& errorMessage) {
         "}"
     );
     m_countdownLabel->show();
+    stopSmileWait();
     
     // Hide error after 3 seconds
     QTimer::singleShot(3000, this, [this]() {
@@ -535,25 +1490,91 @@ void MainWindow::onCameraError(const QString& errorMessage) {
 void MainWindow::startNewSession() {
     m_currentSessionData = std::make_unique<PhotoSessionData>();
     if(m_nameLineEdit) m_nameLineEdit->clear(); 
-    qDebug() << "New photo session started. Session data object created.";
+    qCDebug(lcSession) << "New photo session started. Session data object created.";
 }
 
 void MainWindow::processNameEntry() {
     if (m_currentSessionData && m_nameLineEdit) {
         m_currentSessionData->userName = m_nameLineEdit->text();
-        qDebug() << "Name entered:" << m_currentSessionData->userName;
+        qCDebug(lcSession) << "Name entered:" << m_currentSessionData->userName;
     } else {
-        qWarning() << "processNameEntry called without active session data or line edit!";
+        qCWarning(lcSession) << "processNameEntry called without active session data or line edit!";
+    }
+}
+
+void MainWindow::recordSession() {
+    // Only sessions that got as far as a photo are worth keeping
+    if (!m_currentSessionData ||
+        (m_currentSessionData->capturedPhotoPath.isEmpty() && m_currentSessionData->stripPhotoPaths.isEmpty())) {
+        return;
+    }
+    PendingRecord record;
+    SessionJournal::Entry& entry = record.entry;
+    entry.startTime = m_currentSessionData->startTime;
+    entry.endTime = QDateTime::currentDateTime();
+    entry.userName = m_currentSessionData->userName;
+    entry.weaponId = m_currentSessionData->chosenWeaponId;
+    entry.landId = m_currentSessionData->chosenLandId;
+    entry.companionId = m_currentSessionData->chosenCompanionId;
+    entry.photoPath = m_currentSessionData->capturedPhotoPath;
+    entry.stripPhotoPaths = m_currentSessionData->stripPhotoPaths;
+    entry.printPath = m_currentSessionData->compositePhotoPath;
+    if (m_compositePending) {
+        // Saved by onCompositeReady() once it arrives
+        record.compositeGeneration = m_compositeGeneration;
+    }
+    record.deadlineMs = QDateTime::currentMSecsSinceEpoch() + RECORD_WAIT_MS;
+    m_pendingRecords.push_back(record);
+    recordPendingSessions();
+}
+
+void MainWindow::recordPendingSessions(bool force) {
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    for (auto record = m_pendingRecords.begin(); record != m_pendingRecords.end();) {
+        SessionJournal::Entry& entry = record->entry;
+        QStringList filePaths = entry.stripPhotoPaths;
+        filePaths << entry.photoPath << entry.printPath;
+        const bool saved = std::all_of(filePaths.cbegin(), filePaths.cend(), [](const QString& filePath) {
+            return filePath.isEmpty() || QFileInfo::exists(filePath);
+        });
+        if (!saved && !force && nowMs < record->deadlineMs) {
+            ++record;
+            continue;
+        }
+        if (!saved) {
+            qCWarning(lcSession) << "Recording session for" << entry.userName << "with files still missing";
+        }
+        entry.sequence = SessionJournal::instance()->append(entry);
+        UploadQueue::instance()->submitSession(entry);
+        record = m_pendingRecords.erase(record);
+    }
+
+    if (m_pendingRecords.empty()) {
+        m_pendingRecordTimer->stop();
+    } else if (!m_pendingRecordTimer->isActive()) {
+        m_pendingRecordTimer->start();
     }
 }
 
 void MainWindow::returnToStartScreen() {
+    recordSession();
     m_currentSessionData.reset(); // Destroys current session data, calling its destructor
+    m_reviewPaths.clear();
+    m_retakenPaths.clear();
+    m_printImage = QImage();
+    // A composite still rendering or saving belongs to the guest who left;
+    // a pending print still goes out, matched by m_printOnComposeGeneration
+    ++m_compositeGeneration;
+    m_compositeJobId = 0;
+    m_compositePending = false;
+    // The last guest's photo would otherwise stay in the review label
+    if (m_capturedPhotoLabel) m_capturedPhotoLabel->clear();
+    UploadQueue::instance()->setPaused(false);
     if (QApplication::inputMethod()->isVisible()) {
         QApplication::inputMethod()->hide();
     }
     QApplication::inputMethod()->reset();
     if (m_nameLineEdit) m_nameLineEdit->clear();
-    m_stackedWidget->setCurrentIndex(0); // Go back to start screen
-    qDebug() << "Returned to start screen. Session data cleared.";
+    navigateTo(StartScreen); // Go back to start screen
+    qCDebug(lcSession) << "Returned to start screen. Session data cleared.";
 }
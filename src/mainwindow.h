@@ -8,6 +8,13 @@
 #include <QPixmap>
 #include <qwidget.h>
 #include <QTimer>
+#include <QList>
+#include <QImage>
+#include <QStringList>
+#include <QModelIndex>
+#include <vector>
+#include "photostorage.h"
+#include "sessionjournal.h"
 
 class QStackedWidget;
 class QPushButton;
@@ -16,7 +23,12 @@ class QLineEdit;
 class QVBoxLayout;
 class QHBoxLayout;
 class QPixmap;
+class QImage;
 class ICamera;
+class CameraLoader;
+class GalleryModel;
+class FaceTracker;
+class FramingOverlay;
 
 struct PhotoSessionData;
 
@@ -24,13 +36,39 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
+    // Screens are built the first time they are shown, then kept
+    enum Screen {
+        StartScreen,
+        WeaponScreen,
+        LandScreen,
+        CompanionScreen,
+        NameScreen,
+        CameraScreen,
+        GalleryScreen,      // Operator only; never prebuilt
+        ScreenCount
+    };
+
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // The camera comes up in the background; the camera screen shows a
+    // placeholder and holds off captures until then
+    bool isCameraReady() const { return m_camera != nullptr; }
+
+signals:
+    // The start screen has been painted for the first time
+    void firstFramePainted();
+    void cameraReady();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     // Slots for button clicks
     void onStartButtonClicked();
     void onExitButtonClicked();
+    void onGalleryButtonClicked();
+    void onGalleryItemClicked(const QModelIndex& index);
     void onWeaponSelected(const QString& weaponId);
     void onLandSelected(const QString& landId);
     void onCompanionSelected(const QString& companionId);
@@ -38,19 +76,41 @@ private slots:
     
     // Camera slots
     void onTakePhotoButtonClicked();
+    void onPhotoStripButtonClicked();
     void onRetakeButtonClicked();
     void onCountdownTick();
-    void onCameraPhotoReady(const QPixmap& photo, const QString& filePath);
+    void onFacesChanged();
+    void onSmileWaitTimeout();
+    void onCameraPhotoReady(const QImage& photo, const QString& filePath);
+    void onCameraPhotoSaved(const QString& filePath);
     void onCameraError(const QString& errorMessage);
+    void onBurstShotTaken(int shot, int shots, const QString& filePath);
+    void onBurstFinished(const QStringList& filePaths);
+    void onBurstAborted(const QString& errorMessage);
+    void onCompositeReady(const QImage& composite, const QString& filePath, quint64 generation);
+    void onReviewImageScaled(const QImage& image, quint64 generation);
+    void onGalleryPreviewLoaded(const QImage& image, quint64 generation);
+    void onSaveBackpressureChanged(bool saturated);
+    void onStorageSpaceChanged(PhotoStorage::SpaceLevel level, qint64 bytesAvailable);
+    void onPrintQueueChanged();
+    void onContinueButtonClicked();
+    void prebuildNextScreen();
+    void onCameraLoaded();
+    void onCameraLoadFailed(const QString& errorMessage);
 
 private:
     void setupUi();
     void setupCamera();
+    void attachCameraPreview();
+    void setupMemoryAccounting();
+    QWidget* ensureScreen(Screen screen);
+    void navigateTo(Screen screen);
     
     // Screen creators
     QWidget* createStartScreen();
     QWidget* createNameEntryScreen();
     QWidget* createCameraScreen();
+    QWidget* createGalleryScreen();
 
     QWidget* createChoiceScreen(
                                 const QString& title, 
@@ -63,12 +123,26 @@ private:
     void stopCameraPreview();
     void startCountdown();
     void stopCountdown();
+    void startCaptureTrigger();     // Smiles if they're turned on and detectable, else the countdown
+    void startSmileWait();
+    void stopSmileWait();
+    void flashAndCapture();
+    void placeFramingOverlay();
     void capturePhoto();
+    void setCaptureButtonsEnabled(bool enabled);
+    QString takePhotoButtonText(bool saving) const;
+    void showReview(const QImage& photo);
+    void setReviewImage(const QImage& image);
+    void composeSessionPhoto(const QImage& photo, const QString& filePath);
+    void attachPrintQueue();
+    void queuePrint(const QImage& page, const QString& guestName);
 
     // Session Management
     void startNewSession();
     void processNameEntry();
     void returnToStartScreen(); // Clears session and goes to start
+    void recordSession();       // Appends the finished session to the journal
+    void recordPendingSessions(bool force = false);
 
     void loadPersistentChoiceImages();
     // UI Elements (pointers will be managed by Qt's parent-child or layouts)
@@ -85,23 +159,91 @@ private:
     QWidget *m_cameraPreviewWidget;
     QLabel *m_countdownLabel;
     QPushButton *m_takePhotoButton;
+    QPushButton *m_photoStripButton;
     QPushButton *m_retakeButton;
     QLabel *m_capturedPhotoLabel;
+    QLabel *m_printStatusLabel;
+    FramingOverlay *m_framingOverlay;
 
-    // Pointers to screen widgets for QStackedWidget
-    QWidget *m_startScreenWidget;
-    QWidget *m_weaponChoiceScreenWidget;
-    QWidget *m_landChoiceScreenWidget;
-    QWidget *m_companionChoiceScreenWidget;
-    QWidget *m_nameEntryScreenWidget;
-    QWidget *m_cameraScreenWidget;
+    // Pointers to screen widgets for QStackedWidget, null until built
+    QWidget *m_screens[ScreenCount];
+    bool m_firstFramePainted;
+    bool m_prebuildScreens;
 
     // Camera system
+    CameraLoader *m_cameraLoader;
     std::unique_ptr<ICamera> m_camera;
     QTimer *m_countdownTimer;
     int m_countdownValue;
+    int m_countdownIntervalMs;
+    int m_flashDelayMs;
     static const int COUNTDOWN_SECONDS = 3;
 
+    // Face detection on the preview drives the framing overlay and, with
+    // PHOTOBOOTH_SMILE_TRIGGER=1, takes the photo once everyone is framed
+    // and smiling for SMILE_STREAK detections in a row. The countdown takes
+    // over if that hasn't happened within m_smileWaitMs.
+    FaceTracker *m_faceTracker;
+    bool m_smileTrigger;
+    bool m_waitingForSmiles;
+    int m_smileStreak;
+    QTimer *m_smileTimer;
+    static const int SMILE_STREAK = 3;
+
+    // Photo strip: a burst of shots shown stacked on the review screen
+    bool m_stripMode;
+    int m_stripIntervalMs;
+    QList<QImage> m_stripShots;
+    static const int STRIP_SHOTS = 4;
+    static const int STRIP_SHOT_WIDTH = 320;
+
+    // Print composite of the last single shot; Retake bumps the generation
+    // so a composite still rendering for the rejected photo is dropped
+    quint64 m_compositeGeneration;
+    quint64 m_compositeJobId;
+    bool m_compositePending;
+
+    // Printed on Continue; if the composite is still rendering then, it is
+    // printed when it arrives, matched by generation
+    QImage m_printImage;
+    quint64 m_printOnComposeGeneration;
+    QString m_printGuestName;
+
+    // Review image scaled on a worker; stale results are dropped by generation
+    quint64 m_reviewGeneration;
+
+    // Files behind the photo or strip on the review screen, and its print;
+    // handed back to PhotoStorage as retakes if the guest presses Retake.
+    // Saves that finish after that are kept out of the session.
+    QStringList m_reviewPaths;
+    QStringList m_retakenPaths;
+
+    // Sessions that ended while their photos or print were still being
+    // saved. They are journalled and uploaded once every file is on disk, or
+    // after RECORD_WAIT_MS with whatever made it.
+    struct PendingRecord {
+        SessionJournal::Entry entry;
+        quint64 compositeGeneration = 0;    // Its print, if still rendering
+        qint64 deadlineMs = 0;
+    };
+    std::vector<PendingRecord> m_pendingRecords;
+    QTimer *m_pendingRecordTimer;
+    static const int RECORD_WAIT_MS = 15000;
+
+    // Gallery Screen
+    GalleryModel *m_galleryModel;
+    QLineEdit *m_gallerySearch;
+    QStackedWidget *m_galleryPages;     // Grid, then the full-size preview
+    QLabel *m_galleryPreviewLabel;
+    QLabel *m_galleryPreviewCaption;
+    quint64 m_galleryPreviewGeneration;
+
+    // What this window and the caches it uses hold, registered with
+    // ImageMemory. While it's over budget single shots are decoded for the
+    // review screen only, and the print is composed from that.
+    std::vector<int> m_memorySources;
+    bool m_memoryConstrained;
+
     // Persistent Data (Loaded once)
     std::map<QString, QPixmap> m_selectableImages;
     // Per-Iteration Data
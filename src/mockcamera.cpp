@@ -1,25 +1,110 @@
 #include "mockcamera.h"
+#include "mockframegenerator.h"
+#include "previewwidget.h"
+#include "framesubscriber.h"
+#include "photostorage.h"
+#include "boothlog.h"
 #include <QLabel>
 #include <QTimer>
-#include <QPixmap>
-#include <QStandardPaths>
-#include <QDir>
+#include <QImage>
+#include <QThread>
+#include <QRegularExpression>
 #include <QDateTime>
 #include <QDebug>
 #include <QPainter>
 #include <QFont>
+#include <QMutexLocker>
 
 MockCamera::MockCamera(QObject *parent)
     : ICamera(parent)
     , m_previewWidget(nullptr)
+    , m_streamWidget(nullptr)
     , m_captureTimer(nullptr)
+    , m_statsTimer(nullptr)
+    , m_streamThread(nullptr)
+    , m_generator(nullptr)
+    , m_previewSubscriber(nullptr)
+    , m_captureDelayMs(DEFAULT_CAPTURE_DELAY_MS)
+    , m_handoffNs(0)
+    , m_lookedFramePending(false)
+    , m_lookNs(0)
     , m_initialized(false)
 {
-    setupPhotosDirectory();
+
+    QString streamSpec = qEnvironmentVariable("PHOTOBOOTH_MOCK_STREAM");
+    if (!streamSpec.isEmpty() && !parseStreamSettings(streamSpec, &m_streamSettings)) {
+        qCWarning(lcCamera) << "MockCamera: Ignoring invalid PHOTOBOOTH_MOCK_STREAM" << streamSpec
+                   << "- expected WIDTHxHEIGHT@FPS[:rgb32|argb32|gray8|yuv420p|nv12]";
+    }
+
+    bool ok = false;
+    int delay = qEnvironmentVariableIntValue("PHOTOBOOTH_MOCK_CAPTURE_DELAY_MS", &ok);
+    if (ok) {
+        setCaptureDelay(delay);
+    }
 }
 
 MockCamera::~MockCamera() {
     cleanup();
+    if (m_streamThread) {
+        m_streamThread->quit();
+        m_streamThread->wait();
+    }
+}
+
+bool MockCamera::parseStreamSettings(const QString& spec, StreamSettings *settings) {
+    static const QRegularExpression pattern("^(\\d+)x(\\d+)@(\\d+)(?::(\\w+))?$");
+    QRegularExpressionMatch match = pattern.match(spec.trimmed().toLower());
+    if (!match.hasMatch()) {
+        return false;
+    }
+
+    StreamSettings parsed;
+    parsed.enabled = true;
+    parsed.resolution = QSize(match.captured(1).toInt(), match.captured(2).toInt());
+    parsed.fps = match.captured(3).toInt();
+
+    QString format = match.captured(4);
+    if (format.isEmpty() || format == "rgb32") {
+        parsed.format = CameraFrame::Format_RGB32;
+    } else if (format == "argb32") {
+        parsed.format = CameraFrame::Format_ARGB32_Premultiplied;
+    } else if (format == "gray8") {
+        parsed.format = CameraFrame::Format_Grayscale8;
+    } else if (format == "yuv420p") {
+        parsed.format = CameraFrame::Format_YUV420P;
+    } else if (format == "nv12") {
+        parsed.format = CameraFrame::Format_NV12;
+    } else {
+        return false;
+    }
+
+    if (parsed.resolution.width() < 16 || parsed.resolution.width() > MAX_STREAM_WIDTH ||
+        parsed.resolution.height() < 16 || parsed.resolution.height() > MAX_STREAM_HEIGHT ||
+        parsed.fps < 1 || parsed.fps > MAX_STREAM_FPS) {
+        return false;
+    }
+
+    // Chroma planes are subsampled 2x2
+    if ((parsed.format == CameraFrame::Format_YUV420P || parsed.format == CameraFrame::Format_NV12) &&
+        (parsed.resolution.width() % 2 || parsed.resolution.height() % 2)) {
+        return false;
+    }
+
+    *settings = parsed;
+    return true;
+}
+
+void MockCamera::setStreamSettings(const StreamSettings& settings) {
+    if (m_generator) {
+        qCWarning(lcCamera) << "MockCamera: Stream settings must be set before initialize()";
+        return;
+    }
+    m_streamSettings = settings;
+}
+
+void MockCamera::setCaptureDelay(int milliseconds) {
+    m_captureDelayMs = qMax(0, milliseconds);
 }
 
 bool MockCamera::initialize() {
@@ -27,32 +112,76 @@ bool MockCamera::initialize() {
         return true;
     }
 
-    qDebug() << "MockCamera: Initializing mock camera";
-    
-    // Create preview widget
-    m_previewWidget = new QLabel();
-    m_previewWidget->setAlignment(Qt::AlignCenter);
-    m_previewWidget->setStyleSheet("background-color: #2c3e50; color: white; font-size: 18px;");
-    m_previewWidget->setText("📷 Mock Camera Preview\n\nClick 'Take Photo' to capture a test image");
-    m_previewWidget->setMinimumSize(640, 480);
-    
+    qCDebug(lcCamera) << "MockCamera: Initializing mock camera";
+
+    if (m_streamSettings.enabled) {
+        if (!m_streamWidget) {
+            m_streamWidget = new PreviewWidget();
+            m_streamWidget->setPlaceholderText("📷 Mock Camera Stream");
+
+            // Lives on the GUI thread; the generator only overwrites its slot
+            m_previewSubscriber = new FrameSubscriber(this);
+            connect(m_previewSubscriber, &FrameSubscriber::frameAvailable,
+                    this, &MockCamera::onPreviewFrameAvailable);
+        }
+        addFrameSubscriber(m_previewSubscriber);
+    } else if (!m_previewWidget) {
+        // Create preview widget
+        m_previewWidget = new QLabel();
+        m_previewWidget->setAlignment(Qt::AlignCenter);
+        m_previewWidget->setStyleSheet("background-color: #2c3e50; color: white; font-size: 18px;");
+        m_previewWidget->setText("📷 Mock Camera Preview\n\nClick 'Take Photo' to capture a test image");
+        m_previewWidget->setMinimumSize(640, 480);
+    }
+
     // Create capture timer for simulating photo delay
-    m_captureTimer = new QTimer(this);
-    m_captureTimer->setSingleShot(true);
-    connect(m_captureTimer, &QTimer::timeout, this, &MockCamera::simulatePhotoCapture);
-    
+    if (!m_captureTimer) {
+        m_captureTimer = new QTimer(this);
+        m_captureTimer->setSingleShot(true);
+        connect(m_captureTimer, &QTimer::timeout, this, &MockCamera::simulatePhotoCapture);
+
+        m_statsTimer = new QTimer(this);
+        m_statsTimer->setInterval(STATS_INTERVAL_MS);
+        connect(m_statsTimer, &QTimer::timeout, this, &MockCamera::logStreamStatistics);
+    }
+
+    // Frames are generated on their own thread so a slow GUI shows up as
+    // dropped frames rather than a slower generator
+    if (!m_streamThread) {
+        m_generator = new MockFrameGenerator(
+            [this](int width, int height, CameraFrame::PixelFormat format) {
+                if (!hasFrameSubscribers()) {
+                    return CameraFrame();
+                }
+                return acquireFrame(width, height, format);
+            },
+            [this](const CameraFrame& frame) {
+                publishFrame(frame);
+                offerLookedFrame(frame);
+            });
+        m_generator->setFormat(m_streamSettings.resolution, m_streamSettings.fps, m_streamSettings.format);
+
+        m_streamThread = new QThread(this);
+        m_streamThread->setObjectName("MockFrameGenerator");
+        m_generator->moveToThread(m_streamThread);
+        connect(m_streamThread, &QThread::finished, m_generator, &QObject::deleteLater);
+        m_streamThread->start();
+    }
+
     m_initialized = true;
-    qDebug() << "MockCamera: Initialization complete";
+    qCDebug(lcCamera) << "MockCamera: Initialization complete";
     return true;
 }
 
 void MockCamera::cleanup() {
-    qDebug() << "MockCamera: Cleaning up";
-    
+    qCDebug(lcCamera) << "MockCamera: Cleaning up";
+
     if (m_captureTimer) {
         m_captureTimer->stop();
     }
-    
+    stopStream();
+    m_latestFrame = CameraFrame();
+
     // m_previewWidget will be deleted by Qt's parent-child system
     m_initialized = false;
 }
@@ -62,6 +191,9 @@ bool MockCamera::isAvailable() const {
 }
 
 QWidget* MockCamera::getPreviewWidget() {
+    if (m_streamWidget) {
+        return m_streamWidget;
+    }
     return m_previewWidget;
 }
 
@@ -69,118 +201,245 @@ void MockCamera::startPreview() {
     if (!m_initialized) {
         return;
     }
-    
-    qDebug() << "MockCamera: Starting preview";
-    
+
+    qCDebug(lcCamera) << "MockCamera: Starting preview";
+
     // Show live preview simulation
-    m_previewWidget->setText("📷 Mock Camera - Live Preview\n\nReady to take photo!");
-    m_previewWidget->setStyleSheet("background-color: #34495e; color: white; font-size: 18px; border: 2px solid #3498db;");
+    if (m_streamWidget) {
+        m_streamWidget->setPlaceholderText("📷 Mock Camera Stream\n\nWaiting for frames...");
+    } else {
+        m_previewWidget->setText("📷 Mock Camera - Live Preview\n\nReady to take photo!");
+        m_previewWidget->setStyleSheet("background-color: #34495e; color: white; font-size: 18px; border: 2px solid #3498db;");
+    }
+    startStream();
 }
 
 void MockCamera::stopPreview() {
-    qDebug() << "MockCamera: Stopping preview";
-    
-    if (m_previewWidget) {
+    qCDebug(lcCamera) << "MockCamera: Stopping preview";
+
+    stopStream();
+    {
+        QMutexLocker locker(&m_lookedFrameMutex);
+        m_lookedFrame = QImage();
+    }
+
+    if (m_streamWidget) {
+        m_streamWidget->clearFrame();
+        m_streamWidget->setPlaceholderText("📷 Mock Camera Stream\n\nPreview stopped");
+    } else if (m_previewWidget) {
         m_previewWidget->setText("📷 Mock Camera Preview\n\nPreview stopped");
         m_previewWidget->setStyleSheet("background-color: #2c3e50; color: white; font-size: 18px;");
     }
 }
 
+void MockCamera::startStream() {
+    if (!m_generator) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_generator, "start", Qt::QueuedConnection);
+
+    if (m_streamSettings.enabled) {
+        m_lastLoggedStatistics = streamStatistics();
+        m_statsClock.start();
+        m_statsTimer->start();
+    }
+}
+
+void MockCamera::stopStream() {
+    if (!m_generator || !m_streamThread->isRunning()) {
+        return;
+    }
+    // Blocking so no frame is published once the preview has stopped
+    QMetaObject::invokeMethod(m_generator, "stop", Qt::BlockingQueuedConnection);
+
+    if (m_statsTimer && m_statsTimer->isActive()) {
+        m_statsTimer->stop();
+        logStreamStatistics();
+    }
+}
+
+void MockCamera::onPreviewFrameAvailable() {
+    QElapsedTimer handoffTimer;
+    handoffTimer.start();
+
+    CameraFrame frame = m_previewSubscriber->takeFrame();
+    if (!frame.isValid()) {
+        return;
+    }
+    m_latestFrame = frame;
+    if (!hasLook()) {
+        m_streamWidget->setFrame(frame.toImage());
+    }
+
+    m_handoffNs += handoffTimer.nsecsElapsed();
+}
+
+void MockCamera::offerLookedFrame(const CameraFrame& frame) {
+    // Generator thread; the pooled frame itself is left as it is for the
+    // other subscribers and for capture
+    if (!m_streamWidget || !hasLook()) {
+        return;
+    }
+    QElapsedTimer lookTimer;
+    lookTimer.start();
+    const QImage looked = lookedPreview(frame.toImage());
+    m_lookNs += lookTimer.nsecsElapsed();
+    if (looked.isNull()) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_lookedFrameMutex);
+        m_lookedFrame = looked;
+    }
+    if (!m_lookedFramePending.exchange(true)) {
+        QMetaObject::invokeMethod(this, &MockCamera::onLookedFrameAvailable, Qt::QueuedConnection);
+    }
+}
+
+void MockCamera::onLookedFrameAvailable() {
+    QImage frame;
+    {
+        QMutexLocker locker(&m_lookedFrameMutex);
+        frame = std::move(m_lookedFrame);
+        m_lookedFrame = QImage();
+        m_lookedFramePending = false;
+    }
+    if (!frame.isNull()) {
+        m_streamWidget->setFrame(frame);
+    }
+}
+
+QSize MockCamera::previewFrameSize() const {
+    return m_streamSettings.enabled ? m_streamSettings.resolution : QSize();
+}
+
+MockCamera::StreamStatistics MockCamera::streamStatistics() const {
+    StreamStatistics stats;
+    if (m_generator) {
+        MockFrameGenerator::Statistics generator = m_generator->statistics();
+        stats.framesGenerated = generator.framesGenerated;
+        stats.framesSkipped = generator.framesSkipped;
+        stats.ticksMissed = generator.ticksMissed;
+        stats.renderNs = generator.renderNs;
+        stats.lookNs = m_lookNs.load();
+    }
+    if (m_previewSubscriber) {
+        stats.framesShown = m_previewSubscriber->framesDelivered();
+        stats.framesDropped = m_previewSubscriber->framesDropped();
+    }
+    if (m_streamWidget) {
+        stats.framesPainted = m_streamWidget->framesPainted();
+        stats.guiNs = m_handoffNs + m_streamWidget->paintNs();
+    }
+    return stats;
+}
+
+void MockCamera::logStreamStatistics() {
+    StreamStatistics current = streamStatistics();
+    const StreamStatistics& last = m_lastLoggedStatistics;
+    double seconds = qMax<qint64>(1, m_statsClock.restart()) / 1000.0;
+
+    quint64 generated = current.framesGenerated - last.framesGenerated;
+    quint64 painted = current.framesPainted - last.framesPainted;
+    double renderMs = generated ? (current.renderNs - last.renderNs) / 1e6 / generated : 0.0;
+    double guiMs = painted ? (current.guiNs - last.guiNs) / 1e6 / painted : 0.0;
+    double lookMs = generated ? (current.lookNs - last.lookNs) / 1e6 / generated : 0.0;
+
+    qCDebug(lcCamera) << "MockCamera: Stream" << m_streamSettings.resolution << "@" << m_streamSettings.fps
+             << "- generated" << QString::number(generated / seconds, 'f', 1) << "fps"
+             << "painted" << QString::number(painted / seconds, 'f', 1) << "fps"
+             << "dropped" << current.framesDropped - last.framesDropped
+             << "skipped" << current.framesSkipped - last.framesSkipped
+             << "missed ticks" << current.ticksMissed - last.ticksMissed
+             << "render" << QString::number(renderMs, 'f', 2) << "ms/frame"
+             << "look" << QString::number(lookMs, 'f', 2) << "ms/frame"
+             << "GUI" << QString::number(guiMs, 'f', 2) << "ms/frame";
+
+    m_lastLoggedStatistics = current;
+}
+
 void MockCamera::capturePhoto() {
     if (!m_initialized) {
         emit captureError("Mock camera not initialized");
         return;
     }
-    
-    qDebug() << "MockCamera: Starting photo capture simulation";
-    
-    // Show capturing state
-    m_previewWidget->setText("📸 Capturing...");
-    m_previewWidget->setStyleSheet("background-color: #e74c3c; color: white; font-size: 24px; font-weight: bold;");
-    
+
+    qCDebug(lcCamera) << "MockCamera: Starting photo capture simulation";
+
+    // Show capturing state; a streaming preview keeps running until the shot
+    if (m_previewWidget) {
+        m_previewWidget->setText("📸 Capturing...");
+        m_previewWidget->setStyleSheet("background-color: #e74c3c; color: white; font-size: 24px; font-weight: bold;");
+    }
+
     // Simulate capture delay
-    m_captureTimer->start(1000); // 1 second delay
+    m_captureTimer->start(m_captureDelayMs);
 }
 
 void MockCamera::simulatePhotoCapture() {
-    qDebug() << "MockCamera: Simulating photo capture";
-    
-    // Create a test image with some content
-    QPixmap testPhoto = createTestPhoto();
-    
-    // Generate filename
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
-    QString filename = QString("mock_photo_%1.png").arg(timestamp);
-    QString fullPath = QDir(m_photosDirectory).absoluteFilePath(filename);
-    
-    // Save the test photo
-    if (testPhoto.save(fullPath)) {
-        qDebug() << "MockCamera: Photo saved to" << fullPath;
-        emit photoReady(testPhoto, fullPath);
+    qCDebug(lcCamera) << "MockCamera: Simulating photo capture";
+
+    QImage testPhoto;
+    QString fullPath;
+    if (m_streamSettings.enabled && m_latestFrame.isValid()) {
+        // Detach from the pooled buffer so the stream can reuse it
+        testPhoto = m_latestFrame.toImage().copy();
+        fullPath = PhotoStorage::instance()->nextPhotoPath("mock_frame", "jpg");
     } else {
-        qWarning() << "MockCamera: Failed to save photo to" << fullPath;
-        emit captureError("Failed to save mock photo");
+        // Create a test image with some content
+        testPhoto = createTestPhoto();
+        fullPath = PhotoStorage::instance()->nextPhotoPath("mock_photo", "png");
     }
+
+    // Keyed, graded and scaled to the review size on a worker; encoding and
+    // the write happen on the save workers and photoSaved() follows
+    deliverPhoto(testPhoto, fullPath);
 }
 
-QPixmap MockCamera::createTestPhoto() {
+QImage MockCamera::createTestPhoto() {
     // Create a 800x600 test image
-    QPixmap pixmap(800, 600);
-    pixmap.fill(QColor(52, 73, 94)); // Dark blue-gray background
-    
-    QPainter painter(&pixmap);
+    QImage photo(800, 600, QImage::Format_RGB32);
+    photo.fill(QColor(52, 73, 94)); // Dark blue-gray background
+
+    QPainter painter(&photo);
     painter.setRenderHint(QPainter::Antialiasing);
-    
+
     // Draw a gradient background
     QLinearGradient gradient(0, 0, 800, 600);
     gradient.setColorAt(0, QColor(52, 152, 219)); // Light blue
     gradient.setColorAt(1, QColor(44, 62, 80));   // Dark blue
-    painter.fillRect(pixmap.rect(), gradient);
-    
+    painter.fillRect(photo.rect(), gradient);
+
     // Draw some decorative elements
     painter.setPen(QPen(QColor(255, 255, 255, 100), 2));
     painter.setBrush(QBrush(QColor(255, 255, 255, 50)));
-    
+
     // Draw circles
     painter.drawEllipse(100, 100, 150, 150);
     painter.drawEllipse(550, 350, 200, 200);
     painter.drawEllipse(200, 400, 100, 100);
-    
+
     // Draw text
     painter.setPen(QColor(255, 255, 255));
     painter.setFont(QFont("Arial", 36, QFont::Bold));
-    painter.drawText(pixmap.rect(), Qt::AlignCenter, "📷 MOCK PHOTO\n\nPhoto Booth Test");
-    
+    painter.drawText(photo.rect(), Qt::AlignCenter, "📷 MOCK PHOTO\n\nPhoto Booth Test");
+
     // Add timestamp
     painter.setFont(QFont("Arial", 16));
     QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-    painter.drawText(20, pixmap.height() - 20, timestamp);
-    
+    painter.drawText(20, photo.height() - 20, timestamp);
+
     // Add a border
     painter.setPen(QPen(QColor(255, 255, 255), 4));
-    painter.drawRect(pixmap.rect().adjusted(2, 2, -2, -2));
-    
-    return pixmap;
+    painter.drawRect(photo.rect().adjusted(2, 2, -2, -2));
+
+    return photo;
 }
 
 void MockCamera::cancelCapture() {
-    
-    qDebug() << "MockCamera: Cancelling capture";
+
+    qCDebug(lcCamera) << "MockCamera: Cancelling capture";
     MockCamera::cleanup();
-    
-}
-
-void MockCamera::setupPhotosDirectory() {
-    m_photosDirectory = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation) + "/PhotoBooth";
-    QDir dir;
-    if (!dir.exists(m_photosDirectory)) {
-        if (dir.mkpath(m_photosDirectory)) {
-            qDebug() << "MockCamera: Created photos directory:" << m_photosDirectory;
-        } else {
-            qWarning() << "MockCamera: Failed to create photos directory:" << m_photosDirectory;
-            m_photosDirectory = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-        }
-    } else {
-        qDebug() << "MockCamera: Photos directory:" << m_photosDirectory;
-    }
-}
\ No newline at end of file
+
+}
+
@@ -4,12 +4,48 @@
 #include "icamera.h"
 #include <QLabel>
 #include <QTimer>
-#include <QPixmap>
+#include <QImage>
+#include <QSize>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
 
+class QThread;
+class MockFrameGenerator;
+class PreviewWidget;
+class FrameSubscriber;
+
+// Without configuration the preview is a static label and captures return a
+// painted test photo. Set PHOTOBOOTH_MOCK_STREAM to stream synthetic moving
+// frames through the normal preview and capture paths instead, e.g.
+//   PHOTOBOOTH_MOCK_STREAM=1920x1080@60:nv12
+// Formats are rgb32, argb32, gray8, yuv420p and nv12. Captures then grab the
+// newest streamed frame. PHOTOBOOTH_MOCK_CAPTURE_DELAY_MS overrides the
+// simulated shutter delay (1000 ms by default). Photos go wherever
+// PhotoStorage puts them, so PHOTOBOOTH_PHOTOS_DIR applies here too.
 class MockCamera : public ICamera {
     Q_OBJECT
 
 public:
+    struct StreamSettings {
+        bool enabled = false;
+        QSize resolution = QSize(640, 480);
+        int fps = 30;
+        CameraFrame::PixelFormat format = CameraFrame::Format_RGB32;
+    };
+
+    struct StreamStatistics {
+        quint64 framesGenerated = 0;
+        quint64 framesSkipped = 0;     // Pool exhausted or nobody subscribed
+        quint64 ticksMissed = 0;       // Generator could not keep the frame rate
+        quint64 framesShown = 0;       // Taken by the preview
+        quint64 framesDropped = 0;     // Overwritten before the preview took them
+        quint64 framesPainted = 0;
+        qint64 renderNs = 0;           // Generator thread
+        qint64 lookNs = 0;             // Generator thread: keying and grading the preview
+        qint64 guiNs = 0;              // GUI thread: frame hand-off plus painting
+    };
+
     explicit MockCamera(QObject *parent = nullptr);
     ~MockCamera() override;
 
@@ -24,23 +60,55 @@ public:
 
     void capturePhoto() override;
     void cancelCapture() override;
+    QSize previewFrameSize() const override;
+
+    // Call before initialize(); overrides PHOTOBOOTH_MOCK_STREAM
+    void setStreamSettings(const StreamSettings& settings);
+    StreamSettings streamSettings() const { return m_streamSettings; }
+    void setCaptureDelay(int milliseconds);
+
+    StreamStatistics streamStatistics() const;
+
+    static bool parseStreamSettings(const QString& spec, StreamSettings *settings);
 
 private slots:
-    // void updatePreview();
-    // void simulateCapture();
+    void onPreviewFrameAvailable();
+    void onLookedFrameAvailable();
+    void logStreamStatistics();
 
 private:
-    void setupPhotosDirectory();
     void simulatePhotoCapture();
-    QPixmap createTestPhoto(); // Add this line
-    
+    QImage createTestPhoto();
+    void startStream();
+    void stopStream();
+    void offerLookedFrame(const CameraFrame& frame);
+
     QLabel *m_previewWidget;
+    PreviewWidget *m_streamWidget;
     QTimer *m_captureTimer;
-    QString m_photosDirectory;
+    QTimer *m_statsTimer;
+    QThread *m_streamThread;
+    MockFrameGenerator *m_generator;
+    FrameSubscriber *m_previewSubscriber;
+    CameraFrame m_latestFrame;
+    StreamSettings m_streamSettings;
+    int m_captureDelayMs;
+    qint64 m_handoffNs;
+    // With a look set, the preview shows frames keyed and graded on the
+    // generator thread instead of the raw ones; only the newest is kept
+    QMutex m_lookedFrameMutex;
+    QImage m_lookedFrame;
+    std::atomic<bool> m_lookedFramePending;
+    std::atomic<qint64> m_lookNs;
+    StreamStatistics m_lastLoggedStatistics;
+    QElapsedTimer m_statsClock;
     bool m_initialized;
-    
-    QPixmap generateMockFrame();
-    QPixmap generateMockPhoto();
+
+    static const int DEFAULT_CAPTURE_DELAY_MS = 1000;
+    static const int STATS_INTERVAL_MS = 5000;
+    static const int MAX_STREAM_WIDTH = 3840;
+    static const int MAX_STREAM_HEIGHT = 2160;
+    static const int MAX_STREAM_FPS = 240;
 };
 
-#endif // MOCKCAMERA_H
\ No newline at end of file
+#endif // MOCKCAMERA_H
@@ -0,0 +1,286 @@
+#include "mockframegenerator.h"
+#include "boothlog.h"
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+struct YuvColor {
+    uchar y;
+    uchar u;
+    uchar v;
+};
+
+// 75% colour bars: white, yellow, cyan, green, magenta, red, blue, black
+const quint32 BAR_RGB[8] = {
+    0xffc0c0c0, 0xffc0c000, 0xff00c0c0, 0xff00c000,
+    0xffc000c0, 0xffc00000, 0xff0000c0, 0xff000000
+};
+
+YuvColor toYuv(quint32 rgb) {
+    int r = (rgb >> 16) & 0xff;
+    int g = (rgb >> 8) & 0xff;
+    int b = rgb & 0xff;
+    YuvColor color;
+    color.y = static_cast<uchar>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    color.u = static_cast<uchar>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    color.v = static_cast<uchar>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    return color;
+}
+
+// 3x5 glyphs for the burned-in counter, one row per entry, MSB is the left column
+const uchar GLYPHS[12][5] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7},
+    {5, 5, 7, 1, 1}, {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1},
+    {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7}, {0, 0, 0, 0, 2}, {0, 0, 0, 0, 0}
+};
+
+int glyphIndex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    return c == '.' ? 10 : 11;
+}
+
+} // namespace
+
+MockFrameGenerator::MockFrameGenerator(AcquireFunction acquire, PublishFunction publish, QObject *parent)
+    : QObject(parent)
+    , m_acquire(std::move(acquire))
+    , m_publish(std::move(publish))
+    , m_timer(new QTimer(this))
+    , m_resolution(640, 480)
+    , m_fps(30)
+    , m_format(CameraFrame::Format_RGB32)
+    , m_frameIndex(0)
+    , m_frameIntervalNs(1000000000LL / 30)
+    , m_framesGenerated(0)
+    , m_framesSkipped(0)
+    , m_ticksMissed(0)
+    , m_renderNs(0)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &MockFrameGenerator::generateFrame);
+}
+
+void MockFrameGenerator::setFormat(const QSize& resolution, int fps, CameraFrame::PixelFormat format) {
+    m_resolution = resolution;
+    m_fps = std::max(1, fps);
+    m_format = format;
+    m_frameIntervalNs = 1000000000LL / m_fps;
+}
+
+MockFrameGenerator::Statistics MockFrameGenerator::statistics() const {
+    Statistics stats;
+    stats.framesGenerated = m_framesGenerated.load();
+    stats.framesSkipped = m_framesSkipped.load();
+    stats.ticksMissed = m_ticksMissed.load();
+    stats.renderNs = m_renderNs.load();
+    return stats;
+}
+
+void MockFrameGenerator::start() {
+    if (m_timer->isActive()) {
+        return;
+    }
+    qCDebug(lcCamera) << "MockFrameGenerator: Streaming" << m_resolution << "@" << m_fps << "fps, format" << m_format;
+    prepareTemplates();
+    m_frameIndex = 0;
+    m_clock.start();
+    m_timer->start(0);
+}
+
+void MockFrameGenerator::stop() {
+    m_timer->stop();
+}
+
+void MockFrameGenerator::scheduleNextFrame() {
+    qint64 now = m_clock.nsecsElapsed();
+    qint64 due = static_cast<qint64>(m_frameIndex) * m_frameIntervalNs;
+
+    if (now - due > m_frameIntervalNs) {
+        // Too slow for the requested rate: skip the ticks we missed instead of bursting
+        quint64 missed = static_cast<quint64>((now - due) / m_frameIntervalNs);
+        m_ticksMissed += missed;
+        m_frameIndex += missed;
+        due = static_cast<qint64>(m_frameIndex) * m_frameIntervalNs;
+    }
+
+    m_timer->start(static_cast<int>(std::max<qint64>(0, (due - now) / 1000000)));
+}
+
+void MockFrameGenerator::generateFrame() {
+    CameraFrame frame = m_acquire(m_resolution.width(), m_resolution.height(), m_format);
+    if (!frame.isValid()) {
+        ++m_framesSkipped;
+    } else {
+        QElapsedTimer renderTimer;
+        renderTimer.start();
+
+        const int width = m_resolution.width();
+        const int height = m_resolution.height();
+        const int speed = std::max(1, width / 240);
+        const int offset = static_cast<int>((m_frameIndex * speed) % width);
+        const int bandY = static_cast<int>((m_frameIndex * std::max(1, height / 180)) % height);
+
+        if (m_format == CameraFrame::Format_RGB32 || m_format == CameraFrame::Format_ARGB32_Premultiplied) {
+            renderRgb(frame, offset, bandY);
+        } else {
+            renderYuv(frame, offset, bandY);
+        }
+        burnOverlay(frame, m_frameIndex, m_clock.elapsed());
+
+        m_renderNs += renderTimer.nsecsElapsed();
+        ++m_framesGenerated;
+        m_publish(frame);
+    }
+
+    ++m_frameIndex;
+    scheduleNextFrame();
+}
+
+void MockFrameGenerator::prepareTemplates() {
+    const int width = m_resolution.width();
+    const int chromaWidth = (width + 1) / 2;
+    const int barWidth = std::max(1, width / 8);
+
+    m_rgbRow.resize(width * 2);
+    m_lumaRow.resize(width * 2);
+    for (int x = 0; x < width * 2; ++x) {
+        quint32 rgb = BAR_RGB[(x / barWidth) % 8];
+        m_rgbRow[x] = rgb;
+        m_lumaRow[x] = toYuv(rgb).y;
+    }
+
+    // NV12 keeps interleaved UV pairs in m_uRow
+    const bool interleaved = m_format == CameraFrame::Format_NV12;
+    m_uRow.resize(chromaWidth * 2 * (interleaved ? 2 : 1));
+    m_vRow.resize(interleaved ? 0 : chromaWidth * 2);
+    for (int x = 0; x < chromaWidth * 2; ++x) {
+        YuvColor color = toYuv(BAR_RGB[((x * 2) / barWidth) % 8]);
+        if (interleaved) {
+            m_uRow[x * 2] = color.u;
+            m_uRow[x * 2 + 1] = color.v;
+        } else {
+            m_uRow[x] = color.u;
+            m_vRow[x] = color.v;
+        }
+    }
+}
+
+void MockFrameGenerator::renderRgb(CameraFrame& frame, int offset, int bandY) {
+    const int width = frame.width();
+    const int height = frame.height();
+    const int bandHeight = std::max(1, height / 20);
+    const int bpl = frame.bytesPerLine(0);
+    uchar* bits = frame.bits(0);
+
+    for (int y = 0; y < height; ++y) {
+        quint32* line = reinterpret_cast<quint32*>(bits + y * bpl);
+        if (y >= bandY && y < bandY + bandHeight) {
+            std::fill(line, line + width, 0xffffffffu);
+        } else {
+            memcpy(line, m_rgbRow.data() + offset, width * sizeof(quint32));
+        }
+    }
+}
+
+void MockFrameGenerator::renderYuv(CameraFrame& frame, int offset, int bandY) {
+    const int width = frame.width();
+    const int height = frame.height();
+    const int bandHeight = std::max(1, height / 20);
+
+    uchar* luma = frame.bits(0);
+    const int lumaBpl = frame.bytesPerLine(0);
+    for (int y = 0; y < height; ++y) {
+        uchar* line = luma + y * lumaBpl;
+        if (y >= bandY && y < bandY + bandHeight) {
+            memset(line, 235, width);
+        } else {
+            memcpy(line, m_lumaRow.data() + offset, width);
+        }
+    }
+
+    if (m_format == CameraFrame::Format_Grayscale8) {
+        return;
+    }
+
+    const int chromaOffset = offset / 2;
+    for (int plane = 1; plane < frame.planeCount(); ++plane) {
+        uchar* bits = frame.bits(plane);
+        const int bpl = frame.bytesPerLine(plane);
+        for (int y = 0; y < frame.planeHeight(plane); ++y) {
+            uchar* line = bits + y * bpl;
+            int lumaY = y * 2;
+            if (lumaY >= bandY && lumaY < bandY + bandHeight) {
+                memset(line, 128, bpl);
+            } else if (m_format == CameraFrame::Format_NV12) {
+                memcpy(line, m_uRow.data() + chromaOffset * 2, bpl);
+            } else {
+                const std::vector<uchar>& row = plane == 1 ? m_uRow : m_vRow;
+                memcpy(line, row.data() + chromaOffset, bpl);
+            }
+        }
+    }
+}
+
+void MockFrameGenerator::burnOverlay(CameraFrame& frame, quint64 index, qint64 elapsedMs) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%06llu %05lld.%03lld",
+                  static_cast<unsigned long long>(index),
+                  static_cast<long long>(elapsedMs / 1000),
+                  static_cast<long long>(elapsedMs % 1000));
+
+    const int length = static_cast<int>(strlen(text));
+    const int scale = std::max(2, frame.height() / 90);
+    const int margin = scale * 2;
+    const int boxWidth = std::min(frame.width(), length * 4 * scale + margin * 2);
+    const int boxHeight = std::min(frame.height(), 5 * scale + margin * 2);
+
+    const bool rgb = frame.pixelFormat() == CameraFrame::Format_RGB32 ||
+                     frame.pixelFormat() == CameraFrame::Format_ARGB32_Premultiplied;
+    uchar* bits = frame.bits(0);
+    const int bpl = frame.bytesPerLine(0);
+
+    auto fill = [&](int x0, int y0, int w, int h, bool on) {
+        const int x1 = std::min(x0 + w, boxWidth);
+        if (x1 <= x0) {
+            return;
+        }
+        for (int y = y0; y < y0 + h && y < boxHeight; ++y) {
+            uchar* line = bits + y * bpl;
+            if (rgb) {
+                quint32* pixels = reinterpret_cast<quint32*>(line);
+                std::fill(pixels + x0, pixels + x1, on ? 0xffffffffu : 0xff000000u);
+            } else {
+                memset(line + x0, on ? 235 : 16, x1 - x0);
+            }
+        }
+    };
+
+    fill(0, 0, boxWidth, boxHeight, false);
+    for (int i = 0; i < length; ++i) {
+        const uchar* glyph = GLYPHS[glyphIndex(text[i])];
+        for (int row = 0; row < 5; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                if (glyph[row] & (4 >> col)) {
+                    fill(margin + (i * 4 + col) * scale, margin + row * scale, scale, scale, true);
+                }
+            }
+        }
+    }
+
+    // Neutral chroma behind the text
+    for (int plane = 1; plane < frame.planeCount(); ++plane) {
+        uchar* chroma = frame.bits(plane);
+        const int chromaBpl = frame.bytesPerLine(plane);
+        const int chromaBytes = frame.pixelFormat() == CameraFrame::Format_NV12 ? boxWidth : (boxWidth + 1) / 2;
+        for (int y = 0; y < (boxHeight + 1) / 2; ++y) {
+            memset(chroma + y * chromaBpl, 128, std::min(chromaBytes, chromaBpl));
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef MOCKFRAMEGENERATOR_H
+#define MOCKFRAMEGENERATOR_H
+
+#include "cameraframe.h"
+#include <QObject>
+#include <QSize>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+class QTimer;
+
+// Produces synthetic moving frames at a fixed rate on whatever thread it lives
+// in. Each frame shows scrolling colour bars, a moving band and the frame
+// counter plus stream time burned into the top-left corner, written directly
+// into a pooled buffer in the requested pixel format.
+class MockFrameGenerator : public QObject {
+    Q_OBJECT
+
+public:
+    using AcquireFunction = std::function<CameraFrame(int, int, CameraFrame::PixelFormat)>;
+    using PublishFunction = std::function<void(const CameraFrame&)>;
+
+    struct Statistics {
+        quint64 framesGenerated = 0;
+        quint64 framesSkipped = 0;     // No free pool buffer
+        quint64 ticksMissed = 0;       // Generator fell behind its schedule
+        qint64 renderNs = 0;           // Total time spent rendering
+    };
+
+    MockFrameGenerator(AcquireFunction acquire, PublishFunction publish, QObject *parent = nullptr);
+
+    // Call before start()
+    void setFormat(const QSize& resolution, int fps, CameraFrame::PixelFormat format);
+
+    Statistics statistics() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void generateFrame();
+
+private:
+    void scheduleNextFrame();
+    void prepareTemplates();
+    void renderRgb(CameraFrame& frame, int offset, int bandY);
+    void renderYuv(CameraFrame& frame, int offset, int bandY);
+    void burnOverlay(CameraFrame& frame, quint64 index, qint64 elapsedMs);
+
+    AcquireFunction m_acquire;
+    PublishFunction m_publish;
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    QSize m_resolution;
+    int m_fps;
+    CameraFrame::PixelFormat m_format;
+    quint64 m_frameIndex;
+    qint64 m_frameIntervalNs;
+
+    // One row of the bar pattern, twice as wide so scrolling is a single copy
+    std::vector<quint32> m_rgbRow;
+    std::vector<uchar> m_lumaRow;
+    std::vector<uchar> m_uRow;
+    std::vector<uchar> m_vRow;
+
+    std::atomic<quint64> m_framesGenerated;
+    std::atomic<quint64> m_framesSkipped;
+    std::atomic<quint64> m_ticksMissed;
+    std::atomic<qint64> m_renderNs;
+};
+
+#endif // MOCKFRAMEGENERATOR_H
@@ -0,0 +1,420 @@
+#include "photocompositor.h"
+#include "boothlog.h"
+#include "pixelmath.h"
+#include "simd.h"
+#include <QElapsedTimer>
+#include <QFont>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QSemaphore>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+Q_GLOBAL_STATIC(PhotoCompositor, s_photoCompositor)
+
+namespace {
+
+const int BAND_HEIGHT = 32;
+const int FRAME_BORDER = 14;
+const int OVERLAY_SIZE = PhotoCompositor::PRINT_HEIGHT * 3 / 10;
+const int OVERLAY_MARGIN = 40;
+const double OVERLAY_FEATHER = 0.15;
+const QRgb BACKGROUND_COLOR = 0xff2c3e50;
+
+using PixelMath::byteMul;
+using PixelMath::lerpPixel;
+
+// Premultiplied source-over. The SIMD versions round exactly like byteMul().
+void blendRowScalar(quint32 *dst, const quint32 *src, int count) {
+    for (int i = 0; i < count; ++i) {
+        const quint32 s = src[i];
+        const quint32 alpha = s >> 24;
+        if (alpha == 255) {
+            dst[i] = s;
+        } else if (alpha != 0) {
+            dst[i] = s + byteMul(dst[i], 255 - alpha);
+        }
+    }
+}
+
+#if defined(PHOTOBOOTH_SSE2)
+void blendRowSimd(quint32 *dst, const quint32 *src, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i alpha = _mm_and_si128(s, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff) {
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+            continue;
+        }
+
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i sLo = _mm_unpacklo_epi8(s, zero);
+        const __m128i sHi = _mm_unpackhi_epi8(s, zero);
+        // Alpha is the fourth 16-bit lane of each pixel
+        const __m128i inverseLo = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0xff), 0xff));
+        const __m128i inverseHi = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0xff), 0xff));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inverseLo), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inverseHi), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi8(s, _mm_packus_epi16(lo, hi)));
+    }
+    blendRowScalar(dst + i, src + i, count - i);
+}
+#elif defined(PHOTOBOOTH_NEON)
+void blendRowSimd(quint32 *dst, const quint32 *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t s = vld1q_u32(src + i);
+        const uint32x4_t alpha = vshrq_n_u32(s, 24);
+        // Pairwise min/max also work on 32-bit ARM, unlike vmaxvq
+        uint32x2_t highest = vpmax_u32(vget_low_u32(alpha), vget_high_u32(alpha));
+        uint32x2_t lowest = vpmin_u32(vget_low_u32(alpha), vget_high_u32(alpha));
+        highest = vpmax_u32(highest, highest);
+        lowest = vpmin_u32(lowest, lowest);
+        if (vget_lane_u32(highest, 0) == 0) {
+            continue;
+        }
+        if (vget_lane_u32(lowest, 0) == 255) {
+            vst1q_u32(dst + i, s);
+            continue;
+        }
+
+        const uint8x16_t inverse = vmvnq_u8(vreinterpretq_u8_u32(vmulq_n_u32(alpha, 0x01010101)));
+        const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+        const uint16x8_t lo = vmull_u8(vget_low_u8(d), vget_low_u8(inverse));
+        const uint16x8_t hi = vmull_u8(vget_high_u8(d), vget_high_u8(inverse));
+        const uint8x16_t scaled = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                                              vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(vaddq_u8(vreinterpretq_u8_u32(s), scaled)));
+    }
+    blendRowScalar(dst + i, src + i, count - i);
+}
+#else
+void blendRowSimd(quint32 *dst, const quint32 *src, int count) {
+    blendRowScalar(dst, src, count);
+}
+#endif
+
+// Premultiplies by a feathered ellipse so square JPEG art sits softly on the page
+void applyEllipseMask(QImage *image) {
+    const int width = image->width();
+    const int height = image->height();
+    for (int y = 0; y < height; ++y) {
+        quint32 *row = reinterpret_cast<quint32*>(image->scanLine(y));
+        const double ny = (y + 0.5) / height * 2.0 - 1.0;
+        for (int x = 0; x < width; ++x) {
+            const double nx = (x + 0.5) / width * 2.0 - 1.0;
+            const double coverage = std::clamp((1.0 - std::sqrt(nx * nx + ny * ny)) / OVERLAY_FEATHER, 0.0, 1.0);
+            row[x] = byteMul(row[x], static_cast<quint32>(coverage * 255.0 + 0.5));
+        }
+    }
+}
+
+int envThreads() {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue("PHOTOBOOTH_COMPOSITOR_THREADS", &ok);
+    return ok && value > 0 ? value : QThread::idealThreadCount();
+}
+
+} // namespace
+
+// Everything a band needs, read-only while the bands run. Raw pointers are
+// taken up front: QImage::scanLine() may detach and must not race.
+struct PhotoCompositor::Page {
+    uchar *canvas = nullptr;
+    qsizetype canvasStride = 0;
+
+    const uchar *background = nullptr;
+    qsizetype backgroundStride = 0;
+
+    const uchar *photo = nullptr;
+    qsizetype photoStride = 0;
+    QRect photoRect;
+    QRect frameRect;
+    std::vector<int> sourceX;
+    std::vector<quint32> weightX;
+    std::vector<int> sourceY;
+    std::vector<quint32> weightY;
+
+    const uchar *overlay[2] = {nullptr, nullptr};
+    qsizetype overlayStride[2] = {0, 0};
+    QRect overlayRect[2];
+
+    bool simd = true;
+};
+
+PhotoCompositor::PhotoCompositor(int threadCount)
+    : m_threadCount(threadCount > 0 ? threadCount : envThreads())
+    , m_simdEnabled(true)
+{
+    // The calling thread renders bands too
+    m_pool.setMaxThreadCount(std::max(1, m_threadCount - 1));
+    m_pool.setObjectName("PhotoCompositor");
+}
+
+PhotoCompositor::~PhotoCompositor() {
+    m_pool.waitForDone();
+}
+
+PhotoCompositor* PhotoCompositor::instance() {
+    return s_photoCompositor();
+}
+
+void PhotoCompositor::setAsset(const QString& id, const QImage& image) {
+    QMutexLocker locker(&m_mutex);
+    m_assets.insert(id, image);
+    // Drop layers built from the old image
+    for (const char* role : {"0:", "1:", "2:"}) {
+        m_prepared.remove(role + id);
+    }
+}
+
+void PhotoCompositor::clearCache() {
+    QMutexLocker locker(&m_mutex);
+    m_prepared.clear();
+}
+
+qint64 PhotoCompositor::cacheBytes() const {
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = 0;
+    for (const QHash<QString, QImage>* cache : {&m_assets, &m_prepared}) {
+        for (const QImage& image : *cache) {
+            bytes += image.sizeInBytes();
+        }
+    }
+    return bytes;
+}
+
+PhotoCompositor::Timing PhotoCompositor::lastTiming() const {
+    QMutexLocker locker(&m_mutex);
+    return m_lastTiming;
+}
+
+QImage PhotoCompositor::loadAsset(const QString& id) const {
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_assets.constFind(id);
+        if (it != m_assets.constEnd()) {
+            return it.value();
+        }
+    }
+    return QImage(QString(":/%1.jpg").arg(id));
+}
+
+QImage PhotoCompositor::preparedAsset(const QString& id, Role role) {
+    if (id.isEmpty()) {
+        return QImage();
+    }
+
+    const QString key = QString("%1:%2").arg(static_cast<int>(role)).arg(id);
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_prepared.constFind(key);
+        if (it != m_prepared.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QImage source = loadAsset(id);
+    if (source.isNull()) {
+        qCWarning(lcPrint) << "PhotoCompositor: Missing asset" << id;
+        return QImage();
+    }
+
+    QImage layer;
+    if (role == Background) {
+        // Cover the page, cropping the longer side evenly
+        const QSize page(PRINT_WIDTH, PRINT_HEIGHT);
+        QImage scaled = source.scaled(page, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+        layer = scaled.copy((scaled.width() - page.width()) / 2, (scaled.height() - page.height()) / 2,
+                            page.width(), page.height())
+                    .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    } else {
+        layer = source.scaled(OVERLAY_SIZE, OVERLAY_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                    .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        if (!source.hasAlphaChannel()) {
+            applyEllipseMask(&layer);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_prepared.insert(key, layer);
+    return layer;
+}
+
+void PhotoCompositor::prepare(const QString& landId, const QString& weaponId, const QString& companionId) {
+    preparedAsset(landId, Background);
+    preparedAsset(weaponId, LeftOverlay);
+    preparedAsset(companionId, RightOverlay);
+}
+
+QRect PhotoCompositor::photoRect(const QSize& photoSize) {
+    // Centred in the upper part of the page, leaving room for the caption
+    const QRect box(150, 70, PHOTO_BOX_WIDTH, PHOTO_BOX_HEIGHT);
+    const QSize fitted = photoSize.scaled(box.size(), Qt::KeepAspectRatio);
+    return QRect(box.x() + (box.width() - fitted.width()) / 2,
+                 box.y() + (box.height() - fitted.height()) / 2,
+                 fitted.width(), fitted.height());
+}
+
+QImage PhotoCompositor::compose(const Request& request) {
+    QMutexLocker composeLocker(&m_composeMutex);
+    Timing timing;
+    QElapsedTimer timer;
+    timer.start();
+
+    const QImage background = preparedAsset(request.landId, Background);
+    const QImage overlays[2] = {
+        preparedAsset(request.weaponId, LeftOverlay),
+        preparedAsset(request.companionId, RightOverlay)
+    };
+    timing.prepareNs = timer.nsecsElapsed();
+    timer.restart();
+
+    QImage canvas(PRINT_WIDTH, PRINT_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+    if (canvas.isNull()) {
+        qCWarning(lcPrint) << "PhotoCompositor: Failed to allocate the page";
+        return QImage();
+    }
+
+    QImage photo = request.photo;
+    if (photo.format() != QImage::Format_RGB32 && photo.format() != QImage::Format_ARGB32_Premultiplied) {
+        photo = photo.convertToFormat(QImage::Format_RGB32);
+    }
+
+    Page page;
+    page.canvas = canvas.bits();
+    page.canvasStride = canvas.bytesPerLine();
+    page.simd = m_simdEnabled;
+    if (!background.isNull()) {
+        page.background = background.constBits();
+        page.backgroundStride = background.bytesPerLine();
+    }
+    if (!photo.isNull()) {
+        page.photo = photo.constBits();
+        page.photoStride = photo.bytesPerLine();
+        page.photoRect = photoRect(photo.size());
+        page.frameRect = page.photoRect.adjusted(-FRAME_BORDER, -FRAME_BORDER, FRAME_BORDER, FRAME_BORDER);
+        PixelMath::buildSamplePositions(photo.width(), page.photoRect.width(), &page.sourceX, &page.weightX);
+        PixelMath::buildSamplePositions(photo.height(), page.photoRect.height(), &page.sourceY, &page.weightY);
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (overlays[i].isNull()) {
+            continue;
+        }
+        // Weapon bottom left, companion bottom right, overlapping the frame
+        const QSize size = overlays[i].size();
+        const int x = i == 0 ? OVERLAY_MARGIN : PRINT_WIDTH - OVERLAY_MARGIN - size.width();
+        page.overlay[i] = overlays[i].constBits();
+        page.overlayStride[i] = overlays[i].bytesPerLine();
+        page.overlayRect[i] = QRect(QPoint(x, PRINT_HEIGHT - OVERLAY_MARGIN - size.height()), size);
+    }
+
+    // Workers pull bands until none are left, so a slow core takes fewer
+    const int bandCount = (PRINT_HEIGHT + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::atomic<int> nextBand{0};
+    auto renderBands = [this, &page, &nextBand, bandCount]() {
+        for (int band = nextBand++; band < bandCount; band = nextBand++) {
+            renderBand(page, band * BAND_HEIGHT, std::min(PRINT_HEIGHT, (band + 1) * BAND_HEIGHT));
+        }
+    };
+    const int helpers = std::min(m_threadCount, bandCount) - 1;
+    QSemaphore finished;
+    for (int i = 0; i < helpers; ++i) {
+        m_pool.start([&renderBands, &finished]() {
+            renderBands();
+            finished.release();
+        });
+    }
+    renderBands();
+    finished.acquire(helpers);
+    timing.renderNs = timer.nsecsElapsed();
+    timer.restart();
+
+    if (!request.caption.isEmpty()) {
+        QPainter painter(&canvas);
+        painter.setRenderHint(QPainter::TextAntialiasing);
+        QFont font("Arial", 44, QFont::Bold);
+        painter.setFont(font);
+        const QRect captionRect(0, PRINT_HEIGHT - 170, PRINT_WIDTH, 150);
+        painter.setPen(QColor(0, 0, 0, 160));
+        painter.drawText(captionRect.translated(3, 3), Qt::AlignCenter, request.caption);
+        painter.setPen(Qt::white);
+        painter.drawText(captionRect, Qt::AlignCenter, request.caption);
+    }
+    timing.captionNs = timer.nsecsElapsed();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_lastTiming = timing;
+    }
+    qCDebug(lcPrint) << "PhotoCompositor: Page rendered on" << m_threadCount << "threads, assets"
+             << timing.prepareNs / 1000000 << "ms, render" << timing.renderNs / 1000000 << "ms";
+
+    // Every pixel is opaque, so the premultiplied data is valid RGB32 as is
+    canvas.reinterpretAsFormat(QImage::Format_RGB32);
+    return canvas;
+}
+
+void PhotoCompositor::renderBand(const Page& page, int y0, int y1) const {
+    void (*blendRow)(quint32*, const quint32*, int) = page.simd ? blendRowSimd : blendRowScalar;
+
+    for (int y = y0; y < y1; ++y) {
+        quint32 *row = reinterpret_cast<quint32*>(page.canvas + y * page.canvasStride);
+
+        if (page.background) {
+            std::memcpy(row, page.background + y * page.backgroundStride, PRINT_WIDTH * sizeof(quint32));
+        } else {
+            std::fill(row, row + PRINT_WIDTH, BACKGROUND_COLOR);
+        }
+
+        if (page.photo && y >= page.frameRect.top() && y <= page.frameRect.bottom()) {
+            std::fill(row + page.frameRect.left(), row + page.frameRect.right() + 1, 0xffffffffu);
+        }
+
+        if (page.photo && y >= page.photoRect.top() && y <= page.photoRect.bottom()) {
+            const int ty = y - page.photoRect.top();
+            const int sy = page.sourceY[ty];
+            const quint32 wy = page.weightY[ty];
+            const quint32 *top = reinterpret_cast<const quint32*>(page.photo + sy * page.photoStride);
+            // A non-zero weight means the next row or column exists
+            const quint32 *bottom = wy ? top + page.photoStride / sizeof(quint32) : top;
+            quint32 *out = row + page.photoRect.left();
+            for (int tx = 0; tx < page.photoRect.width(); ++tx) {
+                const int sx = page.sourceX[tx];
+                const quint32 wx = page.weightX[tx];
+                const int sx1 = wx ? sx + 1 : sx;
+                const quint32 upper = lerpPixel(top[sx], top[sx1], wx);
+                const quint32 lower = lerpPixel(bottom[sx], bottom[sx1], wx);
+                out[tx] = lerpPixel(upper, lower, wy) | 0xff000000;
+            }
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            const QRect& rect = page.overlayRect[i];
+            if (!page.overlay[i] || y < rect.top() || y > rect.bottom()) {
+                continue;
+            }
+            const quint32 *source = reinterpret_cast<const quint32*>(
+                page.overlay[i] + (y - rect.top()) * page.overlayStride[i]);
+            blendRow(row + rect.left(), source, rect.width());
+        }
+    }
+}
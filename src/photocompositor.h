@@ -0,0 +1,91 @@
+#ifndef PHOTOCOMPOSITOR_H
+#define PHOTOCOMPOSITOR_H
+
+#include <QImage>
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QRect>
+#include <QThreadPool>
+
+// Renders the print: the guest's land fills the page, the captured photo sits
+// in a white frame in the middle, and the weapon and companion are blended
+// over the lower corners. The page is rendered in row bands spread over a
+// private thread pool; each band copies the background, resamples its rows of
+// the photo and alpha-blends the overlays (SSE2/NEON, see simd.h).
+//
+// Scaled and masked assets are cached, so only the first print with a given
+// land, weapon or companion pays for decoding and resampling them. prepare()
+// does that work ahead of time, e.g. while the guest types their name.
+//
+// compose() may be called from any thread; calls are serialized.
+class PhotoCompositor {
+public:
+    struct Request {
+        QImage photo;
+        QString landId;
+        QString weaponId;
+        QString companionId;
+        QString caption;
+    };
+
+    struct Timing {
+        qint64 prepareNs = 0;   // Asset decode and resample, zero when cached
+        qint64 renderNs = 0;    // Banded page render
+        qint64 captionNs = 0;
+    };
+
+    // 6x4 inches at 300 dpi
+    static const int PRINT_WIDTH = 1800;
+    static const int PRINT_HEIGHT = 1200;
+
+    // Area the photo is fitted into; a capture larger than this gains nothing
+    static const int PHOTO_BOX_WIDTH = PRINT_WIDTH - 300;
+    static const int PHOTO_BOX_HEIGHT = PRINT_HEIGHT - 260;
+
+    // threadCount 0 uses PHOTOBOOTH_COMPOSITOR_THREADS or one per core
+    explicit PhotoCompositor(int threadCount = 0);
+    ~PhotoCompositor();
+
+    // Shared instance used by MainWindow
+    static PhotoCompositor* instance();
+
+    QImage compose(const Request& request);
+    void prepare(const QString& landId, const QString& weaponId, const QString& companionId);
+
+    // Replaces the image loaded from :/<id>.jpg; used by the benchmark
+    void setAsset(const QString& id, const QImage& image);
+    void clearCache();
+    qint64 cacheBytes() const;          // Prepared layers and setAsset() overrides
+
+    // Scalar blending, for comparing against the SIMD path
+    void setSimdEnabled(bool enabled) { m_simdEnabled = enabled; }
+
+    int threadCount() const { return m_threadCount; }
+    Timing lastTiming() const;
+
+private:
+    enum Role {
+        Background,
+        LeftOverlay,
+        RightOverlay
+    };
+
+    struct Page;
+
+    QImage preparedAsset(const QString& id, Role role);
+    QImage loadAsset(const QString& id) const;
+    static QRect photoRect(const QSize& photoSize);
+    void renderBand(const Page& page, int y0, int y1) const;
+
+    int m_threadCount;
+    bool m_simdEnabled;
+    QThreadPool m_pool;
+    mutable QMutex m_mutex;             // Guards the caches and timing
+    QMutex m_composeMutex;
+    QHash<QString, QImage> m_assets;    // setAsset() overrides
+    QHash<QString, QImage> m_prepared;  // "<role>:<id>" -> page-ready layer
+    Timing m_lastTiming;
+};
+
+#endif // PHOTOCOMPOSITOR_H
@@ -0,0 +1,203 @@
+#include "photosaveservice.h"
+#include "photostorage.h"
+#include "boothlog.h"
+#include <QBuffer>
+#include <QDeadlineTimer>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(PhotoSaveService, s_photoSaveService,
+    (envInt("PHOTOBOOTH_SAVE_WORKERS", std::min(2, std::max(1, QThread::idealThreadCount() - 1))),
+     envInt("PHOTOBOOTH_SAVE_QUEUE", 4)))
+
+PhotoSaveService* PhotoSaveService::instance() {
+    return s_photoSaveService();
+}
+
+PhotoSaveService::PhotoSaveService(int workerCount, int capacity, QObject *parent)
+    : QObject(parent)
+    , m_capacity(std::max(1, capacity))
+    , m_inFlight(0)
+    , m_inFlightBytes(0)
+    , m_nextJobId(1)
+    , m_saturated(false)
+    , m_shuttingDown(false)
+{
+    workerCount = std::max(1, workerCount);
+    for (int i = 0; i < workerCount; ++i) {
+        QThread* worker = QThread::create([this]() { workerLoop(); });
+        worker->setObjectName(QString("PhotoSave-%1").arg(i));
+        worker->start(QThread::LowPriority);
+        m_workers.push_back(worker);
+    }
+    qCDebug(lcStorage) << "PhotoSaveService: Started" << workerCount << "workers, queue capacity" << m_capacity;
+}
+
+PhotoSaveService::~PhotoSaveService() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shuttingDown = true;
+        m_jobAvailable.wakeAll();
+    }
+    // Workers drain the queue before exiting so no capture is lost on shutdown
+    for (QThread* worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+quint64 PhotoSaveService::submit(const QImage& image, const QString& filePath,
+                                 const QByteArray& format, int quality) {
+    quint64 jobId = 0;
+    bool becameSaturated = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        int pending = static_cast<int>(m_queue.size()) + m_inFlight;
+        if (m_shuttingDown || pending >= m_capacity) {
+            qCWarning(lcStorage) << "PhotoSaveService: Queue full, rejecting" << filePath;
+            return 0;
+        }
+
+        Job job;
+        job.id = m_nextJobId++;
+        job.image = image;
+        job.filePath = filePath;
+        job.format = format.isEmpty() ? QFileInfo(filePath).suffix().toLatin1() : format;
+        job.quality = quality;
+        job.queuedTimer.start();
+        jobId = job.id;
+        m_queue.push_back(std::move(job));
+        m_jobAvailable.wakeOne();
+
+        if (!m_saturated && pending + 1 >= m_capacity) {
+            m_saturated = true;
+            becameSaturated = true;
+        }
+    }
+
+    if (becameSaturated) {
+        updateBackpressure(true);
+    }
+    return jobId;
+}
+
+int PhotoSaveService::pendingJobs() const {
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_queue.size()) + m_inFlight;
+}
+
+qint64 PhotoSaveService::queuedBytes() const {
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = m_inFlightBytes;
+    for (const Job& job : m_queue) {
+        bytes += job.image.sizeInBytes();
+    }
+    return bytes;
+}
+
+bool PhotoSaveService::isSaturated() const {
+    QMutexLocker locker(&m_mutex);
+    return m_saturated;
+}
+
+bool PhotoSaveService::waitForIdle(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (!m_queue.empty() || m_inFlight > 0) {
+        if (!m_idle.wait(&m_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PhotoSaveService::workerLoop() {
+    forever {
+        Job job;
+        qint64 jobBytes = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.empty() && !m_shuttingDown) {
+                m_jobAvailable.wait(&m_mutex);
+            }
+            if (m_queue.empty()) {
+                return; // Shutting down and drained
+            }
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+            ++m_inFlight;
+            jobBytes = job.image.sizeInBytes();
+            m_inFlightBytes += jobBytes;
+        }
+
+        runJob(job);
+
+        bool cleared = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            --m_inFlight;
+            m_inFlightBytes -= jobBytes;
+            int pending = static_cast<int>(m_queue.size()) + m_inFlight;
+            // Release the UI only once the backlog has halved, to avoid flapping
+            if (m_saturated && pending <= m_capacity / 2) {
+                m_saturated = false;
+                cleared = true;
+            }
+            if (pending == 0) {
+                m_idle.wakeAll();
+            }
+        }
+        if (cleared) {
+            updateBackpressure(false);
+        }
+    }
+}
+
+void PhotoSaveService::runJob(Job& job) {
+    qint64 queueUs = job.queuedTimer.nsecsElapsed() / 1000;
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray encoded;
+    {
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, job.format);
+        writer.setQuality(job.quality);
+        if (!writer.write(job.image)) {
+            emit jobFailed(job.id, job.filePath, QString("Failed to encode photo: %1").arg(writer.errorString()));
+            return;
+        }
+    }
+    qint64 encodeUs = timer.nsecsElapsed() / 1000;
+    job.image = QImage(); // Drop the pixels before the slow part
+
+    timer.restart();
+    QString errorMessage;
+    if (!PhotoStorage::instance()->write(job.filePath, encoded, &errorMessage)) {
+        emit jobFailed(job.id, job.filePath, QString("Failed to write photo: %1").arg(errorMessage));
+        return;
+    }
+    qint64 writeUs = timer.nsecsElapsed() / 1000;
+
+    emit jobFinished(job.id, job.filePath, queueUs, encodeUs, writeUs);
+}
+
+void PhotoSaveService::updateBackpressure(bool saturated) {
+    qCDebug(lcStorage) << "PhotoSaveService: Backpressure" << (saturated ? "on" : "off");
+    emit backpressureChanged(saturated);
+}
@@ -0,0 +1,81 @@
+#ifndef PHOTOSAVESERVICE_H
+#define PHOTOSAVESERVICE_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <vector>
+
+class QThread;
+
+// Encodes and writes captured photos on a small pool of worker threads so the
+// GUI thread never touches the SD card. The queue is bounded: submit() refuses
+// new work once capacity jobs are queued or in flight, and backpressureChanged()
+// lets the UI hold off further captures until the card catches up.
+//
+// Completion signals are emitted from worker threads; connect with the default
+// (auto) connection type to receive them on the receiver's thread.
+class PhotoSaveService : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PhotoSaveService(int workerCount, int capacity, QObject *parent = nullptr);
+    ~PhotoSaveService() override;
+
+    // Shared instance used by all camera backends. Sized from
+    // PHOTOBOOTH_SAVE_WORKERS and PHOTOBOOTH_SAVE_QUEUE when set.
+    static PhotoSaveService* instance();
+
+    // Returns a job id, or 0 if the queue is full. The format is taken from the
+    // file suffix when empty.
+    quint64 submit(const QImage& image, const QString& filePath,
+                   const QByteArray& format = QByteArray(), int quality = 95);
+
+    int pendingJobs() const;
+    qint64 queuedBytes() const;     // Pixels held by queued and encoding jobs
+    int capacity() const { return m_capacity; }
+    int workerCount() const { return static_cast<int>(m_workers.size()); }
+    bool isSaturated() const;
+
+    // Blocks until every submitted job has completed; used on shutdown
+    bool waitForIdle(int timeoutMs);
+
+signals:
+    void jobFinished(quint64 jobId, const QString& filePath,
+                     qint64 queueUs, qint64 encodeUs, qint64 writeUs);
+    void jobFailed(quint64 jobId, const QString& filePath, const QString& errorMessage);
+    void backpressureChanged(bool saturated);
+
+private:
+    struct Job {
+        quint64 id;
+        QImage image;
+        QString filePath;
+        QByteArray format;
+        int quality;
+        QElapsedTimer queuedTimer;
+    };
+
+    void workerLoop();
+    void runJob(Job& job);
+    void updateBackpressure(bool saturated);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_jobAvailable;
+    QWaitCondition m_idle;
+    std::deque<Job> m_queue;
+    std::vector<QThread*> m_workers;
+    int m_capacity;
+    int m_inFlight;
+    qint64 m_inFlightBytes;     // Pixels of the jobs being encoded
+    quint64 m_nextJobId;
+    bool m_saturated;
+    bool m_shuttingDown;
+};
+
+#endif // PHOTOSAVESERVICE_H
@@ -2,8 +2,9 @@
 #define PHOTOSESSIONDATA_H
 
 #include <QString>
+#include <QStringList>
 #include <QDateTime>
-#include <QDebug> // For logging
+#include "boothlog.h"
 
 struct PhotoSessionData {
     QDateTime startTime;
@@ -12,18 +13,22 @@ struct PhotoSessionData {
     QString chosenCompanionId;
     QString userName;
     QString capturedPhotoPath;
+    QStringList stripPhotoPaths;
+    QString compositePhotoPath;
 
     PhotoSessionData() {
         startTime = QDateTime::currentDateTime();
-        qDebug() << "PhotoSessionData: Instance created at" << startTime.toString(Qt::ISODate);
+        qCDebug(lcSession) << "PhotoSessionData: Instance created at" << startTime.toString(Qt::ISODate);
     }
 
     ~PhotoSessionData() {
-        qDebug() << "PhotoSessionData: Instance for user" << (userName.isEmpty() ? "[NoName]" : userName)
+        qCDebug(lcSession) << "PhotoSessionData: Instance for user" << (userName.isEmpty() ? "[NoName]" : userName)
                  << "Weapon:" << chosenWeaponId
                  << "Land:" << chosenLandId
                  << "Companion:" << chosenCompanionId
                  << "Photo:" << (capturedPhotoPath.isEmpty() ? "[None]" : capturedPhotoPath)
+                 << "Strip:" << stripPhotoPaths.size() << "photos"
+                 << "Print:" << (compositePhotoPath.isEmpty() ? "[None]" : compositePhotoPath)
                  << "destroyed.";
     }
 
@@ -36,6 +41,8 @@ struct PhotoSessionData {
         chosenLandId.clear();
         userName.clear();
         capturedPhotoPath.clear();
+        stripPhotoPaths.clear();
+        compositePhotoPath.clear();
     }
 };
 
@@ -0,0 +1,392 @@
+#include "photostorage.h"
+#include "boothlog.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const char* const RETAKE_DIRECTORY = ".retakes";
+
+qint64 envMegabytes(const char* name, qint64 defaultBytes) {
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value >= 0 ? static_cast<qint64>(value) << 20 : defaultBytes;
+}
+
+QString defaultDirectory() {
+    QString directory = qEnvironmentVariable("PHOTOBOOTH_PHOTOS_DIR");
+    if (directory.isEmpty()) {
+        directory = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation) + "/PhotoBooth";
+    }
+    if (!QDir().mkpath(directory)) {
+        qCWarning(lcStorage) << "PhotoStorage: Failed to create photos directory:" << directory;
+        directory = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    }
+    return directory;
+}
+
+PhotoStorage::Limits defaultLimits() {
+    PhotoStorage::Limits limits;
+    limits.quotaBytes = envMegabytes("PHOTOBOOTH_STORAGE_QUOTA_MB", limits.quotaBytes);
+    limits.lowSpaceBytes = envMegabytes("PHOTOBOOTH_STORAGE_LOW_MB", limits.lowSpaceBytes);
+    limits.reserveBytes = envMegabytes("PHOTOBOOTH_STORAGE_RESERVE_MB", limits.reserveBytes);
+    bool ok = false;
+    const int hours = qEnvironmentVariableIntValue("PHOTOBOOTH_RETAKE_MAX_AGE_H", &ok);
+    if (ok && hours >= 0) {
+        limits.retakeMaxAgeSecs = hours * 3600LL;
+    }
+    return limits;
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(PhotoStorage, s_photoStorage, (defaultDirectory(), defaultLimits()))
+
+PhotoStorage* PhotoStorage::instance() {
+    return s_photoStorage();
+}
+
+PhotoStorage::PhotoStorage(const QString& directory, const Limits& limits, QObject *parent)
+    : QObject(parent)
+    , m_directory(QDir(directory).absolutePath())
+    , m_retakeDirectory(QDir(m_directory).absoluteFilePath(RETAKE_DIRECTORY))
+    , m_limits(limits)
+    , m_indexed(false)
+    , m_level(SpaceOk)
+{
+}
+
+void PhotoStorage::ensureIndexed() {
+    if (m_indexed) {
+        return;
+    }
+    m_indexed = true;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!QDir().mkpath(m_retakeDirectory)) {
+        qCWarning(lcStorage) << "PhotoStorage: Failed to create retake directory:" << m_retakeDirectory;
+    }
+
+    // The only directory listing; everything after this goes through the index
+    const QFileInfoList photos = QDir(m_directory).entryInfoList(QDir::Files);
+    for (const QFileInfo& info : photos) {
+        indexFile(info.fileName(), info.size());
+    }
+    const QFileInfoList retakes = QDir(m_retakeDirectory).entryInfoList(QDir::Files);
+    for (const QFileInfo& info : retakes) {
+        if (!m_files.contains(info.fileName())) {
+            indexRetake(info.fileName(), info.size(), info.lastModified().toMSecsSinceEpoch());
+        }
+    }
+    m_statistics.scanNs = timer.nsecsElapsed();
+    qCDebug(lcStorage) << "PhotoStorage: Photos directory:" << m_directory << "-" << m_statistics.photos << "photos,"
+             << m_statistics.retakes << "retakes, indexed in" << m_statistics.scanNs / 1000000 << "ms";
+}
+
+void PhotoStorage::indexFile(const QString& fileName, qint64 bytes) {
+    auto existing = m_files.find(fileName);
+    if (existing != m_files.end() && existing->retakenMs == 0) {
+        // Written over in place
+        m_statistics.photoBytes += bytes - existing->bytes;
+        existing->bytes = bytes;
+    } else {
+        if (existing != m_files.end()) {
+            // Supersedes a retake of the same name
+            m_retakeOrder.erase({existing->retakenMs, fileName});
+            --m_statistics.retakes;
+            m_statistics.retakeBytes -= existing->bytes;
+            QFile::remove(QDir(m_retakeDirectory).filePath(fileName));
+        }
+        Record record;
+        record.bytes = bytes;
+        m_files.insert(fileName, record);
+        ++m_statistics.photos;
+        m_statistics.photoBytes += bytes;
+    }
+
+    if (m_pendingDiscards.remove(fileName) && !moveToRetakes(fileName)) {
+        qCWarning(lcStorage) << "PhotoStorage: Failed to move retake" << fileName;
+    }
+}
+
+void PhotoStorage::indexRetake(const QString& fileName, qint64 bytes, qint64 modifiedMs) {
+    // A rename keeps the capture time, so age counts from the capture
+    Record record;
+    record.bytes = bytes;
+    record.retakenMs = std::max<qint64>(1, modifiedMs);
+    m_files.insert(fileName, record);
+    m_retakeOrder.emplace(record.retakenMs, fileName);
+    ++m_statistics.retakes;
+    m_statistics.retakeBytes += record.bytes;
+}
+
+void PhotoStorage::forgetFile(const QString& fileName) {
+    const Record record = m_files.take(fileName);
+    if (record.retakenMs != 0) {
+        m_retakeOrder.erase({record.retakenMs, fileName});
+        --m_statistics.retakes;
+        m_statistics.retakeBytes -= record.bytes;
+    } else {
+        --m_statistics.photos;
+        m_statistics.photoBytes -= record.bytes;
+    }
+}
+
+bool PhotoStorage::moveToRetakes(const QString& fileName) {
+    auto record = m_files.find(fileName);
+    if (record == m_files.end() || record->retakenMs != 0) {
+        return false;
+    }
+    if (!QFile::rename(QDir(m_directory).filePath(fileName), QDir(m_retakeDirectory).filePath(fileName))) {
+        return false;
+    }
+    record->retakenMs = QDateTime::currentMSecsSinceEpoch();
+    m_retakeOrder.emplace(record->retakenMs, fileName);
+    --m_statistics.photos;
+    m_statistics.photoBytes -= record->bytes;
+    ++m_statistics.retakes;
+    m_statistics.retakeBytes += record->bytes;
+    return true;
+}
+
+bool PhotoStorage::isIndexed(const QString& filePath, QString *fileName) const {
+    const QFileInfo info(filePath);
+    if (info.absolutePath() != m_directory) {
+        return false;
+    }
+    *fileName = info.fileName();
+    return true;
+}
+
+QString PhotoStorage::nextPhotoPath(const QString& prefix, const QString& suffix) {
+    static std::atomic<quint32> sequence{0};
+
+    const QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
+    QMutexLocker locker(&m_mutex);
+    ensureIndexed();
+    QString fileName;
+    do {
+        // Files from an earlier run in the same second are skipped over
+        fileName = QString("%1_%2_%3.%4").arg(prefix, timestamp)
+                       .arg(++sequence, 4, 10, QChar('0')).arg(suffix);
+    } while (m_files.contains(fileName));
+    return QDir(m_directory).filePath(fileName);
+}
+
+bool PhotoStorage::write(const QString& filePath, const QByteArray& data, QString *errorMessage) {
+    QString fileName;
+    const bool indexed = isIndexed(filePath, &fileName);
+    if (indexed) {
+        reclaim(data.size(), false);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = writeFile(filePath, data, errorMessage);
+    if (!ok && indexed && reclaim(data.size(), true) > 0) {
+        // Something else filled the card; every retake has gone, try once more
+        qCWarning(lcStorage) << "PhotoStorage: Retrying" << filePath << "after evicting all retakes";
+        ok = writeFile(filePath, data, errorMessage);
+    }
+    const qint64 elapsedNs = timer.nsecsElapsed();
+
+    QMutexLocker locker(&m_mutex);
+    if (!ok) {
+        ++m_statistics.failedWrites;
+        return false;
+    }
+    ++m_statistics.writes;
+    m_statistics.maxWriteNs = std::max(m_statistics.maxWriteNs, elapsedNs);
+    if (indexed) {
+        indexFile(fileName, data.size());
+    }
+    return true;
+}
+
+bool PhotoStorage::writeFile(const QString& filePath, const QByteArray& data, QString *errorMessage) const {
+    // Temporary file in the same directory, synced, then renamed over filePath
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void PhotoStorage::adopt(const QString& filePath) {
+    QString fileName;
+    if (!isIndexed(filePath, &fileName)) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureIndexed();
+        indexFile(fileName, QFileInfo(filePath).size());
+    }
+    reclaim(0, false);
+}
+
+void PhotoStorage::discard(const QString& filePath) {
+    QString fileName;
+    if (!isIndexed(filePath, &fileName)) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    ensureIndexed();
+    auto record = m_files.constFind(fileName);
+    if (record == m_files.cend()) {
+        m_pendingDiscards.insert(fileName);
+    } else if (record->retakenMs == 0 && !moveToRetakes(fileName)) {
+        qCWarning(lcStorage) << "PhotoStorage: Failed to move retake" << filePath;
+    }
+}
+
+void PhotoStorage::refresh() {
+    syncIndex();
+    reclaim(0, false);
+}
+
+void PhotoStorage::syncIndex() {
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_indexed) {
+            // The first scan is as fresh as a listing gets
+            ensureIndexed();
+            return;
+        }
+    }
+
+    // Listed without the lock so writes aren't held up by the card
+    const QFileInfoList photos = QDir(m_directory).entryInfoList(QDir::Files);
+    const QFileInfoList retakes = QDir(m_retakeDirectory).entryInfoList(QDir::Files);
+    QSet<QString> listedPhotos;
+    QSet<QString> listedRetakes;
+    for (const QFileInfo& info : photos) {
+        listedPhotos.insert(info.fileName());
+    }
+    for (const QFileInfo& info : retakes) {
+        listedRetakes.insert(info.fileName());
+    }
+
+    QMutexLocker locker(&m_mutex);
+    const quint64 changesBefore = m_statistics.externalChanges;
+    // Anything written, moved or evicted since the listing is checked again
+    // on its own before the index gives it up
+    std::vector<QString> gone;
+    for (auto record = m_files.cbegin(); record != m_files.cend(); ++record) {
+        const bool retake = record->retakenMs != 0;
+        if ((retake ? listedRetakes : listedPhotos).contains(record.key())) {
+            continue;
+        }
+        if (!QFileInfo::exists(QDir(retake ? m_retakeDirectory : m_directory).filePath(record.key()))) {
+            gone.push_back(record.key());
+        }
+    }
+    for (const QString& fileName : gone) {
+        forgetFile(fileName);
+        ++m_statistics.externalChanges;
+    }
+
+    for (const QFileInfo& info : photos) {
+        if (!m_files.contains(info.fileName()) && QFileInfo::exists(info.absoluteFilePath())) {
+            indexFile(info.fileName(), info.size());
+            ++m_statistics.externalChanges;
+        }
+    }
+    for (const QFileInfo& info : retakes) {
+        if (!m_files.contains(info.fileName()) && QFileInfo::exists(info.absoluteFilePath())) {
+            indexRetake(info.fileName(), info.size(), info.lastModified().toMSecsSinceEpoch());
+            ++m_statistics.externalChanges;
+        }
+    }
+
+    if (m_statistics.externalChanges != changesBefore) {
+        qCDebug(lcStorage) << "PhotoStorage:" << m_statistics.externalChanges - changesBefore
+                 << "files added or removed outside the booth";
+    }
+}
+
+int PhotoStorage::reclaim(qint64 incomingBytes, bool evictAll) {
+    const QStorageInfo storage(m_directory);
+    qint64 available = storage.isValid() && storage.isReady() ? storage.bytesAvailable() : -1;
+
+    std::vector<QString> victims;
+    SpaceLevel level = SpaceOk;
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureIndexed();
+
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        const qint64 maxAgeMs = m_limits.retakeMaxAgeSecs * 1000;
+        while (!m_retakeOrder.empty()) {
+            const auto oldest = m_retakeOrder.begin();
+            const qint64 used = m_statistics.photoBytes + m_statistics.retakeBytes + incomingBytes;
+            const bool expired = maxAgeMs > 0 && nowMs - oldest->first > maxAgeMs;
+            const bool overQuota = m_limits.quotaBytes > 0 && used > m_limits.quotaBytes;
+            const bool shortOfSpace = available >= 0 && available - incomingBytes < m_limits.lowSpaceBytes;
+            if (!evictAll && !expired && !overQuota && !shortOfSpace) {
+                break;
+            }
+            const qint64 bytes = m_files.take(oldest->second).bytes;
+            victims.push_back(oldest->second);
+            m_retakeOrder.erase(oldest);
+            --m_statistics.retakes;
+            m_statistics.retakeBytes -= bytes;
+            ++m_statistics.evictions;
+            m_statistics.evictedBytes += bytes;
+            if (available >= 0) {
+                available += bytes;
+            }
+        }
+
+        // Levels are judged as if the incoming file were already written
+        const qint64 used = m_statistics.photoBytes + m_statistics.retakeBytes + incomingBytes;
+        const qint64 remaining = available >= 0 ? available - incomingBytes : -1;
+        if ((remaining >= 0 && remaining < m_limits.reserveBytes) ||
+            (m_limits.quotaBytes > 0 && used > m_limits.quotaBytes)) {
+            level = SpaceCritical;
+        } else if ((remaining >= 0 && remaining < m_limits.lowSpaceBytes) ||
+                   (m_limits.quotaBytes > 0 && used > m_limits.quotaBytes / 10 * 9)) {
+            level = SpaceLow;
+        }
+        m_statistics.bytesAvailable = available;
+    }
+
+    for (const QString& fileName : victims) {
+        if (!QFile::remove(QDir(m_retakeDirectory).filePath(fileName))) {
+            qCWarning(lcStorage) << "PhotoStorage: Failed to remove retake" << fileName;
+        }
+    }
+    if (!victims.empty()) {
+        qCDebug(lcStorage) << "PhotoStorage: Evicted" << victims.size() << "retakes";
+    }
+
+    if (m_level.exchange(level) != level) {
+        if (level == SpaceOk) {
+            qCDebug(lcStorage) << "PhotoStorage: Space ok," << available / (1024 * 1024) << "MB free";
+        } else {
+            qCWarning(lcStorage) << "PhotoStorage: Space" << (level == SpaceLow ? "low," : "critical,")
+                       << available / (1024 * 1024) << "MB free";
+        }
+        emit spaceLevelChanged(level, available);
+    }
+    return static_cast<int>(victims.size());
+}
+
+PhotoStorage::Statistics PhotoStorage::statistics() const {
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
@@ -0,0 +1,137 @@
+#ifndef PHOTOSTORAGE_H
+#define PHOTOSTORAGE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <atomic>
+#include <set>
+#include <utility>
+
+// The photos directory, shared by every camera backend and the save workers.
+//
+// write() puts data in a temporary file beside the target, syncs it and
+// renames it into place (QSaveFile), so a power cut leaves the whole photo or
+// nothing. The directory is scanned once, on first use; after that an
+// in-memory index of every file and its size answers name collisions and
+// usage without touching the card.
+//
+// Photos the guest turned down with Retake are discard()ed into .retakes/.
+// Retakes are deleted oldest first whenever the directory is over its quota
+// or the card is running short, and once they pass the retake age limit.
+// Photos a guest kept are never deleted.
+//
+// Free space is checked before every write. Below the low-space mark the
+// level drops to SpaceLow and the UI stops offering strips; below the
+// reserve, or over quota with no retakes left to evict, it drops to
+// SpaceCritical and captures are refused, while the card still has room.
+// Only refresh() looks at the directory again, so the level can recover
+// after files are deleted or copied off behind the booth's back.
+class PhotoStorage : public QObject {
+    Q_OBJECT
+
+public:
+    enum SpaceLevel {
+        SpaceOk,
+        SpaceLow,
+        SpaceCritical
+    };
+    Q_ENUM(SpaceLevel)
+
+    struct Limits {
+        qint64 quotaBytes = 0;                  // Photos plus retakes; 0 for none
+        qint64 lowSpaceBytes = 1024LL << 20;
+        qint64 reserveBytes = 256LL << 20;
+        qint64 retakeMaxAgeSecs = 72 * 3600;    // 0 keeps retakes until space is needed
+    };
+
+    struct Statistics {
+        int photos = 0;
+        int retakes = 0;
+        qint64 photoBytes = 0;
+        qint64 retakeBytes = 0;
+        qint64 bytesAvailable = -1;             // -1 until first checked
+        quint64 writes = 0;
+        quint64 failedWrites = 0;
+        quint64 evictions = 0;
+        qint64 evictedBytes = 0;
+        qint64 maxWriteNs = 0;                  // Slowest write, sync and rename
+        qint64 scanNs = 0;                      // Directory scan on first use
+        quint64 externalChanges = 0;            // Files added or removed by anything else
+    };
+
+    PhotoStorage(const QString& directory, const Limits& limits, QObject *parent = nullptr);
+
+    // Shared instance in PHOTOBOOTH_PHOTOS_DIR, or ~/Pictures/PhotoBooth when
+    // unset. Limits come from PHOTOBOOTH_STORAGE_QUOTA_MB,
+    // PHOTOBOOTH_STORAGE_LOW_MB, PHOTOBOOTH_STORAGE_RESERVE_MB and
+    // PHOTOBOOTH_RETAKE_MAX_AGE_H.
+    static PhotoStorage* instance();
+
+    QString directory() const { return m_directory; }
+    QString retakeDirectory() const { return m_retakeDirectory; }
+
+    // <directory>/<prefix>_<yyyy-MM-dd_hh-mm-ss>_<sequence>.<suffix>. The
+    // sequence is shared by every camera in the process and the name never
+    // matches an indexed file, so shots within the same second don't collide.
+    QString nextPhotoPath(const QString& prefix, const QString& suffix);
+
+    // Atomically replaces filePath with data, evicting retakes first if it
+    // wouldn't otherwise fit. May be called from any thread. Files outside
+    // directory() are written the same way but not indexed.
+    bool write(const QString& filePath, const QByteArray& data, QString *errorMessage = nullptr);
+
+    // Indexes a file another process has already put in place
+    void adopt(const QString& filePath);
+
+    // The guest rejected this photo. May be called before it's been written,
+    // in which case it goes straight to .retakes/ when it is.
+    void discard(const QString& filePath);
+
+    // Re-lists the directory, dropping files deleted and indexing files added
+    // by anything else, then re-checks free space and evicts anything due.
+    // Blocks on the card; call it off the GUI thread.
+    void refresh();
+
+    SpaceLevel spaceLevel() const { return m_level.load(std::memory_order_relaxed); }
+    Statistics statistics() const;
+
+signals:
+    // Emitted from whichever thread noticed the change
+    void spaceLevelChanged(PhotoStorage::SpaceLevel level, qint64 bytesAvailable);
+
+private:
+    struct Record {
+        qint64 bytes = 0;
+        qint64 retakenMs = 0;   // Non-zero once in .retakes/
+    };
+
+    void ensureIndexed();                                       // m_mutex held
+    void indexFile(const QString& fileName, qint64 bytes);      // m_mutex held
+    void indexRetake(const QString& fileName, qint64 bytes, qint64 modifiedMs);   // m_mutex held
+    void forgetFile(const QString& fileName);                   // m_mutex held
+    void syncIndex();
+    bool moveToRetakes(const QString& fileName);                // m_mutex held
+    bool isIndexed(const QString& filePath, QString *fileName) const;
+    // Evicts retakes to make room for incomingBytes and updates the level.
+    // Returns the number evicted.
+    int reclaim(qint64 incomingBytes, bool evictAll);
+    bool writeFile(const QString& filePath, const QByteArray& data, QString *errorMessage) const;
+
+    const QString m_directory;
+    const QString m_retakeDirectory;
+    const Limits m_limits;
+
+    mutable QMutex m_mutex;
+    bool m_indexed;
+    QHash<QString, Record> m_files;                             // By file name
+    std::set<std::pair<qint64, QString>> m_retakeOrder;         // Oldest first
+    QSet<QString> m_pendingDiscards;
+    Statistics m_statistics;
+    std::atomic<SpaceLevel> m_level;
+};
+
+#endif // PHOTOSTORAGE_H
@@ -1,21 +1,41 @@
 #include "picamera.h"
-#include <QLabel>
-#include <QProcess>
+#include "picapturehelper.h"
+#include "previewstreamreader.h"
+#include "previewwidget.h"
+#include "imagedecoder.h"
+#include "imagedownscaler.h"
+#include "photostorage.h"
+#include "boothlog.h"
+#include <QThread>
 #include <QStandardPaths>
 #include <QDir>
-#include <QDateTime>
 #include <QDebug>
-#include <QPixmap>
-#include <QFile>
+#include <QBuffer>
+#include <QImage>
+#include <QImageWriter>
+#include <QPointer>
+#include <QThreadPool>
+#include <QCoreApplication>
 
 PiCamera::PiCamera(QObject *parent)
     : ICamera(parent)
     , m_previewWidget(nullptr)
-    , m_captureProcess(nullptr)
+    , m_captureHelper(nullptr)
+    , m_streamReader(nullptr)
+    , m_streamThread(nullptr)
     , m_initialized(false)
     , m_previewActive(false)
+    , m_exclusiveSensor(qEnvironmentVariableIsEmpty("PHOTOBOOTH_PI_PREVIEW_COMMAND"))
+    , m_sensorOwner(SensorFree)
+    , m_sensorReleasing(false)
+    , m_captureQueued(false)
 {
-    setupPhotosDirectory();
+    // Fake commands don't contend for a sensor, but the handoff can be
+    // exercised against them, e.g. by pihandoffbench
+    const QString exclusive = qEnvironmentVariable("PHOTOBOOTH_PI_EXCLUSIVE_SENSOR");
+    if (!exclusive.isEmpty()) {
+        m_exclusiveSensor = exclusive != "0";
+    }
 }
 
 PiCamera::~PiCamera() {
@@ -27,29 +47,70 @@ bool PiCamera::initialize() {
         return true;
     }
 
-    qDebug() << "PiCamera: Initializing Raspberry Pi camera";
+    qCDebug(lcCamera) << "PiCamera: Initializing Raspberry Pi camera";
 
     if (!checkCameraAvailable()) {
-        qWarning() << "PiCamera: Camera not available";
+        qCWarning(lcCamera) << "PiCamera: Camera not available";
         return false;
     }
 
     // Create preview widget
-    m_previewWidget = new QLabel();
-    m_previewWidget->setAlignment(Qt::AlignCenter);
-    m_previewWidget->setStyleSheet("background-color: #34495e; color: white; font-size: 16px;");
-    m_previewWidget->setText("Raspberry Pi Camera\nPreview");
-    m_previewWidget->setMinimumSize(640, 480);
-
-    // Create capture process
-    m_captureProcess = new QProcess(this);
-    connect(m_captureProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &PiCamera::onCaptureProcessFinished);
-    connect(m_captureProcess, &QProcess::errorOccurred,
-            this, &PiCamera::onCaptureProcessError);
+    m_previewWidget = new PreviewWidget();
+    m_previewWidget->setPlaceholderText("Raspberry Pi Camera\nPreview");
+
+    // Start the long-lived capture helper now so the sensor is powered and
+    // exposure has converged by the time the first countdown finishes
+    m_captureHelper = new PiCaptureHelper(this);
+    connect(m_captureHelper, &PiCaptureHelper::captureFinished,
+            this, &PiCamera::onHelperCaptureFinished);
+    connect(m_captureHelper, &PiCaptureHelper::captureFailed,
+            this, &PiCamera::onHelperCaptureFailed);
+    connect(m_captureHelper, &PiCaptureHelper::stopped,
+            this, &PiCamera::onHelperStopped);
+    if (!m_captureHelper->start(spoolDirectory())) {
+        qCWarning(lcCamera) << "PiCamera: Failed to start capture helper";
+        delete m_captureHelper;
+        m_captureHelper = nullptr;
+        return false;
+    }
+    m_sensorOwner = SensorHelper;
+
+    // Preview frames are read and decoded on their own thread
+    m_streamThread = new QThread(this);
+    m_streamThread->setObjectName("PiPreviewStream");
+    m_streamReader = new PreviewStreamReader();
+    if (qEnvironmentVariable("PHOTOBOOTH_PI_PREVIEW_FORMAT").toLower() == "yuv420") {
+        m_streamReader->setFormat(PreviewStreamReader::Yuv420);
+    }
+    m_streamReader->setFrameSize(PREVIEW_WIDTH, PREVIEW_HEIGHT);
+    m_streamReader->setFrameRate(PREVIEW_FPS);
+    // Keyed and graded on the stream thread; the widget only paints
+    m_streamReader->setFrameFilter([this](const QImage& frame) {
+        const QImage looked = lookedPreview(frame);
+        return looked.isNull() ? frame : looked;
+    });
+    m_streamReader->moveToThread(m_streamThread);
+    connect(m_streamThread, &QThread::finished, m_streamReader, &QObject::deleteLater);
+    connect(m_streamReader, &PreviewStreamReader::frameAvailable,
+            this, &PiCamera::onPreviewFrameAvailable, Qt::QueuedConnection);
+    connect(m_streamReader, &PreviewStreamReader::streamError,
+            this, &PiCamera::onPreviewStreamError, Qt::QueuedConnection);
+    connect(m_streamReader, &PreviewStreamReader::stopped,
+            this, &PiCamera::onPreviewStreamStopped, Qt::QueuedConnection);
+    // Runs on the stream thread; frame subscribers get a pooled copy
+    connect(m_streamReader, &PreviewStreamReader::frameDecoded, this, [this](const QImage& frame) {
+        if (hasFrameSubscribers()) {
+            publishImage(frame);
+        }
+    }, Qt::DirectConnection);
+    m_streamThread->start();
+
+    // A strip keeps the sensor with the helper from its first shot to its last
+    connect(this, &ICamera::burstFinished, this, &PiCamera::updateSensor, Qt::UniqueConnection);
+    connect(this, &ICamera::burstAborted, this, &PiCamera::updateSensor, Qt::UniqueConnection);
 
     m_initialized = true;
-    qDebug() << "PiCamera: Initialization complete";
+    qCDebug(lcCamera) << "PiCamera: Initialization complete";
     return true;
 }
 
@@ -58,16 +119,26 @@ void PiCamera::cleanup() {
         return;
     }
 
-    qDebug() << "PiCamera: Cleaning up";
-    stopPreview();
+    qCDebug(lcCamera) << "PiCamera: Cleaning up";
+    m_previewActive = false;
+    m_captureQueued = false;
+
+    if (m_streamThread) {
+        // The reader stops its process as it is deleted on its own thread
+        m_streamThread->quit();
+        m_streamThread->wait();
+        m_streamThread = nullptr;
+        m_streamReader = nullptr; // Deleted via QThread::finished
+    }
 
-    if (m_captureProcess) {
-        if (m_captureProcess->state() != QProcess::NotRunning) {
-            m_captureProcess->kill();
-            m_captureProcess->waitForFinished(3000);
-        }
-        m_captureProcess = nullptr;
+    if (m_captureHelper) {
+        m_captureHelper->disconnect(this);
+        m_captureHelper->stop();
+        m_captureHelper->deleteLater();
+        m_captureHelper = nullptr;
     }
+    m_sensorOwner = SensorFree;
+    m_sensorReleasing = false;
 
     if (m_previewWidget) {
         m_previewWidget->deleteLater();
@@ -93,14 +164,17 @@ void PiCamera::startPreview() {
         return;
     }
 
-    qDebug() << "PiCamera: Starting preview";
+    qCDebug(lcCamera) << "PiCamera: Starting preview";
     m_previewActive = true;
-    
-    if (m_previewWidget) {
-        m_previewWidget->setText("Raspberry Pi Camera\nPreview Active");
-        m_previewWidget->setStyleSheet("background-color: #27ae60; color: white; font-size: 16px;");
+
+    m_previewWidget->setPlaceholderText("Starting preview...");
+    if (m_exclusiveSensor) {
+        // The stream starts once the helper has let go of the sensor
+        updateSensor();
+    } else {
+        QMetaObject::invokeMethod(m_streamReader, "start", Qt::QueuedConnection);
     }
-    
+
     emitPreviewStarted();
 }
 
@@ -109,80 +183,237 @@ void PiCamera::stopPreview() {
         return;
     }
 
-    qDebug() << "PiCamera: Stopping preview";
+    qCDebug(lcCamera) << "PiCamera: Stopping preview";
     m_previewActive = false;
-    
+    if (m_exclusiveSensor) {
+        // Keep the still helper warm while nothing is streaming
+        updateSensor();
+    } else {
+        QMetaObject::invokeMethod(m_streamReader, "stop", Qt::QueuedConnection);
+    }
+
     if (m_previewWidget) {
-        m_previewWidget->setText("Raspberry Pi Camera\nPreview Stopped");
-        m_previewWidget->setStyleSheet("background-color: #34495e; color: white; font-size: 16px;");
+        m_previewWidget->clearFrame();
+        m_previewWidget->setPlaceholderText("Raspberry Pi Camera\nPreview Stopped");
     }
-    
+
     emitPreviewStopped();
 }
 
+void PiCamera::onPreviewFrameAvailable() {
+    if (!m_previewActive || !m_streamReader) {
+        return;
+    }
+    QImage frame = m_streamReader->takeLatestFrame();
+    if (!frame.isNull()) {
+        m_previewWidget->setFrame(frame);
+    }
+}
+
+void PiCamera::onPreviewStreamError(const QString& errorMessage) {
+    // Losing the preview should not block capture
+    qCWarning(lcCamera) << "PiCamera: Preview stream error:" << errorMessage;
+    if (m_previewWidget) {
+        m_previewWidget->clearFrame();
+        m_previewWidget->setPlaceholderText("Raspberry Pi Camera\nPreview unavailable");
+    }
+}
+
+void PiCamera::onPreviewStreamStopped() {
+    if (m_sensorOwner == SensorStream && m_sensorReleasing) {
+        m_sensorOwner = SensorFree;
+        m_sensorReleasing = false;
+        updateSensor();
+    }
+}
+
+void PiCamera::onHelperStopped() {
+    if (m_sensorOwner == SensorHelper && m_sensorReleasing) {
+        m_sensorOwner = SensorFree;
+        m_sensorReleasing = false;
+        updateSensor();
+    }
+}
+
+void PiCamera::updateSensor() {
+    // libcamera gives the sensor to one process at a time. The helper holds
+    // it for a queued shot, until a strip's last shot and whenever nothing is
+    // previewing; otherwise the stream does. Each side is asked to let go and
+    // says when it has, so the GUI thread never waits for a process to exit.
+    if (!m_exclusiveSensor || !m_initialized || !m_captureHelper || m_sensorReleasing) {
+        return;
+    }
+
+    const bool wantHelper = m_captureQueued || m_captureHelper->isBusy() || isBurstActive() || !m_previewActive;
+    if (m_sensorOwner == SensorStream) {
+        if (wantHelper) {
+            qCDebug(lcCamera) << "PiCamera: Handing the sensor to the capture helper";
+            m_sensorReleasing = true;
+            QMetaObject::invokeMethod(m_streamReader, "stop", Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    if (m_sensorOwner == SensorHelper && !m_captureHelper->isRunning()) {
+        // Died and gave up restarting; trigger() has one more go at it
+        m_sensorOwner = wantHelper ? SensorHelper : SensorFree;
+    }
+
+    if (m_sensorOwner == SensorHelper && !wantHelper) {
+        qCDebug(lcCamera) << "PiCamera: Handing the sensor to the preview stream";
+        m_sensorReleasing = true;
+        m_captureHelper->stop();
+        return;
+    }
+
+    if (m_sensorOwner == SensorFree) {
+        if (!wantHelper) {
+            m_sensorOwner = SensorStream;
+            QMetaObject::invokeMethod(m_streamReader, "start", Qt::QueuedConnection);
+            return;
+        }
+        m_sensorOwner = SensorHelper;
+        if (!m_captureHelper->start(spoolDirectory())) {
+            qCWarning(lcCamera) << "PiCamera: Failed to start capture helper";
+        }
+    }
+
+    if (m_captureQueued) {
+        // Queued inside the helper until its process is up
+        m_captureQueued = false;
+        if (!m_captureHelper->trigger(m_currentCaptureFile)) {
+            emitCaptureError("Failed to trigger camera capture");
+        }
+    }
+}
+
+QString PiCamera::spoolDirectory() const {
+    return QDir(PhotoStorage::instance()->directory()).absoluteFilePath(".spool");
+}
+
 void PiCamera::capturePhoto() {
-    if (!m_initialized) {
+    if (!m_initialized || !m_captureHelper) {
         emitCaptureError("Camera not initialized");
         return;
     }
 
-    if (m_captureProcess->state() != QProcess::NotRunning) {
+    if (m_captureQueued || m_captureHelper->isBusy()) {
         emitCaptureError("Capture already in progress");
         return;
     }
 
-    // Generate filename with timestamp
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
-    m_currentCaptureFile = QString("%1/pi_photo_%2.jpg").arg(m_photosDirectory, timestamp);
-
-    qDebug() << "PiCamera: Capturing photo to" << m_currentCaptureFile;
-
-    // Use libcamera-still (modern Pi camera command)
-    QStringList arguments;
-    arguments << "-o" << m_currentCaptureFile;
-    arguments << "--width" << "1920";
-    arguments << "--height" << "1080";
-    arguments << "--quality" << "95";
-    arguments << "--timeout" << "1"; // 1ms timeout (immediate capture)
-
-    m_captureProcess->start("libcamera-still", arguments);
-    
-    if (!m_captureProcess->waitForStarted(3000)) {
-        // Fallback to raspistill for older Pi OS versions
-        qDebug() << "PiCamera: libcamera-still failed, trying raspistill";
-        arguments.clear();
-        arguments << "-o" << m_currentCaptureFile;
-        arguments << "-w" << "1920";
-        arguments << "-h" << "1080";
-        arguments << "-q" << "95";
-        arguments << "-t" << "1";
-        
-        m_captureProcess->start("raspistill", arguments);
-        
-        if (!m_captureProcess->waitForStarted(3000)) {
-            emitCaptureError("Failed to start camera capture process");
-        }
+    m_currentCaptureFile = PhotoStorage::instance()->nextPhotoPath("pi_photo", "jpg");
+
+    qCDebug(lcCamera) << "PiCamera: Capturing photo to" << m_currentCaptureFile;
+
+    if (m_exclusiveSensor) {
+        // Triggered once the helper has the sensor; the preview keeps its
+        // last frame meanwhile
+        m_captureQueued = true;
+        updateSensor();
+        return;
+    }
+
+    if (!m_captureHelper->trigger(m_currentCaptureFile)) {
+        emitCaptureError("Failed to trigger camera capture");
     }
 }
 
 void PiCamera::cancelCapture() {
-    if (m_captureProcess && m_captureProcess->state() != QProcess::NotRunning) {
-        qDebug() << "PiCamera: Cancelling capture";
-        m_captureProcess->kill();
+    if (m_captureQueued || (m_captureHelper && m_captureHelper->isBusy())) {
+        qCDebug(lcCamera) << "PiCamera: Cancelling capture";
+        m_captureQueued = false;
+        m_captureHelper->cancel();
+        updateSensor();
     }
 }
 
-void PiCamera::onCaptureProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
-    qDebug() << "PiCamera: Capture process finished with exit code:" << exitCode;
+void PiCamera::onHelperCaptureFinished(const QString& filePath, qint64 latencyMs) {
+    qCDebug(lcCamera) << "PiCamera: Capture finished in" << latencyMs << "ms";
+    // The stream gets the sensor back unless a strip has more shots to take
+    updateSensor();
 
-    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
-        emitCaptureError(QString("Capture process failed with exit code: %1").arg(exitCode));
+    QPointer<PiCamera> guard(this);
+    const QSize decodeSize = photoDecodeSize();
+    const std::shared_ptr<const ColorLut> lut = colorLut();
+    const QImage backdrop = this->backdrop();
+    if (lut || !backdrop.isNull()) {
+        // The backdrop and look are baked into the file, so the helper's JPEG
+        // is decoded at full size, keyed, graded and written over itself
+        // before anyone sees it
+        QThreadPool::globalInstance()->start([guard, filePath, decodeSize, lut, backdrop]() {
+            QImage photo = ImageDecoder::read(filePath);
+            QString errorMessage;
+            if (photo.isNull()) {
+                errorMessage = "Failed to load captured photo";
+            } else {
+                photo = finishPhoto(photo, backdrop, lut.get());
+                QByteArray encoded;
+                QBuffer buffer(&encoded);
+                buffer.open(QIODevice::WriteOnly);
+                QImageWriter writer(&buffer, "jpg");
+                writer.setQuality(95);
+                if (!writer.write(photo)) {
+                    errorMessage = QString("Failed to encode photo: %1").arg(writer.errorString());
+                } else if (!PhotoStorage::instance()->write(filePath, encoded, &errorMessage)) {
+                    errorMessage = QString("Failed to write photo: %1").arg(errorMessage);
+                } else {
+                    // Then only as large as the review and print need
+                    const QSize fitted = ImageDownscaler::fitSize(photo.size(), decodeSize);
+                    if (fitted.isValid() && fitted.width() < photo.width()) {
+                        photo = ImageDownscaler::areaAverage(photo, fitted);
+                    }
+                }
+            }
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, photo, filePath, errorMessage]() {
+                if (!guard) {
+                    return;
+                }
+                if (errorMessage.isEmpty()) {
+                    qCDebug(lcCamera) << "PiCamera: Photo captured and finished:" << filePath;
+                    guard->emitPhotoReady(photo, filePath);
+                    guard->emitPhotoSaved(filePath);
+                } else {
+                    guard->emitCaptureError(errorMessage);
+                }
+            }, Qt::QueuedConnection);
+        });
         return;
     }
 
-    // Check if file was created and load it
-    if (QFile::exists(m_currentCaptureFile)) {
-        QPixmap photo(m_currentCaptureFile);
-        if (!photo.isNull()) {
-            qDebug() << "PiCamera: Photo captured successfully:" << m_currentCaptureFile;
-            emitPhotoReady(photo, m_currentCaptureFile);
\ No newline at end of file
+    // libcamera-still has already written the file and the helper renamed it
+    // into place; decode it once, off the GUI thread and only as large as the
+    // review and print need
+    PhotoStorage::instance()->adopt(filePath);
+
+    QThreadPool::globalInstance()->start([guard, filePath, decodeSize]() {
+        QImage photo = ImageDecoder::read(filePath, decodeSize);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, photo, filePath]() {
+            if (!guard) {
+                return;
+            }
+            // photoReady then photoSaved, as the other backends report them
+            if (!photo.isNull()) {
+                qCDebug(lcCamera) << "PiCamera: Photo captured successfully:" << filePath;
+                guard->emitPhotoReady(photo, filePath);
+            } else {
+                guard->emitCaptureError("Failed to load captured photo");
+            }
+            guard->emitPhotoSaved(filePath);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PiCamera::onHelperCaptureFailed(const QString& errorMessage) {
+    qCWarning(lcCamera) << "PiCamera: Capture failed:" << errorMessage;
+    emitCaptureError(errorMessage);
+    updateSensor();
+}
+
+bool PiCamera::checkCameraAvailable() {
+    if (!qEnvironmentVariableIsEmpty("PHOTOBOOTH_PI_CAPTURE_HELPER")) {
+        return true;
+    }
+    return !QStandardPaths::findExecutable("libcamera-still").isEmpty() ||
+           !QStandardPaths::findExecutable("raspistill").isEmpty();
+}
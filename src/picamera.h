@@ -2,8 +2,11 @@
 #define PICAMERA_H
 
 #include "icamera.h"
-#include <QLabel>
-#include <QProcess>
+
+class PiCaptureHelper;
+class PreviewStreamReader;
+class PreviewWidget;
+class QThread;
 
 class PiCamera : public ICamera {
     Q_OBJECT
@@ -23,21 +26,46 @@ public:
 
     void capturePhoto() override;
     void cancelCapture() override;
+    QSize previewFrameSize() const override { return QSize(PREVIEW_WIDTH, PREVIEW_HEIGHT); }
+
+    // True when a capture helper can be found; touches no camera state, so it
+    // is safe to call from any thread before a PiCamera exists
+    static bool checkCameraAvailable();
 
 private slots:
-    void onCaptureProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
-    void onCaptureProcessError(QProcess::ProcessError error);
+    void onHelperCaptureFinished(const QString& filePath, qint64 latencyMs);
+    void onHelperCaptureFailed(const QString& errorMessage);
+    void onPreviewFrameAvailable();
+    void onPreviewStreamError(const QString& errorMessage);
+    void onPreviewStreamStopped();
+    void onHelperStopped();
 
 private:
-    QLabel* m_previewWidget;
-    QProcess* m_captureProcess;
+    // Which process has the sensor when only one can (m_exclusiveSensor)
+    enum SensorOwner {
+        SensorFree,
+        SensorStream,
+        SensorHelper
+    };
+
+    PreviewWidget* m_previewWidget;
+    PiCaptureHelper* m_captureHelper;
+    PreviewStreamReader* m_streamReader;
+    QThread* m_streamThread;
     bool m_initialized;
     bool m_previewActive;
-    QString m_photosDirectory;
+    bool m_exclusiveSensor;
+    SensorOwner m_sensorOwner;
+    bool m_sensorReleasing;
+    bool m_captureQueued;
     QString m_currentCaptureFile;
     
-    void setupPhotosDirectory();
-    bool checkCameraAvailable();
+    void updateSensor();
+    QString spoolDirectory() const;
+
+    static const int PREVIEW_WIDTH = 640;
+    static const int PREVIEW_HEIGHT = 480;
+    static const int PREVIEW_FPS = 30;
 };
 
-#endif // PICAMERA_H
\ No newline at end of file
+#endif // PICAMERA_H
@@ -0,0 +1,336 @@
+#include "picapturehelper.h"
+#include "boothlog.h"
+#include <QProcess>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QPointer>
+#include <QDebug>
+
+PiCaptureHelper::PiCaptureHelper(QObject *parent)
+    : QObject(parent)
+    , m_process(nullptr)
+    , m_pollTimer(new QTimer(this))
+    , m_backend(LibcameraStill)
+    , m_stopping(false)
+    , m_triggerQueued(false)
+    , m_restartCount(0)
+    , m_width(1920)
+    , m_height(1080)
+    , m_quality(95)
+    , m_captureTimeoutMs(10000)
+{
+    m_pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(m_pollTimer, &QTimer::timeout, this, &PiCaptureHelper::pollForOutput);
+
+    if (!qEnvironmentVariableIsEmpty("PHOTOBOOTH_PI_CAPTURE_HELPER")) {
+        m_backend = CustomHelper;
+    }
+}
+
+PiCaptureHelper::~PiCaptureHelper() {
+    stop();
+    if (m_process && m_process->state() != QProcess::NotRunning) {
+        m_process->disconnect(this);
+        if (!m_process->waitForFinished(STOP_TIMEOUT_MS)) {
+            m_process->kill();
+            m_process->waitForFinished(STOP_TIMEOUT_MS);
+        }
+    }
+}
+
+bool PiCaptureHelper::start(const QString& spoolDirectory) {
+    if (isRunning()) {
+        return true;
+    }
+
+    m_spoolDirectory = spoolDirectory;
+    if (!QDir().mkpath(m_spoolDirectory)) {
+        qCWarning(lcCamera) << "PiCaptureHelper: Failed to create spool directory:" << m_spoolDirectory;
+        return false;
+    }
+    clearSpool();
+
+    if (!m_process) {
+        m_process = new QProcess(this);
+        m_process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_process->setStandardOutputFile(QProcess::nullDevice());
+        connect(m_process, &QProcess::started, this, &PiCaptureHelper::onProcessStarted);
+        connect(m_process, &QProcess::errorOccurred, this, &PiCaptureHelper::onProcessError);
+        connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, &PiCaptureHelper::onProcessFinished);
+    }
+
+    m_stopping = false;
+    m_restartCount = 0;
+    m_restartWindow.start();
+    launch();
+    return true;
+}
+
+void PiCaptureHelper::stop() {
+    m_stopping = true;
+    m_pollTimer->stop();
+    m_triggerQueued = false;
+    m_pendingOutputPath.clear();
+
+    if (!m_process || m_process->state() == QProcess::NotRunning) {
+        return;
+    }
+
+    qCDebug(lcCamera) << "PiCaptureHelper: Stopping capture helper";
+    if (m_process->state() != QProcess::Running) {
+        m_process->kill();
+        return;
+    }
+
+    // Keypress mode exits cleanly on "x"; one that doesn't is killed
+    m_process->write("x\n");
+    m_process->closeWriteChannel();
+    QPointer<QProcess> process(m_process);
+    QTimer::singleShot(STOP_TIMEOUT_MS, this, [this, process]() {
+        if (process && m_stopping && process->state() != QProcess::NotRunning) {
+            qCWarning(lcCamera) << "PiCaptureHelper: Helper ignored exit request, killing it";
+            process->kill();
+        }
+    });
+}
+
+bool PiCaptureHelper::isRunning() const {
+    return m_process && m_process->state() != QProcess::NotRunning;
+}
+
+bool PiCaptureHelper::isBusy() const {
+    return !m_pendingOutputPath.isEmpty();
+}
+
+bool PiCaptureHelper::trigger(const QString& outputPath) {
+    if (!m_process || isBusy()) {
+        return false;
+    }
+
+    if (!isRunning()) {
+        // Helper died and could not be restarted; try once more before giving up
+        m_stopping = false;
+        launch();
+    }
+
+    m_pendingOutputPath = outputPath;
+    m_triggerTimer.start();
+
+    if (m_process->state() == QProcess::Running) {
+        sendTrigger();
+    } else {
+        // Still starting up; the trigger goes out from onProcessStarted()
+        m_triggerQueued = true;
+    }
+
+    m_pollTimer->start();
+    return true;
+}
+
+void PiCaptureHelper::cancel() {
+    if (!isBusy()) {
+        return;
+    }
+
+    qCDebug(lcCamera) << "PiCaptureHelper: Cancelling pending capture";
+    // The helper still writes the frame; it is discarded by the next clearSpool()
+    m_pendingOutputPath.clear();
+    m_triggerQueued = false;
+    m_pollTimer->stop();
+}
+
+void PiCaptureHelper::setResolution(int width, int height) {
+    m_width = width;
+    m_height = height;
+}
+
+void PiCaptureHelper::setQuality(int quality) {
+    m_quality = quality;
+}
+
+void PiCaptureHelper::setCaptureTimeout(int timeoutMs) {
+    m_captureTimeoutMs = timeoutMs;
+}
+
+void PiCaptureHelper::launch() {
+    qCDebug(lcCamera) << "PiCaptureHelper: Launching" << program() << arguments();
+    m_process->start(program(), arguments());
+}
+
+void PiCaptureHelper::sendTrigger() {
+    clearSpool();
+    m_triggerQueued = false;
+    m_process->write("\n");
+}
+
+void PiCaptureHelper::onProcessStarted() {
+    qCDebug(lcCamera) << "PiCaptureHelper: Capture helper running, pid" << m_process->processId();
+    if (m_triggerQueued) {
+        sendTrigger();
+    }
+}
+
+void PiCaptureHelper::onProcessError(QProcess::ProcessError error) {
+    if (error != QProcess::FailedToStart) {
+        // Crashes are reported through finished() and handled there
+        return;
+    }
+    if (m_stopping) {
+        emit stopped();
+        return;
+    }
+
+    if (m_backend == LibcameraStill) {
+        qCDebug(lcCamera) << "PiCaptureHelper: libcamera-still failed to start, trying raspistill";
+        m_backend = Raspistill;
+        launch();
+        return;
+    }
+
+    qCWarning(lcCamera) << "PiCaptureHelper: Failed to start capture helper" << program();
+    failPendingCapture("Failed to start camera capture process");
+}
+
+void PiCaptureHelper::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    if (m_stopping) {
+        emit stopped();
+        return;
+    }
+
+    qCWarning(lcCamera) << "PiCaptureHelper: Capture helper exited unexpectedly, code" << exitCode
+               << "status" << exitStatus;
+
+    if (m_restartWindow.elapsed() > RESTART_WINDOW_MS) {
+        m_restartWindow.restart();
+        m_restartCount = 0;
+    }
+
+    if (++m_restartCount > MAX_RESTARTS_PER_WINDOW) {
+        qCWarning(lcCamera) << "PiCaptureHelper: Helper keeps dying, not restarting";
+        failPendingCapture(QString("Camera capture process exited with code: %1").arg(exitCode));
+        return;
+    }
+
+    bool hadPendingCapture = isBusy();
+    launch();
+    emit helperRestarted();
+
+    // A shot that was in flight when the helper died is retried on the new instance
+    if (hadPendingCapture) {
+        m_triggerQueued = true;
+    }
+}
+
+void PiCaptureHelper::pollForOutput() {
+    if (!isBusy()) {
+        m_pollTimer->stop();
+        return;
+    }
+
+    const QStringList files = QDir(m_spoolDirectory).entryList(QStringList() << "*.jpg", QDir::Files);
+    for (const QString& file : files) {
+        QString spoolPath = QDir(m_spoolDirectory).absoluteFilePath(file);
+        if (!isCompleteJpeg(spoolPath)) {
+            continue;
+        }
+
+        QString outputPath = m_pendingOutputPath;
+        m_pendingOutputPath.clear();
+        m_pollTimer->stop();
+
+        QFile::remove(outputPath);
+        if (!QFile::rename(spoolPath, outputPath)) {
+            qCWarning(lcCamera) << "PiCaptureHelper: Failed to move" << spoolPath << "to" << outputPath;
+            emit captureFailed("Failed to store captured photo");
+            return;
+        }
+
+        qint64 latencyMs = m_triggerTimer.elapsed();
+        qCDebug(lcCamera) << "PiCaptureHelper: Trigger-to-file latency" << latencyMs << "ms";
+        emit captureFinished(outputPath, latencyMs);
+        return;
+    }
+
+    if (m_triggerTimer.elapsed() > m_captureTimeoutMs) {
+        qCWarning(lcCamera) << "PiCaptureHelper: Capture timed out, restarting helper";
+        failPendingCapture("Camera capture timed out");
+        // Wedged helper; the finished() handler brings up a fresh one
+        if (m_process->state() != QProcess::NotRunning) {
+            m_process->kill();
+        }
+    }
+}
+
+void PiCaptureHelper::failPendingCapture(const QString& errorMessage) {
+    m_pollTimer->stop();
+    m_triggerQueued = false;
+    if (!isBusy()) {
+        return;
+    }
+    m_pendingOutputPath.clear();
+    emit captureFailed(errorMessage);
+}
+
+void PiCaptureHelper::clearSpool() {
+    QDir spool(m_spoolDirectory);
+    const QStringList files = spool.entryList(QDir::Files);
+    for (const QString& file : files) {
+        spool.remove(file);
+    }
+}
+
+QString PiCaptureHelper::program() const {
+    switch (m_backend) {
+        case CustomHelper:
+            return qEnvironmentVariable("PHOTOBOOTH_PI_CAPTURE_HELPER");
+        case Raspistill:
+            return "raspistill";
+        case LibcameraStill:
+        default:
+            return "libcamera-still";
+    }
+}
+
+QStringList PiCaptureHelper::arguments() const {
+    QString outputPattern = QDir(m_spoolDirectory).absoluteFilePath("capture_%04d.jpg");
+    QStringList arguments;
+
+    if (m_backend == Raspistill) {
+        arguments << "-o" << outputPattern;
+        arguments << "-w" << QString::number(m_width);
+        arguments << "-h" << QString::number(m_height);
+        arguments << "-q" << QString::number(m_quality);
+        arguments << "-t" << "0";
+        arguments << "-k";
+        arguments << "-n";
+        return arguments;
+    }
+
+    arguments << "-o" << outputPattern;
+    arguments << "--width" << QString::number(m_width);
+    arguments << "--height" << QString::number(m_height);
+    arguments << "--quality" << QString::number(m_quality);
+    arguments << "--timeout" << "0";   // Run until told to exit
+    arguments << "--keypress";         // ENTER captures, "x" ENTER exits
+    arguments << "--nopreview";
+    return arguments;
+}
+
+bool PiCaptureHelper::isCompleteJpeg(const QString& filePath) {
+    // The helper writes straight to the final spool name, so only accept the
+    // file once the JPEG end-of-image marker has been flushed.
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < 4) {
+        return false;
+    }
+
+    QByteArray head = file.read(2);
+    if (!file.seek(file.size() - 2)) {
+        return false;
+    }
+    QByteArray tail = file.read(2);
+
+    return head == QByteArray("\xFF\xD8", 2) && tail == QByteArray("\xFF\xD9", 2);
+}
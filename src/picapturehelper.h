@@ -0,0 +1,91 @@
+#ifndef PICAPTUREHELPER_H
+#define PICAPTUREHELPER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+
+class QTimer;
+
+// Keeps one libcamera-still (or raspistill) process alive in keypress mode so
+// the sensor stays powered and AE/AWB stay converged between shots. Each
+// trigger() writes a newline to the helper's stdin; the helper writes the JPEG
+// into a private spool directory which is polled until the file is complete and
+// then renamed to the requested output path.
+//
+// stop() asks the helper to exit and returns; stopped() follows once it has,
+// so a caller handing the sensor to another process never waits on the GUI
+// thread. Only the destructor blocks until the process is gone.
+//
+// Set PHOTOBOOTH_PI_CAPTURE_HELPER to run a different program with the same
+// command line (e.g. fakepicapturehelper on a machine without a camera).
+class PiCaptureHelper : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PiCaptureHelper(QObject *parent = nullptr);
+    ~PiCaptureHelper() override;
+
+    bool start(const QString& spoolDirectory);
+    void stop();
+    bool isRunning() const;
+    bool isBusy() const;
+
+    bool trigger(const QString& outputPath);
+    void cancel();
+
+    void setResolution(int width, int height);
+    void setQuality(int quality);
+    void setCaptureTimeout(int timeoutMs);
+
+signals:
+    void captureFinished(const QString& filePath, qint64 latencyMs);
+    void captureFailed(const QString& errorMessage);
+    void helperRestarted();
+    void stopped();
+
+private slots:
+    void onProcessStarted();
+    void onProcessError(QProcess::ProcessError error);
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void pollForOutput();
+
+private:
+    enum Backend {
+        LibcameraStill,
+        Raspistill,
+        CustomHelper
+    };
+
+    void launch();
+    void sendTrigger();
+    void failPendingCapture(const QString& errorMessage);
+    void clearSpool();
+    QString program() const;
+    QStringList arguments() const;
+    static bool isCompleteJpeg(const QString& filePath);
+
+    QProcess *m_process;
+    QTimer *m_pollTimer;
+    Backend m_backend;
+    QString m_spoolDirectory;
+    QString m_pendingOutputPath;
+    QElapsedTimer m_triggerTimer;
+    QElapsedTimer m_restartWindow;
+    bool m_stopping;
+    bool m_triggerQueued;
+    int m_restartCount;
+    int m_width;
+    int m_height;
+    int m_quality;
+    int m_captureTimeoutMs;
+
+    static const int POLL_INTERVAL_MS = 10;
+    static const int MAX_RESTARTS_PER_WINDOW = 3;
+    static const int RESTART_WINDOW_MS = 10000;
+    static const int STOP_TIMEOUT_MS = 1000;
+};
+
+#endif // PICAPTUREHELPER_H
@@ -0,0 +1,48 @@
+#ifndef PIXELMATH_H
+#define PIXELMATH_H
+
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
+
+// Scalar helpers for packed 0xAARRGGBB pixels, working on two channels at a
+// time. The SIMD kernels round exactly like these so results don't depend on
+// the platform.
+namespace PixelMath {
+
+// x * a / 255 for each byte of x, rounded to nearest
+inline quint32 byteMul(quint32 x, quint32 a) {
+    quint32 t = (x & 0x00ff00ff) * a + 0x00800080;
+    t = ((t + ((t >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    quint32 u = ((x >> 8) & 0x00ff00ff) * a + 0x00800080;
+    u = (u + ((u >> 8) & 0x00ff00ff)) & 0xff00ff00;
+    return t | u;
+}
+
+// Linear interpolation between two pixels, weight 0..256 towards b
+inline quint32 lerpPixel(quint32 a, quint32 b, quint32 weight) {
+    const quint32 inverse = 256 - weight;
+    const quint32 rb = (((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+    const quint32 ag = (((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight) & 0xff00ff00;
+    return rb | ag;
+}
+
+// Fixed-point source position for each of targetSize samples over sourceSize,
+// pixel centres aligned. A non-zero weight (0..255, towards the next sample)
+// guarantees the next sample exists.
+inline void buildSamplePositions(int sourceSize, int targetSize,
+                                 std::vector<int> *offsets, std::vector<quint32> *weights) {
+    offsets->resize(targetSize);
+    weights->resize(targetSize);
+    const qint64 step = (static_cast<qint64>(sourceSize) << 16) / targetSize;
+    qint64 position = step / 2 - 0x8000;
+    for (int i = 0; i < targetSize; ++i, position += step) {
+        const qint64 clamped = std::clamp<qint64>(position, 0, static_cast<qint64>(sourceSize - 1) << 16);
+        (*offsets)[i] = static_cast<int>(clamped >> 16);
+        (*weights)[i] = static_cast<quint32>((clamped & 0xffff) >> 8);
+    }
+}
+
+} // namespace PixelMath
+
+#endif // PIXELMATH_H
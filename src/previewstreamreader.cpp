@@ -0,0 +1,272 @@
+#include "previewstreamreader.h"
+#include "boothlog.h"
+#include <QProcess>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+
+PreviewStreamReader::PreviewStreamReader(QObject *parent)
+    : QObject(parent)
+    , m_process(nullptr)
+    , m_format(Mjpeg)
+    , m_width(640)
+    , m_height(480)
+    , m_fps(30)
+    , m_stopping(false)
+    , m_notifyPending(false)
+    , m_framesReceived(0)
+    , m_framesDecoded(0)
+    , m_framesDropped(0)
+    , m_bytesReceived(0)
+    , m_filterNs(0)
+{
+}
+
+PreviewStreamReader::~PreviewStreamReader() {
+    stop();
+}
+
+void PreviewStreamReader::setFormat(StreamFormat format) {
+    m_format = format;
+}
+
+void PreviewStreamReader::setFrameSize(int width, int height) {
+    m_width = width;
+    m_height = height;
+}
+
+void PreviewStreamReader::setFrameRate(int fps) {
+    m_fps = fps;
+}
+
+void PreviewStreamReader::setFrameFilter(FrameFilter filter) {
+    m_frameFilter = std::move(filter);
+}
+
+QImage PreviewStreamReader::takeLatestFrame() {
+    QMutexLocker locker(&m_frameMutex);
+    QImage frame = std::move(m_latestFrame);
+    m_latestFrame = QImage();
+    m_notifyPending = false;
+    return frame;
+}
+
+PreviewStreamReader::Statistics PreviewStreamReader::statistics() const {
+    Statistics stats;
+    stats.framesReceived = m_framesReceived.load();
+    stats.framesDecoded = m_framesDecoded.load();
+    stats.framesDropped = m_framesDropped.load();
+    stats.bytesReceived = m_bytesReceived.load();
+    stats.filterNs = m_filterNs.load();
+    return stats;
+}
+
+void PreviewStreamReader::start() {
+    if (m_process && m_process->state() != QProcess::NotRunning) {
+        return;
+    }
+
+    if (!m_process) {
+        // Created here rather than in the constructor so it belongs to the worker thread
+        m_process = new QProcess(this);
+        m_process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        connect(m_process, &QProcess::readyReadStandardOutput, this, &PreviewStreamReader::onReadyRead);
+        connect(m_process, &QProcess::errorOccurred, this, &PreviewStreamReader::onProcessError);
+        connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, &PreviewStreamReader::onProcessFinished);
+    }
+
+    m_stopping = false;
+    m_buffer.clear();
+    qCDebug(lcCamera) << "PreviewStreamReader: Starting" << program() << arguments();
+    m_process->start(program(), arguments(), QIODevice::ReadOnly);
+}
+
+void PreviewStreamReader::stop() {
+    m_stopping = true;
+    if (m_process && m_process->state() != QProcess::NotRunning) {
+        qCDebug(lcCamera) << "PreviewStreamReader: Stopping preview stream";
+        m_process->terminate();
+        if (!m_process->waitForFinished(500)) {
+            m_process->kill();
+            m_process->waitForFinished(500);
+        }
+        m_buffer.clear();
+    }
+    emit stopped();
+}
+
+void PreviewStreamReader::onReadyRead() {
+    QByteArray chunk = m_process->readAllStandardOutput();
+    m_bytesReceived += chunk.size();
+    m_buffer.append(chunk);
+
+    if (m_format == Yuv420) {
+        extractYuvFrames();
+    } else {
+        extractMjpegFrames();
+    }
+
+    if (m_buffer.size() > MAX_BUFFERED_BYTES) {
+        qCWarning(lcCamera) << "PreviewStreamReader: Stream out of sync, discarding" << m_buffer.size() << "bytes";
+        m_buffer.clear();
+    }
+}
+
+void PreviewStreamReader::extractMjpegFrames() {
+    static const QByteArray startMarker("\xFF\xD8", 2);
+    static const QByteArray endMarker("\xFF\xD9", 2);
+
+    qsizetype lastStart = -1;
+    qsizetype lastEnd = -1;
+    int completeFrames = 0;
+
+    qsizetype pos = m_buffer.indexOf(startMarker);
+    while (pos >= 0) {
+        qsizetype end = m_buffer.indexOf(endMarker, pos + 2);
+        if (end < 0) {
+            break;
+        }
+        lastStart = pos;
+        lastEnd = end + 2;
+        ++completeFrames;
+        pos = m_buffer.indexOf(startMarker, lastEnd);
+    }
+
+    if (completeFrames == 0) {
+        if (pos < 0) {
+            // No frame start at all; only a trailing 0xFF, the first half
+            // of a start marker split across reads, is worth keeping
+            const bool splitMarker = !m_buffer.isEmpty() && static_cast<uchar>(m_buffer.back()) == 0xFF;
+            m_buffer.remove(0, m_buffer.size() - (splitMarker ? 1 : 0));
+        } else if (pos > 0) {
+            m_buffer.remove(0, pos);
+        }
+        return;
+    }
+
+    m_framesReceived += completeFrames;
+    m_framesDropped += completeFrames - 1;
+
+    QImage frame;
+    frame.loadFromData(reinterpret_cast<const uchar*>(m_buffer.constData() + lastStart),
+                       static_cast<int>(lastEnd - lastStart), "JPEG");
+    m_buffer.remove(0, lastEnd);
+
+    if (frame.isNull()) {
+        m_framesDropped += 1;
+        return;
+    }
+    publishFrame(frame);
+}
+
+void PreviewStreamReader::extractYuvFrames() {
+    const qsizetype frameBytes = static_cast<qsizetype>(m_width) * m_height * 3 / 2;
+    const qsizetype completeFrames = m_buffer.size() / frameBytes;
+    if (completeFrames == 0) {
+        return;
+    }
+
+    m_framesReceived += completeFrames;
+    m_framesDropped += completeFrames - 1;
+
+    const char* newest = m_buffer.constData() + (completeFrames - 1) * frameBytes;
+    QImage frame = convertYuv420(newest, m_width, m_height);
+    m_buffer.remove(0, completeFrames * frameBytes);
+    publishFrame(frame);
+}
+
+void PreviewStreamReader::publishFrame(const QImage& frame) {
+    ++m_framesDecoded;
+    emit frameDecoded(frame);
+
+    QImage parked = frame;
+    if (m_frameFilter) {
+        QElapsedTimer filterTimer;
+        filterTimer.start();
+        parked = m_frameFilter(frame);
+        m_filterNs += filterTimer.nsecsElapsed();
+    }
+    {
+        QMutexLocker locker(&m_frameMutex);
+        if (!m_latestFrame.isNull()) {
+            // Consumer never picked up the previous frame
+            ++m_framesDropped;
+        }
+        m_latestFrame = parked;
+    }
+
+    if (!m_notifyPending.exchange(true)) {
+        emit frameAvailable();
+    }
+}
+
+QImage PreviewStreamReader::convertYuv420(const char* data, int width, int height) {
+    // Planar I420 as written by libcamera-vid --codec yuv420, BT.601 limited range
+    const uchar* yPlane = reinterpret_cast<const uchar*>(data);
+    const uchar* uPlane = yPlane + width * height;
+    const uchar* vPlane = uPlane + (width / 2) * (height / 2);
+
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const uchar* yRow = yPlane + y * width;
+        const uchar* uRow = uPlane + (y / 2) * (width / 2);
+        const uchar* vRow = vPlane + (y / 2) * (width / 2);
+        for (int x = 0; x < width; ++x) {
+            int c = (yRow[x] - 16) * 298;
+            int d = uRow[x / 2] - 128;
+            int e = vRow[x / 2] - 128;
+            int r = (c + 409 * e + 128) >> 8;
+            int g = (c - 100 * d - 208 * e + 128) >> 8;
+            int b = (c + 516 * d + 128) >> 8;
+            line[x] = qRgb(std::clamp(r, 0, 255), std::clamp(g, 0, 255), std::clamp(b, 0, 255));
+        }
+    }
+    return image;
+}
+
+void PreviewStreamReader::onProcessError(QProcess::ProcessError error) {
+    if (m_stopping) {
+        return;
+    }
+    qCWarning(lcCamera) << "PreviewStreamReader: Preview process error" << error;
+    if (error == QProcess::FailedToStart) {
+        emit streamError("Failed to start preview stream");
+    }
+}
+
+void PreviewStreamReader::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    if (m_stopping) {
+        return;
+    }
+    qCWarning(lcCamera) << "PreviewStreamReader: Preview process exited, code" << exitCode << "status" << exitStatus;
+    emit streamError(QString("Preview stream exited with code: %1").arg(exitCode));
+}
+
+QString PreviewStreamReader::program() const {
+    QString command = qEnvironmentVariable("PHOTOBOOTH_PI_PREVIEW_COMMAND");
+    if (!command.isEmpty()) {
+        return QProcess::splitCommand(command).value(0);
+    }
+    return "libcamera-vid";
+}
+
+QStringList PreviewStreamReader::arguments() const {
+    QString command = qEnvironmentVariable("PHOTOBOOTH_PI_PREVIEW_COMMAND");
+    if (!command.isEmpty()) {
+        return QProcess::splitCommand(command).mid(1);
+    }
+
+    QStringList arguments;
+    arguments << "--timeout" << "0";
+    arguments << "--nopreview";
+    arguments << "--width" << QString::number(m_width);
+    arguments << "--height" << QString::number(m_height);
+    arguments << "--framerate" << QString::number(m_fps);
+    arguments << "--codec" << (m_format == Yuv420 ? "yuv420" : "mjpeg");
+    arguments << "--flush";
+    arguments << "--output" << "-";
+    return arguments;
+}
@@ -0,0 +1,104 @@
+#ifndef PREVIEWSTREAMREADER_H
+#define PREVIEWSTREAMREADER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+
+// Runs a command that writes preview frames to stdout (libcamera-vid by default)
+// and decodes them on the thread this object lives in. Only the newest complete
+// frame in each read is decoded; older ones are counted as dropped. The decoded
+// frame is parked in a single slot and frameAvailable() is emitted at most once
+// until the consumer calls takeLatestFrame(), so a slow GUI never builds a queue.
+// A frame filter, if set, runs on the reader's thread before a frame is parked,
+// so the consumer gets the frame ready to paint.
+//
+// stop() runs on the reader's thread and emits stopped() once the process has
+// exited, so the GUI thread can hand the sensor on without waiting for it.
+//
+// Set PHOTOBOOTH_PI_PREVIEW_COMMAND to replace the command line, e.g. with
+// fakepreviewstream to replay a recorded stream.
+class PreviewStreamReader : public QObject {
+    Q_OBJECT
+
+public:
+    enum StreamFormat {
+        Mjpeg,
+        Yuv420
+    };
+
+    struct Statistics {
+        quint64 framesReceived = 0;
+        quint64 framesDecoded = 0;
+        quint64 framesDropped = 0;
+        quint64 bytesReceived = 0;
+        qint64 filterNs = 0;            // Spent in the frame filter
+    };
+
+    using FrameFilter = std::function<QImage(const QImage& frame)>;
+
+    explicit PreviewStreamReader(QObject *parent = nullptr);
+    ~PreviewStreamReader() override;
+
+    void setFormat(StreamFormat format);
+    void setFrameSize(int width, int height);
+    void setFrameRate(int fps);
+    // Set before the reader is started; takeLatestFrame() returns its result
+    void setFrameFilter(FrameFilter filter);
+
+    // Thread-safe; may be called from any thread
+    QImage takeLatestFrame();
+    Statistics statistics() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameAvailable();
+    // Emitted on the reader's thread for every decoded frame, before it is parked
+    void frameDecoded(const QImage& frame);
+    void streamError(const QString& errorMessage);
+    void stopped();
+
+private slots:
+    void onReadyRead();
+    void onProcessError(QProcess::ProcessError error);
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    QString program() const;
+    QStringList arguments() const;
+    void extractMjpegFrames();
+    void extractYuvFrames();
+    void publishFrame(const QImage& frame);
+    static QImage convertYuv420(const char* data, int width, int height);
+
+    QProcess *m_process;
+    QByteArray m_buffer;
+    StreamFormat m_format;
+    int m_width;
+    int m_height;
+    int m_fps;
+    bool m_stopping;
+    FrameFilter m_frameFilter;
+
+    mutable QMutex m_frameMutex;
+    QImage m_latestFrame;
+    std::atomic<bool> m_notifyPending;
+
+    std::atomic<quint64> m_framesReceived;
+    std::atomic<quint64> m_framesDecoded;
+    std::atomic<quint64> m_framesDropped;
+    std::atomic<quint64> m_bytesReceived;
+    std::atomic<qint64> m_filterNs;
+
+    static const int MAX_BUFFERED_BYTES = 8 * 1024 * 1024;
+};
+
+#endif // PREVIEWSTREAMREADER_H
@@ -0,0 +1,52 @@
+#include "previewwidget.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QElapsedTimer>
+
+PreviewWidget::PreviewWidget(QWidget *parent)
+    : QWidget(parent)
+    , m_framesPainted(0)
+    , m_paintNs(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(640, 480);
+}
+
+void PreviewWidget::setFrame(const QImage& frame) {
+    m_frame = frame;
+    update();
+}
+
+void PreviewWidget::clearFrame() {
+    m_frame = QImage();
+    update();
+}
+
+void PreviewWidget::setPlaceholderText(const QString& text) {
+    m_placeholderText = text;
+    update();
+}
+
+void PreviewWidget::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (m_frame.isNull()) {
+        painter.setPen(Qt::white);
+        QFont font = painter.font();
+        font.setPointSize(16);
+        painter.setFont(font);
+        painter.drawText(rect(), Qt::AlignCenter, m_placeholderText);
+        return;
+    }
+
+    QSize scaled = m_frame.size().scaled(size(), Qt::KeepAspectRatio);
+    QRect target(QPoint(0, 0), scaled);
+    target.moveCenter(rect().center());
+    painter.drawImage(target, m_frame);
+    ++m_framesPainted;
+    m_paintNs += paintTimer.nsecsElapsed();
+}
@@ -0,0 +1,35 @@
+#ifndef PREVIEWWIDGET_H
+#define PREVIEWWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <QString>
+
+// Paints the most recent preview frame scaled to fit, or a placeholder text
+// when no frame is available. Frames are drawn without smoothing to keep the
+// per-frame GUI cost low. Keying and grading happen before a frame gets here,
+// on the thread that produced it (see ICamera::lookedPreview()).
+class PreviewWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit PreviewWidget(QWidget *parent = nullptr);
+
+    void setFrame(const QImage& frame);
+    void clearFrame();
+    void setPlaceholderText(const QString& text);
+
+    quint64 framesPainted() const { return m_framesPainted; }
+    qint64 paintNs() const { return m_paintNs; }   // Total time spent painting frames
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QImage m_frame;
+    QString m_placeholderText;
+    quint64 m_framesPainted;
+    qint64 m_paintNs;
+};
+
+#endif // PREVIEWWIDGET_H
@@ -0,0 +1,379 @@
+#include "printqueue.h"
+#include "boothlog.h"
+#include "printsink.h"
+#include "photostorage.h"
+#include "photocompositor.h"
+#include "imagedownscaler.h"
+#include <QBuffer>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+namespace {
+
+// Until the printer has been timed, assume a dye-sub's half minute a page
+const double INITIAL_PRINT_MS = 30000.0;
+const double PRINT_AVERAGE_WEIGHT = 0.3;
+const int MIN_BACKOFF_MS = 2000;
+const int MAX_BACKOFF_MS = 60000;
+
+int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+QSize envSize(const char* name, const QSize& defaultValue) {
+    const QStringList parts = qEnvironmentVariable(name).split('x');
+    if (parts.size() != 2 || parts[0].toInt() <= 0 || parts[1].toInt() <= 0) {
+        return defaultValue;
+    }
+    return QSize(parts[0].toInt(), parts[1].toInt());
+}
+
+QString defaultDirectory() {
+    const QString directory = qEnvironmentVariable("PHOTOBOOTH_PRINT_QUEUE_DIR");
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/printqueue";
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(PrintQueue, s_printQueue,
+    (defaultDirectory(), PrintSink::fromEnvironment(),
+     envInt("PHOTOBOOTH_PRINT_QUEUE", PrintQueue::DEFAULT_CAPACITY),
+     envSize("PHOTOBOOTH_PRINT_SIZE", QSize(PhotoCompositor::PRINT_WIDTH, PhotoCompositor::PRINT_HEIGHT)),
+     envInt("PHOTOBOOTH_PRINT_DELAYED_S", 120) * 1000))
+
+PrintQueue* PrintQueue::instance() {
+    return s_printQueue();
+}
+
+PrintQueue::PrintQueue(const QString& directory, std::unique_ptr<PrintSink> sink, int capacity,
+                       const QSize& printSize, int delayedThresholdMs, QObject *parent)
+    : QObject(parent)
+    , m_directory(QDir(directory).absolutePath())
+    , m_sink(std::move(sink))
+    , m_capacity(std::max(1, capacity))
+    , m_printSize(printSize)
+    , m_delayedThresholdMs(delayedThresholdMs)
+    , m_rendering(0)
+    , m_printing(false)
+    , m_printingSubmittedMs(0)
+    , m_lastAttemptFailed(false)
+    , m_delayed(false)
+    , m_shuttingDown(false)
+    , m_nextId(1)
+    , m_averagePrintMs(INITIAL_PRINT_MS)
+    , m_dispatcher(nullptr)
+{
+    recover();
+    if (!m_sink) {
+        qCDebug(lcPrint) << "PrintQueue: Printing disabled," << m_queue.size() << "jobs left in" << m_directory;
+        return;
+    }
+    m_dispatcher = QThread::create([this]() { dispatcherLoop(); });
+    m_dispatcher->setObjectName("PrintQueue");
+    m_dispatcher->start(QThread::LowPriority);
+    qCDebug(lcPrint) << "PrintQueue: Printing to" << m_sink->name() << "at" << m_printSize
+             << ", capacity" << m_capacity << "," << m_queue.size() << "jobs recovered";
+    if (!m_queue.empty()) {
+        publishState();
+    }
+}
+
+PrintQueue::~PrintQueue() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shuttingDown = true;
+        m_jobAvailable.wakeAll();
+        // Renders in flight still hold this; their pages land on disk for next time
+        while (m_rendering > 0) {
+            m_idle.wait(&m_mutex);
+        }
+    }
+    if (m_sink) {
+        m_sink->abort();
+    }
+    if (m_dispatcher) {
+        m_dispatcher->wait();
+        delete m_dispatcher;
+    }
+}
+
+QString PrintQueue::sinkName() const {
+    return m_sink ? m_sink->name() : QString("none");
+}
+
+QString PrintQueue::imagePath(quint64 id) const {
+    return QDir(m_directory).filePath(QString("%1.jpg").arg(id, 10, 10, QChar('0')));
+}
+
+QString PrintQueue::manifestPath(quint64 id) const {
+    return QDir(m_directory).filePath(QString("%1.job").arg(id, 10, 10, QChar('0')));
+}
+
+void PrintQueue::recover() {
+    if (!QDir().mkpath(m_directory)) {
+        qCWarning(lcPrint) << "PrintQueue: Failed to create queue directory:" << m_directory;
+        return;
+    }
+    const QDir dir(m_directory);
+    const QStringList manifests = dir.entryList(QStringList() << "*.job", QDir::Files, QDir::Name);
+    for (const QString& fileName : manifests) {
+        QFile file(dir.filePath(fileName));
+        const QJsonObject manifest = file.open(QIODevice::ReadOnly)
+            ? QJsonDocument::fromJson(file.readAll()).object() : QJsonObject();
+        Job job;
+        job.id = manifest.value("id").toString().toULongLong();
+        job.guestName = manifest.value("guest").toString();
+        job.submittedMs = manifest.value("submitted").toInteger();
+        if (job.id == 0 || !QFile::exists(imagePath(job.id))) {
+            qCWarning(lcPrint) << "PrintQueue: Dropping unreadable job" << fileName;
+            QFile::remove(dir.filePath(fileName));
+            continue;
+        }
+        m_queue.push_back(job);
+        m_nextId = std::max(m_nextId, job.id + 1);
+        ++m_statistics.recovered;
+    }
+
+    // A page without a manifest never became a job
+    const QStringList images = dir.entryList(QStringList() << "*.jpg", QDir::Files);
+    for (const QString& fileName : images) {
+        if (!QFile::exists(manifestPath(QFileInfo(fileName).completeBaseName().toULongLong()))) {
+            QFile::remove(dir.filePath(fileName));
+        }
+    }
+}
+
+quint64 PrintQueue::submit(const QImage& page, const QString& guestName) {
+    Job job;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_sink || page.isNull() || m_shuttingDown || depthLocked() >= m_capacity) {
+            ++m_statistics.rejected;
+            qCWarning(lcPrint) << "PrintQueue: Not queueing print for" << guestName << "-"
+                       << (m_sink ? "queue full" : "printing disabled");
+            return 0;
+        }
+        job.id = m_nextId++;
+        job.guestName = guestName;
+        job.submittedMs = QDateTime::currentMSecsSinceEpoch();
+        ++m_rendering;
+        ++m_statistics.submitted;
+    }
+    publishState();
+
+    QThreadPool::globalInstance()->start([this, job, page]() { render(job, page); });
+    return job.id;
+}
+
+void PrintQueue::render(Job job, const QImage& page) {
+    QElapsedTimer timer;
+    timer.start();
+    const QImage rendered = renderPage(page, m_printSize);
+    QByteArray encoded;
+    bool ok = false;
+    {
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "jpg");
+        writer.setQuality(95);
+        ok = writer.write(rendered);
+    }
+
+    // The manifest is the commit point, so it goes second
+    QJsonObject manifest;
+    manifest.insert("id", QString::number(job.id));
+    manifest.insert("guest", job.guestName);
+    manifest.insert("submitted", job.submittedMs);
+    QString errorMessage = ok ? QString() : QString("Failed to encode print");
+    ok = ok && PhotoStorage::instance()->write(imagePath(job.id), encoded, &errorMessage) &&
+         PhotoStorage::instance()->write(manifestPath(job.id), QJsonDocument(manifest).toJson(QJsonDocument::Compact),
+                                         &errorMessage);
+    if (!ok) {
+        QFile::remove(imagePath(job.id));
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        --m_rendering;
+        if (ok) {
+            const auto position = std::lower_bound(m_queue.begin(), m_queue.end(), job.id,
+                                                   [](const Job& queued, quint64 id) { return queued.id < id; });
+            m_queue.insert(position, job);
+            m_jobAvailable.wakeOne();
+        }
+        m_idle.wakeAll();
+    }
+
+    if (ok) {
+        qCDebug(lcPrint) << "PrintQueue: Job" << job.id << "rendered in" << timer.elapsed() << "ms";
+    } else {
+        qCWarning(lcPrint) << "PrintQueue: Job" << job.id << "failed to render:" << errorMessage;
+        emit jobFailed(job.id, errorMessage);
+    }
+    publishState();
+}
+
+void PrintQueue::dispatcherLoop() {
+    forever {
+        Job job;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.empty() && !m_shuttingDown) {
+                m_jobAvailable.wait(&m_mutex);
+            }
+            if (m_shuttingDown) {
+                return; // Whatever is queued stays on disk for the next start
+            }
+            job = m_queue.front();
+            m_queue.pop_front();
+            m_printing = true;
+            m_printingSubmittedMs = job.submittedMs;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QString errorMessage;
+        const bool ok = m_sink->print(imagePath(job.id), &errorMessage);
+        const qint64 printNs = timer.nsecsElapsed();
+        if (ok) {
+            // Manifest first: a page left on its own is cleaned up at start-up
+            QFile::remove(manifestPath(job.id));
+            QFile::remove(imagePath(job.id));
+        }
+        const qint64 queueMs = QDateTime::currentMSecsSinceEpoch() - job.submittedMs;
+
+        int backoffMs = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            m_printing = false;
+            if (ok) {
+                ++m_statistics.printed;
+                m_lastAttemptFailed = false;
+                m_queueLatency.record(std::max<qint64>(0, queueMs) * 1000000);
+                m_printLatency.record(printNs);
+                m_averagePrintMs = PRINT_AVERAGE_WEIGHT * (printNs / 1e6) + (1.0 - PRINT_AVERAGE_WEIGHT) * m_averagePrintMs;
+            } else {
+                // Stays at the head; a printer out of paper isn't hammered
+                ++m_statistics.failedAttempts;
+                ++job.attempts;
+                m_lastAttemptFailed = true;
+                m_queue.push_front(job);
+                backoffMs = std::min(MAX_BACKOFF_MS, MIN_BACKOFF_MS << std::min(job.attempts - 1, 5));
+            }
+            m_idle.wakeAll();
+        }
+
+        if (ok) {
+            qCDebug(lcPrint) << "PrintQueue: Printed job" << job.id << "in" << printNs / 1000000 << "ms,"
+                     << queueMs << "ms after it was submitted";
+            emit jobPrinted(job.id, queueMs);
+        } else {
+            qCWarning(lcPrint) << "PrintQueue: Job" << job.id << "attempt" << job.attempts << "failed:" << errorMessage
+                       << "- retrying in" << backoffMs << "ms";
+            emit jobFailed(job.id, errorMessage);
+        }
+        publishState();
+
+        if (backoffMs > 0) {
+            QDeadlineTimer deadline(backoffMs);
+            QMutexLocker locker(&m_mutex);
+            while (!m_shuttingDown && m_jobAvailable.wait(&m_mutex, deadline)) {
+            }
+        }
+    }
+}
+
+int PrintQueue::depthLocked() const {
+    return static_cast<int>(m_queue.size()) + m_rendering + (m_printing ? 1 : 0);
+}
+
+qint64 PrintQueue::estimatedWaitLocked() const {
+    return static_cast<qint64>(depthLocked() * m_averagePrintMs);
+}
+
+void PrintQueue::publishState() {
+    int depth = 0;
+    bool delayed = false;
+    bool changed = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        depth = depthLocked();
+        delayed = m_lastAttemptFailed || depth >= m_capacity || estimatedWaitLocked() > m_delayedThresholdMs;
+        changed = delayed != m_delayed;
+        m_delayed = delayed;
+    }
+    emit depthChanged(depth);
+    if (changed) {
+        qCDebug(lcPrint) << "PrintQueue: Prints" << (delayed ? "delayed" : "on time") << "," << depth << "in queue";
+        emit delayedChanged(delayed);
+    }
+}
+
+int PrintQueue::depth() const {
+    QMutexLocker locker(&m_mutex);
+    return depthLocked();
+}
+
+bool PrintQueue::isDelayed() const {
+    QMutexLocker locker(&m_mutex);
+    return m_delayed;
+}
+
+PrintQueue::Statistics PrintQueue::statistics() const {
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.depth = depthLocked();
+    statistics.estimatedWaitMs = estimatedWaitLocked();
+    if (m_statistics.printed > 0) {
+        statistics.pagesPerMinute = 60000.0 / m_averagePrintMs;
+    }
+    qint64 oldestMs = m_printing ? m_printingSubmittedMs : 0;
+    if (!m_queue.empty() && (oldestMs == 0 || m_queue.front().submittedMs < oldestMs)) {
+        oldestMs = m_queue.front().submittedMs;
+    }
+    if (oldestMs > 0) {
+        statistics.oldestWaitMs = QDateTime::currentMSecsSinceEpoch() - oldestMs;
+    }
+    return statistics;
+}
+
+bool PrintQueue::waitForIdle(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (depthLocked() > 0) {
+        if (!m_idle.wait(&m_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QImage PrintQueue::renderPage(const QImage& source, const QSize& printSize) {
+    if (source.isNull() || printSize.isEmpty() || source.size() == printSize) {
+        return source;
+    }
+    const QSize filled = source.size().scaled(printSize, Qt::KeepAspectRatioByExpanding);
+    const QImage scaled = filled.width() < source.width()
+        ? ImageDownscaler::areaAverage(source, filled)
+        : source.scaled(filled, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return scaled.copy(QRect(QPoint((filled.width() - printSize.width()) / 2,
+                                    (filled.height() - printSize.height()) / 2), printSize));
+}
@@ -0,0 +1,130 @@
+#ifndef PRINTQUEUE_H
+#define PRINTQUEUE_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QWaitCondition>
+#include <deque>
+#include <memory>
+#include "latencyhistogram.h"
+
+class QThread;
+class PrintSink;
+
+// Prints finished sessions without ever making the guest wait for the printer.
+//
+// submit() only reserves a place: the page is rendered to printer resolution
+// on the thread pool and written to the queue directory as <id>.jpg plus an
+// <id>.job manifest, which is written last and is what makes the job real.
+// A dispatcher thread sends jobs to the PrintSink oldest first, one at a
+// time, and deletes them once the sink has the page. Jobs still on disk at
+// start-up are printed then, so a crash or power cut may at worst print a
+// page twice, never drop one.
+//
+// The queue is bounded: submit() refuses work once capacity jobs are
+// rendering, queued or printing. Well before that, delayedChanged() tells
+// the UI that prints are running behind, when the estimated wait passes the
+// threshold or the printer has just failed. A failed page stays at the head
+// and is retried with backoff.
+//
+// Signals are emitted from worker threads.
+class PrintQueue : public QObject {
+    Q_OBJECT
+
+public:
+    struct Statistics {
+        int depth = 0;                  // Rendering, queued and printing
+        quint64 submitted = 0;
+        quint64 printed = 0;
+        quint64 rejected = 0;           // Queue full or printing disabled
+        quint64 failedAttempts = 0;
+        quint64 recovered = 0;          // Found on disk at start-up
+        qint64 oldestWaitMs = 0;        // Time in queue of the oldest job
+        qint64 estimatedWaitMs = 0;     // For a page submitted now
+        double pagesPerMinute = 0.0;    // Printer throughput, recent average
+    };
+
+    static const int DEFAULT_CAPACITY = 20;
+
+    // A null sink disables printing. printSize empty renders at the source size.
+    PrintQueue(const QString& directory, std::unique_ptr<PrintSink> sink, int capacity,
+               const QSize& printSize, int delayedThresholdMs, QObject *parent = nullptr);
+    ~PrintQueue() override;
+
+    // Shared instance configured from PHOTOBOOTH_PRINTER (see PrintSink),
+    // PHOTOBOOTH_PRINT_QUEUE_DIR, PHOTOBOOTH_PRINT_QUEUE (capacity),
+    // PHOTOBOOTH_PRINT_SIZE (WxH, the compositor's page by default) and
+    // PHOTOBOOTH_PRINT_DELAYED_S (120 by default).
+    static PrintQueue* instance();
+
+    bool isEnabled() const { return m_sink != nullptr; }
+    int capacity() const { return m_capacity; }
+    QString sinkName() const;
+
+    // Returns a job id, or 0 if printing is disabled or the queue is full.
+    // Never blocks on rendering or the printer.
+    quint64 submit(const QImage& page, const QString& guestName);
+
+    int depth() const;
+    bool isDelayed() const;
+    Statistics statistics() const;
+    const LatencyHistogram& queueLatency() const { return m_queueLatency; }   // Submit to printed
+    const LatencyHistogram& printLatency() const { return m_printLatency; }   // Sink time per page
+
+    // Blocks until nothing is rendering, queued or printing
+    bool waitForIdle(int timeoutMs);
+
+    // Fill to printSize and crop the overflow, as for borderless prints
+    static QImage renderPage(const QImage& source, const QSize& printSize);
+
+signals:
+    void depthChanged(int depth);
+    void delayedChanged(bool delayed);
+    void jobPrinted(quint64 jobId, qint64 queueMs);
+    void jobFailed(quint64 jobId, const QString& errorMessage);
+
+private:
+    struct Job {
+        quint64 id = 0;
+        QString guestName;
+        qint64 submittedMs = 0;
+        int attempts = 0;
+    };
+
+    void recover();
+    void render(Job job, const QImage& page);
+    void dispatcherLoop();
+    void publishState();
+    int depthLocked() const;
+    qint64 estimatedWaitLocked() const;
+    QString imagePath(quint64 id) const;
+    QString manifestPath(quint64 id) const;
+
+    const QString m_directory;
+    const std::unique_ptr<PrintSink> m_sink;
+    const int m_capacity;
+    const QSize m_printSize;
+    const int m_delayedThresholdMs;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_jobAvailable;
+    QWaitCondition m_idle;
+    std::deque<Job> m_queue;            // On disk, by id
+    int m_rendering;
+    bool m_printing;
+    qint64 m_printingSubmittedMs;
+    bool m_lastAttemptFailed;
+    bool m_delayed;
+    bool m_shuttingDown;
+    quint64 m_nextId;
+    double m_averagePrintMs;
+    Statistics m_statistics;
+    LatencyHistogram m_queueLatency;
+    LatencyHistogram m_printLatency;
+    QThread *m_dispatcher;
+};
+
+#endif // PRINTQUEUE_H
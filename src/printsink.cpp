@@ -0,0 +1,163 @@
+#include "printsink.h"
+#include "boothlog.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+const int LP_TIMEOUT_MS = 30000;
+const int LPSTAT_POLL_MS = 2000;
+const int PRINT_TIMEOUT_MS = 15 * 60 * 1000;
+
+int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value >= 0 ? value : defaultValue;
+}
+
+} // namespace
+
+std::unique_ptr<PrintSink> PrintSink::fromEnvironment() {
+    const QString spec = qEnvironmentVariable("PHOTOBOOTH_PRINTER");
+    const QString kind = spec.section(':', 0, 0).toLower();
+    const QString argument = spec.section(':', 1);
+    const QStringList options = qEnvironmentVariable("PHOTOBOOTH_PRINT_OPTIONS").split(' ', Qt::SkipEmptyParts);
+
+    if (spec.isEmpty()) {
+        qCDebug(lcPrint) << "PrintSink: PHOTOBOOTH_PRINTER not set, printing disabled";
+        return nullptr;
+    } else if (kind == "lp") {
+        return std::make_unique<LpPrintSink>(argument, options);
+    } else if (kind == "spool") {
+        const QString directory = argument.isEmpty()
+            ? QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/printspool"
+            : argument;
+        return std::make_unique<SpoolDirectoryPrintSink>(directory, envInt("PHOTOBOOTH_PRINT_PAGE_MS", 0));
+    } else if (kind != "none") {
+        qCWarning(lcPrint) << "PrintSink: Unknown printer" << spec << ", printing disabled";
+    }
+    return nullptr;
+}
+
+bool PrintSink::sleepUnlessAborted(int ms) const {
+    QElapsedTimer timer;
+    timer.start();
+    while (!isAborted() && timer.elapsed() < ms) {
+        QThread::msleep(std::min<qint64>(50, ms - timer.elapsed()));
+    }
+    return !isAborted();
+}
+
+LpPrintSink::LpPrintSink(const QString& destination, const QStringList& options)
+    : m_destination(destination)
+    , m_options(options)
+{
+}
+
+QString LpPrintSink::name() const {
+    return m_destination.isEmpty() ? QString("lp") : QString("lp:%1").arg(m_destination);
+}
+
+bool LpPrintSink::print(const QString& filePath, QString *errorMessage) {
+    QStringList arguments;
+    if (!m_destination.isEmpty()) {
+        arguments << "-d" << m_destination;
+    }
+    for (const QString& option : m_options) {
+        arguments << "-o" << option;
+    }
+    arguments << filePath;
+
+    QProcess lp;
+    lp.start("lp", arguments);
+    if (!lp.waitForFinished(LP_TIMEOUT_MS)) {
+        *errorMessage = QString("lp did not finish: %1").arg(lp.errorString());
+        lp.kill();
+        lp.waitForFinished(1000);
+        return false;
+    }
+    if (lp.exitStatus() != QProcess::NormalExit || lp.exitCode() != 0) {
+        *errorMessage = QString::fromLocal8Bit(lp.readAllStandardError()).trimmed();
+        if (errorMessage->isEmpty()) {
+            *errorMessage = QString("lp exited with code %1").arg(lp.exitCode());
+        }
+        return false;
+    }
+
+    // "request id is booth-42 (1 file(s))". CUPS owns the page from here, so
+    // nothing after this point may fail the job.
+    const QRegularExpressionMatch match =
+        QRegularExpression("request id is (\\S+)").match(QString::fromLocal8Bit(lp.readAllStandardOutput()));
+    if (match.hasMatch()) {
+        waitForCompletion(match.captured(1));
+    }
+    return true;
+}
+
+void LpPrintSink::waitForCompletion(const QString& requestId) {
+    QStringList arguments;
+    arguments << "-W" << "not-completed" << "-o";
+    if (!m_destination.isEmpty()) {
+        arguments << m_destination;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < PRINT_TIMEOUT_MS) {
+        QProcess lpstat;
+        lpstat.start("lpstat", arguments);
+        if (!lpstat.waitForFinished(LP_TIMEOUT_MS) || lpstat.exitCode() != 0) {
+            return; // Can't follow it; the spooler still has it
+        }
+        const QStringList jobs = QString::fromLocal8Bit(lpstat.readAllStandardOutput()).split('\n');
+        const bool pending = std::any_of(jobs.cbegin(), jobs.cend(), [&requestId](const QString& line) {
+            return line.section(' ', 0, 0, QString::SectionSkipEmpty) == requestId;
+        });
+        if (!pending || !sleepUnlessAborted(LPSTAT_POLL_MS)) {
+            return;
+        }
+    }
+    qCWarning(lcPrint) << "LpPrintSink:" << requestId << "still printing after" << PRINT_TIMEOUT_MS / 60000 << "minutes";
+}
+
+SpoolDirectoryPrintSink::SpoolDirectoryPrintSink(const QString& directory, int pageMs)
+    : m_directory(directory)
+    , m_pageMs(pageMs)
+    , m_sequence(0)
+{
+    if (!QDir().mkpath(m_directory)) {
+        qCWarning(lcPrint) << "SpoolDirectoryPrintSink: Failed to create" << m_directory;
+    }
+}
+
+QString SpoolDirectoryPrintSink::name() const {
+    return QString("spool:%1").arg(m_directory);
+}
+
+bool SpoolDirectoryPrintSink::print(const QString& filePath, QString *errorMessage) {
+    // Job ids restart with the queue, so the name also carries the time
+    const QString fileName = QString("print_%1_%2.%3")
+        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz"))
+        .arg(++m_sequence, 4, 10, QChar('0'))
+        .arg(QFileInfo(filePath).suffix());
+    const QString target = QDir(m_directory).filePath(fileName);
+    const QString partial = target + ".part";
+
+    QFile::remove(partial);
+    if (!QFile::copy(filePath, partial) || !QFile::rename(partial, target)) {
+        QFile::remove(partial);
+        *errorMessage = QString("Failed to spool %1 to %2").arg(filePath, m_directory);
+        return false;
+    }
+    sleepUnlessAborted(m_pageMs);
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef PRINTSINK_H
+#define PRINTSINK_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+
+// Where PrintQueue sends finished pages. print() is only ever called from the
+// queue's dispatcher thread, one page at a time, and may block for as long as
+// the printer takes; abort() is called from another thread on shutdown.
+class PrintSink {
+public:
+    virtual ~PrintSink() = default;
+
+    virtual QString name() const = 0;
+
+    // Returns once the printer has taken the page. A false return leaves the
+    // job queued to be retried, so a sink must only fail if the page can't
+    // have been printed.
+    virtual bool print(const QString& filePath, QString *errorMessage) = 0;
+
+    // Cuts short any waiting in print(); the page in hand still counts
+    void abort() { m_aborted.store(true, std::memory_order_relaxed); }
+
+    // PHOTOBOOTH_PRINTER: "lp" or "lp:<destination>" for CUPS,
+    // "spool:<directory>" for a directory stand-in, "none" to disable
+    // printing. Printing is opt-in: unset disables it too, so a machine that
+    // merely has CUPS doesn't print to its default queue. Returns null when
+    // printing is disabled.
+    static std::unique_ptr<PrintSink> fromEnvironment();
+
+protected:
+    bool isAborted() const { return m_aborted.load(std::memory_order_relaxed); }
+
+    // Sleeps in short steps so abort() isn't held up; false if aborted
+    bool sleepUnlessAborted(int ms) const;
+
+private:
+    std::atomic<bool> m_aborted{false};
+};
+
+// Hands pages to CUPS with lp, then follows the request with lpstat until
+// it leaves the not-completed list, so the queue's pace and throughput are
+// the printer's rather than the spooler's. Options from
+// PHOTOBOOTH_PRINT_OPTIONS are passed as -o, e.g. "media=4x6 fit-to-page".
+class LpPrintSink : public PrintSink {
+public:
+    explicit LpPrintSink(const QString& destination = QString(), const QStringList& options = QStringList());
+
+    QString name() const override;
+    bool print(const QString& filePath, QString *errorMessage) override;
+
+private:
+    void waitForCompletion(const QString& requestId);
+
+    QString m_destination;
+    QStringList m_options;
+};
+
+// Copies pages into a directory, renamed into place so a watcher never sees
+// half a file, then waits pageMs as a stand-in for the printer's own time per
+// page. For benchmarks, tests and booths that print from another machine.
+class SpoolDirectoryPrintSink : public PrintSink {
+public:
+    explicit SpoolDirectoryPrintSink(const QString& directory, int pageMs = 0);
+
+    QString name() const override;
+    bool print(const QString& filePath, QString *errorMessage) override;
+
+private:
+    QString m_directory;
+    int m_pageMs;
+    quint64 m_sequence;
+};
+
+#endif // PRINTSINK_H
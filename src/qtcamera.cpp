@@ -1,25 +1,30 @@
 #include "qtcamera.h"
+#include "photostorage.h"
+#include "previewwidget.h"
+#include "boothlog.h"
 #include <QCamera>
-#include <QVideoWidget>
+#include <QMutexLocker>
 #include <QImageCapture>
 #include <QMediaCaptureSession>
-#include <QStandardPaths>
-#include <QDir>
-#include <QDateTime>
+#include <QVideoSink>
+#include <QVideoFrame>
 #include <QDebug>
 #include <QMediaDevices>
 #include <QPermissions>
 #include <QCoreApplication>
+#include <algorithm>
+#include <cstring>
 
 QtCamera::QtCamera(QObject *parent)
     : ICamera(parent)
     , m_camera(nullptr)
-    , m_videoWidget(nullptr)
+    , m_previewWidget(nullptr)
+    , m_videoSink(nullptr)
     , m_imageCapture(nullptr)
     , m_captureSession(nullptr)
     , m_initialized(false)
+    , m_previewFramePending(false)
 {
-    setupPhotosDirectory();
 }
 
 QtCamera::~QtCamera() {
@@ -31,7 +36,7 @@ bool QtCamera::initialize() {
         return true;
     }
 
-    qDebug() << "QtCamera: Initializing Qt camera";
+    qCDebug(lcCamera) << "QtCamera: Initializing Qt camera";
 
     // On macOS, try to initialize directly - the system will prompt for permissions
     return initializeCamera();
@@ -41,56 +46,63 @@ bool QtCamera::initializeCamera() {
     // Check if cameras are available
     const QList<QCameraDevice> cameras = QMediaDevices::videoInputs();
     if (cameras.isEmpty()) {
-        qWarning() << "QtCamera: No cameras available";
+        qCWarning(lcCamera) << "QtCamera: No cameras available";
         return false;
     }
 
     // Use the default camera
     QCameraDevice cameraDevice = QMediaDevices::defaultVideoInput();
     if (cameraDevice.isNull()) {
-        qWarning() << "QtCamera: No default camera found";
+        qCWarning(lcCamera) << "QtCamera: No default camera found";
         return false;
     }
 
-    qDebug() << "QtCamera: Using camera:" << cameraDevice.description();
+    qCDebug(lcCamera) << "QtCamera: Using camera:" << cameraDevice.description();
 
     try {
         // Create camera components
         m_camera = new QCamera(cameraDevice, this);
-        m_videoWidget = new QVideoWidget();
+        m_previewWidget = new PreviewWidget();
+        m_previewWidget->setPlaceholderText("Camera\nPreview");
+        m_videoSink = new QVideoSink(this);
         m_imageCapture = new QImageCapture(this);
         m_captureSession = new QMediaCaptureSession(this);
 
-        // Setup capture session
+        // Setup capture session. Frames come to our own sink rather than a
+        // QVideoWidget, so the preview is keyed and graded like the photo.
         m_captureSession->setCamera(m_camera);
-        m_captureSession->setVideoOutput(m_videoWidget);
+        m_captureSession->setVideoSink(m_videoSink);
         m_captureSession->setImageCapture(m_imageCapture);
 
         // Connect signals
         connect(m_camera, &QCamera::errorOccurred, this, &QtCamera::onCameraError);
         connect(m_camera, &QCamera::activeChanged, this, [this](bool active) {
-            qDebug() << "QtCamera: Camera active state changed to:" << active;
+            qCDebug(lcCamera) << "QtCamera: Camera active state changed to:" << active;
         });
         connect(m_imageCapture, &QImageCapture::imageCaptured, this, &QtCamera::onImageCaptured);
-        connect(m_imageCapture, &QImageCapture::imageSaved, this, &QtCamera::onImageSaved);
+
+        // Frames may arrive on a multimedia thread, so the preview frame is
+        // made and subscribers' frames are copied into the pool right there
+        connect(m_videoSink, &QVideoSink::videoFrameChanged, this, &QtCamera::onVideoFrameChanged,
+                Qt::DirectConnection);
         connect(m_imageCapture, &QImageCapture::errorOccurred, this, &QtCamera::onCaptureError);
 
         // Configure image capture
         m_imageCapture->setFileFormat(QImageCapture::JPEG);
         m_imageCapture->setQuality(QImageCapture::VeryHighQuality);
 
-        // Test camera activation
-        m_camera->start();
-        
+        // The sensor is started by startPreview(). Starting it here blocked
+        // start-up on some backends and left the camera running on the start screen.
+
         m_initialized = true;
-        qDebug() << "QtCamera: Initialization complete";
+        qCDebug(lcCamera) << "QtCamera: Initialization complete";
         return true;
         
     } catch (const std::exception& e) {
-        qWarning() << "QtCamera: Exception during initialization:" << e.what();
+        qCWarning(lcCamera) << "QtCamera: Exception during initialization:" << e.what();
         return false;
     } catch (...) {
-        qWarning() << "QtCamera: Unknown exception during initialization";
+        qCWarning(lcCamera) << "QtCamera: Unknown exception during initialization";
         return false;
     }
 }
@@ -100,7 +112,7 @@ void QtCamera::cleanup() {
         return;
     }
 
-    qDebug() << "QtCamera: Cleaning up";
+    qCDebug(lcCamera) << "QtCamera: Cleaning up";
     stopPreview();
 
     if (m_camera) {
@@ -109,12 +121,13 @@ void QtCamera::cleanup() {
 
     // Qt will handle deletion via parent-child relationships
     m_camera = nullptr;
+    m_videoSink = nullptr;
     m_imageCapture = nullptr;
     m_captureSession = nullptr;
     
-    if (m_videoWidget) {
-        m_videoWidget->deleteLater();
-        m_videoWidget = nullptr;
+    if (m_previewWidget) {
+        m_previewWidget->deleteLater();
+        m_previewWidget = nullptr;
     }
 
     m_initialized = false;
@@ -128,21 +141,22 @@ QWidget* QtCamera::getPreviewWidget() {
     if (!m_initialized) {
         initialize();
     }
-    return m_videoWidget;
+    return m_previewWidget;
 }
 
 void QtCamera::startPreview() {
     if (!m_initialized || !m_camera) {
-        qWarning() << "QtCamera: Cannot start preview - camera not initialized";
+        qCWarning(lcCamera) << "QtCamera: Cannot start preview - camera not initialized";
         return;
     }
 
     if (m_camera->isActive()) {
-        qDebug() << "QtCamera: Preview already active";
+        qCDebug(lcCamera) << "QtCamera: Preview already active";
         return;
     }
 
-    qDebug() << "QtCamera: Starting preview";
+    qCDebug(lcCamera) << "QtCamera: Starting preview";
+    m_previewWidget->setPlaceholderText("Starting preview...");
     m_camera->start();
     emitPreviewStarted();
 }
@@ -156,8 +170,16 @@ void QtCamera::stopPreview() {
         return;
     }
 
-    qDebug() << "QtCamera: Stopping preview";
+    qCDebug(lcCamera) << "QtCamera: Stopping preview";
     m_camera->stop();
+    {
+        QMutexLocker locker(&m_previewFrameMutex);
+        m_previewFrame = QImage();
+    }
+    if (m_previewWidget) {
+        m_previewWidget->clearFrame();
+        m_previewWidget->setPlaceholderText("Camera\nPreview Stopped");
+    }
     emitPreviewStopped();
 }
 
@@ -177,43 +199,128 @@ void QtCamera::capturePhoto() {
         return;
     }
 
-    // Generate filename with timestamp
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
-    QString filename = QString("%1/photo_%2.jpg").arg(m_photosDirectory, timestamp);
+    QString filename = PhotoStorage::instance()->nextPhotoPath("photo", "jpg");
 
-    qDebug() << "QtCamera: Capturing photo to" << filename;
-    m_imageCapture->captureToFile(filename);
+    qCDebug(lcCamera) << "QtCamera: Capturing photo to" << filename;
+    // Capture into memory only; the JPEG is encoded and written by the save workers
+    int id = m_imageCapture->capture();
+    if (id >= 0) {
+        m_pendingCaptures.insert(id, filename);
+    }
 }
 
 void QtCamera::cancelCapture() {
     // Qt's QImageCapture doesn't have a direct cancel method
     // The capture is usually very fast, so this is mainly for interface compliance
-    qDebug() << "QtCamera: Capture cancel requested (not directly supported by Qt)";
+    qCDebug(lcCamera) << "QtCamera: Capture cancel requested (not directly supported by Qt)";
 }
 
 void QtCamera::onImageCaptured(int id, const QImage& image) {
-    Q_UNUSED(id)
-    qDebug() << "QtCamera: Image captured, size:" << image.size();
-    // The actual file saving is handled by onImageSaved
+    qCDebug(lcCamera) << "QtCamera: Image captured, size:" << image.size();
+    QString fileName = m_pendingCaptures.take(id);
+
+    // Keyed, graded and scaled to review size on a worker, then handed to the
+    // UI and queued for writing
+    deliverPhoto(image, fileName);
 }
 
-void QtCamera::onImageSaved(int id, const QString& fileName) {
-    Q_UNUSED(id)
-    qDebug() << "QtCamera: Image saved to" << fileName;
-    
-    // Load the saved image and emit the signal
-    QPixmap pixmap(fileName);
-    if (!pixmap.isNull()) {
-        emitPhotoReady(pixmap, fileName);
-    } else {
-        emitCaptureError("Failed to load captured image");
+QSize QtCamera::previewFrameSize() const {
+    // Known once the first frame is in; the land is fitted on first use before that
+    QMutexLocker locker(&m_previewFrameMutex);
+    return m_previewFrameSize;
+}
+
+void QtCamera::offerPreviewFrame(const QVideoFrame& frame) {
+    // Multimedia thread. One frame waits for the GUI at a time; frames that
+    // arrive meanwhile aren't converted at all.
+    if (m_previewFramePending.load()) {
+        return;
+    }
+    const QImage image = frame.toImage();
+    if (image.isNull()) {
+        return;
+    }
+    const QImage looked = lookedPreview(image);
+    {
+        QMutexLocker locker(&m_previewFrameMutex);
+        m_previewFrame = looked.isNull() ? image : looked;
+        m_previewFrameSize = image.size();
+    }
+    m_previewFramePending = true;
+    QMetaObject::invokeMethod(this, &QtCamera::onPreviewFrameAvailable, Qt::QueuedConnection);
+}
+
+void QtCamera::onPreviewFrameAvailable() {
+    QImage frame;
+    {
+        QMutexLocker locker(&m_previewFrameMutex);
+        frame = std::move(m_previewFrame);
+        m_previewFrame = QImage();
+        m_previewFramePending = false;
+    }
+    if (!frame.isNull() && m_previewWidget && m_camera && m_camera->isActive()) {
+        m_previewWidget->setFrame(frame);
     }
 }
 
+void QtCamera::onVideoFrameChanged(const QVideoFrame& frame) {
+    if (!frame.isValid()) {
+        return;
+    }
+    offerPreviewFrame(frame);
+    if (!hasFrameSubscribers()) {
+        return;
+    }
+
+    CameraFrame::PixelFormat format = CameraFrame::Format_Invalid;
+    switch (frame.pixelFormat()) {
+        case QVideoFrameFormat::Format_NV12:
+            format = CameraFrame::Format_NV12;
+            break;
+        case QVideoFrameFormat::Format_YUV420P:
+            format = CameraFrame::Format_YUV420P;
+            break;
+        case QVideoFrameFormat::Format_BGRA8888_Premultiplied:
+            format = CameraFrame::Format_ARGB32_Premultiplied;
+            break;
+        case QVideoFrameFormat::Format_BGRA8888:
+        case QVideoFrameFormat::Format_BGRX8888:
+            format = CameraFrame::Format_RGB32; // Same byte order as QImage::Format_RGB32
+            break;
+        default:
+            break;
+    }
+
+    if (format == CameraFrame::Format_Invalid) {
+        // Uncommon layouts go through Qt's converter
+        publishImage(frame.toImage());
+        return;
+    }
+
+    QVideoFrame mapped(frame);
+    if (!mapped.map(QVideoFrame::ReadOnly)) {
+        return;
+    }
+
+    CameraFrame target = acquireFrame(mapped.width(), mapped.height(), format);
+    if (target.isValid() && mapped.planeCount() == target.planeCount()) {
+        for (int plane = 0; plane < target.planeCount(); ++plane) {
+            const uchar* src = mapped.bits(plane);
+            uchar* dst = target.bits(plane);
+            const int rowBytes = std::min(mapped.bytesPerLine(plane), target.bytesPerLine(plane));
+            for (int y = 0; y < target.planeHeight(plane); ++y) {
+                memcpy(dst + y * target.bytesPerLine(plane), src + y * mapped.bytesPerLine(plane), rowBytes);
+            }
+        }
+        publishFrame(target);
+    }
+    mapped.unmap();
+}
+
 void QtCamera::onCaptureError(int id, QImageCapture::Error error, const QString& errorString) {
-    Q_UNUSED(id)
     Q_UNUSED(error)
-    qWarning() << "QtCamera: Capture error:" << errorString;
+    m_pendingCaptures.remove(id);
+    qCWarning(lcCamera) << "QtCamera: Capture error:" << errorString;
     emitCaptureError(errorString);
 }
 
@@ -230,12 +337,6 @@ void QtCamera::onCameraError(QCamera::Error error) {
             break;
     }
     
-    qWarning() << "QtCamera: Camera error:" << errorString;
+    qCWarning(lcCamera) << "QtCamera: Camera error:" << errorString;
     emitCaptureError(errorString);
 }
-
-void QtCamera::setupPhotosDirectory() {
-    m_photosDirectory = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation) + "/PhotoBooth";
-    QDir().mkpath(m_photosDirectory);
-    qDebug() << "QtCamera: Photos directory:" << m_photosDirectory;
-}
\ No newline at end of file
@@ -3,9 +3,15 @@
 
 #include "icamera.h"
 #include <QCamera>
-#include <QVideoWidget>
 #include <QImageCapture>
 #include <QMediaCaptureSession>
+#include <QVideoFrame>
+#include <QHash>
+#include <QMutex>
+#include <atomic>
+
+class PreviewWidget;
+class QVideoSink;
 
 class QtCamera : public ICamera {
     Q_OBJECT
@@ -25,23 +31,32 @@ public:
 
     void capturePhoto() override;
     void cancelCapture() override;
+    QSize previewFrameSize() const override;
 
 private slots:
     void onImageCaptured(int id, const QImage& image);
-    void onImageSaved(int id, const QString& fileName);
     void onCaptureError(int id, QImageCapture::Error error, const QString& errorString);
     void onCameraError(QCamera::Error error);
+    void onVideoFrameChanged(const QVideoFrame& frame);
+    void onPreviewFrameAvailable();
 
 private:
     QCamera* m_camera;
-    QVideoWidget* m_videoWidget;
+    PreviewWidget* m_previewWidget;
+    QVideoSink* m_videoSink;
     QImageCapture* m_imageCapture;
     QMediaCaptureSession* m_captureSession;
     bool m_initialized;
-    QString m_photosDirectory;
+    QHash<int, QString> m_pendingCaptures; // capture id -> target file
+
+    // Newest preview frame, keyed and graded on the multimedia thread
+    mutable QMutex m_previewFrameMutex;
+    QImage m_previewFrame;
+    QSize m_previewFrameSize;
+    std::atomic<bool> m_previewFramePending;
     
     bool initializeCamera();
-    void setupPhotosDirectory();
+    void offerPreviewFrame(const QVideoFrame& frame);
 };
 
 #endif // QTCAMERA_H
\ No newline at end of file
@@ -0,0 +1,583 @@
+#include "sessionjournal.h"
+#include "boothlog.h"
+#include "checksum.h"
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 LOG_MAGIC = 0x4a534250;       // "PBSJ"
+const quint32 INDEX_MAGIC = 0x49534250;     // "PBSI"
+const quint32 FORMAT_VERSION = 1;
+const int FILE_HEADER_SIZE = 8;             // Magic, version
+
+const int RECORD_HEADER_SIZE = 8;           // Payload length, CRC-32C
+// Sequence, start, end, six empty strings and an empty strip list
+const quint32 MIN_PAYLOAD_SIZE = 8 + 8 + 8 + 6 * 2 + 2;
+const quint32 MAX_PAYLOAD_SIZE = 256 * 1024;
+
+const int INDEX_ENTRY_SIZE = 32;            // Offset, min, max, count, CRC-32C
+const qint64 SCAN_CHUNK_SIZE = 1024 * 1024;
+
+template <typename T>
+void put(QByteArray& out, T value) {
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, sizeof(T));
+}
+
+void putString(QByteArray& out, const QString& value) {
+    const QByteArray utf8 = value.toUtf8().left(0xffff);
+    put<quint16>(out, static_cast<quint16>(utf8.size()));
+    out.append(utf8);
+}
+
+class PayloadReader {
+public:
+    PayloadReader(const char* data, int size) : m_data(data), m_size(size), m_position(0), m_ok(true) {}
+
+    template <typename T>
+    T read() {
+        if (m_position + static_cast<int>(sizeof(T)) > m_size) {
+            m_ok = false;
+            return T();
+        }
+        T value = qFromLittleEndian<T>(m_data + m_position);
+        m_position += sizeof(T);
+        return value;
+    }
+
+    QString readString() {
+        const int length = read<quint16>();
+        if (!m_ok || m_position + length > m_size) {
+            m_ok = false;
+            return QString();
+        }
+        QString value = QString::fromUtf8(m_data + m_position, length);
+        m_position += length;
+        return value;
+    }
+
+    bool ok() const { return m_ok; }
+
+private:
+    const char* m_data;
+    int m_size;
+    int m_position;
+    bool m_ok;
+};
+
+QByteArray encodeRecord(const SessionJournal::Entry& entry, quint64 sequence) {
+    QByteArray payload;
+    payload.reserve(256);
+    put<quint64>(payload, sequence);
+    put<qint64>(payload, entry.startTime.toMSecsSinceEpoch());
+    put<qint64>(payload, entry.endTime.toMSecsSinceEpoch());
+    putString(payload, entry.userName);
+    putString(payload, entry.weaponId);
+    putString(payload, entry.landId);
+    putString(payload, entry.companionId);
+    putString(payload, entry.photoPath);
+    putString(payload, entry.printPath);
+    const int stripCount = std::min<int>(entry.stripPhotoPaths.size(), 0xffff);
+    put<quint16>(payload, static_cast<quint16>(stripCount));
+    for (int i = 0; i < stripCount; ++i) {
+        putString(payload, entry.stripPhotoPaths.at(i));
+    }
+
+    QByteArray record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    put<quint32>(record, static_cast<quint32>(payload.size()));
+    put<quint32>(record, Checksum::crc32c(payload.constData(), payload.size()));
+    record.append(payload);
+    return record;
+}
+
+bool decodePayload(const char* data, int size, SessionJournal::Entry* entry) {
+    PayloadReader reader(data, size);
+    entry->sequence = reader.read<quint64>();
+    entry->startTime = QDateTime::fromMSecsSinceEpoch(reader.read<qint64>());
+    entry->endTime = QDateTime::fromMSecsSinceEpoch(reader.read<qint64>());
+    entry->userName = reader.readString();
+    entry->weaponId = reader.readString();
+    entry->landId = reader.readString();
+    entry->companionId = reader.readString();
+    entry->photoPath = reader.readString();
+    entry->printPath = reader.readString();
+    const int stripCount = reader.read<quint16>();
+    entry->stripPhotoPaths.clear();
+    for (int i = 0; i < stripCount && reader.ok(); ++i) {
+        entry->stripPhotoPaths.append(reader.readString());
+    }
+    return reader.ok();
+}
+
+// Length of the intact record at data, 0 if it runs past available, or -1
+// if it is corrupt
+qint64 recordLength(const char* data, qint64 available) {
+    if (available < RECORD_HEADER_SIZE) {
+        return 0;
+    }
+    const quint32 length = qFromLittleEndian<quint32>(data);
+    if (length < MIN_PAYLOAD_SIZE || length > MAX_PAYLOAD_SIZE) {
+        return -1;
+    }
+    if (available < RECORD_HEADER_SIZE + static_cast<qint64>(length)) {
+        return 0;
+    }
+    if (qFromLittleEndian<quint32>(data + 4) != Checksum::crc32c(data + RECORD_HEADER_SIZE, length)) {
+        return -1;
+    }
+    return RECORD_HEADER_SIZE + length;
+}
+
+QByteArray fileHeader(quint32 magic) {
+    QByteArray header;
+    put<quint32>(header, magic);
+    put<quint32>(header, FORMAT_VERSION);
+    return header;
+}
+
+bool syncFile(QFile& file) {
+#if defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return file.flush();
+#endif
+}
+
+// Makes a newly created file's directory entry durable
+void syncDirectory(const QString& path) {
+#ifdef Q_OS_UNIX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(path)
+#endif
+}
+
+QString defaultDirectory() {
+    const QString directory = qEnvironmentVariable("PHOTOBOOTH_JOURNAL_DIR");
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal";
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(SessionJournal, s_sessionJournal, (defaultDirectory()))
+
+SessionJournal* SessionJournal::instance() {
+    return s_sessionJournal();
+}
+
+SessionJournal::SessionJournal(const QString& directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+    , m_open(false)
+    , m_committedSize(0)
+    , m_nextSequence(1)
+    , m_committedSequence(0)
+    , m_writing(false)
+    , m_shuttingDown(false)
+    , m_writer(nullptr)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_open = open();
+    if (!m_open) {
+        qCWarning(lcJournal) << "SessionJournal: Cannot open journal in" << m_directory << "- sessions won't be recorded";
+        return;
+    }
+
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->setObjectName("SessionJournal");
+    m_writer->start(QThread::LowPriority);
+    qCDebug(lcJournal) << "SessionJournal: Opened" << m_directory << "with" << m_statistics.entries
+             << "sessions in" << timer.elapsed() << "ms";
+}
+
+SessionJournal::~SessionJournal() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shuttingDown = true;
+        m_workAvailable.wakeAll();
+    }
+    // The writer commits whatever is queued before exiting
+    if (m_writer) {
+        m_writer->wait();
+        delete m_writer;
+    }
+}
+
+bool SessionJournal::open() {
+    if (!QDir().mkpath(m_directory)) {
+        return false;
+    }
+    if (!openLog()) {
+        return false;
+    }
+    openIndex();
+
+    // Rescan the last indexed block along with anything after it. That
+    // rebuilds the open block the same way append() does, and re-indexes
+    // blocks whose index entries never reached the disk.
+    qint64 scanStart = FILE_HEADER_SIZE;
+    if (!m_blocks.empty()) {
+        scanStart = m_blocks.back().offset;
+        m_blocks.pop_back();
+        m_index.resize(FILE_HEADER_SIZE + static_cast<qint64>(m_blocks.size()) * INDEX_ENTRY_SIZE);
+        m_index.seek(m_index.size());
+    }
+    m_statistics.entries = static_cast<quint64>(m_blocks.size()) * INDEX_BLOCK_RECORDS;
+    return recoverTail(scanStart);
+}
+
+bool SessionJournal::openLog() {
+    const QString path = QDir(m_directory).filePath("sessions.log");
+    m_log.setFileName(path);
+    if (!m_log.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        qCWarning(lcJournal) << "SessionJournal: Cannot open" << path << ":" << m_log.errorString();
+        return false;
+    }
+
+    const QByteArray header = m_log.read(FILE_HEADER_SIZE);
+    if (header == fileHeader(LOG_MAGIC)) {
+        return true;
+    }
+
+    if (header.size() == FILE_HEADER_SIZE) {
+        // Not ours, or from a newer build: keep it for inspection and start over
+        const QString aside = path + ".unreadable-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+        m_log.close();
+        QFile::rename(path, aside);
+        qCWarning(lcJournal) << "SessionJournal: Unrecognised journal moved to" << aside;
+        if (!m_log.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+            qCWarning(lcJournal) << "SessionJournal: Cannot create" << path << ":" << m_log.errorString();
+            return false;
+        }
+    }
+
+    // New journal, or one whose header never made it to disk
+    m_log.resize(0);
+    m_log.seek(0);
+    if (m_log.write(fileHeader(LOG_MAGIC)) != FILE_HEADER_SIZE || !syncFile(m_log)) {
+        qCWarning(lcJournal) << "SessionJournal: Cannot write" << path << ":" << m_log.errorString();
+        return false;
+    }
+    syncDirectory(m_directory);
+    return true;
+}
+
+void SessionJournal::openIndex() {
+    m_blocks.clear();
+    const QString path = QDir(m_directory).filePath("sessions.idx");
+    m_index.setFileName(path);
+    if (!m_index.open(QIODevice::ReadWrite)) {
+        qCWarning(lcJournal) << "SessionJournal: Cannot open" << path << ":" << m_index.errorString();
+        return;
+    }
+
+    const QByteArray data = m_index.readAll();
+    if (data.startsWith(fileHeader(INDEX_MAGIC))) {
+        const qint64 logSize = m_log.size();
+        for (int position = FILE_HEADER_SIZE; position + INDEX_ENTRY_SIZE <= data.size();
+             position += INDEX_ENTRY_SIZE) {
+            const char* entry = data.constData() + position;
+            if (qFromLittleEndian<quint32>(entry + 28) != Checksum::crc32c(entry, 28)) {
+                break;
+            }
+            Block block;
+            block.offset = qFromLittleEndian<qint64>(entry);
+            block.minStartMs = qFromLittleEndian<qint64>(entry + 8);
+            block.maxStartMs = qFromLittleEndian<qint64>(entry + 16);
+            block.count = qFromLittleEndian<quint32>(entry + 24);
+            const qint64 previous = m_blocks.empty() ? FILE_HEADER_SIZE - 1 : m_blocks.back().offset;
+            if (block.count != INDEX_BLOCK_RECORDS || block.offset <= previous || block.offset >= logSize) {
+                break;
+            }
+            m_blocks.push_back(block);
+        }
+    } else {
+        m_index.resize(0);
+        m_index.seek(0);
+        m_index.write(fileHeader(INDEX_MAGIC));
+    }
+
+    // Drop anything after the last good entry
+    m_index.resize(FILE_HEADER_SIZE + static_cast<qint64>(m_blocks.size()) * INDEX_ENTRY_SIZE);
+    m_index.seek(m_index.size());
+}
+
+bool SessionJournal::recoverTail(qint64 scanStart) {
+    const qint64 logSize = m_log.size();
+    if (!m_log.seek(scanStart)) {
+        return false;
+    }
+
+    std::vector<Block> completed;
+    quint64 lastSequence = 0;
+    QByteArray buffer;
+    int consumed = 0;
+    qint64 offset = scanStart;
+    bool atEnd = false;
+    forever {
+        const qint64 length = recordLength(buffer.constData() + consumed, buffer.size() - consumed);
+        if (length > 0) {
+            const char* payload = buffer.constData() + consumed + RECORD_HEADER_SIZE;
+            lastSequence = qFromLittleEndian<quint64>(payload);
+            addToBlock(offset, qFromLittleEndian<qint64>(payload + 8), &completed);
+            consumed += static_cast<int>(length);
+            offset += length;
+            continue;
+        }
+        if (length < 0 || atEnd) {
+            break;
+        }
+        buffer.remove(0, consumed);
+        consumed = 0;
+        const QByteArray chunk = m_log.read(SCAN_CHUNK_SIZE);
+        if (chunk.isEmpty()) {
+            atEnd = true;
+        } else {
+            buffer.append(chunk);
+        }
+    }
+
+    if (offset < logSize) {
+        // Power was lost mid-write; everything from the first bad record on goes
+        m_statistics.truncatedBytes = logSize - offset;
+        qCWarning(lcJournal) << "SessionJournal: Truncating" << m_statistics.truncatedBytes
+                   << "bytes of torn tail at offset" << offset;
+        if (!m_log.resize(offset) || !syncFile(m_log)) {
+            qCWarning(lcJournal) << "SessionJournal: Cannot truncate journal:" << m_log.errorString();
+            return false;
+        }
+    }
+    m_log.seek(offset);
+    appendIndexEntries(completed);
+
+    m_committedSize = offset;
+    m_committedSequence = lastSequence;
+    m_nextSequence = lastSequence + 1;
+    return true;
+}
+
+void SessionJournal::addToBlock(qint64 offset, qint64 startMs, std::vector<Block>* completed) {
+    if (m_openBlock.count == 0) {
+        m_openBlock.offset = offset;
+        m_openBlock.minStartMs = startMs;
+        m_openBlock.maxStartMs = startMs;
+    } else {
+        m_openBlock.minStartMs = std::min(m_openBlock.minStartMs, startMs);
+        m_openBlock.maxStartMs = std::max(m_openBlock.maxStartMs, startMs);
+    }
+    ++m_statistics.entries;
+    if (++m_openBlock.count == INDEX_BLOCK_RECORDS) {
+        m_blocks.push_back(m_openBlock);
+        completed->push_back(m_openBlock);
+        m_openBlock = Block();
+    }
+}
+
+void SessionJournal::appendIndexEntries(const std::vector<Block>& blocks) {
+    if (blocks.empty() || !m_index.isOpen()) {
+        return;
+    }
+    // Not synced: entries are checksummed and rebuilt from the log if lost,
+    // and are only written once the records they cover are durable
+    QByteArray data;
+    for (const Block& block : blocks) {
+        QByteArray entry;
+        put<qint64>(entry, block.offset);
+        put<qint64>(entry, block.minStartMs);
+        put<qint64>(entry, block.maxStartMs);
+        put<quint32>(entry, block.count);
+        put<quint32>(entry, Checksum::crc32c(entry.constData(), entry.size()));
+        data.append(entry);
+    }
+    m_index.write(data);
+    m_index.flush();
+}
+
+quint64 SessionJournal::append(const Entry& entry) {
+    if (!m_open) {
+        return 0;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (m_shuttingDown) {
+        return 0;
+    }
+    Pending pending;
+    pending.sequence = m_nextSequence++;
+    pending.startMs = entry.startTime.toMSecsSinceEpoch();
+    pending.record = encodeRecord(entry, pending.sequence);
+    m_pending.push_back(std::move(pending));
+    m_workAvailable.wakeOne();
+    return m_pending.back().sequence;
+}
+
+bool SessionJournal::waitForCommitted(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (!m_pending.empty() || m_writing) {
+        if (!m_idle.wait(&m_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SessionJournal::writerLoop() {
+    forever {
+        std::vector<Pending> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pending.empty() && !m_shuttingDown) {
+                m_workAvailable.wait(&m_mutex);
+            }
+            if (m_pending.empty()) {
+                return;
+            }
+            // Everything queued while the previous batch was syncing goes in this one
+            batch.swap(m_pending);
+            m_writing = true;
+        }
+
+        QByteArray data;
+        for (const Pending& pending : batch) {
+            data.append(pending.record);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 writeOffset = m_log.pos();
+        const bool written = m_log.write(data) == data.size() && syncFile(m_log);
+        const qint64 commitNs = timer.nsecsElapsed();
+
+        if (!written) {
+            const QString error = QString("Cannot write %1: %2").arg(m_log.fileName(), m_log.errorString());
+            qCWarning(lcJournal) << "SessionJournal:" << error;
+            // Cut off the partial batch so the next one starts on a record boundary
+            m_log.resize(writeOffset);
+            m_log.seek(writeOffset);
+            {
+                QMutexLocker locker(&m_mutex);
+                m_statistics.failedEntries += batch.size();
+                m_writing = false;
+                m_idle.wakeAll();
+            }
+            emit writeFailed(error);
+            continue;
+        }
+
+        std::vector<Block> completed;
+        quint64 sequence = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            qint64 offset = writeOffset;
+            for (const Pending& pending : batch) {
+                addToBlock(offset, pending.startMs, &completed);
+                offset += pending.record.size();
+            }
+            m_committedSize = offset;
+            m_committedSequence = batch.back().sequence;
+            sequence = m_committedSequence;
+            ++m_statistics.commits;
+            m_statistics.maxCommitNs = std::max(m_statistics.maxCommitNs, commitNs);
+        }
+        appendIndexEntries(completed);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_writing = false;
+            m_idle.wakeAll();
+        }
+        emit committed(sequence);
+    }
+}
+
+QList<SessionJournal::Entry> SessionJournal::query(const QDateTime& from, const QDateTime& to, int maxEntries) const {
+    QList<Entry> entries;
+    if (!m_open) {
+        return entries;
+    }
+    const qint64 fromMs = from.toMSecsSinceEpoch();
+    const qint64 toMs = to.toMSecsSinceEpoch();
+
+    // Byte ranges of the blocks whose time span overlaps the query
+    std::vector<std::pair<qint64, qint64>> ranges;
+    {
+        QMutexLocker locker(&m_mutex);
+        const qint64 openOffset = m_openBlock.count > 0 ? m_openBlock.offset : m_committedSize;
+        for (size_t i = 0; i < m_blocks.size(); ++i) {
+            const Block& block = m_blocks[i];
+            if (block.maxStartMs >= fromMs && block.minStartMs <= toMs) {
+                ranges.emplace_back(block.offset, i + 1 < m_blocks.size() ? m_blocks[i + 1].offset : openOffset);
+            }
+        }
+        if (m_openBlock.count > 0 && m_openBlock.maxStartMs >= fromMs && m_openBlock.minStartMs <= toMs) {
+            ranges.emplace_back(m_openBlock.offset, m_committedSize);
+        }
+    }
+    if (ranges.empty()) {
+        return entries;
+    }
+
+    QFile file(m_log.fileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcJournal) << "SessionJournal: Cannot read" << file.fileName() << ":" << file.errorString();
+        return entries;
+    }
+    for (const auto& range : ranges) {
+        if (!file.seek(range.first)) {
+            break;
+        }
+        const QByteArray data = file.read(range.second - range.first);
+        qint64 position = 0;
+        while (position < data.size()) {
+            const qint64 length = recordLength(data.constData() + position, data.size() - position);
+            if (length <= 0) {
+                break;
+            }
+            const char* payload = data.constData() + position + RECORD_HEADER_SIZE;
+            const qint64 startMs = qFromLittleEndian<qint64>(payload + 8);
+            if (startMs >= fromMs && startMs <= toMs) {
+                Entry entry;
+                if (decodePayload(payload, static_cast<int>(length - RECORD_HEADER_SIZE), &entry)) {
+                    entries.append(entry);
+                    if (maxEntries >= 0 && entries.size() >= maxEntries) {
+                        return entries;
+                    }
+                }
+            }
+            position += length;
+        }
+    }
+    return entries;
+}
+
+SessionJournal::Statistics SessionJournal::statistics() const {
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.logBytes = m_committedSize;
+    statistics.indexBlocks = static_cast<int>(m_blocks.size());
+    return statistics;
+}
@@ -0,0 +1,133 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+#include <vector>
+
+class QThread;
+
+// Append-only record of every completed session: who chose what and which
+// files they got.
+//
+// sessions.log is a header followed by records framed as
+// [payload length][CRC-32C of payload][payload], little-endian. append()
+// only encodes and queues; a writer thread writes whatever has queued since
+// its last flush and makes it durable with one fdatasync, so appends that
+// arrive during a slow SD card flush share the next one. On open, the tail
+// is scanned and anything after the last intact record (a write torn by
+// power loss) is truncated.
+//
+// sessions.idx is a sparse time index: one checksummed entry per block of
+// INDEX_BLOCK_RECORDS records with the block's offset and its earliest and
+// latest start time. Range queries read only the blocks that overlap. Min
+// and max are kept per block rather than assuming time order, since a Pi
+// without an RTC can boot with its clock in the past. The index is derived
+// data and is rebuilt from the log if it's missing or damaged.
+class SessionJournal : public QObject {
+    Q_OBJECT
+
+public:
+    struct Entry {
+        quint64 sequence = 0;   // Assigned by append()
+        QDateTime startTime;
+        QDateTime endTime;
+        QString userName;
+        QString weaponId;
+        QString landId;
+        QString companionId;
+        QString photoPath;
+        QStringList stripPhotoPaths;
+        QString printPath;
+    };
+
+    struct Statistics {
+        quint64 entries = 0;
+        quint64 commits = 0;            // fdatasync calls on the log
+        quint64 failedEntries = 0;      // Dropped because a write or sync failed
+        qint64 logBytes = 0;
+        qint64 maxCommitNs = 0;         // Slowest write plus sync
+        qint64 truncatedBytes = 0;      // Torn tail removed when the journal was opened
+        int indexBlocks = 0;
+    };
+
+    static const int INDEX_BLOCK_RECORDS = 64;
+
+    explicit SessionJournal(const QString& directory, QObject *parent = nullptr);
+    ~SessionJournal() override;
+
+    // Shared instance in PHOTOBOOTH_JOURNAL_DIR, or the application data
+    // directory when unset
+    static SessionJournal* instance();
+
+    bool isOpen() const { return m_open; }
+    QString directory() const { return m_directory; }
+
+    // Queues the entry and returns its sequence number, or 0 if the journal
+    // couldn't be opened. Never waits for the disk.
+    quint64 append(const Entry& entry);
+
+    // Blocks until everything appended so far is durable; used on shutdown
+    bool waitForCommitted(int timeoutMs);
+
+    // Committed entries that started in [from, to], in append order. A
+    // negative maxEntries returns all of them.
+    QList<Entry> query(const QDateTime& from, const QDateTime& to, int maxEntries = -1) const;
+
+    Statistics statistics() const;
+
+signals:
+    // Emitted from the writer thread once sequence and everything before it
+    // is on disk
+    void committed(quint64 sequence);
+    void writeFailed(const QString& errorMessage);
+
+private:
+    struct Pending {
+        QByteArray record;
+        qint64 startMs;
+        quint64 sequence;
+    };
+
+    struct Block {
+        qint64 offset = 0;
+        qint64 minStartMs = 0;
+        qint64 maxStartMs = 0;
+        quint32 count = 0;
+    };
+
+    bool open();
+    bool openLog();
+    void openIndex();
+    bool recoverTail(qint64 scanStart);
+    void addToBlock(qint64 offset, qint64 startMs, std::vector<Block>* completed);
+    void appendIndexEntries(const std::vector<Block>& blocks);
+    void writerLoop();
+
+    QString m_directory;
+    QFile m_log;                        // Writer thread only, once open
+    QFile m_index;
+    bool m_open;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_idle;
+    std::vector<Pending> m_pending;
+    std::vector<Block> m_blocks;        // Complete blocks, in log order
+    Block m_openBlock;                  // Records since the last complete block
+    qint64 m_committedSize;
+    quint64 m_nextSequence;
+    quint64 m_committedSequence;
+    bool m_writing;
+    bool m_shuttingDown;
+    Statistics m_statistics;
+    QThread* m_writer;
+};
+
+#endif // SESSIONJOURNAL_H
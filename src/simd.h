@@ -0,0 +1,30 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Compile-time SIMD selection for the pixel kernels. x86-64 always has SSE2
+// and AArch64 always has NEON. 32-bit Raspberry Pi OS builds for ARMv6
+// without NEON and gets the scalar paths, which every kernel provides and
+// which give bit-identical results.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHOTOBOOTH_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PHOTOBOOTH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Simd {
+
+inline const char* name() {
+#if defined(PHOTOBOOTH_SSE2)
+    return "sse2";
+#elif defined(PHOTOBOOTH_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace Simd
+
+#endif // SIMD_H
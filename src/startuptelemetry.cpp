@@ -0,0 +1,64 @@
+#include "startuptelemetry.h"
+#include "boothlog.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <utility>
+
+namespace {
+
+QMutex s_mutex;
+QElapsedTimer s_clock;
+QList<QPair<QByteArray, qint64>> s_phases;
+
+void ensureStarted() {
+    if (!s_clock.isValid()) {
+        s_clock.start();
+    }
+}
+
+} // namespace
+
+void StartupTelemetry::start() {
+    QMutexLocker locker(&s_mutex);
+    s_clock.start();
+    s_phases.clear();
+}
+
+void StartupTelemetry::mark(const char* phase) {
+    qint64 ms;
+    {
+        QMutexLocker locker(&s_mutex);
+        ensureStarted();
+        for (const auto& entry : std::as_const(s_phases)) {
+            if (entry.first == phase) {
+                return;
+            }
+        }
+        ms = s_clock.elapsed();
+        s_phases.append(qMakePair(QByteArray(phase), ms));
+    }
+    qCDebug(lcStartup) << "Startup:" << phase << "at" << ms << "ms";
+}
+
+qint64 StartupTelemetry::elapsedMs() {
+    QMutexLocker locker(&s_mutex);
+    ensureStarted();
+    return s_clock.elapsed();
+}
+
+qint64 StartupTelemetry::phaseMs(const char* phase) {
+    QMutexLocker locker(&s_mutex);
+    for (const auto& entry : std::as_const(s_phases)) {
+        if (entry.first == phase) {
+            return entry.second;
+        }
+    }
+    return -1;
+}
+
+QList<QPair<QByteArray, qint64>> StartupTelemetry::phases() {
+    QMutexLocker locker(&s_mutex);
+    return s_phases;
+}
@@ -0,0 +1,24 @@
+#ifndef STARTUPTELEMETRY_H
+#define STARTUPTELEMETRY_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+// Named start-up phases timed from the first line of main(), so time to first
+// frame can be compared across builds and booths. mark() may be called from
+// any thread; only the first mark of each phase is kept.
+namespace StartupTelemetry {
+
+void start();
+void mark(const char* phase);
+
+qint64 elapsedMs();
+// -1 when the phase has not been reached
+qint64 phaseMs(const char* phase);
+QList<QPair<QByteArray, qint64>> phases();
+
+} // namespace StartupTelemetry
+
+#endif // STARTUPTELEMETRY_H
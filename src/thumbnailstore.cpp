@@ -0,0 +1,293 @@
+#include "thumbnailstore.h"
+#include "boothlog.h"
+#include "checksum.h"
+#include "imagedownscaler.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 SEGMENT_MAGIC = 0x53544250;   // "PBTS"
+const quint32 FORMAT_VERSION = 1;
+const int SEGMENT_HEADER_SIZE = 64;
+const int BYTES_PER_PIXEL = 2;              // RGB16
+
+// Record: CRC-32C of bytes 4..255, width, height, capture time,
+// name length and name, path length and path
+const int RECORD_SIZE = 256;
+const int NAME_OFFSET = 17;
+const int MAX_NAME_BYTES = 63;
+const int PATH_OFFSET = 82;
+const int MAX_PATH_BYTES = RECORD_SIZE - PATH_OFFSET;
+
+const qint64 RECORDS_SIZE = static_cast<qint64>(RECORD_SIZE) * ThumbnailStore::SLOTS_PER_SEGMENT;
+const qint64 SLOT_BYTES = static_cast<qint64>(ThumbnailStore::THUMBNAIL_WIDTH) * ThumbnailStore::THUMBNAIL_HEIGHT * BYTES_PER_PIXEL;
+const qint64 PIXELS_OFFSET = SEGMENT_HEADER_SIZE + RECORDS_SIZE;
+const qint64 SEGMENT_SIZE = PIXELS_OFFSET + SLOT_BYTES * ThumbnailStore::SLOTS_PER_SEGMENT;
+
+QByteArray segmentHeader() {
+    QByteArray header(SEGMENT_HEADER_SIZE, '\0');
+    char* data = header.data();
+    qToLittleEndian<quint32>(SEGMENT_MAGIC, data);
+    qToLittleEndian<quint32>(FORMAT_VERSION, data + 4);
+    qToLittleEndian<quint32>(ThumbnailStore::THUMBNAIL_WIDTH, data + 8);
+    qToLittleEndian<quint32>(ThumbnailStore::THUMBNAIL_HEIGHT, data + 12);
+    qToLittleEndian<quint32>(BYTES_PER_PIXEL, data + 16);
+    qToLittleEndian<quint32>(ThumbnailStore::SLOTS_PER_SEGMENT, data + 20);
+    return header;
+}
+
+bool recordValid(const uchar* record) {
+    return qFromLittleEndian<quint32>(record) == Checksum::crc32c(record + 4, RECORD_SIZE - 4);
+}
+
+// UTF-8 of text cut at a character boundary to fit maxBytes
+QByteArray truncatedUtf8(QString text, int maxBytes) {
+    QByteArray utf8 = text.toUtf8();
+    while (utf8.size() > maxBytes) {
+        text.chop(1);
+        utf8 = text.toUtf8();
+    }
+    return utf8;
+}
+
+// Writes back the pages of a mapped range before returning
+void syncRange(const uchar* data, qint64 size) {
+#ifdef Q_OS_UNIX
+    static const quintptr pageSize = static_cast<quintptr>(::sysconf(_SC_PAGESIZE));
+    const quintptr start = reinterpret_cast<quintptr>(data) & ~(pageSize - 1);
+    ::msync(reinterpret_cast<void*>(start), reinterpret_cast<quintptr>(data) + size - start, MS_SYNC);
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+#endif
+}
+
+QString defaultDirectory() {
+    const QString directory = qEnvironmentVariable("PHOTOBOOTH_THUMBNAIL_DIR");
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/thumbnails";
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(ThumbnailStore, s_thumbnailStore, (defaultDirectory()))
+
+ThumbnailStore* ThumbnailStore::instance() {
+    return s_thumbnailStore();
+}
+
+ThumbnailStore::ThumbnailStore(const QString& directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+    , m_open(false)
+    , m_count(0)
+{
+    for (std::atomic<Segment*>& segment : m_segments) {
+        segment.store(nullptr, std::memory_order_relaxed);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    m_open = open();
+    if (!m_open) {
+        qCWarning(lcStorage) << "ThumbnailStore: Cannot open" << m_directory << "- the gallery will be empty";
+        return;
+    }
+    qCDebug(lcStorage) << "ThumbnailStore: Opened" << m_directory << "with" << count()
+             << "thumbnails in" << timer.elapsed() << "ms";
+}
+
+ThumbnailStore::~ThumbnailStore() = default;
+
+bool ThumbnailStore::open() {
+    if (!QDir().mkpath(m_directory)) {
+        return false;
+    }
+
+    // Slots fill in order, so the first record that doesn't check out is the end
+    int count = 0;
+    QMutexLocker locker(&m_mapMutex);
+    for (int index = 0; index < MAX_SEGMENTS; ++index) {
+        Segment* segment = openSegment(index, false);
+        if (!segment) {
+            break;
+        }
+        int slot = 0;
+        while (slot < SLOTS_PER_SEGMENT && recordValid(segment->records + slot * RECORD_SIZE)) {
+            ++slot;
+        }
+        count += slot;
+        if (slot < SLOTS_PER_SEGMENT) {
+            break;
+        }
+    }
+    m_count.store(count, std::memory_order_release);
+    return true;
+}
+
+ThumbnailStore::Segment* ThumbnailStore::openSegment(int index, bool create) {
+    auto segment = std::make_unique<Segment>();
+    segment->file.setFileName(QDir(m_directory).filePath(QString("thumbnails-%1.seg").arg(index, 4, 10, QChar('0'))));
+    if (!create && !segment->file.exists()) {
+        return nullptr;
+    }
+    if (!segment->file.open(QIODevice::ReadWrite)) {
+        qCWarning(lcStorage) << "ThumbnailStore: Cannot open" << segment->file.fileName() << ":" << segment->file.errorString();
+        return nullptr;
+    }
+
+    if (create) {
+        // Also resets a segment left over from a store that was cut short
+        if (!segment->file.resize(0) || !segment->file.resize(SEGMENT_SIZE) ||
+            segment->file.write(segmentHeader()) != SEGMENT_HEADER_SIZE || !segment->file.flush()) {
+            qCWarning(lcStorage) << "ThumbnailStore: Cannot create" << segment->file.fileName() << ":" << segment->file.errorString();
+            return nullptr;
+        }
+    } else if (segment->file.size() != SEGMENT_SIZE || segment->file.read(SEGMENT_HEADER_SIZE) != segmentHeader()) {
+        qCWarning(lcStorage) << "ThumbnailStore: Ignoring" << segment->file.fileName() << "written with a different layout";
+        return nullptr;
+    }
+
+    uchar* mapped = segment->file.map(0, PIXELS_OFFSET);
+    if (!mapped) {
+        qCWarning(lcStorage) << "ThumbnailStore: Cannot map" << segment->file.fileName() << ":" << segment->file.errorString();
+        return nullptr;
+    }
+    segment->records = mapped + SEGMENT_HEADER_SIZE;
+
+    Segment* raw = segment.get();
+    m_segmentStorage[index] = std::move(segment);
+    m_segments[index].store(raw, std::memory_order_release);
+    return raw;
+}
+
+uchar* ThumbnailStore::segmentPixels(Segment* segment) const {
+    uchar* pixels = segment->pixels.load(std::memory_order_acquire);
+    if (pixels) {
+        return pixels;
+    }
+    QMutexLocker locker(&m_mapMutex);
+    pixels = segment->pixels.load(std::memory_order_acquire);
+    if (!pixels) {
+        pixels = segment->file.map(PIXELS_OFFSET, SEGMENT_SIZE - PIXELS_OFFSET);
+        if (!pixels) {
+            qCWarning(lcStorage) << "ThumbnailStore: Cannot map" << segment->file.fileName() << ":" << segment->file.errorString();
+            return nullptr;
+        }
+        segment->pixels.store(pixels, std::memory_order_release);
+    }
+    return pixels;
+}
+
+const uchar* ThumbnailStore::record(int slot) const {
+    if (slot < 0 || slot >= count()) {
+        return nullptr;
+    }
+    const Segment* segment = m_segments[slot / SLOTS_PER_SEGMENT].load(std::memory_order_acquire);
+    return segment->records + (slot % SLOTS_PER_SEGMENT) * RECORD_SIZE;
+}
+
+ThumbnailStore::Entry ThumbnailStore::entry(int slot) const {
+    Entry entry;
+    const uchar* data = record(slot);
+    if (!data) {
+        return entry;
+    }
+    entry.slot = slot;
+    entry.captureTime = QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(data + 8));
+    entry.guestName = QString::fromUtf8(reinterpret_cast<const char*>(data + NAME_OFFSET), data[16]);
+    entry.photoPath = QString::fromUtf8(reinterpret_cast<const char*>(data + PATH_OFFSET),
+                                        qFromLittleEndian<quint16>(data + 80));
+    return entry;
+}
+
+QImage ThumbnailStore::thumbnail(int slot) const {
+    const uchar* data = record(slot);
+    if (!data) {
+        return QImage();
+    }
+    Segment* segment = m_segments[slot / SLOTS_PER_SEGMENT].load(std::memory_order_acquire);
+    const uchar* pixels = segmentPixels(segment);
+    if (!pixels) {
+        return QImage();
+    }
+    return QImage(pixels + (slot % SLOTS_PER_SEGMENT) * SLOT_BYTES,
+                  qFromLittleEndian<quint16>(data + 4), qFromLittleEndian<quint16>(data + 6),
+                  THUMBNAIL_WIDTH * BYTES_PER_PIXEL, QImage::Format_RGB16);
+}
+
+int ThumbnailStore::add(const QImage& photo, const QString& photoPath, const QString& guestName,
+                        const QDateTime& captureTime) {
+    if (!m_open || photo.isNull()) {
+        return -1;
+    }
+    const QByteArray path = photoPath.toUtf8();
+    if (path.size() > MAX_PATH_BYTES) {
+        qCWarning(lcStorage) << "ThumbnailStore: Path too long for the gallery:" << photoPath;
+        return -1;
+    }
+    const QByteArray name = truncatedUtf8(guestName, MAX_NAME_BYTES);
+
+    // Scale before taking the lock; only the copy into the slot is serialised
+    const QSize size = ImageDownscaler::fitSize(photo.size(), QSize(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT));
+    const QImage thumbnail = ImageDownscaler::areaAverage(photo, size).convertToFormat(QImage::Format_RGB16);
+    if (thumbnail.isNull()) {
+        return -1;
+    }
+
+    uchar encoded[RECORD_SIZE] = {};
+    qToLittleEndian<quint16>(static_cast<quint16>(thumbnail.width()), encoded + 4);
+    qToLittleEndian<quint16>(static_cast<quint16>(thumbnail.height()), encoded + 6);
+    qToLittleEndian<qint64>(captureTime.toMSecsSinceEpoch(), encoded + 8);
+    encoded[16] = static_cast<uchar>(name.size());
+    std::memcpy(encoded + NAME_OFFSET, name.constData(), name.size());
+    qToLittleEndian<quint16>(static_cast<quint16>(path.size()), encoded + 80);
+    std::memcpy(encoded + PATH_OFFSET, path.constData(), path.size());
+    qToLittleEndian<quint32>(Checksum::crc32c(encoded + 4, RECORD_SIZE - 4), encoded);
+
+    QMutexLocker locker(&m_writeMutex);
+    const int slot = m_count.load(std::memory_order_relaxed);
+    const int index = slot / SLOTS_PER_SEGMENT;
+    if (index >= MAX_SEGMENTS) {
+        qCWarning(lcStorage) << "ThumbnailStore: Store is full";
+        return -1;
+    }
+    Segment* segment = m_segments[index].load(std::memory_order_acquire);
+    if (!segment) {
+        QMutexLocker mapLocker(&m_mapMutex);
+        segment = openSegment(index, true);
+    }
+    uchar* pixels = segment ? segmentPixels(segment) : nullptr;
+    if (!pixels) {
+        return -1;
+    }
+
+    // Pixels first: a record only becomes valid on disk once its slot is
+    uchar* slotPixels = pixels + (slot % SLOTS_PER_SEGMENT) * SLOT_BYTES;
+    for (int y = 0; y < thumbnail.height(); ++y) {
+        std::memcpy(slotPixels + y * THUMBNAIL_WIDTH * BYTES_PER_PIXEL, thumbnail.constScanLine(y),
+                    thumbnail.width() * BYTES_PER_PIXEL);
+    }
+    syncRange(slotPixels, SLOT_BYTES);
+    uchar* slotRecord = segment->records + (slot % SLOTS_PER_SEGMENT) * RECORD_SIZE;
+    std::memcpy(slotRecord, encoded, RECORD_SIZE);
+    syncRange(slotRecord, RECORD_SIZE);
+
+    m_count.store(slot + 1, std::memory_order_release);
+    locker.unlock();
+    emit thumbnailAdded(slot);
+    return slot;
+}
@@ -0,0 +1,90 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+// Persistent gallery thumbnails, one per captured photo, written once at
+// capture time and never decoded again.
+//
+// Thumbnails live in fixed-size slots in segment files of SLOTS_PER_SEGMENT
+// slots each, memory-mapped and grown a segment at a time. A segment starts
+// with one 256-byte record per slot (capture time, guest name, photo path,
+// CRC-32C) followed by the slots' RGB16 pixels, so thumbnail() is a QImage
+// over the mapping with no copy and no decode. Opening reads only the record
+// areas; pixel areas are mapped the first time something draws from them.
+//
+// A slot's pixels are synced before its record, and the first record that
+// fails its checksum marks the end of the store, so a power cut loses at most
+// the thumbnail being written.
+//
+// add() may be called from any thread. Readers never block on the disk: a
+// slot is only visible through count() once it's complete, and complete
+// slots don't change.
+class ThumbnailStore : public QObject {
+    Q_OBJECT
+
+public:
+    struct Entry {
+        int slot = -1;
+        QDateTime captureTime;
+        QString guestName;
+        QString photoPath;
+    };
+
+    static const int THUMBNAIL_WIDTH = 160;
+    static const int THUMBNAIL_HEIGHT = 120;
+    static const int SLOTS_PER_SEGMENT = 1024;
+    static const int MAX_SEGMENTS = 256;
+
+    explicit ThumbnailStore(const QString& directory, QObject *parent = nullptr);
+    ~ThumbnailStore() override;
+
+    // Shared instance in PHOTOBOOTH_THUMBNAIL_DIR, or the application data
+    // directory when unset
+    static ThumbnailStore* instance();
+
+    bool isOpen() const { return m_open; }
+    int count() const { return m_count.load(std::memory_order_acquire); }
+
+    Entry entry(int slot) const;
+
+    // Points into the mapped store; valid for the store's lifetime
+    QImage thumbnail(int slot) const;
+
+    // Scales photo into the next slot. Returns the slot, or -1 on failure.
+    int add(const QImage& photo, const QString& photoPath, const QString& guestName,
+            const QDateTime& captureTime);
+
+signals:
+    // Emitted from the thread that called add()
+    void thumbnailAdded(int slot);
+
+private:
+    struct Segment {
+        QFile file;
+        uchar* records = nullptr;
+        std::atomic<uchar*> pixels{nullptr};
+    };
+
+    bool open();
+    Segment* openSegment(int index, bool create);
+    uchar* segmentPixels(Segment* segment) const;
+    const uchar* record(int slot) const;
+
+    QString m_directory;
+    bool m_open;
+    std::atomic<int> m_count;
+    std::unique_ptr<Segment> m_segmentStorage[MAX_SEGMENTS];
+    std::atomic<Segment*> m_segments[MAX_SEGMENTS];
+    QMutex m_writeMutex;                // Serialises add()
+    mutable QMutex m_mapMutex;          // Guards QFile::map() calls
+};
+
+#endif // THUMBNAILSTORE_H
@@ -0,0 +1,407 @@
+#include "uploadconnection.h"
+#include <QFile>
+#include <QTcpSocket>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+#ifndef QT_NO_SSL
+#include <QSslSocket>
+#endif
+
+#if defined(Q_OS_LINUX)
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#endif
+
+namespace {
+
+const qint64 MIN_SLICE_BYTES = 1024;
+const qint64 MAX_SLICE_BYTES = 256 * 1024;
+const int PAUSE_POLL_MS = 50;
+const qint64 MAX_ERROR_BODY_BYTES = 64 * 1024;
+
+} // namespace
+
+UploadSegment UploadSegment::fromBytes(const QByteArray& bytes) {
+    UploadSegment segment;
+    segment.bytes = bytes;
+    segment.length = bytes.size();
+    return segment;
+}
+
+UploadSegment UploadSegment::fromFile(const QString& filePath, qint64 offset, qint64 length) {
+    UploadSegment segment;
+    segment.filePath = filePath;
+    segment.fileOffset = offset;
+    segment.length = length;
+    return segment;
+}
+
+BandwidthLimiter::BandwidthLimiter(qint64 bytesPerSecond)
+    : m_bytesPerSecond(std::max<qint64>(0, bytesPerSecond))
+    , m_tokens(0.0)
+    , m_lastNs(0)
+{
+    m_clock.start();
+}
+
+qint64 BandwidthLimiter::sliceBytes() const {
+    if (m_bytesPerSecond == 0) {
+        return MAX_SLICE_BYTES;
+    }
+    return std::clamp(m_bytesPerSecond / 20, MIN_SLICE_BYTES, MAX_SLICE_BYTES);
+}
+
+bool BandwidthLimiter::take(qint64 bytes) {
+    forever {
+        if (isCancelled()) {
+            return false;
+        }
+        if (isPaused()) {
+            // Time spent paused doesn't earn a burst afterwards
+            QThread::msleep(PAUSE_POLL_MS);
+            m_tokens = std::min(m_tokens, 0.0);
+            m_lastNs = m_clock.nsecsElapsed();
+            continue;
+        }
+        if (m_bytesPerSecond == 0) {
+            return true;
+        }
+
+        // At most one slice saved up, so an idle link can't burst past the cap
+        const qint64 now = m_clock.nsecsElapsed();
+        const double burst = static_cast<double>(sliceBytes());
+        m_tokens = std::min(burst, m_tokens + (now - m_lastNs) * (m_bytesPerSecond / 1e9));
+        m_lastNs = now;
+        const double needed = std::min(static_cast<double>(bytes), burst);
+        if (m_tokens >= needed) {
+            m_tokens -= bytes; // May go negative; the debt is paid before the next write
+            return true;
+        }
+        const double waitMs = (needed - m_tokens) * 1000.0 / m_bytesPerSecond;
+        QThread::msleep(static_cast<unsigned long>(std::clamp(std::ceil(waitMs), 1.0, 50.0)));
+    }
+}
+
+QByteArray UploadConnection::Response::header(const QByteArray& name) const {
+    for (const auto& header : headers) {
+        if (header.first == name) {
+            return header.second;
+        }
+    }
+    return QByteArray();
+}
+
+UploadConnection::UploadConnection(BandwidthLimiter *limiter, int timeoutMs)
+    : m_limiter(limiter)
+    , m_timeoutMs(timeoutMs)
+    , m_port(0)
+    , m_secure(false)
+    , m_bodyBytesSent(0)
+{
+#if defined(Q_OS_LINUX)
+    // sendfile() has no MSG_NOSIGNAL; a server hanging up must come back as
+    // EPIPE on this thread rather than kill the booth
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+}
+
+UploadConnection::~UploadConnection() {
+    close();
+}
+
+void UploadConnection::close() {
+    if (m_socket) {
+        m_socket->abort();
+        m_socket.reset();
+    }
+}
+
+bool UploadConnection::ensureConnected(const QUrl& url, QString *errorMessage) {
+    const bool secure = url.scheme() == "https";
+    const int port = url.port(secure ? 443 : 80);
+    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
+        // Notice a keep-alive connection the server has since closed
+        m_socket->waitForReadyRead(0);
+        if (m_socket->state() == QAbstractSocket::ConnectedState && m_host == url.host() && m_port == port &&
+            m_secure == secure) {
+            return true;
+        }
+    }
+    close();
+
+    m_host = url.host();
+    m_port = port;
+    m_secure = secure;
+    if (secure) {
+#ifndef QT_NO_SSL
+        QSslSocket *socket = new QSslSocket();
+        m_socket.reset(socket);
+        socket->connectToHostEncrypted(m_host, static_cast<quint16>(m_port));
+        if (!socket->waitForEncrypted(m_timeoutMs)) {
+            *errorMessage = QString("Cannot connect to %1: %2").arg(m_host, socket->errorString());
+            close();
+            return false;
+        }
+        return true;
+#else
+        *errorMessage = "HTTPS is not available in this Qt build";
+        return false;
+#endif
+    }
+
+    m_socket.reset(new QTcpSocket());
+    m_socket->connectToHost(m_host, static_cast<quint16>(m_port));
+    if (!m_socket->waitForConnected(m_timeoutMs)) {
+        *errorMessage = QString("Cannot connect to %1:%2: %3").arg(m_host).arg(m_port).arg(m_socket->errorString());
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool UploadConnection::flush(QString *errorMessage) {
+    while (m_socket->bytesToWrite() > 0) {
+        if (!m_socket->waitForBytesWritten(m_timeoutMs)) {
+            *errorMessage = QString("Send failed: %1").arg(m_socket->errorString());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UploadConnection::writeBytes(const char *data, qint64 length, bool body, QString *errorMessage) {
+    qint64 written = 0;
+    while (written < length) {
+        const qint64 slice = std::min(length - written, m_limiter->sliceBytes());
+        if (!m_limiter->take(slice)) {
+            *errorMessage = "Upload cancelled";
+            return false;
+        }
+        if (m_socket->write(data + written, slice) != slice || !flush(errorMessage)) {
+            if (errorMessage->isEmpty()) {
+                *errorMessage = QString("Send failed: %1").arg(m_socket->errorString());
+            }
+            return false;
+        }
+        written += slice;
+        if (body) {
+            m_bodyBytesSent += slice;
+        }
+    }
+    return true;
+}
+
+#if defined(Q_OS_LINUX)
+bool UploadConnection::sendFileRange(int fileDescriptor, qint64 offset, qint64 length, QString *errorMessage) {
+    // Headers queued in the socket go first
+    if (!flush(errorMessage)) {
+        return false;
+    }
+    const int socketDescriptor = static_cast<int>(m_socket->socketDescriptor());
+    off_t position = offset;
+    qint64 remaining = length;
+    while (remaining > 0) {
+        const qint64 slice = std::min(remaining, m_limiter->sliceBytes());
+        if (!m_limiter->take(slice)) {
+            *errorMessage = "Upload cancelled";
+            return false;
+        }
+        qint64 sent = 0;
+        while (sent < slice) {
+            const ssize_t written = ::sendfile(socketDescriptor, fileDescriptor, &position, slice - sent);
+            if (written > 0) {
+                sent += written;
+                m_bodyBytesSent += written;
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EINTR)) {
+                // Qt keeps its sockets non-blocking
+                pollfd descriptor = {socketDescriptor, POLLOUT, 0};
+                if (::poll(&descriptor, 1, m_timeoutMs) <= 0) {
+                    *errorMessage = "Send timed out";
+                    return false;
+                }
+                continue;
+            }
+            *errorMessage = written == 0 ? QString("File ended early")
+                                         : QString("Send failed: %1").arg(qt_error_string(errno));
+            return false;
+        }
+        remaining -= slice;
+    }
+    return true;
+}
+#else
+bool UploadConnection::sendFileRange(int, qint64, qint64, QString *errorMessage) {
+    *errorMessage = "sendfile is not available";
+    return false;
+}
+#endif
+
+bool UploadConnection::writeFileRange(const QString& filePath, qint64 offset, qint64 length, QString *errorMessage) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+    if (file.size() < offset + length) {
+        *errorMessage = QString("%1 is shorter than when it was queued").arg(filePath);
+        return false;
+    }
+
+#if defined(Q_OS_LINUX)
+    // TLS has to see the bytes; plain HTTP can go straight from the page cache
+    if (!m_secure) {
+        return sendFileRange(file.handle(), offset, length, errorMessage);
+    }
+#endif
+
+    if (uchar *mapped = file.map(offset, length)) {
+        const bool ok = writeBytes(reinterpret_cast<const char*>(mapped), length, true, errorMessage);
+        file.unmap(mapped);
+        return ok;
+    }
+
+    // Some filesystems can't be mapped; read a slice at a time
+    if (!file.seek(offset)) {
+        *errorMessage = QString("Cannot seek in %1").arg(filePath);
+        return false;
+    }
+    QByteArray buffer;
+    qint64 remaining = length;
+    while (remaining > 0) {
+        buffer = file.read(std::min(remaining, m_limiter->sliceBytes()));
+        if (buffer.isEmpty()) {
+            *errorMessage = QString("Cannot read %1: %2").arg(filePath, file.errorString());
+            return false;
+        }
+        if (!writeBytes(buffer.constData(), buffer.size(), true, errorMessage)) {
+            return false;
+        }
+        remaining -= buffer.size();
+    }
+    return true;
+}
+
+bool UploadConnection::readLine(QByteArray *line, QString *errorMessage) {
+    while (!m_socket->canReadLine()) {
+        if (m_limiter->isCancelled()) {
+            *errorMessage = "Upload cancelled";
+            return false;
+        }
+        if (!m_socket->waitForReadyRead(m_timeoutMs)) {
+            *errorMessage = QString("No response: %1").arg(m_socket->errorString());
+            return false;
+        }
+    }
+    *line = m_socket->readLine().trimmed();
+    return true;
+}
+
+bool UploadConnection::readResponse(const QByteArray& method, Response *response, QString *errorMessage) {
+    QByteArray line;
+    if (!readLine(&line, errorMessage)) {
+        return false;
+    }
+    // "HTTP/1.1 204 No Content"
+    const QList<QByteArray> status = line.split(' ');
+    if (status.size() < 2 || !status[0].startsWith("HTTP/1.")) {
+        *errorMessage = QString("Bad status line: %1").arg(QString::fromLatin1(line.left(80)));
+        return false;
+    }
+    response->status = status[1].toInt();
+    response->headers.clear();
+    forever {
+        if (!readLine(&line, errorMessage)) {
+            return false;
+        }
+        if (line.isEmpty()) {
+            break;
+        }
+        const int colon = line.indexOf(':');
+        if (colon > 0) {
+            response->headers.append(qMakePair(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed()));
+        }
+    }
+
+    // Upload responses carry nothing worth reading; skip whatever body there is
+    const bool hasBody = method != "HEAD" && response->status != 204 && response->status != 304 &&
+                         response->status >= 200;
+    bool lengthKnown = false;
+    qint64 remaining = response->header("content-length").toLongLong(&lengthKnown);
+    if (hasBody && (!lengthKnown || remaining > MAX_ERROR_BODY_BYTES)) {
+        close(); // Chunked or unbounded; cheaper to reconnect than to parse
+        return true;
+    }
+    while (hasBody && remaining > 0) {
+        if (m_socket->bytesAvailable() == 0 && !m_socket->waitForReadyRead(m_timeoutMs)) {
+            *errorMessage = "Response body cut short";
+            return false;
+        }
+        remaining -= m_socket->read(remaining).size();
+    }
+    if (response->header("connection").toLower() == "close") {
+        close();
+    }
+    return true;
+}
+
+bool UploadConnection::request(const QByteArray& method, const QUrl& url, const Headers& headers,
+                               const std::vector<UploadSegment>& body, qint64 bodyOffset, qint64 bodyLength,
+                               Response *response, QString *errorMessage) {
+    if (!ensureConnected(url, errorMessage)) {
+        return false;
+    }
+
+    QByteArray target = url.path(QUrl::FullyEncoded).toUtf8();
+    if (target.isEmpty()) {
+        target = "/";
+    }
+    if (url.hasQuery()) {
+        target += '?' + url.query(QUrl::FullyEncoded).toUtf8();
+    }
+    QByteArray head = method + ' ' + target + " HTTP/1.1\r\n";
+    head += "Host: " + url.host().toUtf8();
+    if (url.port() > 0) {
+        head += ':' + QByteArray::number(url.port());
+    }
+    head += "\r\n";
+    for (const auto& header : headers) {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    head += "Content-Length: " + QByteArray::number(bodyLength) + "\r\n\r\n";
+
+    bool ok = writeBytes(head.constData(), head.size(), false, errorMessage);
+
+    // Only the part of each segment that overlaps the requested range
+    qint64 position = 0;
+    const qint64 end = bodyOffset + bodyLength;
+    for (const UploadSegment& segment : body) {
+        if (!ok || position >= end) {
+            break;
+        }
+        const qint64 from = std::max(bodyOffset, position);
+        const qint64 to = std::min(end, position + segment.length);
+        if (from < to) {
+            ok = segment.filePath.isEmpty()
+                ? writeBytes(segment.bytes.constData() + (from - position), to - from, true, errorMessage)
+                : writeFileRange(segment.filePath, segment.fileOffset + (from - position), to - from, errorMessage);
+        }
+        position += segment.length;
+    }
+
+    ok = ok && flush(errorMessage) && readResponse(method, response, errorMessage);
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
@@ -0,0 +1,107 @@
+#ifndef UPLOADCONNECTION_H
+#define UPLOADCONNECTION_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QUrl>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QTcpSocket;
+
+// Part of a request body: bytes held in memory, or a range of a file that is
+// streamed from disk as it is sent and never read into the heap
+struct UploadSegment {
+    QByteArray bytes;
+    QString filePath;
+    qint64 fileOffset = 0;
+    qint64 length = 0;
+
+    static UploadSegment fromBytes(const QByteArray& bytes);
+    static UploadSegment fromFile(const QString& filePath, qint64 offset, qint64 length);
+};
+
+// Token bucket for everything the uploader sends. take() is called from the
+// upload thread only; setPaused() and cancel() from anywhere.
+class BandwidthLimiter {
+public:
+    // 0 bytesPerSecond sends as fast as the link allows
+    explicit BandwidthLimiter(qint64 bytesPerSecond);
+
+    qint64 bytesPerSecond() const { return m_bytesPerSecond; }
+
+    // Largest write worth making at once: about 50 ms at the rate, so
+    // pausing or cancelling takes effect quickly
+    qint64 sliceBytes() const;
+
+    // Blocks until bytes fit under the rate and the limiter isn't paused.
+    // False once cancelled.
+    bool take(qint64 bytes);
+
+    void setPaused(bool paused) { m_paused.store(paused, std::memory_order_relaxed); }
+    bool isPaused() const { return m_paused.load(std::memory_order_relaxed); }
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    const qint64 m_bytesPerSecond;
+    double m_tokens;
+    qint64 m_lastNs;
+    QElapsedTimer m_clock;
+    std::atomic<bool> m_paused{false};
+    std::atomic<bool> m_cancelled{false};
+};
+
+// Blocking HTTP/1.1 client for the upload thread, over one keep-alive
+// connection that is reopened when it drops. File segments go out with
+// sendfile(2) on Linux over plain HTTP, and from a read-only mapping of the
+// file otherwise, so photos are never copied into memory to be sent. Every
+// byte written is paced by the limiter.
+class UploadConnection {
+public:
+    typedef QList<QPair<QByteArray, QByteArray>> Headers;
+
+    struct Response {
+        int status = 0;
+        Headers headers;                // Names lower-cased
+
+        QByteArray header(const QByteArray& name) const;
+    };
+
+    explicit UploadConnection(BandwidthLimiter *limiter, int timeoutMs = 30000);
+    ~UploadConnection();
+
+    // Sends [bodyOffset, bodyOffset + bodyLength) of the concatenated body.
+    // False on a network error, timeout or cancel, which also closes the
+    // connection; HTTP errors come back in the response.
+    bool request(const QByteArray& method, const QUrl& url, const Headers& headers,
+                 const std::vector<UploadSegment>& body, qint64 bodyOffset, qint64 bodyLength,
+                 Response *response, QString *errorMessage);
+    void close();
+
+    // Body bytes written, including any a dropped connection wasted
+    qint64 bodyBytesSent() const { return m_bodyBytesSent; }
+
+private:
+    bool ensureConnected(const QUrl& url, QString *errorMessage);
+    bool writeBytes(const char *data, qint64 length, bool body, QString *errorMessage);
+    bool writeFileRange(const QString& filePath, qint64 offset, qint64 length, QString *errorMessage);
+    bool sendFileRange(int fileDescriptor, qint64 offset, qint64 length, QString *errorMessage);
+    bool flush(QString *errorMessage);
+    bool readLine(QByteArray *line, QString *errorMessage);
+    bool readResponse(const QByteArray& method, Response *response, QString *errorMessage);
+
+    BandwidthLimiter *m_limiter;
+    const int m_timeoutMs;
+    std::unique_ptr<QTcpSocket> m_socket;
+    QString m_host;
+    int m_port;
+    bool m_secure;
+    qint64 m_bodyBytesSent;
+};
+
+#endif // UPLOADCONNECTION_H
@@ -0,0 +1,714 @@
+#include "uploadqueue.h"
+#include "boothlog.h"
+#include "photostorage.h"
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int MIN_BACKOFF_MS = 1000;
+const int MAX_BACKOFF_MS = 60000;
+const int MAX_BATCH_FILES = 64;
+const qint64 TAR_BLOCK = 512;
+
+int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value >= 0 ? value : defaultValue;
+}
+
+QString defaultDirectory() {
+    const QString directory = qEnvironmentVariable("PHOTOBOOTH_UPLOAD_QUEUE_DIR");
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/uploadqueue";
+}
+
+UploadQueue::Options environmentOptions() {
+    UploadQueue::Options options;
+    options.endpoint = QUrl(qEnvironmentVariable("PHOTOBOOTH_UPLOAD_URL"));
+    options.authorization = qgetenv("PHOTOBOOTH_UPLOAD_AUTH");
+    options.bytesPerSecond = static_cast<qint64>(envInt("PHOTOBOOTH_UPLOAD_KBPS", 1024)) * 1024;
+    return options;
+}
+
+qint64 tarPadding(qint64 size) {
+    return (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+}
+
+// ustar member header. The modification time comes from the queue record so
+// a resumed batch is byte for byte the one the server already has part of.
+QByteArray tarHeader(const QString& name, qint64 size, qint64 modifiedSecs) {
+    QByteArray header(TAR_BLOCK, '\0');
+    auto put = [&header](int offset, const QByteArray& value, int width) {
+        std::memcpy(header.data() + offset, value.constData(), std::min<qsizetype>(value.size(), width));
+    };
+    auto octal = [](qint64 value, int width) {
+        return QByteArray::number(value, 8).rightJustified(width - 1, '0');
+    };
+
+    // Names past 100 bytes are split at a slash into prefix and name
+    QByteArray path = name.toUtf8();
+    QByteArray prefix;
+    if (path.size() > 100) {
+        const qsizetype slash = path.indexOf('/', path.size() - 101);
+        if (slash > 0 && slash <= 155) {
+            prefix = path.left(slash);
+            path = path.mid(slash + 1);
+        }
+    }
+    put(0, path, 100);
+    put(100, octal(0644, 8), 8);
+    put(108, octal(0, 8), 8);
+    put(116, octal(0, 8), 8);
+    put(124, octal(size, 12), 12);
+    put(136, octal(modifiedSecs, 12), 12);
+    std::memset(header.data() + 148, ' ', 8);
+    header[156] = '0';
+    put(257, QByteArray("ustar"), 6);
+    put(263, QByteArray("00"), 2);
+    put(345, prefix, 155);
+
+    unsigned int checksum = 0;
+    for (char c : std::as_const(header)) {
+        checksum += static_cast<unsigned char>(c);
+    }
+    put(148, octal(checksum, 7) + '\0', 8);
+    return header;
+}
+
+QByteArray contentType(const QString& fileName) {
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "jpg" || suffix == "jpeg") {
+        return "image/jpeg";
+    } else if (suffix == "png") {
+        return "image/png";
+    } else if (suffix == "json") {
+        return "application/json";
+    } else if (suffix == "tar") {
+        return "application/x-tar";
+    }
+    return "application/octet-stream";
+}
+
+// tus Upload-Metadata: comma-separated keys with base64 values
+QByteArray uploadMetadata(const QString& fileName) {
+    return "filename " + fileName.toUtf8().toBase64() + ",filetype " + contentType(fileName).toBase64();
+}
+
+} // namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(UploadQueue, s_uploadQueue, (defaultDirectory(), environmentOptions()))
+
+UploadQueue* UploadQueue::instance() {
+    return s_uploadQueue();
+}
+
+UploadQueue::UploadQueue(const QString& directory, const Options& options, QObject *parent)
+    : QObject(parent)
+    , m_directory(QDir(directory).absolutePath())
+    , m_options(options)
+    , m_limiter(options.bytesPerSecond)
+    , m_paused(false)
+    , m_shuttingDown(false)
+    , m_nextId(1)
+    , m_uploader(nullptr)
+{
+    if (!isEnabled()) {
+        qCDebug(lcUpload) << "UploadQueue: No upload URL, uploads disabled";
+        return;
+    }
+    // The queue directory is read on the upload thread, not here
+    m_uploader = QThread::create([this]() { uploaderLoop(); });
+    m_uploader->setObjectName("UploadQueue");
+    m_uploader->start(QThread::LowestPriority);
+    qCDebug(lcUpload) << "UploadQueue: Uploading to" << m_options.endpoint.toDisplayString(QUrl::RemoveUserInfo)
+             << "at up to" << m_options.bytesPerSecond / 1024 << "KB/s";
+}
+
+UploadQueue::~UploadQueue() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shuttingDown = true;
+        m_workAvailable.wakeAll();
+    }
+    // Cuts any request short; what's queued stays on disk for the next start
+    m_limiter.cancel();
+    if (m_uploader) {
+        m_uploader->wait();
+        delete m_uploader;
+    }
+}
+
+QString UploadQueue::itemPath(quint64 id) const {
+    return QDir(m_directory).filePath(QString("%1.item").arg(id, 10, 10, QChar('0')));
+}
+
+QString UploadQueue::uploadPath() const {
+    return QDir(m_directory).filePath("current.upload");
+}
+
+void UploadQueue::submitSession(const SessionJournal::Entry& entry) {
+    if (!isEnabled()) {
+        return;
+    }
+    const QString folder = entry.sequence != 0
+        ? QString("session-%1").arg(entry.sequence, 6, 10, QChar('0'))
+        : QString("session-%1").arg(entry.startTime.toString("yyyyMMdd-hhmmss"));
+
+    QStringList filePaths;
+    if (!entry.photoPath.isEmpty()) {
+        filePaths << entry.photoPath;
+    }
+    filePaths << entry.stripPhotoPaths;
+    if (!entry.printPath.isEmpty()) {
+        filePaths << entry.printPath;
+    }
+
+    std::vector<Incoming> incoming;
+    QJsonArray files;
+    for (const QString& filePath : std::as_const(filePaths)) {
+        Incoming file;
+        file.filePath = filePath;
+        file.remoteName = folder + "/" + QFileInfo(filePath).fileName();
+        files.append(file.remoteName);
+        incoming.push_back(file);
+    }
+
+    QJsonObject summary;
+    summary.insert("sequence", QString::number(entry.sequence));
+    summary.insert("start", entry.startTime.toString(Qt::ISODateWithMs));
+    summary.insert("end", entry.endTime.toString(Qt::ISODateWithMs));
+    summary.insert("guest", entry.userName);
+    summary.insert("weapon", entry.weaponId);
+    summary.insert("land", entry.landId);
+    summary.insert("companion", entry.companionId);
+    summary.insert("files", files);
+    Incoming summaryFile;
+    summaryFile.filePath = QDir(m_directory).filePath(folder + ".json");
+    summaryFile.remoteName = folder + "/session.json";
+    summaryFile.contents = QJsonDocument(summary).toJson();
+    incoming.push_back(summaryFile);
+
+    QMutexLocker locker(&m_mutex);
+    m_incoming.insert(m_incoming.end(), incoming.begin(), incoming.end());
+    m_workAvailable.wakeOne();
+}
+
+void UploadQueue::submitFile(const QString& filePath, const QString& remoteName) {
+    if (!isEnabled()) {
+        return;
+    }
+    Incoming file;
+    file.filePath = filePath;
+    file.remoteName = remoteName;
+    QMutexLocker locker(&m_mutex);
+    m_incoming.push_back(file);
+    m_workAvailable.wakeOne();
+}
+
+void UploadQueue::setPaused(bool paused) {
+    m_limiter.setPaused(paused);
+    QMutexLocker locker(&m_mutex);
+    m_paused = paused;
+    m_workAvailable.wakeOne();
+}
+
+void UploadQueue::recover() {
+    if (!QDir().mkpath(m_directory)) {
+        qCWarning(lcUpload) << "UploadQueue: Failed to create queue directory:" << m_directory;
+        return;
+    }
+    const QDir dir(m_directory);
+    std::deque<Item> items;
+    QSet<QString> ownedPaths;
+    const QStringList records = dir.entryList(QStringList() << "*.item", QDir::Files, QDir::Name);
+    for (const QString& fileName : records) {
+        QFile file(dir.filePath(fileName));
+        const QJsonObject record = file.open(QIODevice::ReadOnly)
+            ? QJsonDocument::fromJson(file.readAll()).object() : QJsonObject();
+        Item item;
+        item.id = QFileInfo(fileName).completeBaseName().toULongLong();
+        item.filePath = record.value("path").toString();
+        item.remoteName = record.value("name").toString();
+        item.size = record.value("size").toInteger();
+        item.submittedMs = record.value("submitted").toInteger();
+        item.owned = record.value("owned").toBool();
+        if (item.id == 0 || item.filePath.isEmpty() || item.remoteName.isEmpty()) {
+            qCWarning(lcUpload) << "UploadQueue: Dropping unreadable record" << fileName;
+            QFile::remove(dir.filePath(fileName));
+            continue;
+        }
+        if (item.owned) {
+            ownedPaths.insert(item.filePath);
+        }
+        m_nextId = std::max(m_nextId, item.id + 1);
+        items.push_back(item);
+    }
+
+    // Summaries written just before a crash, whose records never were
+    const QStringList summaries = dir.entryList(QStringList() << "*.json", QDir::Files);
+    for (const QString& fileName : summaries) {
+        if (!ownedPaths.contains(dir.absoluteFilePath(fileName))) {
+            QFile::remove(dir.filePath(fileName));
+        }
+    }
+
+    // The upload that was in progress carries on where the server has it
+    Upload current;
+    QFile state(uploadPath());
+    if (state.open(QIODevice::ReadOnly)) {
+        const QJsonObject saved = QJsonDocument::fromJson(state.readAll()).object();
+        state.close();
+        const QJsonArray ids = saved.value("items").toArray();
+        for (const QJsonValue& id : ids) {
+            const auto found = std::find_if(items.cbegin(), items.cend(), [&id](const Item& item) {
+                return item.id == id.toString().toULongLong();
+            });
+            if (found == items.cend()) {
+                current.items.clear();
+                break;
+            }
+            current.items << *found;
+        }
+        current.batch = saved.value("batch").toBool();
+        current.location = saved.value("location").toString();
+        current.length = saved.value("length").toInteger();
+        if (current.items.isEmpty()) {
+            current = Upload();
+            QFile::remove(uploadPath());
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_items.insert(m_items.begin(), items.begin(), items.end());
+    m_current = current;
+    if (!items.empty()) {
+        qCDebug(lcUpload) << "UploadQueue:" << items.size() << "files still to upload"
+                 << (current.location.isEmpty() ? "" : ", resuming an upload");
+    }
+}
+
+void UploadQueue::persist(const std::vector<Incoming>& incoming) {
+    for (const Incoming& file : incoming) {
+        QString errorMessage;
+        if (!file.contents.isEmpty() && !PhotoStorage::instance()->write(file.filePath, file.contents, &errorMessage)) {
+            qCWarning(lcUpload) << "UploadQueue: Failed to write" << file.filePath << ":" << errorMessage;
+            QMutexLocker locker(&m_mutex);
+            ++m_statistics.skippedFiles;
+            continue;
+        }
+        const QFileInfo info(file.filePath);
+        if (!info.isFile()) {
+            qCWarning(lcUpload) << "UploadQueue: Not uploading missing file" << file.filePath;
+            QMutexLocker locker(&m_mutex);
+            ++m_statistics.skippedFiles;
+            continue;
+        }
+
+        Item item;
+        item.id = m_nextId++;
+        item.filePath = info.absoluteFilePath();
+        item.remoteName = file.remoteName;
+        item.size = info.size();
+        item.submittedMs = QDateTime::currentMSecsSinceEpoch();
+        item.owned = !file.contents.isEmpty();
+        QJsonObject record;
+        record.insert("path", item.filePath);
+        record.insert("name", item.remoteName);
+        record.insert("size", item.size);
+        record.insert("submitted", item.submittedMs);
+        record.insert("owned", item.owned);
+        // The record is the commit point; an owned file without one is removed at start-up
+        if (!PhotoStorage::instance()->write(itemPath(item.id), QJsonDocument(record).toJson(QJsonDocument::Compact),
+                                             &errorMessage)) {
+            qCWarning(lcUpload) << "UploadQueue: Failed to record" << file.filePath << ":" << errorMessage;
+            if (item.owned) {
+                QFile::remove(item.filePath);
+            }
+            QMutexLocker locker(&m_mutex);
+            ++m_statistics.skippedFiles;
+            continue;
+        }
+        QMutexLocker locker(&m_mutex);
+        m_items.push_back(item);
+    }
+}
+
+bool UploadQueue::nextUpload(Upload *upload, int *delayMs) {
+    QMutexLocker locker(&m_mutex);
+    *delayMs = -1;
+    if (!m_current.items.isEmpty()) {
+        *upload = m_current;
+        return true;
+    }
+
+    // Photos and prints go as they come
+    for (const Item& item : m_items) {
+        if (item.size >= m_options.batchFileBytes) {
+            m_current = Upload();
+            m_current.items << item;
+            m_current.length = item.size;
+            *upload = m_current;
+            return true;
+        }
+    }
+
+    // The rest are small and share a batch once it's full or has waited long enough
+    QList<Item> batch;
+    qint64 length = 2 * TAR_BLOCK;
+    bool full = false;
+    for (const Item& item : m_items) {
+        const qint64 member = TAR_BLOCK + item.size + tarPadding(item.size);
+        if (!batch.isEmpty() && (length + member > m_options.batchBytes || batch.size() >= MAX_BATCH_FILES)) {
+            full = true;
+            break;
+        }
+        batch << item;
+        length += member;
+    }
+    if (batch.isEmpty()) {
+        return false;
+    }
+    const qint64 waitedMs = QDateTime::currentMSecsSinceEpoch() - batch.first().submittedMs;
+    if (!full && waitedMs >= 0 && waitedMs < m_options.batchDelayMs) {
+        *delayMs = static_cast<int>(m_options.batchDelayMs - waitedMs);
+        return false;
+    }
+
+    m_current = Upload();
+    m_current.items = batch;
+    m_current.batch = batch.size() > 1;
+    m_current.length = m_current.batch ? length : batch.first().size;
+    *upload = m_current;
+    return true;
+}
+
+bool UploadQueue::dropChangedItems(Upload *upload) {
+    // Retaken photos can be evicted, and anything can be deleted by hand
+    QList<Item> dropped;
+    for (int i = upload->items.size() - 1; i >= 0; --i) {
+        const Item& item = upload->items[i];
+        const QFileInfo info(item.filePath);
+        if (!info.isFile() || info.size() != item.size) {
+            dropped << item;
+            upload->items.removeAt(i);
+        }
+    }
+    if (dropped.isEmpty()) {
+        return !upload->items.isEmpty();
+    }
+
+    for (const Item& item : std::as_const(dropped)) {
+        qCWarning(lcUpload) << "UploadQueue:" << item.filePath << "changed or went away before it was uploaded";
+        QFile::remove(itemPath(item.id));
+        if (item.owned) {
+            QFile::remove(item.filePath);
+        }
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_statistics.skippedFiles += dropped.size();
+        for (const Item& item : std::as_const(dropped)) {
+            m_items.erase(std::remove_if(m_items.begin(), m_items.end(),
+                                         [&item](const Item& queued) { return queued.id == item.id; }),
+                          m_items.end());
+        }
+    }
+
+    // Different bytes: the server's partial upload can't be continued
+    upload->location.clear();
+    upload->batch = upload->items.size() > 1;
+    upload->length = 0;
+    for (const Item& item : std::as_const(upload->items)) {
+        upload->length += upload->batch ? TAR_BLOCK + item.size + tarPadding(item.size) : item.size;
+    }
+    if (upload->batch) {
+        upload->length += 2 * TAR_BLOCK;
+    }
+    return !upload->items.isEmpty();
+}
+
+std::vector<UploadSegment> UploadQueue::buildBody(const Upload& upload) const {
+    std::vector<UploadSegment> body;
+    if (!upload.batch) {
+        body.push_back(UploadSegment::fromFile(upload.items.first().filePath, 0, upload.items.first().size));
+        return body;
+    }
+    for (const Item& item : upload.items) {
+        body.push_back(UploadSegment::fromBytes(tarHeader(item.remoteName, item.size, item.submittedMs / 1000)));
+        body.push_back(UploadSegment::fromFile(item.filePath, 0, item.size));
+        if (tarPadding(item.size) > 0) {
+            body.push_back(UploadSegment::fromBytes(QByteArray(tarPadding(item.size), '\0')));
+        }
+    }
+    body.push_back(UploadSegment::fromBytes(QByteArray(2 * TAR_BLOCK, '\0')));
+    return body;
+}
+
+void UploadQueue::saveUpload(const Upload& upload) {
+    QJsonArray ids;
+    for (const Item& item : upload.items) {
+        ids.append(QString::number(item.id));
+    }
+    QJsonObject state;
+    state.insert("items", ids);
+    state.insert("batch", upload.batch);
+    state.insert("location", upload.location);
+    state.insert("length", upload.length);
+    QString errorMessage;
+    if (!PhotoStorage::instance()->write(uploadPath(), QJsonDocument(state).toJson(QJsonDocument::Compact),
+                                         &errorMessage)) {
+        qCWarning(lcUpload) << "UploadQueue: Failed to record upload in progress:" << errorMessage;
+    }
+}
+
+bool UploadQueue::call(UploadConnection& connection, const QByteArray& method, const QUrl& url,
+                       UploadConnection::Headers headers, const std::vector<UploadSegment>& body,
+                       qint64 bodyOffset, qint64 bodyLength, UploadConnection::Response *response,
+                       QString *errorMessage) {
+    headers.prepend(qMakePair(QByteArray("Tus-Resumable"), QByteArray("1.0.0")));
+    if (!m_options.authorization.isEmpty()) {
+        headers.append(qMakePair(QByteArray("Authorization"), m_options.authorization));
+    }
+    const qint64 sentBefore = connection.bodyBytesSent();
+    const bool ok = connection.request(method, url, headers, body, bodyOffset, bodyLength, response, errorMessage);
+
+    QMutexLocker locker(&m_mutex);
+    ++m_statistics.requests;
+    m_statistics.sentBytes += connection.bodyBytesSent() - sentBefore;
+    if (!ok || response->status >= 400) {
+        ++m_statistics.failedRequests;
+    }
+    return ok;
+}
+
+bool UploadQueue::send(UploadConnection& connection, Upload *upload, QString *errorMessage) {
+    if (!dropChangedItems(upload)) {
+        return true; // Nothing left to send
+    }
+    const std::vector<UploadSegment> body = buildBody(*upload);
+    UploadConnection::Response response;
+    qint64 offset = 0;
+
+    // After a drop or a restart the server says how much it already has
+    if (!upload->location.isEmpty()) {
+        if (!call(connection, "HEAD", QUrl(upload->location), {}, {}, 0, 0, &response, errorMessage)) {
+            return false;
+        }
+        if (response.status == 404 || response.status == 410) {
+            qCWarning(lcUpload) << "UploadQueue: Server no longer has" << upload->location << ", starting it again";
+            upload->location.clear();
+        } else if (response.status != 200 && response.status != 204) {
+            *errorMessage = QString("HEAD %1 returned %2").arg(upload->location).arg(response.status);
+            return false;
+        } else {
+            offset = std::clamp<qint64>(response.header("upload-offset").toLongLong(), 0, upload->length);
+            if (offset > 0) {
+                QMutexLocker locker(&m_mutex);
+                ++m_statistics.resumes;
+            }
+        }
+    }
+
+    if (upload->location.isEmpty()) {
+        const QString name = upload->batch
+            ? QString("batch-%1.tar").arg(upload->items.first().id, 10, 10, QChar('0'))
+            : upload->items.first().remoteName;
+        UploadConnection::Headers headers;
+        headers << qMakePair(QByteArray("Upload-Length"), QByteArray::number(upload->length))
+                << qMakePair(QByteArray("Upload-Metadata"), uploadMetadata(name));
+        if (!call(connection, "POST", m_options.endpoint, headers, {}, 0, 0, &response, errorMessage)) {
+            return false;
+        }
+        const QByteArray location = response.header("location");
+        if (response.status != 201 || location.isEmpty()) {
+            *errorMessage = QString("Creating %1 returned %2").arg(name).arg(response.status);
+            return false;
+        }
+        upload->location = m_options.endpoint.resolved(QUrl::fromEncoded(location)).toString();
+        saveUpload(*upload);
+    }
+
+    while (offset < upload->length) {
+        const qint64 chunk = std::min(m_options.chunkBytes, upload->length - offset);
+        UploadConnection::Headers headers;
+        headers << qMakePair(QByteArray("Upload-Offset"), QByteArray::number(offset))
+                << qMakePair(QByteArray("Content-Type"), QByteArray("application/offset+octet-stream"));
+        if (!call(connection, "PATCH", QUrl(upload->location), headers, body, offset, chunk, &response,
+                  errorMessage)) {
+            return false;
+        }
+        if (response.status != 204 && response.status != 200) {
+            *errorMessage = QString("PATCH at %1 returned %2").arg(offset).arg(response.status);
+            return false;
+        }
+        bool ok = false;
+        const qint64 next = response.header("upload-offset").toLongLong(&ok);
+        if (!ok || next <= offset || next > upload->length) {
+            *errorMessage = QString("PATCH at %1 answered with offset %2")
+                .arg(offset).arg(QString::fromLatin1(response.header("upload-offset")));
+            return false;
+        }
+        offset = next;
+    }
+    return true;
+}
+
+void UploadQueue::complete(const Upload& upload, qint64 elapsedMs) {
+    QFile::remove(uploadPath());
+    qint64 bytes = 0;
+    for (const Item& item : upload.items) {
+        QFile::remove(itemPath(item.id));
+        if (item.owned) {
+            QFile::remove(item.filePath);
+        }
+        bytes += item.size;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const Item& item : upload.items) {
+            m_items.erase(std::remove_if(m_items.begin(), m_items.end(),
+                                         [&item](const Item& queued) { return queued.id == item.id; }),
+                          m_items.end());
+        }
+        m_current = Upload();
+        if (!upload.items.isEmpty()) {
+            ++m_statistics.uploads;
+            m_statistics.batches += upload.batch ? 1 : 0;
+            m_statistics.uploadedFiles += upload.items.size();
+            m_statistics.uploadedBytes += bytes;
+        }
+    }
+    if (upload.items.isEmpty()) {
+        return;
+    }
+
+    if (upload.batch) {
+        qCDebug(lcUpload) << "UploadQueue: Uploaded a batch of" << upload.items.size() << "files," << bytes << "bytes in"
+                 << elapsedMs << "ms";
+    } else {
+        qCDebug(lcUpload) << "UploadQueue: Uploaded" << upload.items.first().remoteName << "," << bytes << "bytes in"
+                 << elapsedMs << "ms";
+    }
+    for (const Item& item : upload.items) {
+        emit fileUploaded(item.remoteName, item.size);
+    }
+}
+
+void UploadQueue::idleFor(int ms, bool wakeOnSubmit) {
+    QDeadlineTimer deadline(ms);
+    QMutexLocker locker(&m_mutex);
+    while (!m_shuttingDown && m_workAvailable.wait(&m_mutex, deadline)) {
+        if (wakeOnSubmit && !m_incoming.empty()) {
+            return;
+        }
+    }
+}
+
+bool UploadQueue::isIdleLocked() const {
+    return m_incoming.empty() && m_items.empty();
+}
+
+void UploadQueue::uploaderLoop() {
+    recover();
+    UploadConnection connection(&m_limiter, m_options.timeoutMs);
+    int failures = 0;
+    forever {
+        std::vector<Incoming> incoming;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (isIdleLocked()) {
+                m_idle.wakeAll();
+            }
+            while (!m_shuttingDown && m_incoming.empty() && (m_paused || m_items.empty())) {
+                m_workAvailable.wait(&m_mutex);
+            }
+            if (m_shuttingDown) {
+                break;
+            }
+            incoming = m_incoming;
+        }
+        // Left in m_incoming until recorded, so waitForIdle() can't slip between
+        persist(incoming);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_incoming.erase(m_incoming.begin(), m_incoming.begin() + incoming.size());
+        }
+
+        Upload upload;
+        int delayMs = -1;
+        if (!nextUpload(&upload, &delayMs)) {
+            if (delayMs > 0) {
+                idleFor(delayMs, true);
+            }
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QString errorMessage;
+        if (send(connection, &upload, &errorMessage)) {
+            complete(upload, timer.elapsed());
+            failures = 0;
+            continue;
+        }
+        if (m_limiter.isCancelled()) {
+            break;
+        }
+
+        // Keeps the server's location, so the retry continues rather than restarts
+        {
+            QMutexLocker locker(&m_mutex);
+            m_current = upload;
+        }
+        ++failures;
+        const int backoffMs = std::min(MAX_BACKOFF_MS, MIN_BACKOFF_MS << std::min(failures - 1, 6));
+        // Jittered, so booths sharing a venue's Wi-Fi don't retry in step
+        const int retryInMs = backoffMs / 2 + QRandomGenerator::global()->bounded(backoffMs / 2 + 1);
+        qCWarning(lcUpload) << "UploadQueue: Upload failed:" << errorMessage << "- retrying in" << retryInMs << "ms";
+        emit uploadFailed(errorMessage, retryInMs);
+        idleFor(retryInMs, false);
+    }
+}
+
+UploadQueue::Statistics UploadQueue::statistics() const {
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.pendingFiles = static_cast<int>(m_items.size() + m_incoming.size());
+    for (const Item& item : m_items) {
+        statistics.pendingBytes += item.size;
+    }
+    if (!m_items.empty()) {
+        statistics.oldestWaitMs = QDateTime::currentMSecsSinceEpoch() - m_items.front().submittedMs;
+    }
+    return statistics;
+}
+
+bool UploadQueue::waitForIdle(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (!isIdleLocked()) {
+        if (!m_idle.wait(&m_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
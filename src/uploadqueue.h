@@ -0,0 +1,154 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+#include <QWaitCondition>
+#include <deque>
+#include <vector>
+#include "sessionjournal.h"
+#include "uploadconnection.h"
+
+class QThread;
+
+// Sends finished sessions to the gallery server in the background.
+//
+// The server speaks tus 1.0 (https://tus.io), core protocol plus creation:
+// each upload is created with a POST, filled with PATCH requests of at most
+// chunkBytes, and after a dropped connection or a restart its offset is
+// read back with HEAD and the upload continues from there. Failed requests
+// are retried with exponential backoff.
+//
+// Photos and prints go one per upload. Files smaller than batchFileBytes,
+// such as strip shots and the session summaries, wait up to batchDelayMs to
+// share a tar archive of up to batchBytes, so a busy evening isn't hundreds
+// of round trips. Files are streamed from disk as they are sent.
+//
+// Everything goes through one BandwidthLimiter, and sending pauses while
+// setPaused(true) is in effect, so the link and the SD card are left to
+// the camera during a capture. submit calls only queue in memory; the
+// upload thread writes an <id>.item record for each file, and the upload in
+// progress to current.upload, so the queue survives a restart.
+//
+// Signals are emitted from the upload thread.
+class UploadQueue : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QUrl endpoint;                          // tus creation URL; empty disables uploading
+        QByteArray authorization;               // Authorization header, if the server wants one
+        qint64 bytesPerSecond = 1024 * 1024;    // 0 for no cap
+        qint64 chunkBytes = 1024 * 1024;        // Per PATCH; the most a drop can waste
+        qint64 batchFileBytes = 256 * 1024;
+        qint64 batchBytes = 4 * 1024 * 1024;
+        int batchDelayMs = 30000;
+        int timeoutMs = 30000;
+    };
+
+    struct Statistics {
+        int pendingFiles = 0;
+        qint64 pendingBytes = 0;
+        qint64 oldestWaitMs = 0;
+        quint64 uploadedFiles = 0;
+        qint64 uploadedBytes = 0;       // File bytes the server has confirmed
+        qint64 sentBytes = 0;           // Body bytes sent, including what drops wasted
+        quint64 uploads = 0;            // Completed tus uploads, single files and batches
+        quint64 batches = 0;
+        quint64 requests = 0;
+        quint64 failedRequests = 0;
+        quint64 resumes = 0;            // Uploads continued from the server's offset
+        quint64 skippedFiles = 0;       // Gone or changed before they could be sent
+    };
+
+    UploadQueue(const QString& directory, const Options& options, QObject *parent = nullptr);
+    ~UploadQueue() override;
+
+    // Shared instance uploading to PHOTOBOOTH_UPLOAD_URL with
+    // PHOTOBOOTH_UPLOAD_AUTH as the Authorization header, capped at
+    // PHOTOBOOTH_UPLOAD_KBPS (1024 by default, 0 for no cap) and queued in
+    // PHOTOBOOTH_UPLOAD_QUEUE_DIR. Disabled when no URL is set.
+    static UploadQueue* instance();
+
+    bool isEnabled() const { return m_options.endpoint.isValid() && !m_options.endpoint.isEmpty(); }
+
+    // Queues the session's photo, strip and print, and a JSON summary of the
+    // session, under session-<sequence>/ on the server. Never waits for the
+    // disk or the network.
+    void submitSession(const SessionJournal::Entry& entry);
+    void submitFile(const QString& filePath, const QString& remoteName);
+
+    // Holds sending at the next slice, mid-upload if need be
+    void setPaused(bool paused);
+
+    Statistics statistics() const;
+
+    // Blocks until everything submitted has been uploaded or skipped
+    bool waitForIdle(int timeoutMs);
+
+signals:
+    void fileUploaded(const QString& remoteName, qint64 bytes);
+    void uploadFailed(const QString& errorMessage, int retryInMs);
+
+private:
+    struct Incoming {
+        QString filePath;
+        QString remoteName;
+        QByteArray contents;            // Written by the queue when set, e.g. a summary
+    };
+
+    struct Item {
+        quint64 id = 0;
+        QString filePath;
+        QString remoteName;
+        qint64 size = 0;
+        qint64 submittedMs = 0;
+        bool owned = false;             // Written by the queue, removed once sent
+    };
+
+    struct Upload {
+        QList<Item> items;
+        bool batch = false;
+        QString location;               // Empty until the server has created it
+        qint64 length = 0;
+    };
+
+    void recover();
+    void persist(const std::vector<Incoming>& incoming);
+    bool nextUpload(Upload *upload, int *delayMs);
+    bool send(UploadConnection& connection, Upload *upload, QString *errorMessage);
+    bool call(UploadConnection& connection, const QByteArray& method, const QUrl& url,
+              UploadConnection::Headers headers, const std::vector<UploadSegment>& body,
+              qint64 bodyOffset, qint64 bodyLength, UploadConnection::Response *response, QString *errorMessage);
+    std::vector<UploadSegment> buildBody(const Upload& upload) const;
+    bool dropChangedItems(Upload *upload);
+    void saveUpload(const Upload& upload);
+    void complete(const Upload& upload, qint64 elapsedMs);
+    void idleFor(int ms, bool wakeOnSubmit);
+    void uploaderLoop();
+    bool isIdleLocked() const;
+    QString itemPath(quint64 id) const;
+    QString uploadPath() const;
+
+    const QString m_directory;
+    const Options m_options;
+    BandwidthLimiter m_limiter;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_idle;
+    std::vector<Incoming> m_incoming;
+    std::deque<Item> m_items;           // Recorded on disk, in submission order
+    Upload m_current;                   // Being sent; its items stay in m_items
+    bool m_paused;
+    bool m_shuttingDown;
+    quint64 m_nextId;
+    Statistics m_statistics;
+    QThread *m_uploader;
+};
+
+#endif // UPLOADQUEUE_H
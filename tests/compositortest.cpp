@@ -0,0 +1,154 @@
+// Golden-image check of the print layout. Composes synthetic layers whose
+// scaling is exact (a page-sized land, overlay-sized art, a block-pattern
+// photo) and compares the page channel by channel.
+//
+//   compositortest [golden.png] [--update]
+//
+// Runs on one thread and several, with SIMD blending on and off; every page
+// must match the single-threaded scalar one, and the golden when one is given,
+// within TOLERANCE. No caption, since text rendering varies with the installed
+// fonts. --update writes the single-threaded scalar page as the golden instead,
+// for a first build or after an intended layout change; check it by eye before
+// committing it.
+
+#include "photocompositor.h"
+#include <QCoreApplication>
+#include <QImage>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int TOLERANCE = 2;
+
+// Varies along x and in bands down the page, so a misplaced layer shows
+QImage makeLand() {
+    QImage image(PhotoCompositor::PRINT_WIDTH, PhotoCompositor::PRINT_HEIGHT, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            row[x] = qRgb(x * 255 / (image.width() - 1), 40 + (y / 100) * 15, 200 - x * 120 / (image.width() - 1));
+        }
+    }
+    return image;
+}
+
+// Square and opaque, so the compositor feathers it with its ellipse mask
+QImage makeArt(const QColor& fill, const QColor& stripe) {
+    const int size = PhotoCompositor::PRINT_HEIGHT * 3 / 10;
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(fill);
+    for (int y = size * 4 / 9; y < size * 5 / 9; ++y) {
+        std::fill_n(reinterpret_cast<QRgb*>(image.scanLine(y)), size, stripe.rgb());
+    }
+    return image;
+}
+
+// 4x3 blocks, so resampling is checked at every block edge
+QImage makePhoto() {
+    static const QRgb colors[12] = {
+        0xffe74c3c, 0xff2ecc71, 0xff3498db, 0xfff1c40f,
+        0xff9b59b6, 0xff1abc9c, 0xffecf0f1, 0xff34495e,
+        0xffe67e22, 0xff000000, 0xffffffff, 0xff7f8c8d
+    };
+    QImage image(320, 240, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            row[x] = colors[(y / 80) * 4 + x / 80];
+        }
+    }
+    return image;
+}
+
+QImage compose(int threads, bool simd) {
+    PhotoCompositor compositor(threads);
+    compositor.setSimdEnabled(simd);
+    compositor.setAsset("land", makeLand());
+    compositor.setAsset("weapon", makeArt(QColor(230, 200, 60), QColor(120, 40, 40)));
+    compositor.setAsset("companion", makeArt(QColor(70, 150, 220), QColor(250, 250, 250)));
+
+    PhotoCompositor::Request request;
+    request.photo = makePhoto();
+    request.landId = "land";
+    request.weaponId = "weapon";
+    request.companionId = "companion";
+    return compositor.compose(request);
+}
+
+// Largest channel difference, and how many pixels are over TOLERANCE
+int compare(const QImage& actual, const QImage& golden, qint64 *overTolerance) {
+    *overTolerance = 0;
+    int worst = 0;
+    for (int y = 0; y < golden.height(); ++y) {
+        const QRgb *a = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        const QRgb *g = reinterpret_cast<const QRgb*>(golden.constScanLine(y));
+        for (int x = 0; x < golden.width(); ++x) {
+            const int difference = std::max({std::abs(qRed(a[x]) - qRed(g[x])),
+                                             std::abs(qGreen(a[x]) - qGreen(g[x])),
+                                             std::abs(qBlue(a[x]) - qBlue(g[x]))});
+            worst = std::max(worst, difference);
+            if (difference > TOLERANCE) {
+                ++*overTolerance;
+            }
+        }
+    }
+    return worst;
+}
+
+bool check(const QImage& page, const QImage& expected, const QString& what) {
+    if (page.size() != expected.size()) {
+        std::printf("%s: page is %dx%d, expected %dx%d: FAILED\n", qPrintable(what),
+                    page.width(), page.height(), expected.width(), expected.height());
+        return false;
+    }
+    qint64 overTolerance = 0;
+    const int worst = compare(page, expected, &overTolerance);
+    std::printf("%s: max difference %d, %lld pixels over %d: %s\n", qPrintable(what), worst,
+                static_cast<long long>(overTolerance), TOLERANCE, overTolerance == 0 ? "ok" : "FAILED");
+    return overTolerance == 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const QString goldenPath = args.size() > 1 && args.at(1) != "--update" ? args.at(1) : QString();
+
+    if (args.contains("--update")) {
+        if (goldenPath.isEmpty()) {
+            std::fprintf(stderr, "usage: compositortest [golden.png] [--update]\n");
+            return 2;
+        }
+        if (!compose(1, false).save(goldenPath, "PNG")) {
+            std::fprintf(stderr, "compositortest: failed to write %s\n", qPrintable(goldenPath));
+            return 1;
+        }
+        std::printf("compositortest: wrote %s\n", qPrintable(goldenPath));
+        return 0;
+    }
+
+    const QImage reference = compose(1, false);
+    QImage golden;
+    if (!goldenPath.isEmpty()) {
+        golden = QImage(goldenPath).convertToFormat(QImage::Format_RGB32);
+        if (golden.isNull()) {
+            std::fprintf(stderr, "compositortest: failed to read %s\n", qPrintable(goldenPath));
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    const struct { int threads; bool simd; } runs[] = {{1, false}, {1, true}, {4, true}};
+    for (const auto& run : runs) {
+        const QImage page = run.threads == 1 && !run.simd ? reference : compose(run.threads, run.simd);
+        const char *mode = run.simd ? "simd" : "scalar";
+        passed = check(page, reference, QString("%1 threads, %2 against scalar").arg(run.threads).arg(mode)) && passed;
+        if (!golden.isNull()) {
+            passed = check(page, golden, QString("%1 threads, %2 against golden").arg(run.threads).arg(mode)) && passed;
+        }
+    }
+    return passed ? 0 : 1;
+}
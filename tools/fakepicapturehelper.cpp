@@ -0,0 +1,121 @@
+// Stand-in for `libcamera-still --keypress` on machines without a Pi camera.
+//
+// Accepts the same command line PiCaptureHelper passes to libcamera-still,
+// reads stdin line by line and writes one JPEG per empty line ("x" exits).
+// Behaviour is scripted through environment variables:
+//
+//   FAKE_HELPER_STARTUP_MS   delay before the first trigger is accepted (sensor power-up)
+//   FAKE_HELPER_CAPTURE_MS   delay between trigger and the JPEG being written
+//   FAKE_HELPER_CRASH_AFTER  exit with code 1 after this many captures
+//   FAKE_HELPER_LOG          append "<shot> <trigger-to-file us>" lines to this file
+//
+// Run the booth against it with PHOTOBOOTH_CAMERA=pi and
+// PHOTOBOOTH_PI_CAPTURE_HELPER=/path/to/fakepicapturehelper.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+static int envInt(const char* name, int defaultValue) {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? value : defaultValue;
+}
+
+static QImage createFrame(int width, int height, int shot) {
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            line[x] = qRgb((x + shot * 37) & 0xff, (y + shot * 11) & 0xff, (x ^ y) & 0xff);
+        }
+    }
+    return image;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QString outputPattern;
+    int width = 1920;
+    int height = 1080;
+    int quality = 95;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        bool hasValue = i + 1 < args.size();
+        if ((arg == "-o" || arg == "--output") && hasValue) {
+            outputPattern = args.at(++i);
+        } else if ((arg == "--width" || arg == "-w") && hasValue) {
+            width = args.at(++i).toInt();
+        } else if ((arg == "--height" || arg == "-h") && hasValue) {
+            height = args.at(++i).toInt();
+        } else if ((arg == "--quality" || arg == "-q") && hasValue) {
+            quality = args.at(++i).toInt();
+        } else if ((arg == "--timeout" || arg == "-t") && hasValue) {
+            ++i; // Always runs until "x"
+        }
+    }
+
+    if (outputPattern.isEmpty()) {
+        std::fprintf(stderr, "fakepicapturehelper: missing -o <pattern>\n");
+        return 2;
+    }
+
+    const int startupMs = envInt("FAKE_HELPER_STARTUP_MS", 0);
+    const int captureMs = envInt("FAKE_HELPER_CAPTURE_MS", 50);
+    const int crashAfter = envInt("FAKE_HELPER_CRASH_AFTER", -1);
+    const QString logPath = qEnvironmentVariable("FAKE_HELPER_LOG");
+
+    QThread::msleep(startupMs);
+    std::fprintf(stderr, "fakepicapturehelper: ready, %dx%d q%d\n", width, height, quality);
+
+    int shot = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line[0] == 'x') {
+            break;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QThread::msleep(captureMs);
+
+        QString fileName = QString::asprintf(outputPattern.toLocal8Bit().constData(), shot);
+        QImageWriter writer(fileName, "jpg");
+        writer.setQuality(quality);
+        if (!writer.write(createFrame(width, height, shot))) {
+            std::fprintf(stderr, "fakepicapturehelper: failed to write %s\n", qPrintable(fileName));
+            return 1;
+        }
+
+        qint64 latencyUs = timer.nsecsElapsed() / 1000;
+        std::fprintf(stderr, "fakepicapturehelper: shot %d -> %s (%lld us)\n",
+                     shot, qPrintable(fileName), static_cast<long long>(latencyUs));
+
+        if (!logPath.isEmpty()) {
+            QFile log(logPath);
+            if (log.open(QIODevice::Append | QIODevice::Text)) {
+                QTextStream(&log) << shot << ' ' << latencyUs << '\n';
+            }
+        }
+
+        ++shot;
+        if (crashAfter >= 0 && shot >= crashAfter) {
+            std::fprintf(stderr, "fakepicapturehelper: simulating crash\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
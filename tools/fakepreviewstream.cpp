@@ -0,0 +1,142 @@
+// File-backed stand-in for `libcamera-vid --output -`.
+//
+//   fakepreviewstream --input <file> [--format mjpeg|yuv420] [--width W --height H]
+//                     [--fps N] [--frames N]
+//   fakepreviewstream --generate <file> [--count N] [--width W --height H]
+//
+// Replays a recorded MJPEG (concatenated JPEGs) or raw I420 stream to stdout at
+// a fixed frame rate, looping until --frames frames have been written (0 means
+// forever). --generate writes a synthetic MJPEG stream to replay.
+//
+// Run the booth against it with PHOTOBOOTH_PI_PREVIEW_COMMAND set to the full
+// fakepreviewstream command line.
+
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static std::vector<QByteArray> splitMjpeg(const QByteArray& data) {
+    static const QByteArray startMarker("\xFF\xD8", 2);
+    static const QByteArray endMarker("\xFF\xD9", 2);
+
+    std::vector<QByteArray> frames;
+    qsizetype pos = data.indexOf(startMarker);
+    while (pos >= 0) {
+        qsizetype end = data.indexOf(endMarker, pos + 2);
+        if (end < 0) {
+            break;
+        }
+        frames.push_back(data.mid(pos, end + 2 - pos));
+        pos = data.indexOf(startMarker, end + 2);
+    }
+    return frames;
+}
+
+static int generate(const QString& path, int count, int width, int height) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "fakepreviewstream: cannot write %s\n", qPrintable(path));
+        return 1;
+    }
+
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int frame = 0; frame < count; ++frame) {
+        for (int y = 0; y < height; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < width; ++x) {
+                line[x] = qRgb((x + frame * 8) & 0xff, (y + frame * 4) & 0xff, ((x / 32 + y / 32) & 1) * 160);
+            }
+        }
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "jpg");
+        writer.setQuality(80);
+        writer.write(image);
+        file.write(buffer.data());
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QString inputPath;
+    QString generatePath;
+    QString format = "mjpeg";
+    int width = 640;
+    int height = 480;
+    int fps = 30;
+    int maxFrames = 0;
+    int count = 60;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i + 1 < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (arg == "--input") {
+            inputPath = args.at(++i);
+        } else if (arg == "--generate") {
+            generatePath = args.at(++i);
+        } else if (arg == "--format" || arg == "--codec") {
+            format = args.at(++i);
+        } else if (arg == "--width") {
+            width = args.at(++i).toInt();
+        } else if (arg == "--height") {
+            height = args.at(++i).toInt();
+        } else if (arg == "--fps" || arg == "--framerate") {
+            fps = args.at(++i).toInt();
+        } else if (arg == "--frames") {
+            maxFrames = args.at(++i).toInt();
+        } else if (arg == "--count") {
+            count = args.at(++i).toInt();
+        }
+    }
+
+    if (!generatePath.isEmpty()) {
+        return generate(generatePath, count, width, height);
+    }
+
+    QFile input(inputPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "fakepreviewstream: cannot read %s\n", qPrintable(inputPath));
+        return 1;
+    }
+    const QByteArray data = input.readAll();
+
+    std::vector<QByteArray> frames;
+    if (format == "yuv420") {
+        const qsizetype frameBytes = static_cast<qsizetype>(width) * height * 3 / 2;
+        for (qsizetype pos = 0; pos + frameBytes <= data.size(); pos += frameBytes) {
+            frames.push_back(data.mid(pos, frameBytes));
+        }
+    } else {
+        frames = splitMjpeg(data);
+    }
+
+    if (frames.empty()) {
+        std::fprintf(stderr, "fakepreviewstream: no frames in %s\n", qPrintable(inputPath));
+        return 1;
+    }
+
+    const auto frameInterval = std::chrono::microseconds(1000000 / std::max(1, fps));
+    auto nextFrame = std::chrono::steady_clock::now();
+    for (int written = 0; maxFrames == 0 || written < maxFrames; ++written) {
+        const QByteArray& frame = frames[written % frames.size()];
+        if (std::fwrite(frame.constData(), 1, frame.size(), stdout) != static_cast<size_t>(frame.size())) {
+            return 0; // Reader went away
+        }
+        std::fflush(stdout);
+
+        nextFrame += frameInterval;
+        std::this_thread::sleep_until(nextFrame);
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+// Local stand-in for the gallery server's tus 1.0 endpoint.
+//
+//   fakeuploadserver --dir <directory> [--port N] [--drop-after-kb N] [--fail-every N] [--verbose]
+//
+// Accepts uploads at /files (creation with POST, then PATCH and HEAD on
+// /files/<id>) and keeps whatever part of a PATCH body arrived before a
+// connection dropped, as a real tus server does. Finished uploads are stored
+// under --dir by their filename metadata; .tar uploads are unpacked there.
+//
+// --drop-after-kb aborts the connection each time that much more upload data
+// has arrived, as a flaky venue Wi-Fi link would. --fail-every answers every
+// Nth request with 503. Prints "listening on <port>" once ready; port 0, the
+// default, picks a free one.
+
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QMap>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+struct Upload {
+    qint64 length = 0;
+    qint64 offset = 0;
+    QString fileName;
+    QString partPath;
+};
+
+struct Client {
+    QByteArray buffer;
+    bool inBody = false;
+    qint64 bodyRemaining = 0;
+    int status = 0;
+    QByteArray reason;
+    QList<QPair<QByteArray, QByteArray>> responseHeaders;
+    qint64 uploadId = 0;            // PATCH target, 0 to discard the body
+};
+
+static QString s_directory;
+static qint64 s_dropAfterBytes = 0;
+static int s_failEvery = 0;
+static bool s_verbose = false;
+static qint64 s_bytesSinceDrop = 0;
+static quint64 s_requests = 0;
+static qint64 s_nextId = 1;
+static std::map<qint64, Upload> s_uploads;
+static std::map<QTcpSocket*, Client> s_clients;
+
+static void log(const QString& message) {
+    if (s_verbose) {
+        std::fprintf(stderr, "fakeuploadserver: %s\n", qPrintable(message));
+    }
+}
+
+// Refuses names that would escape --dir
+static QString storagePath(const QString& name) {
+    if (name.isEmpty() || name.startsWith('/') || name.split('/').contains("..")) {
+        return QString();
+    }
+    const QString path = QDir(s_directory).filePath(name);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    return path;
+}
+
+static void unpackTar(const QString& archivePath) {
+    QFile archive(archivePath);
+    if (!archive.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    forever {
+        const QByteArray header = archive.read(512);
+        if (header.size() < 512 || header.at(0) == '\0') {
+            break;
+        }
+        const QByteArray name = header.left(100).constData();
+        const QByteArray prefix = header.mid(345, 155).constData();
+        const qint64 size = QByteArray(header.mid(124, 12).constData()).toLongLong(nullptr, 8);
+        const QByteArray data = archive.read(size);
+        archive.read((512 - size % 512) % 512);
+        const QString path = storagePath(QString::fromUtf8(prefix.isEmpty() ? name : prefix + "/" + name));
+        QFile file(path);
+        if (path.isEmpty() || !file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+            std::fprintf(stderr, "fakeuploadserver: cannot unpack %s\n", name.constData());
+            continue;
+        }
+        log(QString("stored %1, %2 bytes, from a batch").arg(path).arg(size));
+    }
+}
+
+static void finishUpload(qint64 id) {
+    const Upload& upload = s_uploads[id];
+    if (upload.fileName.endsWith(".tar")) {
+        unpackTar(upload.partPath);
+        QFile::remove(upload.partPath);
+        return;
+    }
+    const QString path = storagePath(upload.fileName);
+    QFile::remove(path);
+    if (path.isEmpty() || !QFile::rename(upload.partPath, path)) {
+        std::fprintf(stderr, "fakeuploadserver: cannot store %s\n", qPrintable(upload.fileName));
+        return;
+    }
+    log(QString("stored %1, %2 bytes").arg(path).arg(upload.length));
+}
+
+static QString metadataValue(const QByteArray& metadata, const QByteArray& key) {
+    for (const QByteArray& pair : metadata.split(',')) {
+        const QList<QByteArray> parts = pair.trimmed().split(' ');
+        if (parts.size() == 2 && parts[0] == key) {
+            return QString::fromUtf8(QByteArray::fromBase64(parts[1]));
+        }
+    }
+    return QString();
+}
+
+static void respond(QTcpSocket *socket, Client& client) {
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(client.status) + " " + client.reason + "\r\n";
+    response += "Tus-Resumable: 1.0.0\r\n";
+    for (const auto& header : std::as_const(client.responseHeaders)) {
+        response += header.first + ": " + header.second + "\r\n";
+    }
+    if (client.status != 204) {
+        response += "Content-Length: 0\r\n";
+    }
+    response += "\r\n";
+    socket->write(response);
+}
+
+static void startRequest(Client& client, const QByteArray& head) {
+    const QList<QByteArray> lines = head.split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QByteArray target = requestLine.value(1);
+    QMap<QByteArray, QByteArray> headers;
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines[i].indexOf(':');
+        if (colon > 0) {
+            headers.insert(lines[i].left(colon).trimmed().toLower(), lines[i].mid(colon + 1).trimmed());
+        }
+    }
+
+    client.inBody = true;
+    client.bodyRemaining = headers.value("content-length").toLongLong();
+    client.responseHeaders.clear();
+    client.uploadId = 0;
+    ++s_requests;
+
+    const qint64 id = target.startsWith("/files/") ? target.mid(7).toLongLong() : 0;
+    const auto upload = s_uploads.find(id);
+    if (s_failEvery > 0 && s_requests % s_failEvery == 0) {
+        client.status = 503;
+        client.reason = "Service Unavailable";
+    } else if (method == "POST" && target == "/files") {
+        Upload created;
+        created.length = headers.value("upload-length").toLongLong();
+        created.fileName = metadataValue(headers.value("upload-metadata"), "filename");
+        created.partPath = QDir(s_directory).filePath(QString(".partial/%1").arg(s_nextId));
+        QDir().mkpath(QFileInfo(created.partPath).absolutePath());
+        QFile(created.partPath).open(QIODevice::WriteOnly | QIODevice::Truncate);
+        s_uploads[s_nextId] = created;
+        client.status = 201;
+        client.reason = "Created";
+        client.responseHeaders << qMakePair(QByteArray("Location"), "/files/" + QByteArray::number(s_nextId));
+        log(QString("created %1 for %2, %3 bytes").arg(s_nextId).arg(created.fileName).arg(created.length));
+        ++s_nextId;
+    } else if (upload == s_uploads.end()) {
+        client.status = 404;
+        client.reason = "Not Found";
+    } else if (method == "HEAD") {
+        client.status = 200;
+        client.reason = "OK";
+        client.responseHeaders << qMakePair(QByteArray("Upload-Offset"), QByteArray::number(upload->second.offset))
+                               << qMakePair(QByteArray("Upload-Length"), QByteArray::number(upload->second.length))
+                               << qMakePair(QByteArray("Cache-Control"), QByteArray("no-store"));
+    } else if (method == "PATCH") {
+        if (headers.value("upload-offset").toLongLong() != upload->second.offset) {
+            client.status = 409;
+            client.reason = "Conflict";
+        } else if (upload->second.offset + client.bodyRemaining > upload->second.length) {
+            client.status = 400;
+            client.reason = "Bad Request";
+        } else {
+            client.status = 204;
+            client.reason = "No Content";
+            client.uploadId = id;
+        }
+    } else {
+        client.status = 405;
+        client.reason = "Method Not Allowed";
+    }
+}
+
+static void process(QTcpSocket *socket) {
+    Client& client = s_clients[socket];
+    forever {
+        if (!client.inBody) {
+            const qsizetype end = client.buffer.indexOf("\r\n\r\n");
+            if (end < 0) {
+                return;
+            }
+            startRequest(client, client.buffer.left(end));
+            client.buffer.remove(0, end + 4);
+        }
+
+        qint64 take = std::min<qint64>(client.bodyRemaining, client.buffer.size());
+        bool drop = false;
+        if (s_dropAfterBytes > 0 && s_bytesSinceDrop + take >= s_dropAfterBytes && take > 0) {
+            take = s_dropAfterBytes - s_bytesSinceDrop;
+            drop = true;
+        }
+        if (take > 0 && client.uploadId != 0) {
+            Upload& upload = s_uploads[client.uploadId];
+            QFile part(upload.partPath);
+            if (part.open(QIODevice::Append)) {
+                part.write(client.buffer.constData(), take);
+                upload.offset += take;
+            }
+        }
+        s_bytesSinceDrop += take;
+        client.bodyRemaining -= take;
+        client.buffer.remove(0, take);
+        if (drop) {
+            log(QString("dropping connection, upload %1 at %2").arg(client.uploadId)
+                .arg(client.uploadId ? s_uploads[client.uploadId].offset : 0));
+            s_bytesSinceDrop = 0;
+            socket->abort();
+            return;
+        }
+        if (client.bodyRemaining > 0) {
+            return;
+        }
+
+        if (client.uploadId != 0) {
+            const Upload& upload = s_uploads[client.uploadId];
+            client.responseHeaders << qMakePair(QByteArray("Upload-Offset"), QByteArray::number(upload.offset));
+            if (upload.offset == upload.length) {
+                finishUpload(client.uploadId);
+            }
+        }
+        respond(socket, client);
+        client.inBody = false;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    int port = 0;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (arg == "--verbose") {
+            s_verbose = true;
+        } else if (i + 1 >= args.size()) {
+            break;
+        } else if (arg == "--dir") {
+            s_directory = args.at(++i);
+        } else if (arg == "--port") {
+            port = args.at(++i).toInt();
+        } else if (arg == "--drop-after-kb") {
+            s_dropAfterBytes = args.at(++i).toLongLong() * 1024;
+        } else if (arg == "--fail-every") {
+            s_failEvery = args.at(++i).toInt();
+        }
+    }
+    if (s_directory.isEmpty() || !QDir().mkpath(s_directory)) {
+        std::fprintf(stderr, "fakeuploadserver: --dir is required\n");
+        return 1;
+    }
+
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost, static_cast<quint16>(port))) {
+        std::fprintf(stderr, "fakeuploadserver: cannot listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    QObject::connect(&server, &QTcpServer::newConnection, [&server]() {
+        while (QTcpSocket *socket = server.nextPendingConnection()) {
+            s_clients[socket] = Client();
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+                s_clients[socket].buffer += socket->readAll();
+                process(socket);
+            });
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, [socket]() {
+                s_clients.erase(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+
+    std::printf("listening on %d\n", server.serverPort());
+    std::fflush(stdout);
+    return app.exec();
+}
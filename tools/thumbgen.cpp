@@ -0,0 +1,122 @@
+// Build-time generator for the choice-screen thumbnails.
+//
+//   thumbgen --size <N> --output <file.cpp> <key>=<image> [<key>=<image> ...]
+//
+// Each image is scaled to fit N x N exactly as MainWindow would at runtime
+// (KeepAspectRatio, SmoothTransformation), converted to premultiplied ARGB and
+// stacked into a single atlas. The atlas is written as a C++ source file that
+// defines the tables declared in src/choicethumbnails.h, so the app links the
+// ready-to-paint pixels instead of decoding and resampling JPEGs at startup.
+// Pixels are emitted as 32-bit words, which keeps the output endian-neutral.
+
+#include <QCoreApplication>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+struct Thumbnail {
+    QByteArray key;
+    QImage image;
+    int y;
+};
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    int size = 150;
+    QString outputPath;
+    std::vector<Thumbnail> thumbnails;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (arg == "--size" && i + 1 < args.size()) {
+            size = args.at(++i).toInt();
+        } else if (arg == "--output" && i + 1 < args.size()) {
+            outputPath = args.at(++i);
+        } else if (arg.contains('=')) {
+            const QString key = arg.section('=', 0, 0);
+            const QString path = arg.section('=', 1);
+
+            QImageReader reader(path);
+            QImage image = reader.read();
+            if (image.isNull()) {
+                std::fprintf(stderr, "thumbgen: cannot read %s: %s\n",
+                             qPrintable(path), qPrintable(reader.errorString()));
+                return 1;
+            }
+            image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                         .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            thumbnails.push_back({key.toLatin1(), image, 0});
+        } else {
+            std::fprintf(stderr, "thumbgen: unexpected argument %s\n", qPrintable(arg));
+            return 1;
+        }
+    }
+
+    if (outputPath.isEmpty() || size <= 0 || thumbnails.empty()) {
+        std::fprintf(stderr, "usage: thumbgen --size N --output file.cpp key=image...\n");
+        return 1;
+    }
+
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    for (Thumbnail& thumbnail : thumbnails) {
+        thumbnail.y = atlasHeight;
+        atlasWidth = std::max(atlasWidth, thumbnail.image.width());
+        atlasHeight += thumbnail.image.height();
+    }
+
+    QByteArray out;
+    out += "// Generated by thumbgen at build time. Do not edit.\n\n";
+    out += "#include \"choicethumbnails.h\"\n\n";
+    out += "namespace ChoiceThumbnailData {\n\n";
+    out += "const int BOUND = " + QByteArray::number(size) + ";\n";
+    out += "const int ATLAS_WIDTH = " + QByteArray::number(atlasWidth) + ";\n";
+    out += "const int ATLAS_HEIGHT = " + QByteArray::number(atlasHeight) + ";\n";
+    out += "const int COUNT = " + QByteArray::number(static_cast<int>(thumbnails.size())) + ";\n\n";
+
+    out += "const Entry ENTRIES[] = {\n";
+    for (const Thumbnail& thumbnail : thumbnails) {
+        out += "    {\"" + thumbnail.key + "\", 0, " + QByteArray::number(thumbnail.y) + ", "
+               + QByteArray::number(thumbnail.image.width()) + ", "
+               + QByteArray::number(thumbnail.image.height()) + "},\n";
+    }
+    out += "};\n\n";
+
+    // Unused atlas area stays transparent
+    out += "alignas(16) const quint32 ATLAS[] = {\n";
+    char word[16];
+    int column = 0;
+    for (const Thumbnail& thumbnail : thumbnails) {
+        for (int y = 0; y < thumbnail.image.height(); ++y) {
+            const quint32* line = reinterpret_cast<const quint32*>(thumbnail.image.constScanLine(y));
+            for (int x = 0; x < atlasWidth; ++x) {
+                quint32 pixel = x < thumbnail.image.width() ? line[x] : 0u;
+                std::snprintf(word, sizeof(word), "0x%08xu,", pixel);
+                out += column == 0 ? "    " : " ";
+                out += word;
+                if (++column == 8) {
+                    out += '\n';
+                    column = 0;
+                }
+            }
+        }
+    }
+    out += column ? "\n};\n\n" : "};\n\n";
+    out += "} // namespace ChoiceThumbnailData\n";
+
+    QSaveFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+        std::fprintf(stderr, "thumbgen: cannot write %s\n", qPrintable(outputPath));
+        return 1;
+    }
+
+    std::printf("thumbgen: %d thumbnails, %dx%d atlas, %.1f KiB\n", static_cast<int>(thumbnails.size()),
+                atlasWidth, atlasHeight, atlasWidth * atlasHeight * 4 / 1024.0);
+    return 0;
+}